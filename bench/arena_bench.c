@@ -0,0 +1,190 @@
+/*
+ * Benchmark for the per-array arena.
+ *
+ * Builds the model of a 64-antenna array (teams, hosts, engines, devices and sensors, following conf/sensor_list.conf, plus the
+ * sensor index) the way array_activate() does, and tears it down again. The number of calls made to the system allocator, the time
+ * taken and the resident set size are reported for each step, and the whole cycle is repeated to show whether memory comes back.
+ *
+ * Build and run with "make bench".
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "arena.h"
+#include "team.h"
+#include "sensor.h"
+#include "sensor_index.h"
+#include "sensor_table.h"
+
+#define N_ANTENNAS 64
+#define N_ENGINES 4
+#define CYCLES 5
+
+/// The fhost and xhost device lines from sensor_list.conf.
+static char *fhost_devices[] = {"network", "spead-rx", "network-reorder", "dig", "sync", "cd", "pfb", "quant", "ct", "spead-tx"};
+static char *xhost_devices[] = {"network", "spead-rx", "network-reorder", "missing-pkts"};
+/// The xhost.xeng.* lines.
+static char *xeng_devices[] = {"bram-reorder", "vacc", "spead-tx"};
+
+
+/********   SECTION    ***********
+ * Counting calls to the allocator. These wrap glibc's own functions, so everything in the process is counted.
+ *********************************/
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+static size_t allocations = 0;
+static size_t frees = 0;
+
+void *malloc(size_t size)
+{
+    allocations++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+    allocations++;
+    return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    allocations++;
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr)
+{
+    if (ptr != NULL)
+        frees++;
+    __libc_free(ptr);
+}
+
+
+static double now_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec * 1e3 + (double) ts.tv_nsec / 1e6;
+}
+
+
+/**
+ * \fn      static long rss_kib()
+ * \details Read the process's resident set size from /proc.
+ */
+static long rss_kib()
+{
+    long pages_total, pages_resident;
+    FILE *statm = fopen("/proc/self/statm", "r");
+    if (statm == NULL)
+        return -1;
+    int r = fscanf(statm, "%ld %ld", &pages_total, &pages_resident);
+    fclose(statm);
+    if (r != 2)
+        return -1;
+    return pages_resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+
+/**
+ * \fn      static size_t build_tree(struct sensor_table *table, struct team **teams, struct sensor_index *index)
+ * \details Build the f and x teams of a 64-antenna array and index every sensor, as array_activate() would.
+ * \return  The number of sensors created.
+ */
+static size_t build_tree(struct sensor_table *table, struct team **teams, struct sensor_index *index)
+{
+    char name[64];
+    char sensor_name[32];
+    char engine_name[16];
+    size_t n_sensors = 0;
+    size_t i, j, k;
+
+    teams[0] = team_create('f', N_ANTENNAS, table);
+    teams[1] = team_create('x', N_ANTENNAS, table);
+
+    for (i = 0; i < N_ANTENNAS; i++)
+    {
+        for (j = 0; j < sizeof(fhost_devices)/sizeof(*fhost_devices); j++)
+        {
+            team_add_device_sensor(teams[0], i, fhost_devices[j], "device-status");
+            snprintf(name, sizeof(name), "fhost%02zu.%s.device-status", i, fhost_devices[j]);
+            sensor_index_insert(index, name, team_find_sensor(teams[0], i, fhost_devices[j], "device-status"));
+            n_sensors++;
+        }
+        for (j = 0; j < sizeof(xhost_devices)/sizeof(*xhost_devices); j++)
+        {
+            team_add_device_sensor(teams[1], i, xhost_devices[j], "device-status");
+            snprintf(name, sizeof(name), "xhost%02zu.%s.device-status", i, xhost_devices[j]);
+            sensor_index_insert(index, name, team_find_sensor(teams[1], i, xhost_devices[j], "device-status"));
+            n_sensors++;
+        }
+        for (j = 0; j < N_ANTENNAS; j++)
+        {
+            snprintf(sensor_name, sizeof(sensor_name), "fhost%02zu-cnt", j);
+            team_add_device_sensor(teams[1], i, "missing-pkts", sensor_name);
+            snprintf(name, sizeof(name), "xhost%02zu.missing-pkts.%s", i, sensor_name);
+            sensor_index_insert(index, name, team_find_sensor(teams[1], i, "missing-pkts", sensor_name));
+            n_sensors++;
+        }
+        for (k = 0; k < N_ENGINES; k++)
+        {
+            snprintf(engine_name, sizeof(engine_name), "xeng%zu", k);
+            for (j = 0; j < sizeof(xeng_devices)/sizeof(*xeng_devices); j++)
+            {
+                team_add_engine_device_sensor(teams[1], i, engine_name, xeng_devices[j], "device-status");
+                snprintf(name, sizeof(name), "xhost%02zu.%s.%s.device-status", i, engine_name, xeng_devices[j]);
+                sensor_index_insert(index, name, team_find_engine_sensor(teams[1], i, engine_name, xeng_devices[j], "device-status"));
+                n_sensors++;
+            }
+        }
+    }
+    return n_sensors;
+}
+
+
+int main()
+{
+    printf("Model of a %d-antenna array, built and torn down %d times.\n\n", N_ANTENNAS, CYCLES);
+    printf("%6s %10s %12s %10s %10s %12s %10s %10s\n", "cycle", "sensors", "build allocs", "build ms", "RSS KiB", "free calls", "free ms", "RSS KiB");
+
+    long rss_start = rss_kib();
+    int cycle;
+    for (cycle = 0; cycle < CYCLES; cycle++)
+    {
+        struct team *teams[2];
+
+        size_t allocations_before = allocations;
+        double start = now_ms();
+        struct arena *arena = arena_create(0);
+        struct sensor_table *table = sensor_table_create(arena, NULL, NULL);
+        struct sensor_index *index = sensor_index_create(arena);
+        size_t n_sensors = build_tree(table, teams, index);
+        double build_ms = now_ms() - start;
+        size_t build_allocations = allocations - allocations_before;
+        long rss_built = rss_kib();
+
+        size_t frees_before = frees;
+        start = now_ms();
+        sensor_index_destroy(index);
+        sensor_table_destroy(table);
+        arena_destroy(arena);
+        double teardown_ms = now_ms() - start;
+        size_t teardown_frees = frees - frees_before;
+        long rss_freed = rss_kib();
+
+        printf("%6d %10zu %12zu %10.2f %10ld %12zu %10.2f %10ld\n", cycle, n_sensors, build_allocations, build_ms, rss_built,
+                teardown_frees, teardown_ms, rss_freed);
+    }
+    printf("\nRSS at start: %ld KiB.\n", rss_start);
+    return 0;
+}
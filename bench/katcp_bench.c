@@ -0,0 +1,262 @@
+/*
+ * Benchmark for handling sensor informs on the monitor connection.
+ *
+ * Records a stream of #sensor-status informs for the sensors of a 64-antenna array (following conf/sensor_list.conf), the way the
+ * corr2_sensor_servlet sends them, then plays it back through a katcl_line into the array's model. The handling is done twice: the
+ * way the monitor path used to do it, fetching the same arguments from katcl several times and working out the message with strcmp
+ * chains, and with the single-pass dispatcher from katcp_dispatch.h. Messages per second are reported for each.
+ *
+ * Only the argument fetching and the matching of message and sensor names are compared. By the time the dispatcher came in, the
+ * sensors were already looked up in the sensor_index rather than by tokenising the name and strndup()ing the host number, so both
+ * handlers find them the same way. The hostname-functional-mapping, whose parsing still strdup()s and strndup()s, is sent once per
+ * array and isn't in the recording.
+ *
+ * Build and run with "make bench".
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <katcl.h>
+
+#include "arena.h"
+#include "team.h"
+#include "sensor.h"
+#include "sensor_index.h"
+#include "sensor_table.h"
+#include "katcp_dispatch.h"
+
+#define N_ANTENNAS 64
+#define N_ENGINES 4
+#define N_INFORMS 1000000
+#define RUNS 5
+
+/// The fhost and xhost device lines from sensor_list.conf.
+static char *fhost_devices[] = {"network", "spead-rx", "network-reorder", "dig", "sync", "cd", "pfb", "quant", "ct", "spead-tx"};
+static char *xhost_devices[] = {"network", "spead-rx", "network-reorder", "missing-pkts"};
+/// The xhost.xeng.* lines.
+static char *xeng_devices[] = {"bram-reorder", "vacc", "spead-tx"};
+/// Statuses as they turn up in practice: mostly nominal.
+static char *statuses[] = {"nominal", "nominal", "nominal", "nominal", "nominal", "nominal", "warn", "error"};
+
+
+static double now_s()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+
+/**
+ * \fn      static size_t build_model(struct sensor_table *table, struct sensor_index *index, char ***names)
+ * \details Build the f and x teams of a 64-antenna array and index every sensor, as array_activate() would.
+ * \return  The number of sensors, whose full names are put in a newly-allocated list.
+ */
+static size_t build_model(struct sensor_table *table, struct sensor_index *index, char ***names)
+{
+    char name[64];
+    char sensor_name[32];
+    char engine_name[16];
+    size_t n_sensors = 0;
+    size_t i, j, k;
+    struct team *fteam = team_create('f', N_ANTENNAS, table);
+    struct team *xteam = team_create('x', N_ANTENNAS, table);
+    *names = malloc(sizeof(**names)*N_ANTENNAS*(10 + 4 + N_ANTENNAS + N_ENGINES*3));
+
+    for (i = 0; i < N_ANTENNAS; i++)
+    {
+        for (j = 0; j < sizeof(fhost_devices)/sizeof(*fhost_devices); j++)
+        {
+            team_add_device_sensor(fteam, i, fhost_devices[j], "device-status");
+            snprintf(name, sizeof(name), "fhost%02zu.%s.device-status", i, fhost_devices[j]);
+            sensor_index_insert(index, name, team_find_sensor(fteam, i, fhost_devices[j], "device-status"));
+            (*names)[n_sensors++] = strdup(name);
+        }
+        for (j = 0; j < sizeof(xhost_devices)/sizeof(*xhost_devices); j++)
+        {
+            team_add_device_sensor(xteam, i, xhost_devices[j], "device-status");
+            snprintf(name, sizeof(name), "xhost%02zu.%s.device-status", i, xhost_devices[j]);
+            sensor_index_insert(index, name, team_find_sensor(xteam, i, xhost_devices[j], "device-status"));
+            (*names)[n_sensors++] = strdup(name);
+        }
+        for (j = 0; j < N_ANTENNAS; j++)
+        {
+            snprintf(sensor_name, sizeof(sensor_name), "fhost%02zu-cnt", j);
+            team_add_device_sensor(xteam, i, "missing-pkts", sensor_name);
+            snprintf(name, sizeof(name), "xhost%02zu.missing-pkts.%s", i, sensor_name);
+            sensor_index_insert(index, name, team_find_sensor(xteam, i, "missing-pkts", sensor_name));
+            (*names)[n_sensors++] = strdup(name);
+        }
+        for (k = 0; k < N_ENGINES; k++)
+        {
+            snprintf(engine_name, sizeof(engine_name), "xeng%zu", k);
+            for (j = 0; j < sizeof(xeng_devices)/sizeof(*xeng_devices); j++)
+            {
+                team_add_engine_device_sensor(xteam, i, engine_name, xeng_devices[j], "device-status");
+                snprintf(name, sizeof(name), "xhost%02zu.%s.%s.device-status", i, engine_name, xeng_devices[j]);
+                sensor_index_insert(index, name, team_find_engine_sensor(xteam, i, engine_name, xeng_devices[j], "device-status"));
+                (*names)[n_sensors++] = strdup(name);
+            }
+        }
+    }
+    return n_sensors;
+}
+
+
+/**
+ * \fn      static time_t parse_timestamp(char *timestamp)
+ * \details The same as array_parse_katcp_timestamp().
+ */
+static time_t parse_timestamp(char *timestamp)
+{
+    if (timestamp == NULL)
+        return 0;
+    double seconds = strtod(timestamp, NULL);
+    if (seconds > 1e11)
+        seconds /= 1000;
+    return seconds > 0 ? (time_t) seconds : 0;
+}
+
+
+/**
+ * \fn      static void handle_before(struct katcl_line *line, struct sensor_index *index)
+ * \details The inform handling as the monitor path did it just before the dispatcher: the same arguments fetched several times and the
+ *          names matched with strcmp(), but the sensor already found through the sensor_index.
+ */
+static void handle_before(struct katcl_line *line, struct sensor_index *index)
+{
+    char received_message_type = arg_string_katcl(line, 0)[0];
+    switch (received_message_type) {
+        case '#':
+            if (!strcmp(arg_string_katcl(line, 0) + 1, "sensor-status") || !strcmp(arg_string_katcl(line, 0) + 1, "sensor-value"))
+            {
+                if (!strcmp(arg_string_katcl(line, 3), "hostname-functional-mapping"))
+                {
+                    //Never happens here.
+                }
+                else
+                {
+                    struct sensor *this_sensor = sensor_index_find(index, arg_string_katcl(line, 3));
+                    if (this_sensor != NULL)
+                    {
+                        char *new_value = arg_string_katcl(line, 5);
+                        if (new_value == NULL)
+                            new_value = "none";
+                        sensor_update_timestamped(this_sensor, new_value, sensor_status_from_string(arg_string_katcl(line, 4)),
+                                parse_timestamp(arg_string_katcl(line, 1)));
+                    }
+                }
+            }
+            break;
+        default:
+            ;
+    }
+}
+
+
+/**
+ * \fn      static void handle_after(struct katcl_line *line, struct sensor_index *index)
+ * \details The inform handling as the monitor path does it now, with the dispatcher.
+ */
+static void handle_after(struct katcl_line *line, struct sensor_index *index)
+{
+    struct katcp_dispatch message;
+    if (katcp_dispatch_read(line, &message) < 0)
+        return;
+    if (message.type == '#')
+    {
+        switch (message.name)
+        {
+            case KATCP_SENSOR_STATUS:
+            case KATCP_SENSOR_VALUE:
+                {
+                    struct sensor *this_sensor = sensor_index_find(index, message.args[3]);
+                    if (this_sensor != NULL)
+                        sensor_update_timestamped(this_sensor, message.args[5] != NULL ? message.args[5] : "none",
+                                sensor_status_from_string(message.args[4]), parse_timestamp(message.args[1]));
+                    else if (message.args[3] != NULL && !strcmp(message.args[3], "hostname-functional-mapping"))
+                        ; //Never happens here.
+                }
+                break;
+            default:
+                ;
+        }
+    }
+}
+
+
+/**
+ * \fn      static double play_back(FILE *recording, struct sensor_index *index, void (*handle)(struct katcl_line*, struct sensor_index*))
+ * \details Feed the recorded informs through a katcl_line and handle each one.
+ * \return  The time taken, in seconds.
+ */
+static double play_back(FILE *recording, struct sensor_index *index, void (*handle)(struct katcl_line*, struct sensor_index*))
+{
+    rewind(recording);
+    lseek(fileno(recording), 0, SEEK_SET);
+    struct katcl_line *line = create_katcl(fileno(recording));
+    double start = now_s();
+    while (read_katcl(line) == 0)
+    {
+        while (have_katcl(line) > 0)
+            handle(line, index);
+    }
+    double elapsed = now_s() - start;
+    destroy_katcl(line, 0);
+    return elapsed;
+}
+
+
+int main()
+{
+    struct arena *arena = arena_create(0);
+    struct sensor_table *table = sensor_table_create(arena, NULL, NULL);
+    struct sensor_index *index = sensor_index_create(arena);
+    char **names;
+    size_t n_sensors = build_model(table, index, &names);
+
+    FILE *recording = tmpfile();
+    if (recording == NULL)
+    {
+        perror("tmpfile");
+        return 1;
+    }
+    srandom(1);
+    size_t i;
+    for (i = 0; i < N_INFORMS; i++)
+    {
+        fprintf(recording, "#sensor-status %.3f 1 %s %s %ld\n", 1539165063.0 + (double) i / 1000.0, names[(size_t) random() % n_sensors],
+                statuses[(size_t) random() % (sizeof(statuses)/sizeof(*statuses))], random() % 100);
+    }
+    fflush(recording);
+
+    printf("%d recorded #sensor-status informs over %zu sensors, best of %d runs.\n\n", N_INFORMS, n_sensors, RUNS);
+    printf("%-12s %12s %14s\n", "handler", "seconds", "messages/s");
+
+    double best_before = 1e9, best_after = 1e9;
+    int run;
+    for (run = 0; run < RUNS; run++)
+    {
+        double t = play_back(recording, index, handle_before);
+        if (t < best_before)
+            best_before = t;
+        t = play_back(recording, index, handle_after);
+        if (t < best_after)
+            best_after = t;
+    }
+    printf("%-12s %12.3f %14.0f\n", "before", best_before, N_INFORMS / best_before);
+    printf("%-12s %12.3f %14.0f\n", "after", best_after, N_INFORMS / best_after);
+
+    fclose(recording);
+    for (i = 0; i < n_sensors; i++)
+        free(names[i]);
+    free(names);
+    sensor_index_destroy(index);
+    sensor_table_destroy(table);
+    arena_destroy(arena);
+    return 0;
+}
@@ -0,0 +1,184 @@
+/*
+ * Benchmark for the outgoing message queue.
+ *
+ * Pushes N ?sensor-sampling messages onto a queue, the way array_activate() does when subscribing to a large array, then pushes them
+ * all again (which the queue should recognise as duplicates and drop), then pops everything off. This is done with the queue from
+ * queue.h, and with a copy of the way the queue used to work: comparing the composed form of the new message against every message
+ * already on the queue, and deep-copying the front message and shifting the rest down on every pop. That's quadratic, so it's only
+ * run on the smaller sizes.
+ *
+ * Build and run with "make bench".
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "message.h"
+#include "queue.h"
+
+#define N_MESSAGES 100000
+/// The largest size at which the old queue is run. It takes minutes beyond this.
+#define N_BEFORE_MAX 5000
+
+
+static double now_s()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+
+/// The old queue: a plain array of messages.
+struct old_queue {
+    struct message **message_queue;
+    size_t queue_length;
+};
+
+
+/**
+ * \fn      static void old_queue_push(struct old_queue *this_queue, struct message *new_message)
+ * \details queue_push() as it used to be.
+ */
+static void old_queue_push(struct old_queue *this_queue, struct message *new_message)
+{
+    size_t i;
+    for (i = 0; i < this_queue->queue_length; i++)
+    {
+        char *already_queued = message_compose(this_queue->message_queue[i]);
+        char *composed_new_message = message_compose(new_message);
+        if (!strcmp(already_queued, composed_new_message))
+        {
+            free(already_queued);
+            free(composed_new_message);
+            message_destroy(new_message); //The old one leaked it.
+            return;
+        }
+        free(already_queued);
+        free(composed_new_message);
+    }
+    this_queue->message_queue = realloc(this_queue->message_queue, sizeof(*(this_queue->message_queue))*(this_queue->queue_length + 1));
+    char *composed_message = message_compose(new_message);
+    free(composed_message);
+    this_queue->message_queue[this_queue->queue_length++] = new_message;
+}
+
+
+/**
+ * \fn      static struct message *old_queue_pop(struct old_queue *this_queue)
+ * \details queue_pop() as it used to be.
+ */
+static struct message *old_queue_pop(struct old_queue *this_queue)
+{
+    char *composed_message = message_compose(this_queue->message_queue[0]);
+    free(composed_message);
+    struct message *front_message = message_create(message_get_type(this_queue->message_queue[0]));
+    size_t i;
+    for (i = 0; i < (size_t) message_get_number_of_words(this_queue->message_queue[0]); i++)
+        message_add_word(front_message, message_see_word(this_queue->message_queue[0], i));
+    message_destroy(this_queue->message_queue[0]);
+    memmove(&this_queue->message_queue[0], &this_queue->message_queue[1], sizeof(*(this_queue->message_queue))*(this_queue->queue_length - 1));
+    this_queue->message_queue = realloc(this_queue->message_queue, sizeof(*(this_queue->message_queue))*(this_queue->queue_length - 1));
+    this_queue->queue_length--;
+    return front_message;
+}
+
+
+/**
+ * \fn      static struct message *make_message(size_t i)
+ * \details The i'th subscription, named like the per-antenna missing-pkts sensors, which are most of them on a large array.
+ */
+static struct message *make_message(size_t i)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "xhost%02zu.missing-pkts.fhost%02zu-cnt", i / 64, i % 64);
+    if (i >= 64*64) //Beyond what a 64-antenna array has, but the names just need to be different.
+        snprintf(name, sizeof(name), "xhost%02zu.missing-pkts.fhost%02zu-cnt.%zu", (i / 64) % 64, i % 64, i / (64*64));
+    struct message *new_message = message_create('?');
+    message_add_word(new_message, "sensor-sampling");
+    message_add_word(new_message, name);
+    message_add_word(new_message, "auto");
+    return new_message;
+}
+
+
+/**
+ * \fn      static void run_after(size_t n, double *push_s, double *duplicate_s, double *pop_s)
+ * \details Time the current queue.
+ */
+static void run_after(size_t n, double *push_s, double *duplicate_s, double *pop_s)
+{
+    struct queue *this_queue = queue_create();
+    size_t i;
+    double start = now_s();
+    for (i = 0; i < n; i++)
+        queue_push(this_queue, make_message(i));
+    double pushed = now_s();
+    for (i = 0; i < n; i++)
+        queue_push(this_queue, make_message(i));
+    double duplicated = now_s();
+    if (queue_sizeof(this_queue) != n)
+        fprintf(stderr, "queue has %zu messages, expected %zu!\n", queue_sizeof(this_queue), n);
+    for (i = 0; i < n; i++)
+        message_destroy(queue_pop(this_queue));
+    double popped = now_s();
+    queue_destroy(this_queue);
+
+    *push_s = pushed - start;
+    *duplicate_s = duplicated - pushed;
+    *pop_s = popped - duplicated;
+}
+
+
+/**
+ * \fn      static void run_before(size_t n, double *push_s, double *duplicate_s, double *pop_s)
+ * \details Time the old queue.
+ */
+static void run_before(size_t n, double *push_s, double *duplicate_s, double *pop_s)
+{
+    struct old_queue this_queue = {NULL, 0};
+    size_t i;
+    double start = now_s();
+    for (i = 0; i < n; i++)
+        old_queue_push(&this_queue, make_message(i));
+    double pushed = now_s();
+    for (i = 0; i < n; i++)
+        old_queue_push(&this_queue, make_message(i));
+    double duplicated = now_s();
+    for (i = 0; i < n; i++)
+        message_destroy(old_queue_pop(&this_queue));
+    double popped = now_s();
+    free(this_queue.message_queue);
+
+    *push_s = pushed - start;
+    *duplicate_s = duplicated - pushed;
+    *pop_s = popped - duplicated;
+}
+
+
+int main()
+{
+    size_t sizes[] = {1000, N_BEFORE_MAX, N_MESSAGES};
+    printf("Pushing N sensor-sampling messages, pushing them all again as duplicates, then popping them all.\n\n");
+    printf("%-8s %8s %12s %14s %12s %12s\n", "queue", "N", "push (s)", "duplicate (s)", "pop (s)", "ops/s");
+
+    size_t k;
+    for (k = 0; k < sizeof(sizes)/sizeof(*sizes); k++)
+    {
+        double push_s, duplicate_s, pop_s;
+        if (sizes[k] <= N_BEFORE_MAX)
+        {
+            run_before(sizes[k], &push_s, &duplicate_s, &pop_s);
+            printf("%-8s %8zu %12.4f %14.4f %12.4f %12.0f\n", "before", sizes[k], push_s, duplicate_s, pop_s,
+                    3.0*(double) sizes[k]/(push_s + duplicate_s + pop_s));
+        }
+        else
+            printf("%-8s %8zu %12s %14s %12s %12s\n", "before", sizes[k], "-", "-", "-", "(too slow)");
+        run_after(sizes[k], &push_s, &duplicate_s, &pop_s);
+        printf("%-8s %8zu %12.4f %14.4f %12.4f %12.0f\n", "after", sizes[k], push_s, duplicate_s, pop_s,
+                3.0*(double) sizes[k]/(push_s + duplicate_s + pop_s));
+    }
+    return 0;
+}
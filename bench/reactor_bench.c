@@ -0,0 +1,175 @@
+/*
+ * Benchmark for the reactor.
+ *
+ * Measures the cost of a single wakeup (one ready file descriptor among many idle ones) as the total number of watched file
+ * descriptors grows. The same is done with the pselect() approach that the main loop used to take, rebuilding the fd_sets on
+ * every pass, for as far as FD_SETSIZE allows.
+ *
+ * Build and run with "make bench".
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/select.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+#include "reactor.h"
+
+#define ITERATIONS 20000
+
+/// The numbers of file descriptors to try.
+static const size_t fd_counts[] = {10, 100, 500, 1000, 2000};
+
+
+static double now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec * 1e9 + (double) ts.tv_nsec;
+}
+
+
+static void drain(struct reactor *this_reactor, int fd, uint32_t events, void *data)
+{
+    (void) this_reactor;
+    (void) events;
+    char c;
+    if (read(fd, &c, 1) == 1)
+        (*(size_t*) data)++;
+}
+
+
+/**
+ * \fn      static int make_socket_pairs(size_t n, int (*pairs)[2])
+ * \details Create n socket pairs. The first end of each is watched, the second end is used to poke it.
+ */
+static int make_socket_pairs(size_t n, int (*pairs)[2])
+{
+    size_t i;
+    for (i = 0; i < n; i++)
+    {
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, pairs[i]) < 0)
+        {
+            perror("socketpair");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+
+static void close_socket_pairs(size_t n, int (*pairs)[2])
+{
+    size_t i;
+    for (i = 0; i < n; i++)
+    {
+        close(pairs[i][0]);
+        close(pairs[i][1]);
+    }
+}
+
+
+static double bench_reactor(size_t n, int (*pairs)[2])
+{
+    struct reactor *reactor = reactor_create();
+    size_t handled = 0;
+    size_t i;
+    for (i = 0; i < n; i++)
+        reactor_add(reactor, pairs[i][0], REACTOR_READ, drain, &handled);
+
+    double start = now_ns();
+    for (i = 0; i < ITERATIONS; i++)
+    {
+        //Poke a different fd each time, so nothing benefits from being first in line.
+        if (write(pairs[(i * 7919) % n][1], "x", 1) != 1)
+            perror("write");
+        reactor_run_once(reactor, -1, NULL);
+    }
+    double elapsed = now_ns() - start;
+
+    if (handled != ITERATIONS)
+        fprintf(stderr, "reactor: only %zu of %d wakeups handled!\n", handled, ITERATIONS);
+    for (i = 0; i < n; i++)
+        reactor_remove(reactor, pairs[i][0]);
+    reactor_destroy(reactor);
+    return elapsed / ITERATIONS;
+}
+
+
+static double bench_pselect(size_t n, int (*pairs)[2])
+{
+    size_t handled = 0;
+    size_t i, j;
+
+    double start = now_ns();
+    for (i = 0; i < ITERATIONS; i++)
+    {
+        if (write(pairs[(i * 7919) % n][1], "x", 1) != 1)
+            perror("write");
+
+        //This is what the old main loop did: rebuild the set from scratch, then scan all of it.
+        fd_set rd;
+        int nfds = 0;
+        FD_ZERO(&rd);
+        for (j = 0; j < n; j++)
+        {
+            FD_SET(pairs[j][0], &rd);
+            if (pairs[j][0] > nfds)
+                nfds = pairs[j][0];
+        }
+        pselect(nfds + 1, &rd, NULL, NULL, NULL, NULL);
+        for (j = 0; j < n; j++)
+        {
+            if (FD_ISSET(pairs[j][0], &rd))
+                drain(NULL, pairs[j][0], REACTOR_READ, &handled);
+        }
+    }
+    double elapsed = now_ns() - start;
+
+    if (handled != ITERATIONS)
+        fprintf(stderr, "pselect: only %zu of %d wakeups handled!\n", handled, ITERATIONS);
+    return elapsed / ITERATIONS;
+}
+
+
+int main()
+{
+    struct rlimit rl;
+    getrlimit(RLIMIT_NOFILE, &rl);
+    rlim_t needed = 2 * fd_counts[sizeof(fd_counts)/sizeof(fd_counts[0]) - 1] + 64;
+    if (rl.rlim_cur < needed)
+    {
+        rl.rlim_cur = (rl.rlim_max < needed) ? rl.rlim_max : needed;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+
+    printf("%8s %16s %16s\n", "fds", "epoll ns/wakeup", "pselect ns/wakeup");
+    size_t k;
+    for (k = 0; k < sizeof(fd_counts)/sizeof(fd_counts[0]); k++)
+    {
+        size_t n = fd_counts[k];
+        int (*pairs)[2] = malloc(sizeof(*pairs)*n);
+        if (make_socket_pairs(n, pairs) < 0)
+        {
+            fprintf(stderr, "Unable to create %zu socket pairs, raise the open file limit.\n", n);
+            free(pairs);
+            return 1;
+        }
+
+        double epoll_cost = bench_reactor(n, pairs);
+
+        int highest_fd = pairs[n-1][0] > pairs[n-1][1] ? pairs[n-1][0] : pairs[n-1][1];
+        if (highest_fd < FD_SETSIZE)
+            printf("%8zu %16.0f %16.0f\n", n, epoll_cost, bench_pselect(n, pairs));
+        else
+            printf("%8zu %16.0f %16s\n", n, epoll_cost, "(> FD_SETSIZE)");
+
+        close_socket_pairs(n, pairs);
+        free(pairs);
+    }
+    return 0;
+}
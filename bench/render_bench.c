@@ -0,0 +1,299 @@
+/*
+ * Benchmark for rendering array pages.
+ *
+ * Builds the model of an array (following conf/sensor_list.conf) at 16, 32, 64 and 128 antennas, then renders the two big pages: the
+ * array's detail table (one row per antenna, with the fhost and xhost side by side) and the missing-pkts view (a cell for each pair of
+ * hosts). Each is rendered into a strbuf, the way the renderers now do it, and the way they used to: every piece was handed back as a
+ * string of its own and tacked onto the end of the page with realloc() and strcat(), or sprintf() at strlen(), so each piece cost as
+ * much as the page so far. The host rows themselves come from the real renderer in both cases, and the detail table isn't cached
+ * here, so that what's timed is a full render.
+ *
+ * Build and run with "make bench".
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "arena.h"
+#include "team.h"
+#include "sensor.h"
+#include "sensor_table.h"
+#include "strbuf.h"
+
+#define N_ENGINES 4
+/// Renders of each page at each size. The time reported is the average.
+#define RUNS 20
+
+/// The fhost and xhost device lines from sensor_list.conf.
+static char *fhost_devices[] = {"network", "spead-rx", "network-reorder", "dig", "sync", "cd", "pfb", "quant", "ct", "spead-tx"};
+static char *xhost_devices[] = {"network", "spead-rx", "network-reorder", "missing-pkts"};
+/// The xhost.xeng.* lines.
+static char *xeng_devices[] = {"bram-reorder", "vacc", "spead-tx"};
+
+
+static double now_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec * 1e3 + (double) ts.tv_nsec / 1e6;
+}
+
+
+/**
+ * \fn      static struct sensor **build_tree(struct sensor_table *table, struct team **teams, size_t n_antennas)
+ * \details Build the f and x teams of an array, give every sensor a value, and make a grid of the missing-pkts sensors so that the
+ *          missing-pkts view doesn't have to look them up.
+ * \return  The grid, n_antennas by n_antennas, xhosts down and fhosts across.
+ */
+static struct sensor **build_tree(struct sensor_table *table, struct team **teams, size_t n_antennas)
+{
+    char sensor_name[32];
+    char engine_name[16];
+    char input_stream[32];
+    char value[16];
+    size_t i, j, k;
+    struct sensor **grid = malloc(sizeof(*grid)*n_antennas*n_antennas);
+
+    teams[0] = team_create('f', n_antennas, table);
+    teams[1] = team_create('x', n_antennas, table);
+
+    for (i = 0; i < n_antennas; i++)
+    {
+        snprintf(input_stream, sizeof(input_stream), "ant%zu_pol%zu", i / 2, i % 2);
+        team_set_fhost_input_stream(teams[0], input_stream, i);
+        team_set_host_serial_no(teams[0], i, "020304");
+        team_set_host_serial_no(teams[1], i, "020305");
+        for (j = 0; j < sizeof(fhost_devices)/sizeof(*fhost_devices); j++)
+        {
+            team_add_device_sensor(teams[0], i, fhost_devices[j], "device-status");
+            sensor_update(team_find_sensor(teams[0], i, fhost_devices[j], "device-status"), "ok", (i + j) % 7 ? SENSOR_NOMINAL : SENSOR_WARN);
+        }
+        for (j = 0; j < sizeof(xhost_devices)/sizeof(*xhost_devices); j++)
+        {
+            team_add_device_sensor(teams[1], i, xhost_devices[j], "device-status");
+            sensor_update(team_find_sensor(teams[1], i, xhost_devices[j], "device-status"), "ok", SENSOR_NOMINAL);
+        }
+        for (j = 0; j < n_antennas; j++)
+        {
+            snprintf(sensor_name, sizeof(sensor_name), "fhost%02zu-cnt", j);
+            team_add_device_sensor(teams[1], i, "missing-pkts", sensor_name);
+            grid[i*n_antennas + j] = team_find_sensor(teams[1], i, "missing-pkts", sensor_name);
+            snprintf(value, sizeof(value), "%zu", (i*31 + j*17) % 200);
+            sensor_update(grid[i*n_antennas + j], value, (i*31 + j*17) % 200 < 150 ? SENSOR_NOMINAL : SENSOR_WARN);
+        }
+        for (k = 0; k < N_ENGINES; k++)
+        {
+            snprintf(engine_name, sizeof(engine_name), "xeng%zu", k);
+            for (j = 0; j < sizeof(xeng_devices)/sizeof(*xeng_devices); j++)
+            {
+                team_add_engine_device_sensor(teams[1], i, engine_name, xeng_devices[j], "device-status");
+                sensor_update(team_find_engine_sensor(teams[1], i, engine_name, xeng_devices[j], "device-status"), "ok", SENSOR_NOMINAL);
+            }
+        }
+    }
+    return grid;
+}
+
+
+/**
+ * \fn      static size_t detail_after(struct team **teams, size_t n_antennas, struct strbuf *html)
+ * \details The detail table as array_html_detail() renders it when none of the rows are cached.
+ */
+static size_t detail_after(struct team **teams, size_t n_antennas, struct strbuf *html)
+{
+    size_t i, j;
+    strbuf_clear(html);
+    strbuf_append(html, "\n<table>\n");
+    for (i = 0; i < n_antennas; i++)
+    {
+        strbuf_append(html, "<tr>");
+        for (j = 0; j < 2; j++)
+            team_get_host_html_detail(teams[j], i, html);
+        strbuf_append(html, "</tr>\n");
+    }
+    strbuf_append(html, "</table>\n");
+    return strbuf_get_length(html);
+}
+
+
+/**
+ * \fn      static size_t detail_before(struct team **teams, size_t n_antennas, struct strbuf *scratch)
+ * \details The detail table as it used to be put together: each host's HTML handed back as a string of its own, and strcat()ed onto
+ *          the row, and each row onto the table.
+ */
+static size_t detail_before(struct team **teams, size_t n_antennas, struct strbuf *scratch)
+{
+    size_t i, j;
+    char *array_detail = strdup("");
+    for (i = 0; i < n_antennas; i++)
+    {
+        char *row_detail = strdup("<tr>");
+        for (j = 0; j < 2; j++)
+        {
+            strbuf_clear(scratch);
+            team_get_host_html_detail(teams[j], i, scratch);
+            char *host_html_det = strdup(strbuf_see(scratch));
+            row_detail = realloc(row_detail, strlen(row_detail) + strlen(host_html_det) + 1);
+            strcat(row_detail, host_html_det);
+            free(host_html_det);
+        }
+        row_detail = realloc(row_detail, strlen(row_detail) + strlen("</tr>\n") + 1);
+        strcat(row_detail, "</tr>\n");
+        array_detail = realloc(array_detail, strlen(array_detail) + strlen(row_detail) + 1);
+        strcat(array_detail, row_detail);
+        free(row_detail);
+    }
+    char format[] = "\n<table>\n%s</table>\n";
+    ssize_t needed = snprintf(NULL, 0, format, array_detail) + 1;
+    char *final_html = malloc((size_t) needed);
+    sprintf(final_html, format, array_detail);
+    free(array_detail);
+    size_t length = strlen(final_html);
+    free(final_html);
+    return length;
+}
+
+
+/**
+ * \fn      static size_t missing_pkts_after(struct team *fhosts, struct sensor **grid, size_t n_antennas, struct strbuf *html)
+ * \details The missing-pkts view as array_html_missing_pkt_view() renders it.
+ */
+static size_t missing_pkts_after(struct team *fhosts, struct sensor **grid, size_t n_antennas, struct strbuf *html)
+{
+    size_t i, j;
+    strbuf_clear(html);
+    strbuf_append(html, "<table><tr><td> </td>");
+    for (i = 0; i < n_antennas; i++)
+        strbuf_appendf(html, "<td>f%02zu</td>", i);
+    strbuf_append(html, "</tr>\n<tr><td> </td>");
+    for (i = 0; i < n_antennas; i++)
+        strbuf_appendf(html, "<td>%s</td>", team_get_fhost_input_stream(fhosts, i));
+    strbuf_append(html, "</tr>\n");
+    for (i = 0; i < n_antennas; i++)
+    {
+        strbuf_appendf(html, "<tr><td>x%02zu</td>", i);
+        for (j = 0; j < n_antennas; j++)
+            strbuf_appendf(html, "<td class=\"%s\">%s</td>", sensor_status_to_string(sensor_get_status(grid[i*n_antennas + j])), \
+                    sensor_get_value(grid[i*n_antennas + j]));
+        strbuf_append(html, "</tr>\n");
+    }
+    strbuf_append(html, "</table>");
+    return strbuf_get_length(html);
+}
+
+
+/**
+ * \fn      static size_t missing_pkts_before(struct team *fhosts, struct sensor **grid, size_t n_antennas)
+ * \details The missing-pkts view as it used to be put together, with snprintf(NULL, ...), realloc() and sprintf() at strlen() for
+ *          every cell.
+ */
+static size_t missing_pkts_before(struct team *fhosts, struct sensor **grid, size_t n_antennas)
+{
+    size_t i, j;
+    char *top_row_html = strdup("<tr><td> </td>");
+    char *second_row_html = strdup("<tr><td> </td>");
+    char *array_html = strdup("");
+    for (i = 0; i < n_antennas; i++)
+    {
+        char top_row_format[] = "<td>f%02zu</td>";
+        char second_row_format[] = "<td>%s</td>";
+        ssize_t needed = (ssize_t) snprintf(NULL, 0, top_row_format, i) + 1;
+        needed += (ssize_t) strlen(top_row_html);
+        top_row_html = realloc(top_row_html, (size_t) needed);
+        sprintf(top_row_html + strlen(top_row_html), top_row_format, i);
+
+        needed = (ssize_t) snprintf(NULL, 0, second_row_format, team_get_fhost_input_stream(fhosts, i)) + 1;
+        needed += (ssize_t) strlen(second_row_html);
+        second_row_html = realloc(second_row_html, (size_t) needed);
+        sprintf(second_row_html + strlen(second_row_html), second_row_format, team_get_fhost_input_stream(fhosts, i));
+
+        char *host_html = strdup("");
+        for (j = 0; j < n_antennas; j++)
+        {
+            char html_format[] = "<td class=\"%s\">%s</td>";
+            char *sensor_status = sensor_status_to_string(sensor_get_status(grid[i*n_antennas + j]));
+            char *sensor_value = sensor_get_value(grid[i*n_antennas + j]);
+            needed = (ssize_t) snprintf(NULL, 0, html_format, sensor_status, sensor_value) + 1;
+            needed += (ssize_t) strlen(host_html);
+            host_html = realloc(host_html, (size_t) needed);
+            sprintf(host_html + strlen(host_html), html_format, sensor_status, sensor_value);
+        }
+        char array_format[] = "<tr><td>x%02zu</td>%s</tr>\n";
+        needed = (ssize_t) snprintf(NULL, 0, array_format, i, host_html) + 1;
+        needed += (ssize_t) strlen(array_html);
+        array_html = realloc(array_html, (size_t) needed);
+        sprintf(array_html + strlen(array_html), array_format, i, host_html);
+        free(host_html);
+    }
+    top_row_html = realloc(top_row_html, strlen(top_row_html) + strlen("</tr>\n") + 1);
+    strcat(top_row_html, "</tr>\n");
+    second_row_html = realloc(second_row_html, strlen(second_row_html) + strlen("</tr>\n") + 1);
+    strcat(second_row_html, "</tr>\n");
+
+    char final_format[] = "<table>%s%s%s</table>";
+    ssize_t needed = snprintf(NULL, 0, final_format, top_row_html, second_row_html, array_html) + 1;
+    char *final_html = malloc((size_t) needed);
+    sprintf(final_html, final_format, top_row_html, second_row_html, array_html);
+    free(array_html);
+    free(top_row_html);
+    free(second_row_html);
+    size_t length = strlen(final_html);
+    free(final_html);
+    return length;
+}
+
+
+int main()
+{
+    size_t sizes[] = {16, 32, 64, 128};
+    printf("Rendering an array's detail table and missing-pkts view, %d times each, the old way and into a strbuf.\n\n", RUNS);
+    printf("%8s %14s %12s %12s %14s %12s %12s\n", "antennas", "detail bytes", "before ms", "after ms", "mpkts bytes", "before ms", "after ms");
+
+    size_t k;
+    for (k = 0; k < sizeof(sizes)/sizeof(*sizes); k++)
+    {
+        size_t n_antennas = sizes[k];
+        struct team *teams[2];
+        struct arena *arena = arena_create(0);
+        struct sensor_table *table = sensor_table_create(arena, NULL, NULL);
+        struct sensor **grid = build_tree(table, teams, n_antennas);
+        struct strbuf *html = strbuf_create(0);
+        struct strbuf *scratch = strbuf_create(0);
+        size_t detail_length = 0, missing_pkts_length = 0;
+        int run;
+
+        double start = now_ms();
+        for (run = 0; run < RUNS; run++)
+            detail_length = detail_before(teams, n_antennas, scratch);
+        double detail_before_ms = (now_ms() - start)/RUNS;
+
+        start = now_ms();
+        for (run = 0; run < RUNS; run++)
+            if (detail_after(teams, n_antennas, html) != detail_length)
+                fprintf(stderr, "detail tables differ in length!\n");
+        double detail_after_ms = (now_ms() - start)/RUNS;
+
+        start = now_ms();
+        for (run = 0; run < RUNS; run++)
+            missing_pkts_length = missing_pkts_before(teams[0], grid, n_antennas);
+        double missing_pkts_before_ms = (now_ms() - start)/RUNS;
+
+        start = now_ms();
+        for (run = 0; run < RUNS; run++)
+            if (missing_pkts_after(teams[0], grid, n_antennas, html) != missing_pkts_length)
+                fprintf(stderr, "missing-pkts views differ in length!\n");
+        double missing_pkts_after_ms = (now_ms() - start)/RUNS;
+
+        printf("%8zu %14zu %12.3f %12.3f %14zu %12.3f %12.3f\n", n_antennas, detail_length, detail_before_ms, detail_after_ms, \
+                missing_pkts_length, missing_pkts_before_ms, missing_pkts_after_ms);
+
+        strbuf_destroy(scratch);
+        strbuf_destroy(html);
+        free(grid);
+        sensor_table_destroy(table);
+        arena_destroy(arena);
+    }
+    return 0;
+}
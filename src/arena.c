@@ -0,0 +1,168 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <syslog.h>
+
+#include "arena.h"
+
+/// The chunk size used if none is given.
+#define ARENA_DEFAULT_CHUNK_SIZE (64*1024)
+/// Everything handed out is aligned to this, which is good enough for any type the program stores.
+#define ARENA_ALIGNMENT 16
+/// The smallest number of elements that a list grown with arena_list_reserve() has room for.
+#define ARENA_MIN_LIST_CAPACITY 4
+
+
+/// A single block of memory from which allocations are carved. Chunks are kept in a singly-linked list, newest first.
+struct arena_chunk {
+    /// The previous chunk.
+    struct arena_chunk *next;
+    /// The number of bytes available in data.
+    size_t size;
+    /// The number of bytes handed out so far.
+    size_t used;
+    /// The memory itself.
+    unsigned char data[];
+};
+
+
+/// A struct to keep track of an arena's chunks.
+struct arena {
+    /// The chunk currently being allocated from, at the head of the list of all of them.
+    struct arena_chunk *current;
+    /// The size of a normal chunk. Allocations too big to fit get a chunk of their own.
+    size_t chunk_size;
+};
+
+
+/**
+ * \fn      static struct arena_chunk *arena_add_chunk(struct arena *this_arena, size_t size)
+ * \details Allocate a new chunk of at least the given size and put it at the head of the list.
+ */
+static struct arena_chunk *arena_add_chunk(struct arena *this_arena, size_t size)
+{
+    struct arena_chunk *new_chunk = malloc(sizeof(*new_chunk) + size + ARENA_ALIGNMENT);
+    if (new_chunk == NULL)
+    {
+        syslog(LOG_ERR, "Unable to allocate a %zu-byte arena chunk.", size);
+        return NULL;
+    }
+    new_chunk->size = size + ARENA_ALIGNMENT; //The extra space covers whatever is lost to aligning the first allocation.
+    new_chunk->used = 0;
+    new_chunk->next = this_arena->current;
+    this_arena->current = new_chunk;
+    return new_chunk;
+}
+
+
+/**
+ * \fn      struct arena *arena_create(size_t chunk_size)
+ * \details Create an empty arena. No memory is set aside until the first allocation.
+ * \param   chunk_size The size of the chunks in which memory will be requested from the system, 0 for the default.
+ * \return  A pointer to the newly-created arena, NULL on failure.
+ */
+struct arena *arena_create(size_t chunk_size)
+{
+    struct arena *new_arena = malloc(sizeof(*new_arena));
+    if (new_arena != NULL)
+    {
+        new_arena->current = NULL;
+        new_arena->chunk_size = chunk_size ? chunk_size : ARENA_DEFAULT_CHUNK_SIZE;
+    }
+    return new_arena;
+}
+
+
+/**
+ * \fn      void arena_destroy(struct arena *this_arena)
+ * \details Release all of the memory handed out by the arena, and the arena itself. Nothing allocated from it may be used afterwards.
+ * \param   this_arena A pointer to the arena to be destroyed.
+ * \return  void
+ */
+void arena_destroy(struct arena *this_arena)
+{
+    if (this_arena != NULL)
+    {
+        struct arena_chunk *chunk = this_arena->current;
+        while (chunk != NULL)
+        {
+            struct arena_chunk *next = chunk->next;
+            free(chunk);
+            chunk = next;
+        }
+        free(this_arena);
+    }
+}
+
+
+/**
+ * \fn      void *arena_alloc(struct arena *this_arena, size_t size)
+ * \details Allocate memory from the arena. It can't be freed on its own, only along with the whole arena.
+ * \param   this_arena A pointer to the arena in question.
+ * \param   size The number of bytes needed.
+ * \return  A pointer to the memory, aligned for any type, or NULL if no more could be had from the system.
+ */
+void *arena_alloc(struct arena *this_arena, size_t size)
+{
+    struct arena_chunk *chunk = this_arena->current;
+    size_t offset = 0;
+    if (chunk != NULL)
+    {
+        uintptr_t start = (uintptr_t) (chunk->data + chunk->used);
+        offset = chunk->used + (size_t) ((ARENA_ALIGNMENT - start % ARENA_ALIGNMENT) % ARENA_ALIGNMENT);
+    }
+    if (chunk == NULL || offset + size > chunk->size)
+    {
+        chunk = arena_add_chunk(this_arena, size > this_arena->chunk_size ? size : this_arena->chunk_size);
+        if (chunk == NULL)
+            return NULL;
+        uintptr_t start = (uintptr_t) chunk->data;
+        offset = (size_t) ((ARENA_ALIGNMENT - start % ARENA_ALIGNMENT) % ARENA_ALIGNMENT);
+    }
+    chunk->used = offset + size;
+    return chunk->data + offset;
+}
+
+
+/**
+ * \fn      char *arena_strdup(struct arena *this_arena, const char *string)
+ * \details Copy a string into the arena.
+ * \param   this_arena A pointer to the arena in question.
+ * \param   string The string to be copied.
+ * \return  A pointer to the copy, or NULL on failure.
+ */
+char *arena_strdup(struct arena *this_arena, const char *string)
+{
+    size_t length = strlen(string) + 1;
+    char *copy = arena_alloc(this_arena, length);
+    if (copy != NULL)
+        memcpy(copy, string, length);
+    return copy;
+}
+
+
+/**
+ * \fn      void *arena_list_reserve(struct arena *this_arena, void *list, size_t count, size_t element_size)
+ * \details Make sure that a list has room for one more element. The list's capacity isn't stored anywhere; it's implied by the count,
+ *          because lists grown with this function always have room for the next power of two (but at least ARENA_MIN_LIST_CAPACITY)
+ *          elements. When the list is full, it moves to a new block twice the size, and the old block is simply abandoned, so the
+ *          space wasted on a list is never more than the list itself.
+ * \param   this_arena A pointer to the arena in question.
+ * \param   list The list, or NULL if it's empty.
+ * \param   count The number of elements currently in the list.
+ * \param   element_size The size of each element.
+ * \return  A pointer to the list, which may have moved, or NULL if it needed to grow and there was no more memory.
+ */
+void *arena_list_reserve(struct arena *this_arena, void *list, size_t count, size_t element_size)
+{
+    if (count == 0 || list == NULL)
+        return arena_alloc(this_arena, ARENA_MIN_LIST_CAPACITY*element_size);
+    if (count < ARENA_MIN_LIST_CAPACITY || (count & (count - 1)) != 0)
+        return list; //Not full yet.
+
+    void *new_list = arena_alloc(this_arena, 2*count*element_size);
+    if (new_list != NULL)
+        memcpy(new_list, list, count*element_size);
+    return new_list;
+}
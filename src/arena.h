@@ -0,0 +1,22 @@
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include <stddef.h>
+
+/**
+ * \file  arena.h
+ * \brief The arena type is a bump allocator. Memory is handed out from large chunks, is never freed piece by piece, and is all released
+ *        at once when the arena is destroyed. Each array keeps its model (teams, hosts, engines, devices, sensors and their names) in
+ *        its own arena, so that tearing an array down doesn't mean thousands of calls to free().
+ */
+
+struct arena;
+
+struct arena *arena_create(size_t chunk_size);
+void arena_destroy(struct arena *this_arena);
+
+void *arena_alloc(struct arena *this_arena, size_t size);
+char *arena_strdup(struct arena *this_arena, const char *string);
+void *arena_list_reserve(struct arena *this_arena, void *list, size_t count, size_t element_size);
+
+#endif
@@ -5,6 +5,8 @@
 #include <string.h>
 #include <stdint.h>
 #include <time.h>
+#include <errno.h>
+#include <sys/socket.h>
 #include <netc.h>
 #include <katcp.h>
 #include <katcl.h>
@@ -12,19 +14,29 @@
 #include "array.h"
 #include "sensor.h"
 #include "team.h"
+#include "sensor_index.h"
+#include "arena.h"
+#include "sensor_table.h"
 #include "message.h"
 #include "queue.h"
-#include "tokenise.h"
-
-#define BUF_SIZE 1024
-#define SENSOR_LIST_CONFIG_FILE "/etc/cbf_sensor_dashboard/sensor_list.conf"
-
-#undef max
-#define max(x,y) ((x) > (y) ? (x) : (y))
+#include "reactor.h"
+#include "timers.h"
+#include "reconnect.h"
+#include "katcp_dispatch.h"
+#include "pipeline.h"
+#include "sensor_template.h"
+#include "fragment.h"
+
+/// How long a sensor may go without an update before its value is requested again, in seconds.
+#define ARRAY_STALE_S 60
+/// How often to look for stale sensors, in milliseconds.
+#define ARRAY_STALE_CHECK_MS 10000
+/// The most stale sensors to request again in one go. The rest wait for the next check; the longest-silent go first. Each one asked
+/// for isn't asked for again until it has changed (see sensor_table_park_row()).
+#define ARRAY_STALE_REQUEST_MAX 256
 
 enum array_state {
-    ARRAY_SEND_FRONT_OF_QUEUE,
-    ARRAY_WAIT_RESPONSE,
+    ARRAY_WAIT_CONNECT,
     ARRAY_MONITOR,
     ARRAY_DISCONNECTED = -1, //this must be the last thing in the enum so that it gives an error in another place.
 };
@@ -37,10 +49,20 @@ struct array {
     /// An indicator of whether the array is active or not, whether it's in need of garbage collection.
     int array_is_active;
 
+    /// Where the array's model (teams, hosts and everything below them, and the top-level sensors) is allocated, so that it can be freed in one go.
+    struct arena *arena;
+    /// The values, statuses and so on of all of the array's sensors, in flat columns which the sensor objects are views onto.
+    struct sensor_table *sensor_table;
     /// A list of top-level sensors, which do not belong to any host.
     struct sensor **top_level_sensor_list;
     /// The number of top-level sensors in the list.
     size_t num_top_level_sensors;
+    /// Every subscribed sensor (top-level or otherwise) by its full KATCP name, so that updates can go straight to it.
+    struct sensor_index *sensor_index;
+    /// The rows of the detail table as last rendered, one per antenna (its fhost and xhost side by side), until either host changes.
+    struct fragment **row_fragments;
+    /// The whole detail table as last rendered, until anything on any host changes.
+    struct fragment *table_fragment;
 
     /// A list of teams of *hosts. Currently there are only 'f' and 'x'.
     struct team **team_list;
@@ -67,8 +89,8 @@ struct array {
     enum array_state control_state;
     /// The queue for messages waiting to be sent to the corr2_servlet.
     struct queue *outgoing_control_msg_queue;
-    /// The most recently sent message.
-    struct message *current_control_message;
+    /// The messages which have been sent to the corr2_servlet and are waiting for replies.
+    struct pipeline *control_pipeline;
 
     /// The overall instrument status.
     char *instrument_state;
@@ -85,29 +107,282 @@ struct array {
     enum array_state monitor_state;
     /// The queue for messages waiting to be sent to the corr2_sensor_servlet.
     struct queue *outgoing_monitor_msg_queue;
-    /// The most recently sent message.
-    struct message *current_monitor_message;
+    /// The messages which have been sent to the corr2_sensor_servlet and are waiting for replies.
+    struct pipeline *monitor_pipeline;
 
     /// Stores whether or not we have received the hostname-functional-mapping for the array, helps save time.
     int hostname_functional_mapping_received;
+
+    /// Set once the array has been activated, so that its sensors can be subscribed to again if the monitor connection is re-established.
+    int activated;
+    /// The sensors to subscribe to on activation, from sensor_list.conf. Shared with other arrays.
+    struct sensor_template *sensor_template;
+
+    /// The reactor which watches the control and monitor file descriptors.
+    struct reactor *reactor;
+    /// The timers which drive reconnection attempts and the staleness check.
+    struct timers *timers;
+    /// Fires periodically to check for sensors which haven't been heard from in a while.
+    struct timeout *stale_check;
+    /// The backoff state for reconnecting the control connection.
+    struct reconnect *control_reconnect;
+    /// The backoff state for reconnecting the monitor connection.
+    struct reconnect *monitor_reconnect;
 };
 
 
+static void array_control_socket_event(struct reactor *this_reactor, int fd, uint32_t events, void *data);
+static void array_monitor_socket_event(struct reactor *this_reactor, int fd, uint32_t events, void *data);
+static void array_activate(struct array *this_array);
+
+
+/**
+ * \fn      static void array_control_close(struct array *this_array)
+ * \details Stop watching the control connection, close it and its katcl_line, and mark it as disconnected.
+ * \param   this_array A pointer to the array in question.
+ * \return  void
+ */
+static void array_control_close(struct array *this_array)
+{
+    if (this_array->control_fd >= 0)
+    {
+        reactor_remove(this_array->reactor, this_array->control_fd);
+        if (this_array->control_katcl_line != NULL) //because it might not have actually been connected.
+        {
+            destroy_katcl(this_array->control_katcl_line, 0);
+            this_array->control_katcl_line = NULL;
+        }
+        close(this_array->control_fd);
+        this_array->control_fd = -1;
+    }
+    this_array->control_state = ARRAY_DISCONNECTED;
+}
+
+
+/**
+ * \fn      static void array_monitor_close(struct array *this_array)
+ * \details Stop watching the monitor connection, close it and its katcl_line, and mark it as disconnected.
+ * \param   this_array A pointer to the array in question.
+ * \return  void
+ */
+static void array_monitor_close(struct array *this_array)
+{
+    if (this_array->monitor_fd >= 0)
+    {
+        reactor_remove(this_array->reactor, this_array->monitor_fd);
+        if (this_array->monitor_katcl_line != NULL)
+        {
+            destroy_katcl(this_array->monitor_katcl_line, 0);
+            this_array->monitor_katcl_line = NULL;
+        }
+        close(this_array->monitor_fd);
+        this_array->monitor_fd = -1;
+    }
+    this_array->monitor_state = ARRAY_DISCONNECTED;
+}
+
+
+/**
+ * \fn      static void array_control_reconnect_attempt(void *data)
+ * \details Start a (non-blocking) connection to the corr2_servlet, abandoning any attempt still in progress. The next attempt is scheduled
+ *          straight away, and cancelled if this one succeeds.
+ * \param   data A pointer to the array in question.
+ * \return  void
+ */
+static void array_control_reconnect_attempt(void *data)
+{
+    struct array *this_array = data;
+    array_control_close(this_array);
+    this_array->control_fd = net_connect(this_array->cmc_address, this_array->control_port, NETC_VERBOSE_ERRORS | NETC_VERBOSE_STATS | NETC_ASYNC);
+    if (this_array->control_fd >= 0 && \
+            reactor_add(this_array->reactor, this_array->control_fd, REACTOR_WRITE, array_control_socket_event, this_array) == 0)
+    {
+        this_array->control_state = ARRAY_WAIT_CONNECT;
+    }
+    else
+    {
+        syslog(LOG_ERR, "Unable to start connecting to %s:%hu (control), will retry.", this_array->cmc_address, this_array->control_port);
+        if (this_array->control_fd >= 0)
+            close(this_array->control_fd);
+        this_array->control_fd = -1;
+    }
+    reconnect_schedule(this_array->control_reconnect);
+}
+
+
+/**
+ * \fn      static void array_monitor_reconnect_attempt(void *data)
+ * \details Start a (non-blocking) connection to the corr2_sensor_servlet, abandoning any attempt still in progress. The next attempt is
+ *          scheduled straight away, and cancelled if this one succeeds.
+ * \param   data A pointer to the array in question.
+ * \return  void
+ */
+static void array_monitor_reconnect_attempt(void *data)
+{
+    struct array *this_array = data;
+    array_monitor_close(this_array);
+    this_array->monitor_fd = net_connect(this_array->cmc_address, this_array->monitor_port, NETC_VERBOSE_ERRORS | NETC_VERBOSE_STATS | NETC_ASYNC);
+    if (this_array->monitor_fd >= 0 && \
+            reactor_add(this_array->reactor, this_array->monitor_fd, REACTOR_WRITE, array_monitor_socket_event, this_array) == 0)
+    {
+        this_array->monitor_state = ARRAY_WAIT_CONNECT;
+    }
+    else
+    {
+        syslog(LOG_ERR, "Unable to start connecting to %s:%hu (monitor), will retry.", this_array->cmc_address, this_array->monitor_port);
+        if (this_array->monitor_fd >= 0)
+            close(this_array->monitor_fd);
+        this_array->monitor_fd = -1;
+    }
+    reconnect_schedule(this_array->monitor_reconnect);
+}
+
+
+/**
+ * \fn      static void array_control_connected(struct array *this_array)
+ * \details Queue up the messages which every new control connection needs. If the array has already been activated, the control-side
+ *          subscriptions are made again too, and the number of xhosts is asked for again if it's still not known, in case the last
+ *          request for it was lost along with the connection. The monitor connection looks after its own.
+ * \param   this_array A pointer to the array in question.
+ * \return  void
+ */
+static void array_control_connected(struct array *this_array)
+{
+    //Whatever was in flight when the last connection went down will never get a response.
+    pipeline_reset(this_array->control_pipeline);
+
+    struct message *new_message = message_create('?');
+    message_add_word(new_message, "log-local");
+    message_add_word(new_message, "off");
+    queue_push(this_array->outgoing_control_msg_queue, new_message);
+
+    new_message = message_create('?');
+    message_add_word(new_message, "sensor-sampling");
+    message_add_word(new_message, "instrument-state");
+    message_add_word(new_message, "auto");
+    queue_push(this_array->outgoing_control_msg_queue, new_message);
+
+    if (this_array->activated)
+    {
+        new_message = message_create('?');
+        message_add_word(new_message, "sensor-sampling");
+        message_add_word(new_message, "input-labelling");
+        message_add_word(new_message, "auto");
+        queue_push(this_array->outgoing_control_msg_queue, new_message);
+
+        //Until this is answered, failures on the xhosts can't be told apart from unused x-engines.
+        if (this_array->n_xhosts == 0)
+        {
+            new_message = message_create('?');
+            message_add_word(new_message, "sensor-value");
+            message_add_word(new_message, "n-xeng-hosts");
+            queue_push(this_array->outgoing_control_msg_queue, new_message);
+        }
+    }
+
+    this_array->control_state = ARRAY_MONITOR;
+}
+
+
+/**
+ * \fn      static void array_monitor_connected(struct array *this_array)
+ * \details Queue up the messages which every new monitor connection needs. If the array has already been activated, the sensor subscriptions
+ *          are made again too, because the corr2_sensor_servlet forgets them when the connection goes down.
+ * \param   this_array A pointer to the array in question.
+ * \return  void
+ */
+static void array_monitor_connected(struct array *this_array)
+{
+    pipeline_reset(this_array->monitor_pipeline);
+
+    struct message *new_message = message_create('?');
+    message_add_word(new_message, "log-local");
+    message_add_word(new_message, "off");
+    queue_push(this_array->outgoing_monitor_msg_queue, new_message);
+
+    this_array->monitor_state = ARRAY_MONITOR;
+    if (this_array->activated)
+    {
+        syslog(LOG_NOTICE, "%s:%s monitor connection re-established, resubscribing to sensors.", this_array->cmc_address, this_array->name);
+        array_activate(this_array);
+    }
+}
+
+
+/**
+ * \fn      static time_t array_parse_katcp_timestamp(char *timestamp)
+ * \details Work out the time of a sensor update from the timestamp of its KATCP inform. Since KATCP v5 the timestamp is in seconds
+ *          (with a fractional part); before that it was in milliseconds, which is easy to tell apart for any date since 1973.
+ * \param   timestamp The timestamp field of the inform. May be NULL.
+ * \return  The time of the update, 0 if there was no timestamp to be had.
+ */
+static time_t array_parse_katcp_timestamp(char *timestamp)
+{
+    if (timestamp == NULL)
+        return 0;
+    double seconds = strtod(timestamp, NULL);
+    if (seconds > 1e11)
+        seconds /= 1000;
+    return seconds > 0 ? (time_t) seconds : 0;
+}
+
+
+/**
+ * \fn      static void array_stale_check_due(struct timeout *this_timeout, void *data)
+ * \details Request the values of the sensors which haven't been heard from for a while, by name, just in case some updates were
+ *          missed. Nothing is requested while the monitor connection still has requests waiting or unanswered, e.g. the subscriptions
+ *          or the previous batch. The sensors asked for are parked until they change, so that one which is subscribed with the "auto"
+ *          strategy and simply never changes is asked for once, not every time it goes quiet again. Then schedule the next check.
+ * \param   this_timeout A pointer to the timeout which fired.
+ * \param   data A pointer to the array in question.
+ * \return  void
+ */
+static void array_stale_check_due(struct timeout *this_timeout, void *data)
+{
+    struct array *this_array = data;
+    if (this_array->activated && !queue_sizeof(this_array->outgoing_monitor_msg_queue) && !pipeline_get_in_flight(this_array->monitor_pipeline))
+    {
+        size_t stale_rows[ARRAY_STALE_REQUEST_MAX];
+        size_t n_stale_rows = sensor_table_get_stale_rows(this_array->sensor_table, (uint64_t) ARRAY_STALE_S*1000, stale_rows, ARRAY_STALE_REQUEST_MAX);
+        size_t i;
+        for (i = 0; i < n_stale_rows; i++)
+        {
+            struct message *new_message = message_create('?');
+            message_add_word(new_message, "sensor-value");
+            message_add_word(new_message, sensor_table_get_full_name(this_array->sensor_table, stale_rows[i]));
+            queue_push(this_array->outgoing_monitor_msg_queue, new_message);
+            sensor_table_park_row(this_array->sensor_table, stale_rows[i]);
+        }
+        if (n_stale_rows)
+            syslog(LOG_DEBUG, "Array %s asked again for %zu stale sensor%s.", this_array->name, n_stale_rows, n_stale_rows == 1 ? "" : "s");
+    }
+    timeout_schedule(this_timeout, ARRAY_STALE_CHECK_MS);
+}
+
+
 /**
- * \fn      struct array *array_create(char *new_array_name, char *cmc_address, uint16_t control_port, uint16_t monitor_port, size_t n_antennas)
- * \details Allocate memory for a new array object, create teams with hosts, queue up a few messages to send.
+ * \fn      struct array *array_create(char *new_array_name, char *cmc_address, uint16_t control_port, uint16_t monitor_port, size_t n_antennas, struct reactor *reactor, struct timers *timers, struct history_pool *history_pool, struct sensor_template *sensor_template, size_t request_window)
+ * \details Allocate memory for a new array object, create teams with hosts, and start connecting. A few messages are queued to send each
+ *          time a connection is made.
  * \param   new_array_name A string containing the name for the new array.
  * \param   cmc_address A string containing the IP or (resolvable) hostname of the CMC server.
  * \param   control_port The TCP port that the correlator's corr2_servlet is listening to.
  * \param   monitor_port The TCP port that the correlator's corr2_sensor_servlet is listening to.
  * \param   n_antennas The number of antennas, or the size of the correlator.
+ * \param   reactor The reactor with which to register the array's file descriptors.
+ * \param   timers The timers which will drive reconnection attempts and the staleness check.
+ * \param   history_pool The pool from which the array's sensors get their history rings, shared with other arrays.
+ * \param   sensor_template The sensors to subscribe to when the array is activated, shared with other arrays.
+ * \param   request_window The most requests to have in flight on each connection, if the servlets support message IDs.
  * \return  A pointer to the newly-allocated array object.
  */
-struct array *array_create(char *new_array_name, char *cmc_address, uint16_t control_port, uint16_t monitor_port, size_t n_antennas)
+struct array *array_create(char *new_array_name, char *cmc_address, uint16_t control_port, uint16_t monitor_port, size_t n_antennas, struct reactor *reactor, struct timers *timers, struct history_pool *history_pool, struct sensor_template *sensor_template, size_t request_window)
 {
    struct array *new_array = malloc(sizeof(*new_array));
    if (new_array != NULL)
    {
+        new_array->reactor = reactor;
+        new_array->timers = timers;
         new_array->name = strdup(new_array_name);
         new_array->array_is_active = 1;
         new_array->n_antennas = n_antennas;
@@ -117,48 +392,46 @@ struct array *array_create(char *new_array_name, char *cmc_address, uint16_t con
         new_array->last_updated = time(0);
 
         new_array->control_port = control_port;
-        new_array->control_fd = net_connect(cmc_address, control_port, NETC_VERBOSE_ERRORS | NETC_VERBOSE_STATS);
-        new_array->control_katcl_line = create_katcl(new_array->control_fd);
+        new_array->control_fd = -1;
+        new_array->control_katcl_line = NULL; //created once the connection completes.
         new_array->outgoing_control_msg_queue = queue_create();
-
-        struct message *new_message = message_create('?');
-        message_add_word(new_message, "log-local");
-        message_add_word(new_message, "off");
-        queue_push(new_array->outgoing_control_msg_queue, new_message);
-
-        new_message = message_create('?');
-        message_add_word(new_message, "sensor-sampling");
-        message_add_word(new_message, "instrument-state");
-        message_add_word(new_message, "auto");
-        queue_push(new_array->outgoing_control_msg_queue, new_message);
+        new_array->control_pipeline = pipeline_create(request_window);
+        new_array->control_reconnect = reconnect_create(timers, RECONNECT_INITIAL_MS, RECONNECT_MAX_MS, array_control_reconnect_attempt, new_array);
         new_array->instrument_state = strdup("-");
         new_array->config_file = strdup("-");
-        new_array->current_control_message = NULL;
-        array_control_queue_pop(new_array);
-        new_array->control_state = ARRAY_SEND_FRONT_OF_QUEUE;
 
         new_array->monitor_port = monitor_port;
-        new_array->monitor_fd = net_connect(cmc_address, monitor_port, NETC_VERBOSE_ERRORS | NETC_VERBOSE_STATS);
-        new_array->monitor_katcl_line = create_katcl(new_array->monitor_fd);
+        new_array->monitor_fd = -1;
+        new_array->monitor_katcl_line = NULL; //created once the connection completes.
         new_array->outgoing_monitor_msg_queue = queue_create();
+        new_array->monitor_pipeline = pipeline_create(request_window);
+        new_array->monitor_reconnect = reconnect_create(timers, RECONNECT_INITIAL_MS, RECONNECT_MAX_MS, array_monitor_reconnect_attempt, new_array);
 
-        new_message = message_create('?');
-        message_add_word(new_message, "log-local");
-        message_add_word(new_message, "off");
-        queue_push(new_array->outgoing_monitor_msg_queue, new_message);
-        new_array->current_monitor_message = NULL;
-        array_monitor_queue_pop(new_array);
-        new_array->monitor_state = ARRAY_SEND_FRONT_OF_QUEUE;
-
+        new_array->arena = arena_create(0);
+        new_array->sensor_table = sensor_table_create(new_array->arena, history_pool, timers);
         new_array->top_level_sensor_list = NULL;
         new_array->num_top_level_sensors = 0;
+        new_array->sensor_index = sensor_index_create(new_array->arena);
+        new_array->row_fragments = malloc(sizeof(*(new_array->row_fragments))*n_antennas);
+        size_t i;
+        for (i = 0; i < n_antennas; i++)
+            new_array->row_fragments[i] = fragment_create();
+        new_array->table_fragment = fragment_create();
 
         new_array->number_of_teams = 2;
-        new_array->team_list = malloc(sizeof(new_array->team_list)*(new_array->number_of_teams));
-        new_array->team_list[0] = team_create('f', new_array->n_antennas);
-        new_array->team_list[1] = team_create('x', new_array->n_antennas);
+        new_array->team_list = arena_list_reserve(new_array->arena, NULL, 0, sizeof(*(new_array->team_list)));
+        new_array->team_list[0] = team_create('f', new_array->n_antennas, new_array->sensor_table);
+        new_array->team_list[1] = team_create('x', new_array->n_antennas, new_array->sensor_table);
 
         new_array->hostname_functional_mapping_received = 0;
+        new_array->activated = 0;
+        new_array->sensor_template = sensor_template;
+
+        new_array->stale_check = timeout_create(timers, array_stale_check_due, new_array);
+        timeout_schedule(new_array->stale_check, ARRAY_STALE_CHECK_MS);
+
+        array_control_reconnect_attempt(new_array);
+        array_monitor_reconnect_attempt(new_array);
    }
    return new_array;
 }
@@ -177,28 +450,25 @@ void array_destroy(struct array *this_array)
         free(this_array->cmc_address);
         free(this_array->name);
 
+        sensor_index_destroy(this_array->sensor_index);
         size_t i;
-        for (i = 0; i < this_array->num_top_level_sensors; i++)
-        {
-            sensor_destroy(this_array->top_level_sensor_list[i]);
-        }
-        free(this_array->top_level_sensor_list);
-
-        for (i = 0; i < this_array->number_of_teams; i++)
-        {
-            team_destroy(this_array->team_list[i]);
-        }
-        free(this_array->team_list);
-
-        destroy_katcl(this_array->control_katcl_line, 1);
-        close(this_array->control_fd);
+        for (i = 0; i < this_array->n_antennas; i++)
+            fragment_destroy(this_array->row_fragments[i]);
+        free(this_array->row_fragments);
+        fragment_destroy(this_array->table_fragment);
+        sensor_table_destroy(this_array->sensor_table);
+        arena_destroy(this_array->arena); //Takes the teams, hosts and sensors with it, all at once.
+
+        timeout_destroy(this_array->stale_check);
+        reconnect_destroy(this_array->control_reconnect);
+        array_control_close(this_array);
         queue_destroy(this_array->outgoing_control_msg_queue);
-        message_destroy(this_array->current_control_message);
+        pipeline_destroy(this_array->control_pipeline);
 
-        destroy_katcl(this_array->monitor_katcl_line, 1);
-        close(this_array->monitor_fd);
+        reconnect_destroy(this_array->monitor_reconnect);
+        array_monitor_close(this_array);
         queue_destroy(this_array->outgoing_monitor_msg_queue);
-        message_destroy(this_array->current_monitor_message);
+        pipeline_destroy(this_array->monitor_pipeline);
 
         free(this_array->instrument_state);
         free(this_array->config_file);
@@ -221,6 +491,80 @@ char *array_get_name(struct array *this_array)
 }
 
 
+/**
+ * \fn      uint64_t array_get_generation(struct array *this_array)
+ * \details Get the generation of the latest change to anything in the array, so that a copy of its rendering can be checked for
+ *          staleness.
+ * \param   this_array A pointer to the array in question.
+ * \return  The generation. See sensor_table.h.
+ */
+uint64_t array_get_generation(struct array *this_array)
+{
+    return sensor_table_get_generation(this_array->sensor_table);
+}
+
+
+/**
+ * \fn      char *array_get_cmc_address(struct array *this_array)
+ * \details Get the address of the CMC which is controlling the array, which is also the name of the cmc_server to which it belongs.
+ * \param   this_array A pointer to the array in question.
+ * \return  A string containing the address. This string is not newly-allocated, and must not be freed.
+ */
+char *array_get_cmc_address(struct array *this_array)
+{
+    return this_array->cmc_address;
+}
+
+
+/**
+ * \fn      time_t array_get_last_updated(struct array *this_array)
+ * \details Get the time at which anything was last heard from the array's corr2_sensor_servlet.
+ * \param   this_array A pointer to the array in question.
+ * \return  The time.
+ */
+time_t array_get_last_updated(struct array *this_array)
+{
+    return this_array->last_updated;
+}
+
+
+/**
+ * \fn      size_t array_get_status_count(struct array *this_array, enum sensor_status status)
+ * \details Get the number of the array's sensors (top-level ones and those on its hosts) which have a given status.
+ * \param   this_array A pointer to the array in question.
+ * \param   status The status in question.
+ * \return  The number of sensors. It's kept up to date as sensors change, so it costs nothing to read.
+ */
+size_t array_get_status_count(struct array *this_array, enum sensor_status status)
+{
+    return sensor_table_get_status_count(this_array->sensor_table, status);
+}
+
+
+/**
+ * \fn      int array_compare_health(const void *a, const void *b)
+ * \details Compare two arrays by health, for qsort() on a list of struct array pointers. The least healthy sorts first: the one with
+ *          more sensors in failure or error, then the one with more in warn. Arrays which are equally healthy sort by name.
+ * \param   a A pointer to a pointer to the first array.
+ * \param   b A pointer to a pointer to the second array.
+ * \return  Less than, equal to or greater than zero if the first array sorts before, with or after the second.
+ */
+int array_compare_health(const void *a, const void *b)
+{
+    struct array *array_a = *(struct array * const *) a;
+    struct array *array_b = *(struct array * const *) b;
+    size_t bad_a = array_get_status_count(array_a, SENSOR_FAILURE) + array_get_status_count(array_a, SENSOR_ERROR);
+    size_t bad_b = array_get_status_count(array_b, SENSOR_FAILURE) + array_get_status_count(array_b, SENSOR_ERROR);
+    if (bad_a != bad_b)
+        return bad_a > bad_b ? -1 : 1;
+    size_t warn_a = array_get_status_count(array_a, SENSOR_WARN);
+    size_t warn_b = array_get_status_count(array_b, SENSOR_WARN);
+    if (warn_a != warn_b)
+        return warn_a > warn_b ? -1 : 1;
+    return strcmp(array_a->name, array_b->name);
+}
+
+
 /**
  * \fn      int array_get_size(struct array *this_array)
  * \details Get the size (i.e. number of antennas) of the array.
@@ -257,11 +601,11 @@ int array_add_team_host_device_sensor(struct array *this_array, char team_type,
           }
        }
        /*if we've gotten to this point, the team doesn't exist yet.*/
-       struct team **temp = realloc(this_array->team_list, sizeof(*(this_array->team_list))*(this_array->number_of_teams + 1));
+       struct team **temp = arena_list_reserve(this_array->arena, this_array->team_list, this_array->number_of_teams, sizeof(*temp));
        if (temp != NULL)
        {
            this_array->team_list = temp;
-           this_array->team_list[this_array->number_of_teams] = team_create(team_type, this_array->n_antennas);
+           this_array->team_list[this_array->number_of_teams] = team_create(team_type, this_array->n_antennas, this_array->sensor_table);
            this_array->number_of_teams++;
            return team_add_device_sensor(this_array->team_list[i], host_number, device_name, sensor_name);
        }
@@ -295,11 +639,11 @@ int array_add_team_host_engine_device_sensor(struct array *this_array, char team
             }
         }
         /*if we've gotten to this point, the team doesn't exist yet.*/
-        struct team **temp = realloc(this_array->team_list, sizeof(*(this_array->team_list))*(this_array->number_of_teams + 1));
+        struct team **temp = arena_list_reserve(this_array->arena, this_array->team_list, this_array->number_of_teams, sizeof(*temp));
         if (temp != NULL)
         {
             this_array->team_list = temp;
-            this_array->team_list[this_array->number_of_teams] = team_create(team_type, this_array->n_antennas);
+            this_array->team_list[this_array->number_of_teams] = team_create(team_type, this_array->n_antennas, this_array->sensor_table);
             this_array->number_of_teams++;
             return team_add_device_sensor(this_array->team_list[i], host_number, device_name, sensor_name);
         }
@@ -308,44 +652,83 @@ int array_add_team_host_engine_device_sensor(struct array *this_array, char team
 }
 
 
+/**
+ * \fn      static struct team *array_find_team(struct array *this_array, char team_type)
+ * \details Find the array's team of the given type.
+ * \param   this_array A pointer to the array in question.
+ * \param   team_type The type of the team ('f' or 'x').
+ * \return  A pointer to the team, NULL if the array doesn't have one of that type.
+ */
+static struct team *array_find_team(struct array *this_array, char team_type)
+{
+    size_t i;
+    for (i = 0; i < this_array->number_of_teams; i++)
+    {
+        if (team_get_type(this_array->team_list[i]) == team_type)
+            return this_array->team_list[i];
+    }
+    return NULL;
+}
+
+
+/**
+ * \fn      static struct sensor *array_find_top_level_sensor(struct array *this_array, char *sensor_name)
+ * \details Find one of the array's top-level sensors by name.
+ * \param   this_array A pointer to the array in question.
+ * \param   sensor_name A string containing the name of the sensor.
+ * \return  A pointer to the sensor, NULL if there isn't one by that name.
+ */
+static struct sensor *array_find_top_level_sensor(struct array *this_array, char *sensor_name)
+{
+    size_t i;
+    for (i = 0; i < this_array->num_top_level_sensors; i++)
+    {
+        if (!strcmp(sensor_name, sensor_get_name(this_array->top_level_sensor_list[i])))
+            return this_array->top_level_sensor_list[i];
+    }
+    return NULL;
+}
+
+
 /**
  * \fn      int array_add_top_level_sensor(struct array *this_array, char *sensor_name)
  * \details Add a top-level sensor to the array.
  * \param   this_array A pointer to the array in question.
  * \param   sensor_name A string with the intended name for the new sensor.
- * \return  An integer indicating the outcome, at the moment this is coded always to return 0.
+ * \return  0 on success, -1 if there was no memory for it.
  */
 int array_add_top_level_sensor(struct array *this_array, char *sensor_name)
 {
+    if (array_find_top_level_sensor(this_array, sensor_name) != NULL)
+        return 0; //Already there, e.g. when the array is activated a second time.
     syslog(LOG_DEBUG, "Top-level sensor %s added to %s:%s.", sensor_name, this_array->cmc_address, this_array->name);
-    this_array->top_level_sensor_list = realloc(this_array->top_level_sensor_list, \
-            sizeof(*(this_array->top_level_sensor_list))*(this_array->num_top_level_sensors + 1));
-    this_array->top_level_sensor_list[this_array->num_top_level_sensors] = sensor_create(sensor_name);
+    struct sensor **temp = arena_list_reserve(this_array->arena, this_array->top_level_sensor_list, this_array->num_top_level_sensors, sizeof(*temp));
+    if (temp == NULL)
+        return -1;
+    this_array->top_level_sensor_list = temp;
+    this_array->top_level_sensor_list[this_array->num_top_level_sensors] = sensor_create(sensor_name, this_array->sensor_table, SENSOR_TABLE_NONE);
     this_array->num_top_level_sensors++;
-    return 0; //TODO indicate failure somehow.
+    return 0;
 }
 
 
 /**
- * \fn      int array_update_top_level_sensor(struct array *this_array, char *sensor_name, char *new_value, char *new_status)
+ * \fn      int array_update_top_level_sensor(struct array *this_array, char *sensor_name, char *new_value, enum sensor_status new_status)
  * \details Update the value and status of a top-level sensor in the array.
  * \param   this_array A pointer to the array in question.
  * \param   sensor_name A string containing the name of the sensor to update.
  * \param   new_value A string containing the new value to write to the sensor.
- * \param   new_status A string containing the new status to write to the sensor.
+ * \param   new_status The new status to write to the sensor.
  * \return  An integer indicating the outcome of the operation.
  */
-int array_update_top_level_sensor(struct array *this_array, char *sensor_name, char *new_value, char *new_status)
+int array_update_top_level_sensor(struct array *this_array, char *sensor_name, char *new_value, enum sensor_status new_status)
 {
-    syslog(LOG_DEBUG, "Top-level sensor %s in %s:%s updated with %s - %s", sensor_name, this_array->cmc_address, this_array->name, new_value, new_status);
-    size_t i;
-    for (i = 0; i < this_array->num_top_level_sensors; i++)
+    syslog(LOG_DEBUG, "Top-level sensor %s in %s:%s updated with %s - %s", sensor_name, this_array->cmc_address, this_array->name, new_value, sensor_status_to_string(new_status));
+    struct sensor *this_sensor = array_find_top_level_sensor(this_array, sensor_name);
+    if (this_sensor != NULL)
     {
-        if (!strcmp(sensor_name, sensor_get_name(this_array->top_level_sensor_list[i])))
-        {
-            return sensor_update(this_array->top_level_sensor_list[i], new_value, new_status); 
-            /// \retval 0 The operation was successful.
-        }
+        return sensor_update(this_sensor, new_value, new_status);
+        /// \retval 0 The operation was successful.
     }
     return -1; /// \retval -1 The operation failed.
 }
@@ -381,61 +764,13 @@ int array_check_suspect(struct array *this_array)
 
 /**
  * \fn      void array_mark_fine(struct array *this_array)
- * \details Mark the array as fine. Also check whether there are any stagnant sensors under the array, and
- *          re-request them as necessary.
+ * \details Mark the array as fine.
  * \param   this_array A pointer to the array in question.
  * \return  void
  */
 void array_mark_fine(struct array *this_array)
 {
     this_array->array_is_active = 1;
-
-    if (this_array->last_updated + 60 > time(0))
-    {
-        struct message *new_message = message_create('?');
-        message_add_word(new_message, "sensor-value");
-        queue_push(this_array->outgoing_monitor_msg_queue, new_message);
-
-        if (this_array->monitor_state == ARRAY_MONITOR)
-        {
-            array_monitor_queue_pop(this_array);
-            this_array->monitor_state = ARRAY_SEND_FRONT_OF_QUEUE;
-        }
-    }
-
-    //request sensor-value stagnant sensors just in case we missed something.
-    /*size_t n_stagnant_sensors = 0;
-    char **stagnant_sensors = array_get_stagnant_sensor_names(this_array, 120, &n_stagnant_sensors);
-
-    size_t i;
-    for (i = 0; i < n_stagnant_sensors; i++)
-    {
-        if (queue_sizeof(this_array->outgoing_monitor_msg_queue) > MESSAGE_BUFFER_MAX_LENGTH)
-        {
-            struct message *new_message = message_create('?');
-            message_add_word(new_message, "sensor-value");
-            message_add_word(new_message, stagnant_sensors[i]);
-            queue_push(this_array->outgoing_monitor_msg_queue, new_message);
-
-            //syslog(LOG_DEBUG, "%s:%s monitor queue now has %zd messages waiting.",
-            //        this_array->cmc_address, this_array->name, queue_sizeof(this_array->outgoing_monitor_msg_queue));
-
-            if (this_array->monitor_state == ARRAY_MONITOR)
-            {
-                array_monitor_queue_pop(this_array);
-                this_array->monitor_state = ARRAY_SEND_FRONT_OF_QUEUE;
-            }
-        }
-        else
-        {
-            syslog(LOG_DEBUG, "Too many stagnant sensors on %s:%s monitor queue, dropping the remaining %zd.",
-                    this_array->cmc_address, this_array->name, n_stagnant_sensors - i);
-        }
-    }
-
-    for (i = 0; i < n_stagnant_sensors; i++)
-        free(stagnant_sensors[i]);
-    free(stagnant_sensors);*/
 }
 
 
@@ -480,16 +815,16 @@ char *array_get_sensor_value(struct array *this_array, char team_type, size_t ho
 
 
 /**
- * \fn      char *array_get_sensor_status(struct array *this_array, char team_type, size_t host_number, char *device_name, char *sensor_name)
+ * \fn      enum sensor_status array_get_sensor_status(struct array *this_array, char team_type, size_t host_number, char *device_name, char *sensor_name)
  * \details Get the value of a sensor from the array.
  * \param   this_array A pointer to the array in question.
  * \param   team_type The type of host which holds the sensor.
  * \param   host_number The index of the host in the team.
  * \param   device_name A string containing the name of the device which contains the sensor.
  * \param   sensor_name A string containing the name of the sensor to be queried.
- * \return  A string containing the status of the queried sensor.
+ * \return  The status of the queried sensor, SENSOR_UNKNOWN if it isn't found.
  */
-char *array_get_sensor_status(struct array *this_array, char team_type, size_t host_number, char *device_name, char *sensor_name)
+enum sensor_status array_get_sensor_status(struct array *this_array, char team_type, size_t host_number, char *device_name, char *sensor_name)
 {
     if (this_array != NULL)
     {
@@ -500,181 +835,236 @@ char *array_get_sensor_status(struct array *this_array, char team_type, size_t h
                 return team_get_sensor_status(this_array->team_list[i], host_number, device_name, sensor_name);
         }
     }
-    return NULL;
+    return SENSOR_UNKNOWN;
 
 }
 
 
 /**
- * \fn      void array_set_fds(struct array *this_array, fd_set *rd, fd_set *wr, int *nfds)
- * \details This function sets both read and write file desciptors according to the state that the array's state machines are in.
- *          the rd file descriptor will almost always be set if the connection is active, with the wr file descriptor set only if there
- *          is a message waiting to be sent.
+ * \fn      static void array_update_events(struct array *this_array)
+ * \details This function tells the reactor what the array's file descriptors should be watched for, according to the state that the array's
+ *          state machines are in. While connecting, the file descriptor becomes writeable when connect() completes. After that, reads are
+ *          wanted as long as the connection is active, writes only if there is a message waiting to be sent.
  * \param   this_array A pointer to the array in question.
- * \param   rd A pointer to the fd_set indicating ready to read.
- * \param   wr A pointer to the fd_set indicating ready to write.
- * \param   nfds A pointer to an integer indicating the number of file descriptors in the above sets.
  * \return  void
  */
-void array_set_fds(struct array *this_array, fd_set *rd, fd_set *wr, int *nfds)
+static void array_update_events(struct array *this_array)
 {
-    FD_SET(this_array->control_fd, rd);
-    if (flushing_katcl(this_array->control_katcl_line))
+    if (this_array->control_state == ARRAY_WAIT_CONNECT)
+    {
+        reactor_modify(this_array->reactor, this_array->control_fd, REACTOR_WRITE);
+    }
+    else if (this_array->control_state != ARRAY_DISCONNECTED)
     {
-        FD_SET(this_array->control_fd, wr);
+        reactor_modify(this_array->reactor, this_array->control_fd,
+                REACTOR_READ | (flushing_katcl(this_array->control_katcl_line) ? REACTOR_WRITE : 0));
     }
-    *nfds = max(*nfds, this_array->control_fd);
 
-    FD_SET(this_array->monitor_fd, rd);
-    if (flushing_katcl(this_array->monitor_katcl_line))
+    if (this_array->monitor_state == ARRAY_WAIT_CONNECT)
+    {
+        reactor_modify(this_array->reactor, this_array->monitor_fd, REACTOR_WRITE);
+    }
+    else if (this_array->monitor_state != ARRAY_DISCONNECTED)
     {
-        FD_SET(this_array->monitor_fd, wr);
+        reactor_modify(this_array->reactor, this_array->monitor_fd,
+                REACTOR_READ | (flushing_katcl(this_array->monitor_katcl_line) ? REACTOR_WRITE : 0));
     }
-    *nfds = max(*nfds, this_array->monitor_fd);
 }
 
 
 /**
  * \fn      void array_setup_katcp_writes(struct array *this_array)
- * \details If there is a message waiting to be sent, this function will insert it into the katcl_line, word for word, until it's finished.
- *          On the next select() loop, the katcl_line will then report that it's ready to write a fully-formed message to the file descriptor.
+ * \details Move as many waiting messages into each connection's katcl_line as its pipeline has room for: a window's worth if the servlet
+ *          supports message IDs, otherwise one at a time. The reactor is then asked to report when the file descriptors are ready for
+ *          the katcl_lines to write the fully-formed messages.
  * \param   this_array pointer to the array in question.
  * \return  void
  */
 void array_setup_katcp_writes(struct array *this_array)
 {
-    if (this_array->current_control_message)
-    {
-        if (this_array->control_state == ARRAY_SEND_FRONT_OF_QUEUE)
-        {
-            int n = message_get_number_of_words(this_array->current_control_message);
-            if (n > 0)
-            {
-                char *composed_message = message_compose(this_array->current_control_message);
-                free(composed_message);
-                composed_message = NULL;
-
-                char *first_word = malloc(strlen(message_see_word(this_array->current_control_message, 0)) + 2);
-                sprintf(first_word, "%c%s", message_get_type(this_array->current_control_message), message_see_word(this_array->current_control_message, 0));
-                if (message_get_number_of_words(this_array->current_control_message) == 1)
-                    append_string_katcl(this_array->control_katcl_line, KATCP_FLAG_FIRST | KATCP_FLAG_LAST, first_word);
-                else
-                {
-                    append_string_katcl(this_array->control_katcl_line, KATCP_FLAG_FIRST, first_word);
-                    size_t j;
-                    for (j = 1; j < n - 1; j++)
-                    {
-                        append_string_katcl(this_array->control_katcl_line, 0, message_see_word(this_array->current_control_message, j));
-                    }
-                    append_string_katcl(this_array->control_katcl_line, KATCP_FLAG_LAST, message_see_word(this_array->current_control_message, (size_t) n - 1));
-                }
-                free(first_word);
-                first_word = NULL;
+    if (this_array->control_state == ARRAY_MONITOR)
+        pipeline_fill(this_array->control_pipeline, this_array->outgoing_control_msg_queue, this_array->control_katcl_line);
 
-                this_array->control_state = ARRAY_WAIT_RESPONSE;
-            }
-            else
-            {
-                syslog(LOG_WARNING, "A message on %s:%hu's (control) queue had 0 words in it. Cannot send.", this_array->cmc_address, this_array->control_port);
-                //TODO push to the next message.
-            }
-        }
-    }
+    if (this_array->monitor_state == ARRAY_MONITOR)
+        pipeline_fill(this_array->monitor_pipeline, this_array->outgoing_monitor_msg_queue, this_array->monitor_katcl_line);
 
-    if (this_array->current_monitor_message)
-    {
-        if (this_array->monitor_state == ARRAY_SEND_FRONT_OF_QUEUE)
-        {
-            int n = message_get_number_of_words(this_array->current_monitor_message);
-            if (n > 0)
-            {
-                char *composed_message = message_compose(this_array->current_monitor_message);
-                free(composed_message);
-                composed_message = NULL;
-
-                char *first_word = malloc(strlen(message_see_word(this_array->current_monitor_message, 0)) + 2);
-                sprintf(first_word, "%c%s", message_get_type(this_array->current_monitor_message), message_see_word(this_array->current_monitor_message, 0));
-                if (message_get_number_of_words(this_array->current_monitor_message) == 1)
-                    append_string_katcl(this_array->monitor_katcl_line, KATCP_FLAG_FIRST | KATCP_FLAG_LAST, first_word);
-                else
-                {
-                    append_string_katcl(this_array->monitor_katcl_line, KATCP_FLAG_FIRST, first_word);
-                    size_t j;
-                    for (j = 1; j < n - 1; j++)
-                    {
-                        append_string_katcl(this_array->monitor_katcl_line, 0, message_see_word(this_array->current_monitor_message, j));
-                    }
-                    append_string_katcl(this_array->monitor_katcl_line, KATCP_FLAG_LAST, message_see_word(this_array->current_monitor_message, (size_t) n - 1));
-                }
-                free(first_word);
-                first_word = NULL;
+    array_update_events(this_array);
+}
 
-                this_array->monitor_state = ARRAY_WAIT_RESPONSE;
-            }
-            else
-            {
-                syslog(LOG_WARNING, "A message on %s:%hu's (monitor) queue had 0 words in it. Cannot send.", this_array->cmc_address, this_array->monitor_port);
-                //TODO push to the next message.
-            }
-        }
+
+/**
+ * \fn      static struct katcl_line *array_complete_connect(struct array *this_array, int fd, uint16_t port, char *connection_name)
+ * \details Check the outcome of a non-blocking connect() once the reactor reports that the file descriptor is writeable.
+ * \param   this_array A pointer to the array in question.
+ * \param   fd The file descriptor which was connecting.
+ * \param   port The TCP port to which it was connecting, for logging.
+ * \param   connection_name Either "control" or "monitor", for logging.
+ * \return  A newly-created katcl_line for the connection if it succeeded, NULL if it failed.
+ */
+static struct katcl_line *array_complete_connect(struct array *this_array, int fd, uint16_t port, char *connection_name)
+{
+    int so_error;
+    socklen_t socklen = sizeof(so_error);
+    if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &so_error, &socklen) < 0)
+        so_error = errno;
+    if (so_error != 0)
+    {
+        syslog(LOG_ERR, "Connection to %s:%hu (%s) failed: %s", this_array->cmc_address, port, connection_name, strerror(so_error));
+        return NULL;
     }
+    syslog(LOG_INFO, "%s:%hu (%s) connected.", this_array->cmc_address, port, connection_name);
+    return create_katcl(fd);
 }
 
 
 /**
- * \fn      void array_socket_read_write(struct array *this_array, fd_set *rd, fd_set *wr)
- * \details Depending on the state that the array's state machines are in, send all transmissions which are ready, and read
- *          incoming transmissions, storing them in the katcl_line for processing once a fully-formed message is received.
+ * \fn      static void array_control_socket_read_write(struct array *this_array, uint32_t events)
+ * \details Send whatever is waiting on the control connection and read whatever has arrived, storing it in the katcl_line for processing once
+ *          a fully-formed message is received. If either fails, the connection is marked as disconnected and the reactor stops watching it.
  * \param   this_array A pointer to the array in question.
- * \param   rd A pointer to the fd_set indicating ready to read.
- * \param   wr A pointer to the fd_set indicating ready to write.
+ * \param   events The REACTOR_* events which the reactor reported for the control file descriptor.
  * \return  void
  */
-void array_socket_read_write(struct array *this_array, fd_set *rd, fd_set *wr)
+static void array_control_socket_read_write(struct array *this_array, uint32_t events)
 {
     int r;
-    if (FD_ISSET(this_array->control_fd, rd))
+    if (this_array->control_state == ARRAY_WAIT_CONNECT)
+    {
+        if (events & (REACTOR_WRITE | REACTOR_ERROR))
+        {
+            this_array->control_katcl_line = array_complete_connect(this_array, this_array->control_fd, this_array->control_port, "control");
+            if (this_array->control_katcl_line == NULL)
+            {
+                array_control_close(this_array); //The next attempt is already scheduled.
+            }
+            else
+            {
+                reconnect_succeeded(this_array->control_reconnect);
+                array_control_connected(this_array);
+            }
+        }
+        return;
+    }
+
+    if (events & (REACTOR_READ | REACTOR_ERROR))
     {
         r = read_katcl(this_array->control_katcl_line);
         if (r)
         {
             syslog(LOG_ERR, "Read from %s:%hu (control) failed.", this_array->cmc_address, this_array->control_port);
-            this_array->control_state = ARRAY_DISCONNECTED;
+            array_control_close(this_array);
+            reconnect_schedule(this_array->control_reconnect);
+            return;
         }
     }
 
-    if (FD_ISSET(this_array->control_fd, wr))
+    if (events & REACTOR_WRITE)
     {
         r = write_katcl(this_array->control_katcl_line);
         if (r < 0)
         {
             syslog(LOG_ERR, "Write to %s:%hu (control) failed.", this_array->cmc_address, this_array->control_port);
-            this_array->control_state = ARRAY_DISCONNECTED;
+            array_control_close(this_array);
+            reconnect_schedule(this_array->control_reconnect);
+        }
+    }
+}
+
+
+/**
+ * \fn      static void array_monitor_socket_read_write(struct array *this_array, uint32_t events)
+ * \details Send whatever is waiting on the monitor connection and read whatever has arrived, storing it in the katcl_line for processing once
+ *          a fully-formed message is received. If either fails, the connection is marked as disconnected and the reactor stops watching it.
+ * \param   this_array A pointer to the array in question.
+ * \param   events The REACTOR_* events which the reactor reported for the monitor file descriptor.
+ * \return  void
+ */
+static void array_monitor_socket_read_write(struct array *this_array, uint32_t events)
+{
+    int r;
+    if (this_array->monitor_state == ARRAY_WAIT_CONNECT)
+    {
+        if (events & (REACTOR_WRITE | REACTOR_ERROR))
+        {
+            this_array->monitor_katcl_line = array_complete_connect(this_array, this_array->monitor_fd, this_array->monitor_port, "monitor");
+            if (this_array->monitor_katcl_line == NULL)
+            {
+                array_monitor_close(this_array); //The next attempt is already scheduled.
+            }
+            else
+            {
+                reconnect_succeeded(this_array->monitor_reconnect);
+                array_monitor_connected(this_array);
+            }
         }
+        return;
     }
 
-    if (FD_ISSET(this_array->monitor_fd, rd))
+    if (events & (REACTOR_READ | REACTOR_ERROR))
     {
         r = read_katcl(this_array->monitor_katcl_line);
         if (r)
         {
             syslog(LOG_ERR, "Read from %s:%hu (monitor) failed.", this_array->cmc_address, this_array->monitor_port);
-            this_array->monitor_state = ARRAY_DISCONNECTED;
+            array_monitor_close(this_array);
+            reconnect_schedule(this_array->monitor_reconnect);
+            return;
         }
     }
 
-    if (FD_ISSET(this_array->monitor_fd, wr))
+    if (events & REACTOR_WRITE)
     {
         r = write_katcl(this_array->monitor_katcl_line);
         if (r < 0)
         {
             syslog(LOG_ERR, "Write to from %s:%hu (monitor) failed.", this_array->cmc_address, this_array->monitor_port);
-            this_array->monitor_state = ARRAY_DISCONNECTED;
+            array_monitor_close(this_array);
+            reconnect_schedule(this_array->monitor_reconnect);
         }
     }
 }
 
 
+/**
+ * \fn      static void array_subscribe_template_sensor(struct sensor_template_sensor *template_sensor, void *data)
+ * \details Add a sensor from the sensor template to the array's model and index, and queue a subscription to it. Called once for each
+ *          sensor as the template is expanded.
+ * \param   template_sensor The sensor, as expanded by the template.
+ * \param   data A pointer to the array in question.
+ * \return  void
+ */
+static void array_subscribe_template_sensor(struct sensor_template_sensor *template_sensor, void *data)
+{
+    struct array *this_array = data;
+    struct sensor *new_sensor = NULL;
+    switch (template_sensor->scope) {
+        case SENSOR_TEMPLATE_TOP_LEVEL:
+            array_add_top_level_sensor(this_array, template_sensor->sensor_name);
+            new_sensor = array_find_top_level_sensor(this_array, template_sensor->sensor_name);
+            break;
+        case SENSOR_TEMPLATE_HOST:
+        case SENSOR_TEMPLATE_HOST_PAIR:
+            array_add_team_host_device_sensor(this_array, template_sensor->team_type, template_sensor->host_number, template_sensor->device_name, template_sensor->sensor_name);
+            new_sensor = team_find_sensor(array_find_team(this_array, template_sensor->team_type), template_sensor->host_number,
+                    template_sensor->device_name, template_sensor->sensor_name);
+            break;
+        case SENSOR_TEMPLATE_ENGINE:
+            array_add_team_host_engine_device_sensor(this_array, template_sensor->team_type, template_sensor->host_number, template_sensor->engine_name,
+                    template_sensor->device_name, template_sensor->sensor_name);
+            new_sensor = team_find_engine_sensor(array_find_team(this_array, template_sensor->team_type), template_sensor->host_number,
+                    template_sensor->engine_name, template_sensor->device_name, template_sensor->sensor_name);
+            break;
+    }
+    sensor_index_insert(this_array->sensor_index, template_sensor->full_name, new_sensor);
+
+    struct message *new_message = message_create('?');
+    message_add_word(new_message, "sensor-sampling");
+    message_add_word(new_message, template_sensor->full_name);
+    message_add_word(new_message, "auto");
+    queue_push(this_array->outgoing_monitor_msg_queue, new_message);
+}
+
+
 /**
  * \fn      static void array_activate(struct array *this_array)
  * \details Activate the array. The array will appear on the array-list before it's ready to be connected and probed for all its sensor data.
@@ -687,11 +1077,6 @@ static void array_activate(struct array *this_array)
     //if (strstr(this_array->name, "narrow"))
     //    return;
     syslog(LOG_NOTICE, "Detected %s:%s in nominal state, subscribing to sensors.", this_array->cmc_address, this_array->name);
-    FILE *config_file = fopen(SENSOR_LIST_CONFIG_FILE, "r");
-
-    char buffer[BUF_SIZE];
-    char *result;
-
     {
         struct message *new_message = message_create('?');
         message_add_word(new_message, "sensor-sampling");
@@ -699,259 +1084,234 @@ static void array_activate(struct array *this_array)
         message_add_word(new_message, "auto");
         queue_push(this_array->outgoing_monitor_msg_queue, new_message);
 
-        new_message = message_create('?');
-        message_add_word(new_message, "sensor-sampling");
-        message_add_word(new_message, "input-labelling");
-        message_add_word(new_message, "auto");
-        queue_push(this_array->outgoing_control_msg_queue, new_message);
+        if (!this_array->activated) //On later activations the control connection is either still subscribed, or resubscribes itself on reconnecting.
+        {
+            new_message = message_create('?');
+            message_add_word(new_message, "sensor-sampling");
+            message_add_word(new_message, "input-labelling");
+            message_add_word(new_message, "auto");
+            queue_push(this_array->outgoing_control_msg_queue, new_message);
 
-        new_message = message_create('?');
-        message_add_word(new_message, "sensor-value");
-        message_add_word(new_message, "n-xeng-hosts");
-        queue_push(this_array->outgoing_control_msg_queue, new_message);
+            new_message = message_create('?');
+            message_add_word(new_message, "sensor-value");
+            message_add_word(new_message, "n-xeng-hosts");
+            queue_push(this_array->outgoing_control_msg_queue, new_message);
+        }
      }
+    this_array->activated = 1;
 
     //This needs to be hardcoded unfortunately.
     array_add_top_level_sensor(this_array, "device-status");
+    sensor_index_insert(this_array->sensor_index, "device-status", array_find_top_level_sensor(this_array, "device-status"));
     struct message *new_message = message_create('?');
     message_add_word(new_message, "sensor-sampling");
     message_add_word(new_message, "device-status");
     message_add_word(new_message, "auto");
     queue_push(this_array->outgoing_monitor_msg_queue, new_message);
-    
-    //Subscribe to sensors configured in the config file.
-    for (result = fgets(buffer, BUF_SIZE, config_file); result != NULL; result = fgets(buffer, BUF_SIZE, config_file))
+
+    //Subscribe to the sensors in the template which was read from sensor_list.conf at startup.
+    size_t n_sensors = sensor_template_expand(this_array->sensor_template, this_array->n_antennas, array_subscribe_template_sensor, this_array);
+    syslog(LOG_DEBUG, "(%s:%s) Queued subscriptions to %zu sensors.", this_array->cmc_address, this_array->name, n_sensors + 1);
+    //The queued messages go out a window's worth at a time, from array_setup_katcp_writes(), once the connections are up.
+}
+
+
+/**
+ * \fn      static void array_handle_hostname_functional_mapping(struct array *this_array, char *mapping)
+ * \details Pick the hosts' serial numbers out of the hostname-functional-mapping sensor's value, without copying any of it.
+ * \param   this_array A pointer to the array in question.
+ * \param   mapping The sensor's value. May be NULL.
+ * \return  void
+ */
+static void array_handle_hostname_functional_mapping(struct array *this_array, char *mapping)
+{
+    if (mapping == NULL)
     {
-        char **tokens = NULL;
-        size_t n_tokens = tokenise_string(buffer, '.', &tokens);
-        if (!((n_tokens == 1) || (n_tokens == 2) || (n_tokens == 3)))
-            //can't think of a better way to put it than this.i
-            //one token means top-level array sensor,
-            //two means team, host, device,
-            //three means team, host, engine, device
-        {
-            syslog(LOG_ERR, "sensor_list.conf has a malformed sensor name: %s.", buffer);
-        }
-        else
+        syslog(LOG_DEBUG, "(%s:%s) Received NULL hostname-functional-mapping!", this_array->cmc_address, this_array->name);
+        return;
+    }
+
+    syslog(LOG_INFO, "(%s:%s) Received hostname-functional-mapping: %s", this_array->cmc_address, this_array->name, mapping);
+    size_t length = strlen(mapping);
+    size_t i;
+    for (i = 0; i < 2*this_array->n_antennas; i++) //hacky. Only works because of fixed-width fields.
+    {
+        if (i*30 + 28 > length)
+            break;
+        char *entry = mapping + i*30;
+        char host_type = entry[21];
+        if (entry[26] < '0' || entry[26] > '9' || entry[27] < '0' || entry[27] > '9')
+            continue;
+        size_t host_number = (size_t) (entry[26] - '0')*10 + (size_t) (entry[27] - '0');
+        char host_serial[7];
+        memcpy(host_serial, entry + 8, 6);
+        host_serial[6] = '\0';
+        switch (host_type)
         {
-            char team_type = tokens[0][0]; //should be just "f" or "x" at this point.
-            size_t i;
-            switch (n_tokens) {
-                case 1:
-                    {
-                        array_add_top_level_sensor(this_array, tokens[0]);
-                        struct message *new_message = message_create('?');
-                        message_add_word(new_message, "sensor-sampling");
-                        message_add_word(new_message, tokens[0]);
-                        message_add_word(new_message, "auto");
-                        queue_push(this_array->outgoing_monitor_msg_queue, new_message);
-                    }
-                    break;
-                case 2:
-                    {
-                        for (i = 0; i < this_array->n_antennas; i++)
-                        {
-                            array_add_team_host_device_sensor(this_array, team_type, i, tokens[1], "device-status");
-
-                            char format[] = "%chost%02lu.%s.device-status"; 
-                            ssize_t needed = snprintf(NULL, 0, format, team_type, i, tokens[1]) + 1;
-                            char *sensor_string = malloc((size_t) needed); //TODO check for errors.
-                            sprintf(sensor_string, format, team_type, i, tokens[1]);
-
-                            struct message *new_message = message_create('?');
-                            message_add_word(new_message, "sensor-sampling");
-                            message_add_word(new_message, sensor_string);
-                            message_add_word(new_message, "auto");
-                            free(sensor_string);
-                            queue_push(this_array->outgoing_monitor_msg_queue, new_message);
-                        }
-                    }
-                    break;
-                case 3:
-                    if (strstr(tokens[1], "eng")) //i.e. the second token contains the word "eng" - so we assume host.eng.device.device-status
-                    {                             // with the "device-status" part being implicit.
-                        for (i = 0; i < this_array->n_antennas; i++)
-                        {
-                            size_t j;
-                            for (j = 0; j < 4; j++)
-                            {
-                                char *engine_name;
-                                char format[] = "%s%u";
-                                ssize_t needed = snprintf(NULL, 0, format, tokens[1], j) + 1;
-                                engine_name = malloc((size_t) needed);
-                                sprintf(engine_name, format, tokens[1], j);
-                                array_add_team_host_engine_device_sensor(this_array, team_type, i, engine_name, tokens[2], "device-status");
-
-                                {
-                                    char format[] = "%chost%02lu.%s.%s.device-status";
-                                    ssize_t needed = snprintf(NULL, 0, format, team_type, i, engine_name, tokens[2], "device-status") + 1;
-                                    char *sensor_string = malloc((size_t) needed); //TODO check for errors.
-                                    sprintf(sensor_string, format, team_type, i, engine_name, tokens[2]);
-
-                                    struct message *new_message = message_create('?');
-                                    message_add_word(new_message, "sensor-sampling");
-                                    message_add_word(new_message, sensor_string);
-                                    message_add_word(new_message, "auto");
-                                    free(sensor_string);
-                                    queue_push(this_array->outgoing_monitor_msg_queue, new_message);
-                                }
-                                free(engine_name);
-                            }
-                        }
-                    }
-                    else //i.e. we assume host.device.sensor
-                         //NB! For the time being, the only case of this is xhost.missing-pkts.fhost%02d-cnt.
-                         //so I'm going to semi-hardcode for that. If another case is required, I'm going to have to format this somewhat differently.
-                    {
-                        for (i = 0; i < this_array->n_antennas; i++)
-                        {
-                            int j;
-                            for (j = 0; j < this_array->n_antennas; j++) //each xengine gets packets from each fengine
-                            {
-                                ssize_t needed = snprintf(NULL, 0, tokens[2], j) + 1;
-                                char *sensor_name = malloc((size_t) needed);
-                                sprintf(sensor_name, tokens[2], j);
-
-                                array_add_team_host_device_sensor(this_array, team_type, i, tokens[1], sensor_name);
-
-                                char format[] = "%chost%02lu.%s.%s";
-                                needed = snprintf(NULL, 0, format, team_type, i, tokens[1], sensor_name) + 1;
-                                char *sensor_string = malloc((size_t) needed);
-                                sprintf(sensor_string, format, team_type, i, tokens[1], sensor_name);
-                                free(sensor_name);
-                                struct message *new_message = message_create('?');
-                                message_add_word(new_message, "sensor-sampling");
-                                message_add_word(new_message, sensor_string);
-                                message_add_word(new_message, "auto");
-                                free(sensor_string);
-                                queue_push(this_array->outgoing_monitor_msg_queue, new_message);
-                            }
-                        }
-                    }
-                    break;
-                default:
-                    ; //won't get here, checked earlier.
-            }
+            //TODO: this should probably check more rigorously against team types.
+            case 'f':
+                team_set_host_serial_no(this_array->team_list[0], host_number, host_serial);
+                break;
+            case 'x':
+                team_set_host_serial_no(this_array->team_list[1], host_number, host_serial);
+                break;
+            default:
+                syslog(LOG_WARNING, "Couldn't properly parse hostname-functional-mapping for %s:%s.", this_array->cmc_address, this_array->name);
         }
-        size_t i;
-        for (i = 0; i < n_tokens; i++)
-            free(tokens[i]);
-        free(tokens);
     }
-    array_monitor_queue_pop(this_array);
-    this_array->monitor_state = ARRAY_SEND_FRONT_OF_QUEUE;
-    if (this_array->control_state == ARRAY_MONITOR)
+    this_array->hostname_functional_mapping_received = 1;
+}
+
+
+/**
+ * \fn      static void array_handle_sensor_inform(struct array *this_array, struct katcp_dispatch *message)
+ * \details Handle a #sensor-status or #sensor-value inform from the monitor connection.
+ * \param   this_array A pointer to the array in question.
+ * \param   message The inform: timestamp, count, sensor name, status and value in arguments 1 to 5.
+ * \return  void
+ */
+static void array_handle_sensor_inform(struct array *this_array, struct katcp_dispatch *message)
+{
+    //Everything we subscribed to is in the index, so this is one hash lookup rather than a walk down the tree.
+    struct sensor *this_sensor = sensor_index_find(this_array->sensor_index, message->args[3]);
+    if (this_sensor != NULL)
+    {
+        sensor_update_timestamped(this_sensor, message->args[5] != NULL ? message->args[5] : "none", sensor_status_from_string(message->args[4]),
+                array_parse_katcp_timestamp(message->args[1]));
+    }
+    else if (message->args[3] != NULL && !strcmp(message->args[3], "hostname-functional-mapping"))
     {
-        array_control_queue_pop(this_array); 
-        this_array->control_state = ARRAY_SEND_FRONT_OF_QUEUE;
-    } //If it's not in ARRAY_MONITOR state, it means that we're probably activating the array straight away on starting the server.
-      //but if we've been waiting around for a while, we need to get things ticking over a bit.
-    fclose(config_file);
+        array_handle_hostname_functional_mapping(this_array, message->args[5]);
+        return;
+    }
+    //Anything else (e.g. fhost01.device-status, in reply to a bare ?sensor-value) is simply ignored, but still shows that the
+    //connection is alive.
+    this_array->last_updated = time(0);
 }
 
 
 /**
- * \fn      void array_handle_received_katcl_lines(struct array *this_array)
- * \details This function checks whether the katcl_line has any messages ready, and then processes the message, in accordance with the logic of the
- *          built-in state machine.
+ * \fn      static void array_handle_failed_request(struct array *this_array, struct queue *outgoing_queue, struct message *failed_message, char *connection_name)
+ * \details Deal with a request which got a fail reply: put it back on the queue to be tried again, unless it was about an xhost which
+ *          the array doesn't have (which is expected in the narrowband case).
  * \param   this_array A pointer to the array in question.
+ * \param   outgoing_queue The queue of the connection on which the request was sent.
+ * \param   failed_message The request. It is either queued again or destroyed.
+ * \param   connection_name Either "control" or "monitor", for logging.
  * \return  void
  */
-void array_handle_received_katcl_lines(struct array *this_array)
+static void array_handle_failed_request(struct array *this_array, struct queue *outgoing_queue, struct message *failed_message, char *connection_name)
 {
-    while (have_katcl(this_array->control_katcl_line) > 0)
+    char *composed_message = message_compose(failed_message);
+    //If sensor value requests are failing, it could be that we are looking for xhosts that don't exist.
+    char host_type;
+    size_t host_number;
+    if (katcp_parse_host(message_see_word(failed_message, 1), &host_type, &host_number) != NULL && host_type == 'x' && host_number >= this_array->n_xhosts)
     {
-	//syslog(LOG_DEBUG, "Receved katcp message on %s:%s (control) - %s %s %s %s %s", this_array->cmc_address, this_array->name,
-	//		arg_string_katcl(this_array->control_katcl_line, 0),
-	//		arg_string_katcl(this_array->control_katcl_line, 1),
-	//		arg_string_katcl(this_array->control_katcl_line, 2),
-	//		arg_string_katcl(this_array->control_katcl_line, 3),
-	//		arg_string_katcl(this_array->control_katcl_line, 4));
-
-        char received_message_type = arg_string_katcl(this_array->control_katcl_line, 0)[0];
-        switch (received_message_type) {
-            case '!': // it's a katcp response
-                if (!strcmp(arg_string_katcl(this_array->control_katcl_line, 0) + 1, message_see_word(this_array->current_control_message, 0)))
-                {
-                    char *composed_message = message_compose(this_array->current_control_message);
-                    if (!strcmp(arg_string_katcl(this_array->control_katcl_line, 1), "ok"))
-                    {
-                        //Don't actually need to do anything here, the inform processing code should handle.
-                        //syslog(LOG_DEBUG, "Waiting message was: %s", composed_message);
-                    }
-                    else
-                    {
-                        //If sensor value requests are failing, it could be that we are looking for xhosts that don't exist.
-                        char *r;
-                        if ((r = strstr(composed_message, "xhost")))
-                        {
-                            char *xhost_n_chr = strndup(r, 2);
-                            int xhost_n = atoi(xhost_n_chr);
-                            free(xhost_n_chr);
-                            if (xhost_n < this_array->n_xhosts)
-                            {
-                                //If we get too many of these, there is something wrong.
-                                syslog(LOG_WARNING, "(%s:%s) Fail response to [%s] received. Queue resending...", this_array->cmc_address, this_array->name, composed_message);
-                                queue_push(this_array->outgoing_control_msg_queue, this_array->current_control_message);
-                            }
-                            else
-                            {
-                                syslog(LOG_INFO, "(%s:%s) Fail response to [%s] received. NOT resending, probably narrowband.", this_array->cmc_address, this_array->name, composed_message);
-                                message_destroy(this_array->current_control_message);
-                            }
-                        }
-                        else
-                            queue_push(this_array->outgoing_control_msg_queue, this_array->current_control_message);
-                        this_array->current_control_message = NULL;
-                    }
-                    free(composed_message);
+        syslog(LOG_INFO, "(%s:%s) Fail response to [%s] received on %s connection. Probably unused x-engine, NOT re-requesting.",
+                this_array->cmc_address, this_array->name, composed_message, connection_name);
+        message_destroy(failed_message);
+    }
+    else
+    {
+        //If we get too many of these, there is something wrong.
+        syslog(LOG_WARNING, "(%s:%s) Fail response to [%s] received on %s connection. Re-requesting.",
+                this_array->cmc_address, this_array->name, composed_message, connection_name);
+        queue_push(outgoing_queue, failed_message);
+    }
+    free(composed_message);
+}
 
-                    if (queue_sizeof(this_array->outgoing_control_msg_queue))
-                    {
-                        array_control_queue_pop(this_array);
-                        this_array->control_state = ARRAY_SEND_FRONT_OF_QUEUE;
-                    }
-                    else
-                    {
-                        syslog(LOG_DEBUG, "%s:%hu going into monitoring state.", this_array->cmc_address, this_array->control_port);
-                        message_destroy(this_array->current_control_message);
-                        this_array->current_control_message = NULL; //doesn't do this in the above function. C problem.
-                        this_array->control_state = ARRAY_MONITOR;
-                    }
-                }
+
+/**
+ * \fn      static void array_handle_reply(struct array *this_array, struct pipeline *this_pipeline, struct queue *outgoing_queue, struct katcp_dispatch *reply, char *connection_name)
+ * \details Match a reply to the request in flight which caused it, and retry the request if it failed. A failed bulk sensor-sampling
+ *          request is retried sensor by sensor. Whatever else came back with the reply has already been handled as informs.
+ * \param   this_array A pointer to the array in question.
+ * \param   this_pipeline The pipeline of the connection on which the reply arrived.
+ * \param   outgoing_queue The queue of the same connection.
+ * \param   reply The reply.
+ * \param   connection_name Either "control" or "monitor", for logging.
+ * \return  void
+ */
+static void array_handle_reply(struct array *this_array, struct pipeline *this_pipeline, struct queue *outgoing_queue, struct katcp_dispatch *reply, char *connection_name)
+{
+    struct message *request = pipeline_complete(this_pipeline, reply);
+    if (request == NULL)
+    {
+        syslog(LOG_DEBUG, "(%s:%s) Unexpected reply %s on %s connection, ignoring.", this_array->cmc_address, this_array->name, reply->args[0], connection_name);
+        return;
+    }
+
+    if (reply->args[1] == NULL || strcmp(reply->args[1], "ok"))
+    {
+        if (pipeline_split(this_pipeline, request) == 0) //A failed bulk request is split up and retried by the pipeline itself.
+            array_handle_failed_request(this_array, outgoing_queue, request, connection_name);
+    }
+    else
+        message_destroy(request);
+
+    if (!pipeline_get_in_flight(this_pipeline) && !queue_sizeof(outgoing_queue))
+        syslog(LOG_DEBUG, "%s:%s %s connection has no more requests outstanding.", this_array->cmc_address, this_array->name, connection_name);
+}
+
+
+/**
+ * \fn      static void array_handle_received_katcl_lines(struct array *this_array)
+ * \details This function checks whether the katcl_lines have any messages ready, and then processes them. Replies are matched to the
+ *          requests in flight on their connection; informs are handled according to what they are.
+ * \param   this_array A pointer to the array in question.
+ * \return  void
+ */
+static void array_handle_received_katcl_lines(struct array *this_array)
+{
+    struct katcp_dispatch message;
+    while (this_array->control_katcl_line != NULL && have_katcl(this_array->control_katcl_line) > 0)
+    {
+        if (katcp_dispatch_read(this_array->control_katcl_line, &message) < 0)
+            continue;
+
+        switch (message.type) {
+            case '!': // it's a katcp response
+                array_handle_reply(this_array, this_array->control_pipeline, this_array->outgoing_control_msg_queue, &message, "control");
                 break;
             case '#': // it's a katcp inform
-                if (!strcmp(arg_string_katcl(this_array->control_katcl_line, 0) + 1, "sensor-status"))
+                if (message.name == KATCP_VERSION_CONNECT)
                 {
-                    if (!strcmp(arg_string_katcl(this_array->control_katcl_line, 3), "instrument-state"))
+                    pipeline_handle_version_connect(this_array->control_pipeline, &message);
+                }
+                else if (message.name == KATCP_SENSOR_STATUS && message.args[3] != NULL)
+                {
+                    if (!strcmp(message.args[3], "instrument-state"))
                     {
                         //TODO consider copying these things into their own strings to make for a bit more clarity.
                         syslog(LOG_NOTICE, "%s (%s) Instrument state to be updated: %s - %s",
                                 this_array->name, this_array->cmc_address,
-                                arg_string_katcl(this_array->control_katcl_line, 5),
-                                arg_string_katcl(this_array->control_katcl_line, 4));
+                                message.args[5],
+                                message.args[4]);
 
-                        if (strcmp(this_array->instrument_state, arg_string_katcl(this_array->control_katcl_line, 4)) || \
-                             strcmp(this_array->config_file, arg_string_katcl(this_array->control_katcl_line, 5))  ) //without ! in front, i.e. if they are different.
+                        if (strcmp(this_array->instrument_state, message.args[4]) || \
+                             strcmp(this_array->config_file, message.args[5])  ) //without ! in front, i.e. if they are different.
                                                                         //4 is the state, 5 is the config file, so if either one changes the stuff should update.
                         {
-                            if (!strcmp(arg_string_katcl(this_array->control_katcl_line, 4), "nominal") && strcmp(arg_string_katcl(this_array->control_katcl_line, 5), "none"))
+                            if (!strcmp(message.args[4], "nominal") && strcmp(message.args[5], "none"))
                                                                                                             //i.e. the config file is not none. Otherwise array_activate potentially
                                                                                                             //gets run twice.
                             {
                                 array_activate(this_array); 
                             }
                             free(this_array->instrument_state);
-                            this_array->instrument_state = strdup(arg_string_katcl(this_array->control_katcl_line, 4));
+                            this_array->instrument_state = strdup(message.args[4]);
                             free(this_array->config_file);
-                            this_array->config_file = strdup(arg_string_katcl(this_array->control_katcl_line, 5));
+                            this_array->config_file = strdup(message.args[5]);
+                            sensor_table_touch(this_array->sensor_table);
                         }
                     }
-                    else if (!strcmp(arg_string_katcl(this_array->control_katcl_line, 3), "input-labelling"))
+                    else if (!strcmp(message.args[3], "input-labelling"))
                     {
-                        if (arg_string_katcl(this_array->control_katcl_line, 5) != NULL)
+                        if (message.args[5] != NULL)
                         {
-                            char *sensor_value = strdup(arg_string_katcl(this_array->control_katcl_line, 5));
+                            char *sensor_value = strdup(message.args[5]);
                             syslog(LOG_INFO, "(%s:%s) Received input-labelling: %s", this_array->cmc_address, this_array->name, sensor_value);
                             
                             //hacky. No fixed width fields, but we can tokenise stuff and get it in the correct order.
@@ -983,13 +1343,13 @@ void array_handle_received_katcl_lines(struct array *this_array)
                         }
                     }
                 }
-                else if (!strcmp(arg_string_katcl(this_array->control_katcl_line, 0) + 1, "sensor-value"))
+                else if (message.name == KATCP_SENSOR_VALUE)
                 {
-                    if (arg_string_katcl(this_array->control_katcl_line, 5) != NULL)
+                    if (message.args[5] != NULL)
                     {
-                        if (!strcmp(arg_string_katcl(this_array->control_katcl_line, 3), "n-xeng-hosts"))
+                        if (message.args[3] != NULL && !strcmp(message.args[3], "n-xeng-hosts"))
                         {
-                            this_array->n_xhosts = (size_t) atoi(arg_string_katcl(this_array->control_katcl_line, 5));
+                            this_array->n_xhosts = (size_t) atoi(message.args[5]);
                         }
                     }
                     else
@@ -1004,195 +1364,29 @@ void array_handle_received_katcl_lines(struct array *this_array)
         }
     }
 
-    while (have_katcl(this_array->monitor_katcl_line) > 0)
+    while (this_array->monitor_katcl_line != NULL && have_katcl(this_array->monitor_katcl_line) > 0)
     {
-        char received_message_type = arg_string_katcl(this_array->monitor_katcl_line, 0)[0];
-
-	//syslog(LOG_DEBUG, "Receved katcp message on %s:%s (monitor) - %s %s %s %s %s", this_array->cmc_address, this_array->name,
-	//		arg_string_katcl(this_array->monitor_katcl_line, 0),
-	//		arg_string_katcl(this_array->monitor_katcl_line, 1),
-	//		arg_string_katcl(this_array->monitor_katcl_line, 2),
-	//		arg_string_katcl(this_array->monitor_katcl_line, 3),
-	//		arg_string_katcl(this_array->monitor_katcl_line, 4));
+        //Each argument is fetched once, here, and the message is identified by a hash of its name rather than a chain of strcmps.
+        if (katcp_dispatch_read(this_array->monitor_katcl_line, &message) < 0)
+            continue;
 
-        switch (received_message_type) {
+        switch (message.type) {
             case '!': // it's a katcp response
-                if (!strcmp(arg_string_katcl(this_array->monitor_katcl_line, 0) + 1, message_see_word(this_array->current_monitor_message, 0)))
-                {
-                    char *composed_message = message_compose(this_array->current_monitor_message);
-                    if (!strcmp(arg_string_katcl(this_array->monitor_katcl_line, 1), "ok"))
-                    {
-                        //Don't actually need to do anything here, the inform processing code should handle.
-                        //syslog(LOG_DEBUG, "Waiting message was: %s", composed_message);
-                    }
-                    else
-                    {
-                        //If sensor value requests are failing, it could be that we are looking for xhosts that don't exist.
-                        char *r;
-                        if ((r = strstr(composed_message, "xhost")))
-                        {
-                            char *xhost_n_chr = strndup(r + strlen("xhost"), 2);
-                            int xhost_n = atoi(xhost_n_chr);
-                            //syslog(LOG_WARNING, "Noticed that an xhost message failed. We have %zd xhosts in this array, this message was for xhost%02d (%s).",
-                            //        this_array->n_xhosts, xhost_n, xhost_n_chr);
-                            free(xhost_n_chr);
-                            if (xhost_n < this_array->n_xhosts)
-                            {
-                                syslog(LOG_WARNING, "(%s:%s) Fail response to [%s] received. Re-requesting.", this_array->cmc_address, this_array->name, composed_message);
-                                queue_push(this_array->outgoing_monitor_msg_queue, this_array->current_monitor_message);
-                            }
-                            else
-                            {
-                                syslog(LOG_INFO, "(%s:%s) Fail response to [%s] received. Probably unused x-engine, NOT re-requesting.", this_array->cmc_address, this_array->name, composed_message);
-                                message_destroy(this_array->current_monitor_message);
-                            }
-                        }
-                        else
-                        {
-                            syslog(LOG_WARNING, "(%s:%s) Fail response to '%s' received. Re-requesting.", this_array->cmc_address, this_array->name, composed_message);
-                            queue_push(this_array->outgoing_monitor_msg_queue, this_array->current_monitor_message);
-                        }
-                        this_array->current_monitor_message = NULL;
-                    }
-                    free(composed_message);
-
-                    if (queue_sizeof(this_array->outgoing_monitor_msg_queue))
-                    {
-                        array_monitor_queue_pop(this_array);
-                        this_array->monitor_state = ARRAY_SEND_FRONT_OF_QUEUE;
-                    }
-                    else
-                    {
-                        syslog(LOG_DEBUG, "%s:%s monitor connection going into monitoring state.", this_array->cmc_address, this_array->name);
-                        message_destroy(this_array->current_monitor_message);
-                        this_array->current_monitor_message = NULL; //doesn't do this in the above function. C problem.
-                        this_array->monitor_state = ARRAY_MONITOR;
-                    }
-                }
+                array_handle_reply(this_array, this_array->monitor_pipeline, this_array->outgoing_monitor_msg_queue, &message, "monitor");
                 break;
             case '#': // it's a katcp inform
-                if (!strcmp(arg_string_katcl(this_array->monitor_katcl_line, 0) + 1, "sensor-status") || !strcmp(arg_string_katcl(this_array->monitor_katcl_line, 0) + 1, "sensor-value"))
+                switch (message.name)
                 {
-                    if (!strcmp(arg_string_katcl(this_array->monitor_katcl_line, 3), "hostname-functional-mapping"))
-                    {
-                        if (arg_string_katcl(this_array->monitor_katcl_line, 5) != NULL)
-                        {
-                            char *sensor_value = strdup(arg_string_katcl(this_array->monitor_katcl_line, 5));
-                            syslog(LOG_INFO, "(%s:%s) Received hostname-functional-mapping: %s", this_array->cmc_address, this_array->name, sensor_value);
-                            int i;
-                            for (i = 0; i < 2*this_array->n_antennas; i++) //hacky. Only works because of fixed-width fields.
-                            {
-                                if (i*30 + 21 > strlen(sensor_value))
-                                        break;
-                                char host_type = sensor_value[i*30 + 21];
-                                //syslog(LOG_DEBUG, "host type: %c", host_type);
-
-                                char *host_number_str = strndup(sensor_value + (i*30 + 26), 2);
-                                size_t host_number = (size_t) atoi(host_number_str);
-                                //syslog(LOG_DEBUG, "host number: %lu", host_number);
-                                char *host_serial = strndup(sensor_value + (i*30 + 8), 6);
-                                //syslog(LOG_DEBUG, "host serial: %s", host_serial);
-                                switch (host_type)
-                                {
-                                    //TODO: this should probably check more rigorously against team types.
-                                    case 'f':
-                                        team_set_host_serial_no(this_array->team_list[0], host_number, host_serial);
-                                        break;
-                                    case 'x':
-                                        team_set_host_serial_no(this_array->team_list[1], host_number, host_serial);
-                                        break;
-                                    default:
-                                        syslog(LOG_WARNING, "Couldn't properly parse hostname-functional-mapping for %s:%s.", \
-                                                this_array->cmc_address, this_array->name);
-                                }
-                                free(host_serial);
-                                free(host_number_str);
-                            }
-                            free(sensor_value);
-                        }
-                        else
-                        {
-                            syslog(LOG_DEBUG, "(%s:%s) Received NULL hostname-functional-mapping!", this_array->cmc_address, this_array->name);
-                        }
-                        this_array->hostname_functional_mapping_received = 1;
-                    }
-                    else
-                    {
-                        char **tokens = NULL;
-                        size_t n_tokens = tokenise_string(arg_string_katcl(this_array->monitor_katcl_line, 3), '.', &tokens);
-                        char team = tokens[0][0];
-                        size_t team_no;
-                        switch (team) {
-                            case 'f': team_no = 0;
-                                      break;
-                            case 'x': team_no = 1;
-                                      break;
-                            case 'd': // This happens when it's the top-level "device-status" sensor. Expected behaviour.
-                                      break;
-                            default:  syslog(LOG_WARNING, "Received unknown team type %c from sensor-status message: %s", team, arg_string_katcl(this_array->monitor_katcl_line, 1));
-                        }
-                        char *host_no_str = strndup(tokens[0] + 5, 2);
-                        size_t host_no = (size_t) atoi(host_no_str);
-                        free(host_no_str);
-                        host_no_str = NULL;
-
-                        //Sanitise the katcl strings. Nulls cause strdup to segfault.
-                        char *new_value;
-                        if (arg_string_katcl(this_array->monitor_katcl_line, 5) != NULL) //I guess the "!= NULL" is redundant, but I want this to be explicit and readable
-                        {
-                            new_value = strdup(arg_string_katcl(this_array->monitor_katcl_line, 5));
-                        }
-                        else
-                        {
-                            //syslog(LOG_DEBUG, "KATCP message from %s:%s for sensor-status %s - null value received.", this_array->cmc_address, this_array->name, arg_string_katcl(this_array->monitor_katcl_line, 3));
-                            new_value = strdup("none");
-                        }
-
-                        char *new_status;
-                        if (arg_string_katcl(this_array->monitor_katcl_line, 4) != NULL) 
-                        {
-                            new_status = strdup(arg_string_katcl(this_array->monitor_katcl_line, 4));
-                        }
-                        else
-                        {
-                            //syslog(LOG_DEBUG, "KATCP message from %s:%s for sensor-status %chost%02ld.%s.%s - null status received.", this_array->cmc_address, this_array->name, team, host_no, tokens[1], tokens[2]);
-                            new_status = strdup("none");
-                        }
-
-                        switch (n_tokens) {
-                            case 1:
-                                array_update_top_level_sensor(this_array, tokens[0], new_value, new_status);
-                                break;
-                            case 2: 
-                                ; //Nothing to do here. It's probably a fhost01.device-status or something like that.
-                                // will get these when requesting sensor-value for all the sensorz. Just ignore.
-                                break;
-                            case 3:
-                                team_update_sensor(this_array->team_list[team_no], host_no, tokens[1], tokens[2], new_value, new_status);
-                                break;
-                            case 4:
-                                team_update_engine_sensor(this_array->team_list[team_no], host_no, tokens[1], tokens[2], tokens[3], new_value, new_status);
-                                break;
-                            default:
-                                //TODO make this error message a bit more reasonable so that I'd be able to find it if I needed to.
-                                syslog(LOG_ERR, "Unexpected number of tokens (%ld) in received KATCP message: %s", n_tokens, arg_string_katcl(this_array->monitor_katcl_line, 3)); 
-                        }
-
-                        //Update the time
-                        this_array->last_updated = time(0);
-
-                        size_t i;
-                        for (i = 0; i < n_tokens; i++)
-                            free(tokens[i]);
-                        free(tokens);
-                        free(new_value);
-                        free(new_status);
-                    }
+                    case KATCP_SENSOR_STATUS:
+                    case KATCP_SENSOR_VALUE:
+                        array_handle_sensor_inform(this_array, &message);
+                        break;
+                    case KATCP_VERSION_CONNECT:
+                        pipeline_handle_version_connect(this_array->monitor_pipeline, &message);
+                        break;
+                    default:
+                        ; //Nothing else is of interest on the monitor connection.
                 }
-                /*else if (!strcmp(arg_string_katcl(this_array->monitor_katcl_line, -1) + 0, "sensor-list"))
-                {
-                    //TODO -- it looks as though this functionality is no longer required.
-                }*/
                 break;
             default:
                 ; //This shouldn't ever happen.
@@ -1202,235 +1396,443 @@ void array_handle_received_katcl_lines(struct array *this_array)
 
 
 /**
- * \fn      char *array_html_summary(struct array *this_array, char *cmc_name)
- * \details Generate an HTML summary representation of the array, for when the array is on the main, CMC-list page.
- * \param   this_array A pointer to the array in question.
- * \param   cmc_name A string containing the name of the cmc_server that is the array's parent.
- * \return  A string containing the summary HTML representation of the array.
+ * \fn      static void array_control_socket_event(struct reactor *this_reactor, int fd, uint32_t events, void *data)
+ * \details The reactor callback for the array's control connection. Does the reading and writing, handles any complete messages, then
+ *          updates what the reactor should watch for.
+ * \param   this_reactor The reactor which reported the events.
+ * \param   fd The control file descriptor.
+ * \param   events The REACTOR_* events which are ready.
+ * \param   data A pointer to the array which owns the file descriptor.
+ * \return  void
  */
-char *array_html_summary(struct array *this_array, char *cmc_name)
+static void array_control_socket_event(struct reactor *this_reactor, int fd, uint32_t events, void *data)
 {
-    char format[] = "<tr><td><a href=\"%s/%s\">%s</a></td><td>%hu</td><td>%hu</td><td>%lu</td><td>%s</td><td>%s</td>";
-    ssize_t needed = snprintf(NULL, 0, format, cmc_name, this_array->name, this_array->name, this_array->control_port, this_array->monitor_port, this_array->n_antennas, this_array->config_file, this_array->instrument_state) + 1;
-    //TODO checks
-    char *html_summary = malloc((size_t) needed);
-    sprintf(html_summary, format, cmc_name, this_array->name, this_array->name, this_array->control_port, this_array->monitor_port, this_array->n_antennas, this_array->config_file, this_array->instrument_state);
-    return html_summary;
+    (void) this_reactor;
+    (void) fd;
+    struct array *this_array = data;
+    array_control_socket_read_write(this_array, events);
+    array_handle_received_katcl_lines(this_array);
+    array_update_events(this_array);
 }
 
 
 /**
- * \fn      char *array_html_detail(struct array *this_array)
- * \details Generate an HTML detailed representation of the array, for when the array is the focus.
+ * \fn      static void array_monitor_socket_event(struct reactor *this_reactor, int fd, uint32_t events, void *data)
+ * \details The reactor callback for the array's monitor connection. Does the reading and writing, handles any complete messages, then
+ *          updates what the reactor should watch for.
+ * \param   this_reactor The reactor which reported the events.
+ * \param   fd The monitor file descriptor.
+ * \param   events The REACTOR_* events which are ready.
+ * \param   data A pointer to the array which owns the file descriptor.
+ * \return  void
+ */
+static void array_monitor_socket_event(struct reactor *this_reactor, int fd, uint32_t events, void *data)
+{
+    (void) this_reactor;
+    (void) fd;
+    struct array *this_array = data;
+    array_monitor_socket_read_write(this_array, events);
+    array_handle_received_katcl_lines(this_array);
+    array_update_events(this_array);
+}
+
+
+/**
+ * \fn      int array_html_summary(struct array *this_array, char *cmc_name, struct strbuf *html)
+ * \details Append an HTML summary representation of the array, for when the array is on the main, CMC-list page. The last column
+ *          sums up the array's health from its status counts: how many sensors are in each of the bad states, coloured by the worst.
  * \param   this_array A pointer to the array in question.
- * \return  A string with a detailed HTML representation of the array and its children.
+ * \param   cmc_name A string containing the name of the cmc_server that is the array's parent.
+ * \param   html The strbuf to which the summary is appended.
+ * \return  0 on success, -1 if the strbuf has failed.
  */
-char *array_html_detail(struct array *this_array)
+int array_html_summary(struct array *this_array, char *cmc_name, struct strbuf *html)
 {
-    char *top_detail = strdup("");
+    //Worst first, so that the first one with any sensors gives the colour.
+    static const enum sensor_status bad_statuses[] = {SENSOR_FAILURE, SENSOR_ERROR, SENSOR_WARN};
+    char health[128] = "";
+    char *health_class = this_array->activated ? "nominal" : "unknown";
+    size_t i;
+    for (i = 0; i < sizeof(bad_statuses)/sizeof(*bad_statuses); i++)
     {
-        //collect the top-level sensors first.
-        size_t i;
-        char *tl_sensors_rep = strdup("");
-        for (i = 0; i < this_array->num_top_level_sensors; i++)
+        size_t count = array_get_status_count(this_array, bad_statuses[i]);
+        if (count)
         {
-            char tl_sensors_format[] = "<button class=\"%s\" style=\"width:300px\">%s</button> ";
-            ssize_t needed = (ssize_t) snprintf(NULL, 0, tl_sensors_format, sensor_get_status(this_array->top_level_sensor_list[i]), \
-                    sensor_get_name(this_array->top_level_sensor_list[i])) + 1;
-            needed += (ssize_t) strlen(tl_sensors_rep);
-            tl_sensors_rep = realloc(tl_sensors_rep, (size_t) needed); //TODO check for -1
-            sprintf(tl_sensors_rep + strlen(tl_sensors_rep), tl_sensors_format, sensor_get_status(this_array->top_level_sensor_list[i]), \
-                    sensor_get_name(this_array->top_level_sensor_list[i]));
+            size_t length = strlen(health);
+            snprintf(health + length, sizeof(health) - length, "%s%zu %s", length ? ", " : "", count, sensor_status_to_string(bad_statuses[i]));
+            if (length == 0)
+                health_class = sensor_status_to_string(bad_statuses[i]);
         }
-        char format[] = "<p align=\"right\">CMC: %s | Array name: %s | Config: %s | %s Last updated: %s (%d seconds ago). <button style=\"width:7%\"><a href=\"/%s/%s/missing-pkts\">missing-pkts</a></button></p>";
-        char time_str[20];
-        struct tm *last_updated_tm = localtime(&this_array->last_updated);
-        strftime(time_str, 20, "%F %T", last_updated_tm);
-        ssize_t needed = snprintf(NULL, 0, format, this_array->cmc_address, this_array->name, this_array->config_file, tl_sensors_rep, time_str, (int)(time(0) - this_array->last_updated), this_array->cmc_address, this_array->name) + 1;
-        top_detail = realloc(top_detail, (size_t) needed);
-        sprintf(top_detail, format, this_array->cmc_address, this_array->name, this_array->config_file, tl_sensors_rep, time_str, (int)(time(0) - this_array->last_updated), this_array->cmc_address, this_array->name);
-        free(tl_sensors_rep);
     }
-    
-    char *array_detail = strdup(""); //must free() later.
-    size_t i, j;
-    for (i = 0; i < this_array->n_antennas; i++)
+    if (health[0] == '\0')
+        strcpy(health, this_array->activated ? "nominal" : "-");
+
+    return strbuf_appendf(html, "<tr><td><a href=\"%s/%s\">%s</a></td><td>%hu</td><td>%hu</td><td>%lu</td><td>%s</td><td>%s</td><td class=\"%s\">%s</td>", \
+            cmc_name, this_array->name, this_array->name, this_array->control_port, this_array->monitor_port, this_array->n_antennas, \
+            this_array->config_file, this_array->instrument_state, health_class, health);
+}
+
+
+/**
+ * \fn      static void array_html_row(struct array *this_array, size_t antenna, struct strbuf *html)
+ * \details Append one row of the array's detail table (the hosts which belong to one antenna, side by side), rendering it again only if
+ *          one of the hosts has changed since last time. A freshly-rendered row goes straight into the table and is copied into the
+ *          row's fragment from there.
+ * \param   this_array A pointer to the array in question.
+ * \param   antenna The number of the row.
+ * \param   html The strbuf in which the table is being put together.
+ * \return  void
+ */
+static void array_html_row(struct array *this_array, size_t antenna, struct strbuf *html)
+{
+    //Generations all come from the one counter in the sensor table, so the later of the hosts' generations moves on whenever
+    //either of them changes.
+    uint64_t row_generation = 0;
+    size_t j;
+    for (j = 0; j < this_array->number_of_teams; j++)
     {
-        char *row_detail = strdup("");
-        for (j = 0; j < this_array->number_of_teams; j++)
-        {
-            char *host_html_det = team_get_host_html_detail(this_array->team_list[j], i);
-            size_t needed =  strlen(row_detail) + strlen(host_html_det) + 1;
-            row_detail = realloc(row_detail, needed);
-            strcat(row_detail, host_html_det);
-            free(host_html_det);
-        }
-        char format[] = "<tr>%s</tr>\n";
-        ssize_t needed = (ssize_t) snprintf(NULL, 0, format, row_detail) + 1;
-        needed += (ssize_t) strlen(array_detail);
-        //printf("Needed: %zd\n", needed);
-        array_detail = realloc(array_detail, (size_t) needed);
-        sprintf(array_detail + strlen(array_detail), format, row_detail);
-        free(row_detail);
+        uint64_t host_generation = team_get_host_generation(this_array->team_list[j], antenna);
+        if (host_generation > row_generation)
+            row_generation = host_generation;
     }
+    struct fragment *row_fragment = this_array->row_fragments[antenna];
+    if (fragment_is_current(row_fragment, row_generation))
+    {
+        strbuf_append_length(html, fragment_see(row_fragment), fragment_get_length(row_fragment));
+        return;
+    }
+
+    size_t start = strbuf_get_length(html);
+    strbuf_append(html, "<tr>");
+    for (j = 0; j < this_array->number_of_teams; j++)
+        team_get_host_html_detail(this_array->team_list[j], antenna, html);
+    strbuf_append(html, "</tr>\n");
+    if (!strbuf_has_failed(html))
+        fragment_store(row_fragment, strbuf_see(html) + start, row_generation);
+}
+
 
-    char format[] = "%s\n<table>\n%s</table>\n";
-    ssize_t needed = snprintf(NULL, 0, format, top_detail, array_detail) + 1;
-    char *temp = malloc((size_t) needed); //TODO I really should get around to being rigorous about this
-    if (temp != NULL)
+/**
+ * \fn      int array_html_heading(struct array *this_array, struct strbuf *html)
+ * \details Append the line which goes above the array's detail table: where the array is, its top-level sensors, and how long ago it
+ *          was last heard from. This is rendered every time, since the time moves on even when nothing else does.
+ * \param   this_array A pointer to the array in question.
+ * \param   html The strbuf to which the heading is appended.
+ * \return  0 on success, -1 if the strbuf has failed.
+ */
+int array_html_heading(struct array *this_array, struct strbuf *html)
+{
+    size_t i;
+    char time_str[20];
+    struct tm *last_updated_tm = localtime(&this_array->last_updated);
+    strftime(time_str, 20, "%F %T", last_updated_tm);
+    strbuf_appendf(html, "<p align=\"right\">CMC: %s | Array name: %s | Config: %s | ", this_array->cmc_address, this_array->name, this_array->config_file);
+    for (i = 0; i < this_array->num_top_level_sensors; i++)
     {
-        sprintf(temp, format, top_detail, array_detail);
+        strbuf_appendf(html, "<button id=\"top-%zu\" class=\"%s\" style=\"width:300px\">%s</button> ", \
+                i, sensor_status_to_string(sensor_get_status(this_array->top_level_sensor_list[i])), sensor_get_name(this_array->top_level_sensor_list[i]));
     }
-    free(top_detail);
-    free(array_detail);
-    return temp;
+    return strbuf_appendf(html, " Last updated: <span id=\"heard-time\">%s</span> (<span id=\"heard-age\">%d</span> seconds ago). <button style=\"width:7%%\"><a href=\"/%s/%s/missing-pkts\">missing-pkts</a></button></p>", \
+            time_str, (int)(time(0) - this_array->last_updated), this_array->cmc_address, this_array->name);
 }
 
 
+/**
+ * \fn      struct fragment *array_html_table(struct array *this_array)
+ * \details Bring the array's detail table (a row of hosts for each antenna) up to date. It's only put together again if something on
+ *          one of the hosts has changed since last time, and then only the rows whose hosts have changed are rendered again.
+ * \param   this_array A pointer to the array in question.
+ * \return  The table's fragment, which belongs to the array. It's left empty if there was no memory to render it.
+ */
+struct fragment *array_html_table(struct array *this_array)
+{
+    uint64_t table_generation = 0;
+    size_t j;
+    for (j = 0; j < this_array->number_of_teams; j++)
+    {
+        uint64_t team_generation = team_get_generation(this_array->team_list[j]);
+        if (team_generation > table_generation)
+            table_generation = team_generation;
+    }
+    if (fragment_is_current(this_array->table_fragment, table_generation))
+        return this_array->table_fragment;
+
+    struct strbuf *html = strbuf_create(0);
+    if (html == NULL)
+        return this_array->table_fragment;
+    size_t i;
+    strbuf_append(html, "\n<table>\n");
+    for (i = 0; i < this_array->n_antennas; i++)
+        array_html_row(this_array, i, html);
+    strbuf_append(html, "</table>\n");
+    if (!strbuf_has_failed(html))
+        fragment_store(this_array->table_fragment, strbuf_see(html), table_generation);
+    strbuf_destroy(html);
+    return this_array->table_fragment;
+}
+
+
+
+/**
+ * \fn      size_t array_get_number_of_cells(struct array *this_array)
+ * \details Get the number of cells with a status on the array's detail page: the top-level sensors in the heading, and those of the
+ *          hosts in the table. Only the statuses of these cells change without the page's layout changing.
+ * \param   this_array A pointer to the array in question.
+ * \return  The number of cells.
+ */
+size_t array_get_number_of_cells(struct array *this_array)
+{
+    size_t number_of_cells = this_array->num_top_level_sensors;
+    size_t i, j;
+    for (i = 0; i < this_array->n_antennas; i++)
+        for (j = 0; j < this_array->number_of_teams; j++)
+            number_of_cells += team_get_host_number_of_cells(this_array->team_list[j], i);
+    return number_of_cells;
+}
+
 
 /**
- * \fn      char *array_html_missing_pkt_view(struct array *this_array)
- * \details Generate an HTML representation of the array's missing-pkt sensors on the xhosts.
+ * \fn      void array_get_cell_statuses(struct array *this_array, uint64_t generation, unsigned char *cell_status)
+ * \details Fill in the statuses shown by the cells of a detail page rendered at the given generation, as far as they can be known: those
+ *          of the top-level sensors and hosts which haven't changed since then are as they are now. The rest are left alone.
  * \param   this_array A pointer to the array in question.
- * \return  A string with an HTML representation of the array's missing-pkt sensors.
+ * \param   generation The generation at which the page was rendered.
+ * \param   cell_status The statuses, one for each cell (see array_get_number_of_cells()).
+ * \return  void
  */
-char *array_html_missing_pkt_view(struct array *this_array)
+void array_get_cell_statuses(struct array *this_array, uint64_t generation, unsigned char *cell_status)
 {
-    char *top_row_html = strdup("<tr><td> </td>");
-    char *second_row_html = strdup("<tr><td> </td>");
-    char *array_html = strdup("");
     size_t i, j;
+    for (i = 0; i < this_array->num_top_level_sensors; i++)
+    {
+        struct sensor *this_sensor = this_array->top_level_sensor_list[i];
+        if (sensor_table_get_row_generation(this_array->sensor_table, sensor_get_row(this_sensor)) <= generation)
+            cell_status[i] = (unsigned char) sensor_get_status(this_sensor);
+    }
+    size_t offset = this_array->num_top_level_sensors;
     for (i = 0; i < this_array->n_antennas; i++)
     {
-        char top_row_format[] = "<td>f%02d</td>";
-        char second_row_format[] = "<td>%s</td>";
-        ssize_t needed = (ssize_t) snprintf(NULL, 0, top_row_format, i) + 1; //using vertical axis to build column headings,
-        needed += (ssize_t) strlen(top_row_html);                                                                //which should be okay because we assume a square array.
-        top_row_html = realloc(top_row_html, (size_t) needed);
-        sprintf(top_row_html + strlen(top_row_html), top_row_format, i);
-
-        needed = (ssize_t) snprintf(NULL, 0, second_row_format, team_get_fhost_input_stream(this_array->team_list[0], (size_t) i)) + 1;
-        needed += (ssize_t) strlen(second_row_html);
-        second_row_html = realloc(second_row_html, (size_t) needed);
-        sprintf(second_row_html + strlen(second_row_html), second_row_format, team_get_fhost_input_stream(this_array->team_list[0], (size_t) i));
-
-        char *host_html = strdup("");
-        for (j = 0; j < this_array->n_antennas; j++)
+        for (j = 0; j < this_array->number_of_teams; j++)
         {
-            //need to know which sensor to ask for
-            char sensor_name_format[] = "fhost%02d-cnt"; 
-            ssize_t needed = snprintf(NULL, 0, sensor_name_format, j) + 1;
-            char *sensor_name = malloc((size_t) needed);
-            sprintf(sensor_name, sensor_name_format, j);
-
-            char html_format[] = "<td class=\"%s\">%s</td>";
-            char *sensor_status = array_get_sensor_status(this_array, 'x', i, "missing-pkts", sensor_name);
-            char *sensor_value = array_get_sensor_value(this_array, 'x', i, "missing-pkts", sensor_name);
-            needed = (ssize_t) snprintf(NULL, 0, html_format, sensor_status, sensor_value) + 1;
-            needed += (ssize_t) strlen(host_html);
-            host_html = realloc(host_html, (size_t) needed);
-            sprintf(host_html + strlen(host_html), html_format, sensor_status, sensor_value);
-            
-            free(sensor_name);
+            if (team_get_host_generation(this_array->team_list[j], i) <= generation)
+                team_get_host_cell_statuses(this_array->team_list[j], i, cell_status + offset);
+            offset += team_get_host_number_of_cells(this_array->team_list[j], i);
         }
-        //syslog(LOG_DEBUG, "Generated host html: %s", host_html);
-        char array_format[] = "<tr><td>x%02d</td>%s</tr>\n";
-        needed = (ssize_t) snprintf(NULL, 0, array_format, i, host_html) + 1;
-        needed += (ssize_t) strlen(array_html);
-        array_html = realloc(array_html, (size_t) needed);
-        sprintf(array_html + strlen(array_html), array_format, i, host_html);
-        free(host_html);
     }
-
-    char top_row_format[] = "%s</tr>\n";
-    top_row_html = realloc(top_row_html, strlen(top_row_html) + strlen(top_row_format) + 1);
-    strcat(top_row_html, top_row_format);
-
-    char final_format[] = "<table>%s%s%s</table>";
-    ssize_t needed = snprintf(NULL, 0, final_format, top_row_html, second_row_html, array_html) + 1;
-    char *final_html = malloc((size_t) needed);
-    sprintf(final_html, final_format, top_row_html, second_row_html, array_html);
-    free(array_html);
-    free(top_row_html);
-    free(second_row_html);
-    return final_html;
 }
 
 
 /**
- * \fn      struct message *array_control_queue_pop(struct array *this_array)
- * \details Remove the array's current_control_message (if any), and replaces it with one popped from the outgoing_control_msg_queue.
+ * \fn      int array_html_changes(struct array *this_array, uint64_t since, unsigned char *cell_status, struct strbuf *lines)
+ * \details Append a line for each cell of the array's detail page which has changed from what the page was last told, in the form
+ *          "status <id> <status>" or "text <id> <text>" (see host_html_changes()). Only the hosts which have changed since the given
+ *          generation are looked at, so on a quiet array this costs next to nothing.
  * \param   this_array A pointer to the array in question.
- * \return  A pointer to the message that was popped from the outgoing_control_msg_queue.
+ * \param   since The generation up to which the page is known to be current.
+ * \param   cell_status The statuses last sent, one for each cell (see array_get_number_of_cells()), which are brought up to date.
+ *          Anything which isn't a valid enum sensor_status counts as never having been sent.
+ * \param   lines The strbuf to which the lines are appended.
+ * \return  0 on success, -1 if the strbuf has failed.
  */
-struct message *array_control_queue_pop(struct array *this_array)
+int array_html_changes(struct array *this_array, uint64_t since, unsigned char *cell_status, struct strbuf *lines)
 {
-    if (this_array->current_control_message != NULL)
+    size_t i, j;
+    for (i = 0; i < this_array->num_top_level_sensors; i++)
     {
-        message_destroy(this_array->current_control_message);
+        enum sensor_status status = sensor_get_status(this_array->top_level_sensor_list[i]);
+        if (cell_status[i] != status)
+        {
+            strbuf_appendf(lines, "status top-%zu %s\n", i, sensor_status_to_string(status));
+            cell_status[i] = (unsigned char) status;
+        }
+    }
+    size_t offset = this_array->num_top_level_sensors;
+    for (i = 0; i < this_array->n_antennas; i++)
+    {
+        for (j = 0; j < this_array->number_of_teams; j++)
+        {
+            if (team_get_host_generation(this_array->team_list[j], i) > since)
+                team_get_host_html_changes(this_array->team_list[j], i, since, cell_status + offset, lines);
+            offset += team_get_host_number_of_cells(this_array->team_list[j], i);
+        }
     }
-    this_array->current_control_message = queue_pop(this_array->outgoing_control_msg_queue);
-    return this_array->current_control_message;
+    return strbuf_has_failed(lines) ? -1 : 0;
 }
 
 
 /**
- * \fn      struct message *array_monitor_queue_pop(struct array *this_array)
- * \details Remove the array's current_monitor_message (if any), and replaces it with one popped from the outgoing_monitor_msg_queue.
- * \param   this_array A pointer to the array in question.
- * \return  A pointer to the message that was popped from the outgoing_monitor_msg_queue.
+ * \fn      static void array_json_members(struct array *this_array, struct json_writer *json, unsigned int fields)
+ * \details Write the members which an array's JSON object has whether it's a summary or in full: its name, where it is, its size and
+ *          ports, and whichever of its config, state, time last heard from and status counts are asked for.
  */
-struct message *array_monitor_queue_pop(struct array *this_array)
+static void array_json_members(struct array *this_array, struct json_writer *json, unsigned int fields)
 {
-    if (this_array->current_monitor_message != NULL)
+    size_t i;
+    json_key_string(json, "name", this_array->name);
+    json_key_string(json, "cmc", this_array->cmc_address);
+    json_key_integer(json, "size", (long long) this_array->n_antennas);
+    json_key_integer(json, "control_port", this_array->control_port);
+    json_key_integer(json, "monitor_port", this_array->monitor_port);
+    if (fields & JSON_FIELD_INFO)
     {
-        message_destroy(this_array->current_monitor_message);
+        json_key_string(json, "config", this_array->config_file);
+        json_key_string(json, "instrument_state", this_array->instrument_state);
+    }
+    if (fields & JSON_FIELD_UPDATED)
+        json_key_integer(json, "last_updated", (long long) this_array->last_updated);
+    if (fields & JSON_FIELD_STATUS)
+    {
+        json_key(json, "status_counts");
+        json_begin_object(json);
+        for (i = 0; i < SENSOR_NUMBER_OF_STATUSES; i++)
+            json_key_integer(json, sensor_status_to_string((enum sensor_status) i), (long long) array_get_status_count(this_array, (enum sensor_status) i));
+        json_end_object(json);
     }
-    this_array->current_monitor_message = queue_pop(this_array->outgoing_monitor_msg_queue);
-    return this_array->current_monitor_message;
 }
 
+
 /**
- * \fn      char** array_get_stagnant_sensor_names(struct array *this_array, time_t stagnant_time, size_t *number_of_sensors)
- * \details Get a list of names of the array's sensors (via its child teams) which haven't been updated for a specified amount of time.
- * \param   this_array A pointer to the array.
- * \param   stagnant_time The time in seconds above which sensors should be reported stagnant.
- * \param   number_of_sensors A pointer to an integer so that the function can return the number of sensors in the list.
- * \return  A pointer to an array of strings containing the names of the array's stagnant sensors.
+ * \fn      int array_json_summary(struct array *this_array, struct json_writer *json, unsigned int fields)
+ * \details Write a JSON object summarising the array, as in the CMC's list of arrays: everything but its sensors and hosts.
+ * \param   this_array A pointer to the array in question.
+ * \param   json The json_writer to which the object is written.
+ * \param   fields The JSON_FIELD_* flags saying which fields to write.
+ * \return  0 on success, -1 if the writer has failed.
  */
-/*char** array_get_stagnant_sensor_names(struct array *this_array, time_t stagnant_time, size_t *number_of_sensors)
+int array_json_summary(struct array *this_array, struct json_writer *json, unsigned int fields)
 {
-    *number_of_sensors = 0;
-    char **sensor_names = NULL;
-    int i;
+    json_begin_object(json);
+    array_json_members(this_array, json, fields);
+    json_end_object(json);
+    return json_writer_has_failed(json) ? -1 : 0;
+}
+
+
+/**
+ * \fn      int array_json(struct array *this_array, struct json_writer *json, unsigned int fields)
+ * \details Write the whole array as a JSON object: the summary (see array_json_summary()), the top-level sensors, and every host (the
+ *          fhosts, then the xhosts) with everything on it. It's written straight from the model as it's walked.
+ * \param   this_array A pointer to the array in question.
+ * \param   json The json_writer to which the object is written.
+ * \param   fields The JSON_FIELD_* flags saying which fields to write, for the array and everything in it.
+ * \return  0 on success, -1 if the writer has failed.
+ */
+int array_json(struct array *this_array, struct json_writer *json, unsigned int fields)
+{
+    size_t i, j;
+    json_begin_object(json);
+    array_json_members(this_array, json, fields);
+    json_key(json, "top_level_sensors");
+    json_begin_array(json);
     for (i = 0; i < this_array->num_top_level_sensors; i++)
+        sensor_json(this_array->top_level_sensor_list[i], json, fields);
+    json_end_array(json);
+    json_key(json, "hosts");
+    json_begin_array(json);
+    for (j = 0; j < this_array->number_of_teams; j++)
+        for (i = 0; i < this_array->n_antennas; i++)
+            team_get_host_json(this_array->team_list[j], i, json, fields);
+    json_end_array(json);
+    json_end_object(json);
+    return json_writer_has_failed(json) ? -1 : 0;
+}
+
+
+/**
+ * \fn      int array_json_host(struct array *this_array, char *host_id, struct json_writer *json, unsigned int fields)
+ * \details Write one of the array's hosts as a JSON object. See host_json().
+ * \param   this_array A pointer to the array in question.
+ * \param   host_id The host's type and number, e.g. "f3", as on the detail page.
+ * \param   json The json_writer to which the object is written.
+ * \param   fields The JSON_FIELD_* flags saying which fields to write.
+ * \return  An integer indicating the outcome of the operation.
+ */
+int array_json_host(struct array *this_array, char *host_id, struct json_writer *json, unsigned int fields)
+{
+    struct team *this_team = array_find_team(this_array, host_id[0]);
+    if (this_team == NULL || host_id[1] < '0' || host_id[1] > '9')
+        return 1; /// \retval 1 There's no such host. Nothing has been written.
+    char *end;
+    unsigned long host_number = strtoul(host_id + 1, &end, 10);
+    if (*end != '\0' || host_number >= this_array->n_antennas)
+        return 1;
+    if (team_get_host_json(this_team, (size_t) host_number, json, fields) < 0)
+        return -1; /// \retval -1 The writer has failed.
+    return 0; /// \retval 0 The host has been written.
+}
+
+
+/**
+ * \fn      int array_html_missing_pkt_view(struct array *this_array, struct strbuf *html)
+ * \details Append an HTML representation of the array's missing-pkt sensors on the xhosts. Rather than looking each of the
+ *          n_antennas^2 sensors up by name, the sensor table is scanned once to find them all.
+ * \param   this_array A pointer to the array in question.
+ * \param   html The strbuf to which the representation is appended.
+ * \return  0 on success, -1 if there was no memory.
+ */
+int array_html_missing_pkt_view(struct array *this_array, struct strbuf *html)
+{
+    size_t n_antennas = this_array->n_antennas;
+    size_t n_devices = sensor_table_get_number_of_devices(this_array->sensor_table);
+    size_t n_rows = sensor_table_get_number_of_rows(this_array->sensor_table);
+    //Which xhost each device is the missing-pkts device of, if any, and which row of the table belongs in each cell.
+    size_t n_cells = n_antennas*n_antennas;
+    size_t *device_xhost = malloc(sizeof(*device_xhost)*(n_devices > 0 ? n_devices : 1));
+    size_t *cell_row = malloc(sizeof(*cell_row)*(n_cells > 0 ? n_cells : 1));
+    if (device_xhost == NULL || cell_row == NULL)
     {
-        if (time(0) >= sensor_get_last_updated(this_array->top_level_sensor_list[i]) + stagnant_time)
-        {
-            sensor_names = realloc(sensor_names, sizeof(*sensor_names)*(*number_of_sensors + 1));
-            sensor_names[(*number_of_sensors)++] = strdup(sensor_get_name(this_array->top_level_sensor_list[i]));
-        }
+        free(device_xhost);
+        free(cell_row);
+        return -1;
     }
-
-    for (i = 0; i < this_array->number_of_teams; i++)
+    size_t i, j;
+    for (i = 0; i < n_cells; i++)
+        cell_row[i] = SENSOR_TABLE_NONE;
+    for (i = 0; i < n_devices; i++)
+    {
+        size_t host = sensor_table_get_device_host(this_array->sensor_table, i);
+        device_xhost[i] = SENSOR_TABLE_NONE;
+        if (sensor_table_get_host_type(this_array->sensor_table, host) == 'x' && \
+                (size_t) sensor_table_get_host_number(this_array->sensor_table, host) < n_antennas && \
+                !strcmp(sensor_table_get_device_name(this_array->sensor_table, i), "missing-pkts"))
+            device_xhost[i] = (size_t) sensor_table_get_host_number(this_array->sensor_table, host);
+    }
+    for (i = 0; i < n_rows; i++)
+    {
+        size_t device = sensor_table_get_row_device(this_array->sensor_table, i);
+        unsigned int fhost;
+        if (device != SENSOR_TABLE_NONE && device_xhost[device] != SENSOR_TABLE_NONE && \
+                sscanf(sensor_get_name(sensor_table_get_row_sensor(this_array->sensor_table, i)), "fhost%u-cnt", &fhost) == 1 && \
+                fhost < n_antennas)
+            cell_row[device_xhost[device]*n_antennas + fhost] = i;
+    }
+    free(device_xhost);
+
+    //Column headings come from the vertical axis, which should be okay because we assume a square array.
+    strbuf_append(html, "<table><tr><td> </td>");
+    for (i = 0; i < n_antennas; i++)
+        strbuf_appendf(html, "<td>f%02zu</td>", i);
+    strbuf_append(html, "</tr>\n<tr><td> </td>");
+    for (i = 0; i < n_antennas; i++)
+        strbuf_appendf(html, "<td>%s</td>", team_get_fhost_input_stream(this_array->team_list[0], i));
+    strbuf_append(html, "</tr>\n");
+    for (i = 0; i < n_antennas; i++)
     {
-        size_t batch_n_sensors;
-        char **batch_sensor_names = team_get_stagnant_sensor_names(this_array->team_list[i], stagnant_time, &batch_n_sensors);
-        sensor_names = realloc(sensor_names, sizeof(*sensor_names)*(*number_of_sensors + batch_n_sensors));
-        int j;
-        for (j = 0; j < batch_n_sensors; j++)
+        strbuf_appendf(html, "<tr><td>x%02zu</td>", i);
+        for (j = 0; j < n_antennas; j++)
         {
-            sensor_names[*number_of_sensors + (size_t) j] = strdup(batch_sensor_names[j]);
-            free(batch_sensor_names[j]); //can do it here I guess, no need to through another loop?
+            size_t row = cell_row[i*n_antennas + j];
+            if (row == SENSOR_TABLE_NONE)
+                strbuf_appendf(html, "<td class=\"%s\"></td>", sensor_status_to_string(SENSOR_UNKNOWN));
+            else
+                strbuf_appendf(html, "<td class=\"%s\">%s</td>", sensor_status_to_string(sensor_table_get_status(this_array->sensor_table, row)), \
+                        sensor_table_get_value(this_array->sensor_table, row));
         }
-        free(batch_sensor_names);
-        *number_of_sensors += batch_n_sensors;
+        strbuf_append(html, "</tr>\n");
     }
-
-    if (*number_of_sensors)
-        syslog(LOG_DEBUG, "Array %s reported %ld stagnant sensor%s.", this_array->name, *number_of_sensors, *number_of_sensors == 1 ? "" : "s");
-    return sensor_names;
-
-} */
+    strbuf_append(html, "</table>");
+    free(cell_row);
+    return strbuf_has_failed(html) ? -1 : 0;
+}
 
 
@@ -1,7 +1,15 @@
 #ifndef _ARRAY_H_
 #define _ARRAY_H_
 #include <stdint.h>
+#include <time.h>
 #include "message.h"
+#include "sensor.h"
+#include "reactor.h"
+#include "timers.h"
+#include "history.h"
+#include "sensor_template.h"
+#include "strbuf.h"
+#include "fragment.h"
 
 /**
  * \file  array.h
@@ -11,15 +19,20 @@
 
 struct array;
 
-struct array *array_create(char *new_array_name, char *cmc_address, uint16_t control_port, uint16_t monitor_port, size_t n_antennas);
+struct array *array_create(char *new_array_name, char *cmc_address, uint16_t control_port, uint16_t monitor_port, size_t n_antennas, struct reactor *reactor, struct timers *timers, struct history_pool *history_pool, struct sensor_template *sensor_template, size_t request_window);
 void array_destroy(struct array *this_array);
 
 char *array_get_name(struct array *this_array);
+uint64_t array_get_generation(struct array *this_array);
+char *array_get_cmc_address(struct array *this_array);
+time_t array_get_last_updated(struct array *this_array);
 size_t array_get_size(struct array *this_array);
+size_t array_get_status_count(struct array *this_array, enum sensor_status status);
+int array_compare_health(const void *a, const void *b);
 int array_add_team_host_device_sensor(struct array *this_array, char team_type, size_t host_number, char *device_name, char *sensor_name);
 int array_add_team_host_engine_device_sensor(struct array *this_array, char team_type, size_t host_number, char *engine_name, char *device_name, char *sensor_name);
 int array_add_top_level_sensor(struct array *this_array, char *sensor_name);
-int array_update_top_level_sensor(struct array *this_array, char *sensor_name, char *new_value, char *new_status);
+int array_update_top_level_sensor(struct array *this_array, char *sensor_name, char *new_value, enum sensor_status new_status);
 
 void array_mark_suspect(struct array *this_array);
 int array_check_suspect(struct array *this_array);
@@ -28,20 +41,19 @@ void array_mark_fine(struct array *this_array);
 int array_functional(struct array *this_array);
 
 char *array_get_sensor_value(struct array *this_array, char team_type, size_t host_number, char *device_name, char *sensor_name);
-char *array_get_sensor_status(struct array *this_array, char team_type, size_t host_number, char *device_name, char *sensor_name);
+enum sensor_status array_get_sensor_status(struct array *this_array, char team_type, size_t host_number, char *device_name, char *sensor_name);
 
-void array_set_fds(struct array *this_array, fd_set *rd, fd_set *wr, int *nfds);
 void array_setup_katcp_writes(struct array *this_array);
-void array_socket_read_write(struct array *this_array, fd_set *rd, fd_set *wr);
-void array_handle_received_katcl_lines(struct array *this_array);
 
-struct message *array_control_queue_pop(struct array *this_array);
-struct message *array_monitor_queue_pop(struct array *this_array);
-
-char *array_html_summary(struct array *this_array, char *cmc_name);
-char *array_html_detail(struct array *this_array);
-char *array_html_missing_pkt_view(struct array *this_array);
-
-//char** array_get_stagnant_sensor_names(struct array *this_array, time_t stagnant_time, size_t *number_of_sensors);
+int array_html_summary(struct array *this_array, char *cmc_name, struct strbuf *html);
+int array_html_heading(struct array *this_array, struct strbuf *html);
+struct fragment *array_html_table(struct array *this_array);
+size_t array_get_number_of_cells(struct array *this_array);
+void array_get_cell_statuses(struct array *this_array, uint64_t generation, unsigned char *cell_status);
+int array_html_changes(struct array *this_array, uint64_t since, unsigned char *cell_status, struct strbuf *lines);
+int array_json_summary(struct array *this_array, struct json_writer *json, unsigned int fields);
+int array_json(struct array *this_array, struct json_writer *json, unsigned int fields);
+int array_json_host(struct array *this_array, char *host_id, struct json_writer *json, unsigned int fields);
+int array_html_missing_pkt_view(struct array *this_array, struct strbuf *html);
 
 #endif
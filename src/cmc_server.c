@@ -14,19 +14,25 @@
 #include "message.h"
 #include "utils.h"
 #include "array.h"
-
-#undef max
-#define max(x,y) ((x) > (y) ? (x) : (y))
+#include "reactor.h"
+#include "timers.h"
+#include "reconnect.h"
+#include "katcp_dispatch.h"
+#include "pipeline.h"
+#include "fragment.h"
+#include "strbuf.h"
 
 enum cmc_state {
     CMC_WAIT_CONNECT,
-    CMC_SEND_FRONT_OF_QUEUE,
-    CMC_WAIT_RESPONSE,
     CMC_MONITOR,
     CMC_DISCONNECTED,
 };
 
 
+/// How often to check whether arrays have been created or destroyed on the CMC server, in milliseconds.
+#define CMC_ARRAY_LIST_POLL_MS 60000
+
+
 /// A struct to manage the connection to a CMC server.
 struct cmc_server {
     /// The port on which the CMC server is listening for KATCP connections. Usually 7147.
@@ -39,10 +45,12 @@ struct cmc_server {
     struct katcl_line *katcl_line;
     /// The current state of the connection state-machine.
     enum cmc_state state;
-    /// The queue storing messages to be sent. A queue is needed because the CMC server wants you to wait for the ok response before sending another message.
+    /// The queue storing messages to be sent. A queue is needed because only so many requests may be waiting for responses at once.
     struct queue *outgoing_msg_queue;
-    /// The most recent message that's been sent, so that we can match it against the response received, to know whether it's failed or not.
-    struct message *current_message;
+    /// The messages which have been sent, so that we can match them against the responses received, to know whether they've failed or not.
+    struct pipeline *pipeline;
+    /// The most requests to have in flight on each connection, the CMC server's and its arrays', if message IDs are supported.
+    size_t request_window;
     /// The list of arrays that the CMC server is currently managing.
     struct array **array_list;
     /// The number of arrays in the list.
@@ -53,56 +61,181 @@ struct cmc_server {
     size_t up_skarabs;
     /// The number of skarabs allocated to an array.
     size_t allocated_skarabs;
+    /// Moves on whenever anything on the CMC server's part of the main page changes, other than its arrays, which have their own.
+    uint64_t generation;
+    /// The CMC server's part of the main page as last rendered, from the generation above.
+    struct fragment *html_fragment;
+    /// The generation of each array (in array_list order) when the fragment was rendered. The arrays' generations are counted
+    /// separately, so they can't be folded into a single number.
+    uint64_t *rendered_array_generations;
+    /// The reactor which watches the CMC server's file descriptor, and those of its arrays.
+    struct reactor *reactor;
+    /// The timers used for reconnection attempts and other periodic work, for the CMC server and its arrays.
+    struct timers *timers;
+    /// The pool from which the arrays' sensors get their history rings.
+    struct history_pool *history_pool;
+    /// The sensors to which the arrays subscribe, from sensor_list.conf.
+    struct sensor_template *sensor_template;
+    /// The backoff state for reconnecting to the CMC server.
+    struct reconnect *reconnect;
+    /// Fires periodically to check whether the CMC server's list of arrays has changed.
+    struct timeout *array_list_poll;
 };
 
 
+static void cmc_server_socket_event(struct reactor *this_reactor, int fd, uint32_t events, void *data);
+
+
+/**
+ * \fn      static void cmc_server_close_connection(struct cmc_server *this_cmc_server)
+ * \details Stop watching the CMC server's file descriptor, and close it along with its katcl_line.
+ * \param   this_cmc_server A pointer to the cmc_server in question.
+ * \return  void
+ */
+static void cmc_server_close_connection(struct cmc_server *this_cmc_server)
+{
+    if (this_cmc_server->katcp_socket_fd >= 0)
+    {
+        reactor_remove(this_cmc_server->reactor, this_cmc_server->katcp_socket_fd);
+        if (this_cmc_server->katcl_line != NULL)
+        {
+            destroy_katcl(this_cmc_server->katcl_line, 0);
+            this_cmc_server->katcl_line = NULL;
+        }
+        close(this_cmc_server->katcp_socket_fd);
+        this_cmc_server->katcp_socket_fd = -1;
+    }
+}
+
+
+/**
+ * \fn      static void cmc_server_update_events(struct cmc_server *this_cmc_server)
+ * \details Tell the reactor which events the cmc_server is interested in, according to the state that its state machine is in.
+ *          While waiting for the connect() to complete, the file descriptor will become writeable. Once connected, reads are always
+ *          wanted, but writes only if the katcl_line has something waiting to be sent.
+ * \param   this_cmc_server A pointer to the cmc_server in question.
+ * \return  void
+ */
+static void cmc_server_update_events(struct cmc_server *this_cmc_server)
+{
+    switch (this_cmc_server->state) {
+        case CMC_WAIT_CONNECT:
+            reactor_modify(this_cmc_server->reactor, this_cmc_server->katcp_socket_fd, REACTOR_WRITE);
+            break;
+        case CMC_DISCONNECTED:
+            break; //Nothing to do here, the file descriptor isn't registered.
+        default:
+            reactor_modify(this_cmc_server->reactor, this_cmc_server->katcp_socket_fd,
+                    REACTOR_READ | (flushing_katcl(this_cmc_server->katcl_line) ? REACTOR_WRITE : 0));
+    }
+}
+
+
+/**
+ * \fn      static void cmc_server_reconnect_attempt(void *data)
+ * \details Start a (non-blocking) connection to the CMC server, abandoning any attempt which is still in progress. The next attempt is
+ *          scheduled straight away, and cancelled if this one succeeds.
+ * \param   data A pointer to the cmc_server in question.
+ * \return  void
+ */
+static void cmc_server_reconnect_attempt(void *data)
+{
+    struct cmc_server *this_cmc_server = data;
+    cmc_server_close_connection(this_cmc_server);
+    //TODO destroy all the arrays underneath as well?
+    this_cmc_server->katcp_socket_fd = net_connect(this_cmc_server->address, this_cmc_server->katcp_port, NETC_VERBOSE_ERRORS | NETC_VERBOSE_STATS | NETC_ASYNC | NETC_TCP_KEEP_ALIVE | NETC_TCP_USR_TIMEOUT);
+    if (this_cmc_server->katcp_socket_fd >= 0 && \
+            reactor_add(this_cmc_server->reactor, this_cmc_server->katcp_socket_fd, REACTOR_WRITE, cmc_server_socket_event, this_cmc_server) == 0)
+    {
+        this_cmc_server->state = CMC_WAIT_CONNECT;
+        this_cmc_server->generation++;
+    }
+    else
+    {
+        syslog(LOG_ERR, "Unable to start connecting to %s:%hu, will retry.", this_cmc_server->address, this_cmc_server->katcp_port);
+        if (this_cmc_server->katcp_socket_fd >= 0)
+            close(this_cmc_server->katcp_socket_fd);
+        this_cmc_server->katcp_socket_fd = -1;
+        this_cmc_server->state = CMC_DISCONNECTED;
+        this_cmc_server->generation++;
+    }
+    reconnect_schedule(this_cmc_server->reconnect);
+}
+
+
+/**
+ * \fn      static void cmc_server_connection_lost(struct cmc_server *this_cmc_server)
+ * \details Close an established connection which has failed, and schedule a reconnection attempt.
+ * \param   this_cmc_server A pointer to the cmc_server in question.
+ * \return  void
+ */
+static void cmc_server_connection_lost(struct cmc_server *this_cmc_server)
+{
+    cmc_server_close_connection(this_cmc_server);
+    this_cmc_server->state = CMC_DISCONNECTED;
+    this_cmc_server->generation++;
+    reconnect_schedule(this_cmc_server->reconnect);
+}
+
+
+/**
+ * \fn      static void cmc_server_array_list_poll_due(struct timeout *this_timeout, void *data)
+ * \details Poll the CMC server for its list of arrays, and schedule the next poll.
+ * \param   this_timeout A pointer to the timeout which fired.
+ * \param   data A pointer to the cmc_server in question.
+ * \return  void
+ */
+static void cmc_server_array_list_poll_due(struct timeout *this_timeout, void *data)
+{
+    cmc_server_poll_array_list(data);
+    timeout_schedule(this_timeout, CMC_ARRAY_LIST_POLL_MS);
+}
+
+
 /**
- * \fn      struct cmc_server *cmc_server_create(char *address, uint16_t katcp_port)
+ * \fn      struct cmc_server *cmc_server_create(char *address, uint16_t katcp_port, struct reactor *reactor, struct timers *timers, struct history_pool *history_pool, struct sensor_template *sensor_template, size_t request_window)
  * \details Allocate memory for a cmc_server object and initialise its members so that it gets ready to start communicating with the CMC server.
- *          The object is created with a hard-coded list of initial messages to send: "?log-local off", "?client-config info-all", and "?array-list".
+ *          Every time a connection is made, a hard-coded list of initial messages is sent: "?log-local off", "?client-config info-all",
+ *          "?array-list" and "?resource-list".
  * \param   address A string containing the IP address or (resolvable) hostname of the CMC server.
  * \param   katcp_port The TCP port on which the CMC server is listening for KATCP connections.
+ * \param   reactor The reactor with which the cmc_server (and its arrays) will register their file descriptors.
+ * \param   timers The timers which will drive reconnection attempts for the cmc_server (and its arrays).
+ * \param   history_pool The pool from which the cmc_server's arrays get their sensors' history rings.
+ * \param   sensor_template The sensors to which the cmc_server's arrays subscribe when they're activated.
+ * \param   request_window The most requests to have in flight on each KATCP connection, if the server at the other end supports
+ *                         message IDs.
  * \returns A pointer to the newly-allocated cmc_server object.
  */
-struct cmc_server *cmc_server_create(char *address, uint16_t katcp_port)
+struct cmc_server *cmc_server_create(char *address, uint16_t katcp_port, struct reactor *reactor, struct timers *timers, struct history_pool *history_pool, struct sensor_template *sensor_template, size_t request_window)
 {
     struct cmc_server *new_cmc_server = malloc(sizeof(*new_cmc_server));
     new_cmc_server->address = strdup(address);
     new_cmc_server->katcp_port = katcp_port;
-    new_cmc_server->katcp_socket_fd = net_connect(address, katcp_port, NETC_VERBOSE_ERRORS | NETC_VERBOSE_STATS | NETC_ASYNC | NETC_TCP_KEEP_ALIVE | NETC_TCP_USR_TIMEOUT );
+    new_cmc_server->reactor = reactor;
+    new_cmc_server->timers = timers;
+    new_cmc_server->history_pool = history_pool;
+    new_cmc_server->sensor_template = sensor_template;
+    new_cmc_server->reconnect = reconnect_create(timers, RECONNECT_INITIAL_MS, RECONNECT_MAX_MS, cmc_server_reconnect_attempt, new_cmc_server);
+    new_cmc_server->array_list_poll = timeout_create(timers, cmc_server_array_list_poll_due, new_cmc_server);
+    new_cmc_server->katcp_socket_fd = -1;
     new_cmc_server->katcl_line = NULL;
     new_cmc_server->outgoing_msg_queue = queue_create();
+    new_cmc_server->pipeline = pipeline_create(request_window);
+    new_cmc_server->request_window = request_window;
 
     new_cmc_server->array_list = NULL;
     new_cmc_server->no_of_arrays = 0;
 
-    /*This bit is hardcoded for the time being. Perhaps a better way would be to include it in a config
-     * file like the sensors to which we'll be subscribing. */
-    struct message *new_message = message_create('?');
-    message_add_word(new_message, "log-local");
-    message_add_word(new_message, "off");
-    queue_push(new_cmc_server->outgoing_msg_queue, new_message);
-
-    new_message = message_create('?');
-    message_add_word(new_message, "client-config");
-    message_add_word(new_message, "info-all");
-    queue_push(new_cmc_server->outgoing_msg_queue, new_message);
-
-    new_message = message_create('?');
-    message_add_word(new_message, "array-list");
-    queue_push(new_cmc_server->outgoing_msg_queue, new_message);
-
-    new_message = message_create('?');
-    message_add_word(new_message, "resource-list");
-    queue_push(new_cmc_server->outgoing_msg_queue, new_message);
-
     new_cmc_server->standby_skarabs = 0;
     new_cmc_server->up_skarabs = 0;
     new_cmc_server->allocated_skarabs = 0;
 
-    new_cmc_server->current_message = NULL;
-    cmc_server_queue_pop(new_cmc_server);
-    new_cmc_server->state = CMC_WAIT_CONNECT;
+    new_cmc_server->generation = 0;
+    new_cmc_server->html_fragment = fragment_create();
+    new_cmc_server->rendered_array_generations = NULL;
+
+    cmc_server_reconnect_attempt(new_cmc_server);
     return new_cmc_server;
 }
 
@@ -117,11 +250,11 @@ void cmc_server_destroy(struct cmc_server *this_cmc_server)
 {
     if (this_cmc_server != NULL)
     {
-        if (this_cmc_server->katcl_line != NULL) //because it might not have actually been connected.
-            destroy_katcl(this_cmc_server->katcl_line, 1);
-        close(this_cmc_server->katcp_socket_fd);
+        cmc_server_close_connection(this_cmc_server);
+        reconnect_destroy(this_cmc_server->reconnect);
+        timeout_destroy(this_cmc_server->array_list_poll);
         queue_destroy(this_cmc_server->outgoing_msg_queue);
-        message_destroy(this_cmc_server->current_message);
+        pipeline_destroy(this_cmc_server->pipeline);
         size_t i;
         for (i = 0; i < this_cmc_server->no_of_arrays; i++)
         {
@@ -129,30 +262,13 @@ void cmc_server_destroy(struct cmc_server *this_cmc_server)
         }
         free(this_cmc_server->array_list);
         free(this_cmc_server->address);
+        fragment_destroy(this_cmc_server->html_fragment);
+        free(this_cmc_server->rendered_array_generations);
         free(this_cmc_server);
     }
 }
 
 
-/**
- * \fn      void cmc_server_try_reconnect(struct cmc_server *this_cmc_server)
- * \details If the cmc_server's state indicates that it is disconnected, try to reconnect.
- *          Honestly, I'm not entirely sure that this actually works properly.
- * \param   this_cmc_server A pointer to the cmc_server in question.
- * \return  void
- */
-void cmc_server_try_reconnect(struct cmc_server *this_cmc_server)
-{
-    if (this_cmc_server->state == CMC_DISCONNECTED || this_cmc_server->state == CMC_WAIT_CONNECT)
-    {
-        close(this_cmc_server->katcp_socket_fd);
-        //TODO destroy all the arrays underneath as well?
-        this_cmc_server->katcp_socket_fd = net_connect(this_cmc_server->address, this_cmc_server->katcp_port, NETC_VERBOSE_ERRORS | NETC_VERBOSE_STATS | NETC_ASYNC | NETC_TCP_KEEP_ALIVE | NETC_TCP_USR_TIMEOUT);
-        this_cmc_server->state = CMC_WAIT_CONNECT;
-    }
-}
-
-
 /**
  * \fn      void cmc_server_poll_array_list(struct cmc_server *this_cmc_server)
  * \details This function adds an "?array-list" message to the cmc_server's message queue and sets it up to send (if it's not busy with other things).
@@ -182,36 +298,45 @@ void cmc_server_poll_array_list(struct cmc_server *this_cmc_server)
         this_cmc_server->standby_skarabs = 0;
         this_cmc_server->up_skarabs = 0;
         this_cmc_server->allocated_skarabs = 0;
-
-        char *message_exists = message_compose(this_cmc_server->current_message);
-       	// Don't just check for null, because a message might exist with zero words in it somehow. If it composes to a usable string, then it's legit.
-        if (!message_exists)
-            cmc_server_queue_pop(this_cmc_server);
-        free(message_exists);
+        this_cmc_server->generation++;
         //syslog(LOG_DEBUG, "%s:%hu pushed an array-list poll onto its message queue.", this_cmc_server->address, this_cmc_server->katcp_port);
-        if (this_cmc_server->state == CMC_MONITOR)
-        {
-            // If not in monitor state, it's probably still working through some sort of a queue.
-            this_cmc_server->state = CMC_SEND_FRONT_OF_QUEUE;
-        }
     }
 }
 
 
 /**
- * \fn      struct message *cmc_server_queue_pop(struct cmc_server *this_cmc_server)
- * \details Remove the cmc_server's current_message (if any), and replaces it with one popped from the outgoing_msg_queue.
+ * \fn      static void cmc_server_queue_initial_messages(struct cmc_server *this_cmc_server)
+ * \details Queue up the messages which need to be sent on every new connection. Anything left over from the last one is thrown away
+ *          first, so that the handshake goes out before anything else: it could only be an earlier poll, or a retry of one, and the
+ *          array-list and resource-list are polled for afresh here. The array-list also weeds out any arrays which disappeared while the
+ *          connection was down.
  * \param   this_cmc_server A pointer to the cmc_server in question.
- * \return  A pointer to the message that was popped from the outgoing_msg_queue.
+ * \return  void
  */
-struct message *cmc_server_queue_pop(struct cmc_server *this_cmc_server)
+static void cmc_server_queue_initial_messages(struct cmc_server *this_cmc_server)
 {
-    if (this_cmc_server->current_message != NULL)
-    {
-        message_destroy(this_cmc_server->current_message);
-    }
-    this_cmc_server->current_message = queue_pop(this_cmc_server->outgoing_msg_queue);
-    return this_cmc_server->current_message;
+    //Whatever was in flight when the last connection went down will never get a response.
+    pipeline_reset(this_cmc_server->pipeline);
+    while (queue_sizeof(this_cmc_server->outgoing_msg_queue))
+        message_destroy(queue_pop(this_cmc_server->outgoing_msg_queue));
+
+    /*This bit is hardcoded for the time being. Perhaps a better way would be to include it in a config
+     * file like the sensors to which we'll be subscribing. */
+    struct message *new_message = message_create('?');
+    message_add_word(new_message, "log-local");
+    message_add_word(new_message, "off");
+    queue_push(this_cmc_server->outgoing_msg_queue, new_message);
+
+    new_message = message_create('?');
+    message_add_word(new_message, "client-config");
+    message_add_word(new_message, "info-all");
+    queue_push(this_cmc_server->outgoing_msg_queue, new_message);
+
+    this_cmc_server->state = CMC_MONITOR;
+    this_cmc_server->generation++;
+    cmc_server_poll_array_list(this_cmc_server);
+    //The regular polls count from here.
+    timeout_schedule(this_cmc_server->array_list_poll, CMC_ARRAY_LIST_POLL_MS);
 }
 
 
@@ -228,107 +353,19 @@ char *cmc_server_get_name(struct cmc_server *this_cmc_server)
 }
 
 
-/**
- * \fn      void cmc_server_set_fds(struct cmc_server *this_cmc_server, fd_set *rd, fd_set *wr, int *nfds)
- * \details This function sets both read and write file desciptors according to the state that the cmc_server's state machine is in.
- *          the rd file descriptor will almost always be set if the connection is active, with the wr file descriptor set only if there
- *          is a message waiting to be sent.
- * \param   this_cmc_server A pointer to the cmc_server in question.
- * \param   rd A pointer to the fd_set indicating ready to read.
- * \param   wr A pointer to the fd_set indicating ready to write.
- * \param   nfds A pointer to an integer indicating the number of file descriptors in the above sets.
- * \return  void
- */
-void cmc_server_set_fds(struct cmc_server *this_cmc_server, fd_set *rd, fd_set *wr, int *nfds)
-{
-    /* //I forget why this code is here.
-    int so_error;
-    socklen_t len = sizeof(so_error);
-    getsockopt(this_cmc_server->katcp_socket_fd, SOL_SOCKET, SO_ERROR, &so_error, &len);
-    if (so_error != 0)
-    {
-        this_cmc_server->state = CMC_DISCONNECTED;
-    }
-    */
-    switch (this_cmc_server->state) {
-        case CMC_WAIT_CONNECT:
-            syslog(LOG_NOTICE, "CMC server %s:%hu still not connected...\n", this_cmc_server->address, this_cmc_server->katcp_port);
-            FD_SET(this_cmc_server->katcp_socket_fd, wr); // If we're still waiting for the connect() to happen, then it'll appear on the writeable FDs.
-            *nfds = max(*nfds, this_cmc_server->katcp_socket_fd);
-            break;
-        case CMC_DISCONNECTED:
-            break; //Nothing to do here.
-        default:
-            FD_SET(this_cmc_server->katcp_socket_fd, rd);
-            if (flushing_katcl(this_cmc_server->katcl_line))
-            {
-                FD_SET(this_cmc_server->katcp_socket_fd, wr);
-            }
-            *nfds = max(*nfds, this_cmc_server->katcp_socket_fd);
-            
-            //now for the individual arrays.
-            size_t i;
-            for (i = 0; i < this_cmc_server->no_of_arrays; i++)
-            {
-                if (array_functional(this_cmc_server->array_list[i]) >= 0)
-                    array_set_fds(this_cmc_server->array_list[i], rd, wr, nfds);
-                //TODO some other way to deal with this.
-            }
-    }
-}
-
-
 /**
  * \fn      void cmc_server_setup_katcp_writes(struct cmc_server *this_cmc_server)
- * \details If there is a message waiting to be sent, this function will insert it into the katcl_line, word for word, until it's finished.
- *          On the next select() loop, the katcl_line will then report that it's ready to write a fully-formed message to the file descriptor.
+ * \details Move as many waiting messages into the katcl_line as the pipeline has room for, and do the same for each of the arrays. The
+ *          reactor will then report when the file descriptors are ready for the katcl_lines to write the fully-formed messages.
  * \param   this_cmc_server A pointer to the cmc_server in question.
  * \return  void
  */
 void cmc_server_setup_katcp_writes(struct cmc_server *this_cmc_server)
 {
-    if (this_cmc_server->current_message)
-    {
-        if (this_cmc_server->state == CMC_SEND_FRONT_OF_QUEUE)
-        {
-            int n = message_get_number_of_words(this_cmc_server->current_message);
-            if (n > 0)
-            {
-                char *composed_message = message_compose(this_cmc_server->current_message);
-                syslog(LOG_DEBUG, "%s is sending a message: %s", this_cmc_server->address, composed_message);
-                free(composed_message);
-                composed_message = NULL;
-
-                char *first_word = malloc(strlen(message_see_word(this_cmc_server->current_message, 0)) + 2);
-                sprintf(first_word, "%c%s", message_get_type(this_cmc_server->current_message), message_see_word(this_cmc_server->current_message, 0));
-                if (message_get_number_of_words(this_cmc_server->current_message) == 1)
-                {
-                    append_string_katcl(this_cmc_server->katcl_line, KATCP_FLAG_FIRST | KATCP_FLAG_LAST, first_word);
-                }
-                else
-                {
-                    append_string_katcl(this_cmc_server->katcl_line, KATCP_FLAG_FIRST, first_word);
-                    size_t j;
-                    for (j = 1; j < n - 1; j++)
-                    {
-                        append_string_katcl(this_cmc_server->katcl_line, 0, message_see_word(this_cmc_server->current_message, j));
-                    }
-                    append_string_katcl(this_cmc_server->katcl_line, KATCP_FLAG_LAST, message_see_word(this_cmc_server->current_message, (size_t) n - 1));
-                }
+    if (this_cmc_server->state == CMC_MONITOR)
+        pipeline_fill(this_cmc_server->pipeline, this_cmc_server->outgoing_msg_queue, this_cmc_server->katcl_line);
 
-                syslog(LOG_DEBUG, "%s message sent successfully.", first_word);
-                free(first_word);
-                this_cmc_server->state = CMC_WAIT_RESPONSE;
-            }
-            /*
-            else
-            {
-                syslog(LOG_WARNING, "A message on %s:%hu's queue had 0 words in it. Cannot send.", this_cmc_server->address, this_cmc_server->katcp_port);
-                //TODO push through the queue if there's an error.
-            }
-            */
-        }
-    }
+    cmc_server_update_events(this_cmc_server);
 
     size_t i;
     for (i=0; i < this_cmc_server->no_of_arrays; i++)
@@ -339,19 +376,18 @@ void cmc_server_setup_katcp_writes(struct cmc_server *this_cmc_server)
 
 
 /**
- * \fn      void cmc_server_socket_read_write(struct cmc_server *this_cmc_server, fd_set *rd, fd_set *wr)
+ * \fn      static void cmc_server_socket_read_write(struct cmc_server *this_cmc_server, uint32_t events)
  * \details Depending on the state that the cmc_server's state machine is in, send all transmissions which are ready, and read
  *          incoming transmissions, storing them in the katcl_line for processing once a fully-formed message is received.
  * \param   this_cmc_server A pointer to the cmc_server in question.
- * \param   rd A pointer to the fd_set indicating ready to read.
- * \param   wr A pointer to the fd_set indicating ready to write.
+ * \param   events The REACTOR_* events which the reactor reported for the file descriptor.
  * \return  void
  */
-void cmc_server_socket_read_write(struct cmc_server *this_cmc_server, fd_set *rd, fd_set *wr)
+static void cmc_server_socket_read_write(struct cmc_server *this_cmc_server, uint32_t events)
 {
     switch (this_cmc_server->state) {
         case CMC_WAIT_CONNECT:
-            if (FD_ISSET(this_cmc_server->katcp_socket_fd, wr))
+            if (events & (REACTOR_WRITE | REACTOR_ERROR))
             {
                 syslog(LOG_DEBUG, "%s:%hu file descriptor writeable.", this_cmc_server->address, this_cmc_server->katcp_port);
                 int so_error;
@@ -362,13 +398,16 @@ void cmc_server_socket_read_write(struct cmc_server *this_cmc_server, fd_set *rd
                     //Connection is a success
                     syslog(LOG_INFO, "%s:%hu connected.", this_cmc_server->address, this_cmc_server->katcp_port);
                     this_cmc_server->katcl_line = create_katcl(this_cmc_server->katcp_socket_fd);
-                    this_cmc_server->state = CMC_SEND_FRONT_OF_QUEUE;
+                    reconnect_succeeded(this_cmc_server->reconnect);
+                    cmc_server_queue_initial_messages(this_cmc_server);
                 }
                 else
                 {
-                    //Connection failed for whatever reason.
-                    syslog(LOG_ERR, "Connection to %s%hu failed: %s", this_cmc_server->address, this_cmc_server->katcp_port, strerror(so_error));
+                    //Connection failed for whatever reason. The next attempt is already scheduled.
+                    syslog(LOG_ERR, "Connection to %s:%hu failed: %s", this_cmc_server->address, this_cmc_server->katcp_port, strerror(so_error));
+                    cmc_server_close_connection(this_cmc_server);
                     this_cmc_server->state = CMC_DISCONNECTED;
+                    this_cmc_server->generation++;
                 }
             }
             break;
@@ -379,33 +418,26 @@ void cmc_server_socket_read_write(struct cmc_server *this_cmc_server, fd_set *rd
 
         default: ; //for some reason a label (default) can only be followed by a statement, and my "int r;" is a declaration, not a statement.
             int r;
-            size_t i;
-            if (FD_ISSET(this_cmc_server->katcp_socket_fd, rd))
+            if (events & (REACTOR_READ | REACTOR_ERROR))
             {
                 r = read_katcl(this_cmc_server->katcl_line);
                 if (r)
                 {
                     syslog(LOG_ERR, "read from %s:%hu on fd %d failed\n", this_cmc_server->address, this_cmc_server->katcp_port, this_cmc_server->katcp_socket_fd);
-                    /*TODO some kind of error checking, what to do if the CMC doesn't connect.*/
-                    this_cmc_server->state = CMC_DISCONNECTED;
+                    cmc_server_connection_lost(this_cmc_server);
+                    return;
                 }
             }
             
-            if (FD_ISSET(this_cmc_server->katcp_socket_fd, wr))
+            if (events & REACTOR_WRITE)
             {
                 r = write_katcl(this_cmc_server->katcl_line);
                 if (r < 0)
                 {
-                    /*TODO some other kind of error checking.*/
                     syslog(LOG_ERR, "write to %s:%hu on fd %d failed\n", this_cmc_server->address, this_cmc_server->katcp_port, this_cmc_server->katcp_socket_fd);
-                    this_cmc_server->state = CMC_DISCONNECTED;
+                    cmc_server_connection_lost(this_cmc_server);
                 }
             }
-
-            for (i=0; i < this_cmc_server->no_of_arrays; i++)
-            {
-                array_socket_read_write(this_cmc_server->array_list[i], rd, wr);
-            }
     }
 }
 
@@ -465,7 +497,7 @@ static int cmc_server_add_array(struct cmc_server *this_cmc_server, char *array_
         return -1;
     }
     this_cmc_server->array_list = temp;
-    this_cmc_server->array_list[this_cmc_server->no_of_arrays] = array_create(array_name, this_cmc_server->address, control_port, monitor_port, number_of_antennas);
+    this_cmc_server->array_list[this_cmc_server->no_of_arrays] = array_create(array_name, this_cmc_server->address, control_port, monitor_port, number_of_antennas, this_cmc_server->reactor, this_cmc_server->timers, this_cmc_server->history_pool, this_cmc_server->sensor_template, this_cmc_server->request_window);
     if (this_cmc_server->array_list[this_cmc_server->no_of_arrays] == NULL)
     {
         syslog(LOG_ERR, "Unable to create array \"%s\" on %s:%hu.", array_name, this_cmc_server->address, this_cmc_server->katcp_port);
@@ -473,6 +505,7 @@ static int cmc_server_add_array(struct cmc_server *this_cmc_server, char *array_
     }
     syslog(LOG_INFO, "Added array \"%s\" to %s:%hu.", array_name, this_cmc_server->address, this_cmc_server->katcp_port);
     this_cmc_server->no_of_arrays++;
+    this_cmc_server->generation++;
 
     qsort(this_cmc_server->array_list, this_cmc_server->no_of_arrays, sizeof(struct array *), cmp_array_by_name);
     return 0;
@@ -480,78 +513,75 @@ static int cmc_server_add_array(struct cmc_server *this_cmc_server, char *array_
 
 
 /**
- * \fn      void cmc_server_handle_received_katcl_lines(struct cmc_server *this_cmc_server)
+ * \fn      static void cmc_server_handle_received_katcl_lines(struct cmc_server *this_cmc_server)
  * \details This function checks whether the katcl_line has any messages ready, and then processes the message, in accordance with the logic of the
  *          built-in state machine.
  * \param   this_cmc_server A pointer to the cmc_server in question.
  * \return  void
  */
-void cmc_server_handle_received_katcl_lines(struct cmc_server *this_cmc_server)
+static void cmc_server_handle_received_katcl_lines(struct cmc_server *this_cmc_server)
 {
     if (this_cmc_server->state == CMC_WAIT_CONNECT || this_cmc_server->state == CMC_DISCONNECTED)
     {
         return; //nothing to do here.
     }
 
-    //let's try doing the array stuff before the cmc stuff
-    size_t i;
-    for (i=0; i < this_cmc_server->no_of_arrays; i++)
-    {
-        array_handle_received_katcl_lines(this_cmc_server->array_list[i]);
-    }
+    struct katcp_dispatch message;
     while (have_katcl(this_cmc_server->katcl_line) > 0)
     {
-        char received_message_type = arg_string_katcl(this_cmc_server->katcl_line, 0)[0];
-        switch (received_message_type) {
+        if (katcp_dispatch_read(this_cmc_server->katcl_line, &message) < 0)
+            continue;
+
+        switch (message.type) {
             case '!': // it's a katcp response
-                if (!strcmp(arg_string_katcl(this_cmc_server->katcl_line, 0) + 1, message_see_word(this_cmc_server->current_message, 0)))
                 {
-                    if (!strcmp(arg_string_katcl(this_cmc_server->katcl_line, 1), "ok"))
+                    struct message *request = pipeline_complete(this_cmc_server->pipeline, &message);
+                    if (request == NULL)
                     {
-                        this_cmc_server->state = CMC_SEND_FRONT_OF_QUEUE;
-                        if (queue_sizeof(this_cmc_server->outgoing_msg_queue))
-                        {
-                            cmc_server_queue_pop(this_cmc_server);
-                        }
-                        else
-                        {
-                            syslog(LOG_DEBUG, "%s:%hu going into monitoring state.", this_cmc_server->address, this_cmc_server->katcp_port);
-                            message_destroy(this_cmc_server->current_message);
-                            this_cmc_server->current_message = NULL; //doesn't do this in the above function. C problem.
-                            this_cmc_server->state = CMC_MONITOR;
-                        }
+                        syslog(LOG_DEBUG, "%s:%hu received unexpected reply %s, ignoring.", this_cmc_server->address, this_cmc_server->katcp_port, message.args[0]);
+                        break;
                     }
-                    else 
+                    if (message.args[1] != NULL && !strcmp(message.args[1], "ok"))
                     {
-                        syslog(LOG_WARNING, "Received %s %s. Retrying the request...",\
-                                message_see_word(this_cmc_server->current_message, 0), arg_string_katcl(this_cmc_server->katcl_line, 1));
-                        this_cmc_server->state = CMC_SEND_FRONT_OF_QUEUE;
+                        message_destroy(request);
+                        if (!pipeline_get_in_flight(this_cmc_server->pipeline) && !queue_sizeof(this_cmc_server->outgoing_msg_queue))
+                            syslog(LOG_DEBUG, "%s:%hu has no more requests outstanding.", this_cmc_server->address, this_cmc_server->katcp_port);
                     }
-                    //If the "!array-list ok" message is received, we need to prune the arrays which aren't active anymore. 
-                    if (!strcmp(arg_string_katcl(this_cmc_server->katcl_line, 0) + 1, "array-list"))
+                    else
                     {
-                        size_t i;
-                        for (i = 0; i < this_cmc_server->no_of_arrays; i++)
+                        syslog(LOG_WARNING, "Received %s %s. Retrying the request...", message.name_string, message.args[1] ? message.args[1] : "");
+                        queue_push(this_cmc_server->outgoing_msg_queue, request);
+                    }
+                }
+                //If the "!array-list ok" message is received, we need to prune the arrays which aren't active anymore.
+                if (message.name == KATCP_ARRAY_LIST)
+                {
+                    size_t i;
+                    for (i = 0; i < this_cmc_server->no_of_arrays; i++)
+                    {
+                        if (array_check_suspect(this_cmc_server->array_list[i]))
                         {
-                            if (array_check_suspect(this_cmc_server->array_list[i]))
-                            {
-                                syslog(LOG_INFO, "%s:%hu destroying array %s.\n", this_cmc_server->address, this_cmc_server->katcp_port, array_get_name(this_cmc_server->array_list[i]));
-                                array_destroy(this_cmc_server->array_list[i]);
-                                memmove(&this_cmc_server->array_list[i], &this_cmc_server->array_list[i+1], sizeof(*(this_cmc_server->array_list))*(this_cmc_server->no_of_arrays - i - 1));
-                                this_cmc_server->array_list = realloc(this_cmc_server->array_list, sizeof(*(this_cmc_server->array_list))*(this_cmc_server->no_of_arrays - 1));
-                                //TODO should probably do the sanitary thing here and use a temp variable. Lazy right now.
-                                this_cmc_server->no_of_arrays--;
-                                i--;
-                            }
+                            syslog(LOG_INFO, "%s:%hu destroying array %s.\n", this_cmc_server->address, this_cmc_server->katcp_port, array_get_name(this_cmc_server->array_list[i]));
+                            array_destroy(this_cmc_server->array_list[i]);
+                            memmove(&this_cmc_server->array_list[i], &this_cmc_server->array_list[i+1], sizeof(*(this_cmc_server->array_list))*(this_cmc_server->no_of_arrays - i - 1));
+                            this_cmc_server->array_list = realloc(this_cmc_server->array_list, sizeof(*(this_cmc_server->array_list))*(this_cmc_server->no_of_arrays - 1));
+                            //TODO should probably do the sanitary thing here and use a temp variable. Lazy right now.
+                            this_cmc_server->no_of_arrays--;
+                            this_cmc_server->generation++;
+                            i--;
                         }
                     }
                 }
                 break;
             case '#': // it's a katcp inform
-                if (!strcmp(arg_string_katcl(this_cmc_server->katcl_line, 0) + 1, "array-list"))
+                if (message.name == KATCP_VERSION_CONNECT)
+                {
+                    pipeline_handle_version_connect(this_cmc_server->pipeline, &message);
+                }
+                else if (message.name == KATCP_ARRAY_LIST)
                 {
-                    char* array_name = arg_string_katcl(this_cmc_server->katcl_line, 1);
-                    uint16_t control_port = (uint16_t) atoi(strtok(arg_string_katcl(this_cmc_server->katcl_line, 2), ",")); 
+                    char* array_name = message.args[1];
+                    uint16_t control_port = (uint16_t) atoi(strtok(message.args[2], ",")); 
                     uint16_t monitor_port = (uint16_t) atoi(strtok(NULL, ","));
                     /* will leave this here while I can't think of anything to do with the multicast groups.
                     int j = 3;
@@ -583,15 +613,15 @@ void cmc_server_handle_received_katcl_lines(struct cmc_server *this_cmc_server)
                     cmc_server_add_array(this_cmc_server, array_name, control_port, monitor_port, number_of_antennas);
                     //TODO check if return is proper.
                 }
-                else if (!strcmp(arg_string_katcl(this_cmc_server->katcl_line, 0) + 1, "resource-list"))
+                else if (message.name == KATCP_RESOURCE_LIST)
                 {
-                    if (!strcmp(arg_string_katcl(this_cmc_server->katcl_line, 2), "standby"))
+                    if (!strcmp(message.args[2], "standby"))
                     {
                         this_cmc_server->standby_skarabs++;
                     }
-                    else if (!strcmp(arg_string_katcl(this_cmc_server->katcl_line, 2), "up"))
+                    else if (!strcmp(message.args[2], "up"))
                     {
-                        if (arg_string_katcl(this_cmc_server->katcl_line, 3)) //i.e. if it's not NULL
+                        if (message.args[3]) //i.e. if it's not NULL
                         {
                             this_cmc_server->allocated_skarabs++;
                         }
@@ -600,85 +630,124 @@ void cmc_server_handle_received_katcl_lines(struct cmc_server *this_cmc_server)
                             this_cmc_server->up_skarabs++;
                         }
                     }
+                    this_cmc_server->generation++;
                 }
                 break;
             default:
-                syslog(LOG_NOTICE, "Unexpected KATCP message received, starting with %c", received_message_type);
+                syslog(LOG_NOTICE, "Unexpected KATCP message received, starting with %c", message.type);
         }
     }
 }
 
 
 /**
- * \fn      char *cmc_server_html_representation(struct cmc_server *this_cmc_server)
+ * \fn      static void cmc_server_socket_event(struct reactor *this_reactor, int fd, uint32_t events, void *data)
+ * \details The reactor callback for the cmc_server's file descriptor. Does whatever reading and writing is ready, deals with any complete
+ *          messages that have arrived, and then tells the reactor what to wait for next.
+ * \param   this_reactor The reactor which reported the events.
+ * \param   fd The file descriptor which is ready.
+ * \param   events The REACTOR_* events which are ready.
+ * \param   data A pointer to the cmc_server which owns the file descriptor.
+ * \return  void
+ */
+static void cmc_server_socket_event(struct reactor *this_reactor, int fd, uint32_t events, void *data)
+{
+    (void) this_reactor;
+    (void) fd;
+    struct cmc_server *this_cmc_server = data;
+    cmc_server_socket_read_write(this_cmc_server, events);
+    cmc_server_handle_received_katcl_lines(this_cmc_server);
+    cmc_server_update_events(this_cmc_server);
+}
+
+
+/**
+ * \fn      static void cmc_server_render_html(struct cmc_server *this_cmc_server, struct strbuf *html)
  * \details This funcion generates an HTML representation of the CMC server's current array-list, showing a brief description of each array in a table.
  * \param   this_cmc_server A pointer to the cmc_server in question.
- * \return  A newly-allocated string containing the cmc_server's HTML representation.
+ * \param   html The strbuf to which the representation is appended.
+ * \return  void
  */
-char *cmc_server_html_representation(struct cmc_server *this_cmc_server)
+static void cmc_server_render_html(struct cmc_server *this_cmc_server, struct strbuf *html)
 {
-    char *cmc_html_rep;
     switch (this_cmc_server->state) {
         case CMC_WAIT_CONNECT:
-            {
-                char format[] = "<h1>%s</h1>\n<p>Connecting to CMC server...</p>\n";
-                ssize_t needed = snprintf(NULL, 0, format, this_cmc_server->address) + 1;
-                cmc_html_rep = malloc((size_t) needed);
-                sprintf(cmc_html_rep, format, this_cmc_server->address);
-                return cmc_html_rep;
-            }
+            strbuf_appendf(html, "<h1>%s</h1>\n<p>Connecting to CMC server...</p>\n", this_cmc_server->address);
             break;
-         case CMC_DISCONNECTED:
-            {
-                char format[] = "<h1>%s</h1>\n<p>Could not connect to CMC server...</p>\n";
-                ssize_t needed = snprintf(NULL, 0, format, this_cmc_server->address, this_cmc_server->allocated_skarabs, this_cmc_server->up_skarabs, this_cmc_server->standby_skarabs) + 1;
-                cmc_html_rep = malloc((size_t) needed);
-                sprintf(cmc_html_rep, format, this_cmc_server->address, this_cmc_server->allocated_skarabs, this_cmc_server->up_skarabs, this_cmc_server->standby_skarabs);
-                return cmc_html_rep;
-            }
+        case CMC_DISCONNECTED:
+            strbuf_appendf(html, "<h1>%s</h1>\n<p>Could not connect to CMC server...</p>\n", this_cmc_server->address);
             break;
         default:
             if (this_cmc_server->no_of_arrays < 1)
             {
-                char format[] = "<h1>%s</h1>\n<p>No arrays currently running.</p><p>Allocated SKARABS: %lu</p><p>Up SKARABS: %lu</p><p>Standby SKARABs: %lu</p>";
-                ssize_t needed = snprintf(NULL, 0, format, this_cmc_server->address, this_cmc_server->allocated_skarabs, this_cmc_server->up_skarabs, this_cmc_server->standby_skarabs) + 1;
-                cmc_html_rep = malloc((size_t) needed);
-                sprintf(cmc_html_rep, format, this_cmc_server->address, this_cmc_server->allocated_skarabs, this_cmc_server->up_skarabs, this_cmc_server->standby_skarabs);
-                return cmc_html_rep;
+                strbuf_appendf(html, "<h1>%s</h1>\n<p>No arrays currently running.</p><p>Allocated SKARABS: %lu</p><p>Up SKARABS: %lu</p><p>Standby SKARABs: %lu</p>", \
+                        this_cmc_server->address, this_cmc_server->allocated_skarabs, this_cmc_server->up_skarabs, this_cmc_server->standby_skarabs);
+                break;
             }
 
-            {   //putting this in its own block so that I can reuse the names "format" and "needed" later.
-                //might not be ready since this is followed by a for-loop, but anyway.
-                char format[] = "<h1>%s</h1>\n<table class=\"cmctable\">\n<tr><th>Array Name</th><th>Control Port</th><th>Monitor Port</th><th>N_Antennas</th><th>Config File</th><th>Instrument State</th></tr>";
-                ssize_t needed = snprintf(NULL, 0, format, this_cmc_server->address) + 1;
-                //TODO checks
-                cmc_html_rep = malloc((size_t) needed);
-                sprintf(cmc_html_rep, format, this_cmc_server->address);
+            strbuf_appendf(html, "<h1>%s</h1>\n<table class=\"cmctable\">\n<tr><th>Array Name</th><th>Control Port</th><th>Monitor Port</th><th>N_Antennas</th><th>Config File</th><th>Instrument State</th><th>Health</th></tr>", \
+                    this_cmc_server->address);
+
+            //List the least healthy arrays first. The array_list itself is left alone, because arrays can be referred to by position.
+            struct array **sorted_arrays = malloc(sizeof(*sorted_arrays)*this_cmc_server->no_of_arrays);
+            if (sorted_arrays == NULL)
+                sorted_arrays = this_cmc_server->array_list; //Unsorted will do.
+            else
+            {
+                memcpy(sorted_arrays, this_cmc_server->array_list, sizeof(*sorted_arrays)*this_cmc_server->no_of_arrays);
+                qsort(sorted_arrays, this_cmc_server->no_of_arrays, sizeof(*sorted_arrays), array_compare_health);
             }
-            
             size_t i;
             for (i = 0; i < this_cmc_server->no_of_arrays; i++)
             {
-                char format[] = "%s\n";
-                char *array_html_rep = array_html_summary(this_cmc_server->array_list[i], this_cmc_server->address);
-                ssize_t needed = (ssize_t) snprintf(NULL, 0, format, array_html_rep) + 1;
-                needed += (ssize_t) strlen(cmc_html_rep);
-                //TODO checks
-                cmc_html_rep = realloc(cmc_html_rep, (size_t) needed); //naughty naughty, no temp variable.
-                sprintf(cmc_html_rep + strlen(cmc_html_rep), format, array_html_rep);
-                free(array_html_rep);
+                array_html_summary(sorted_arrays[i], this_cmc_server->address, html);
+                strbuf_append(html, "\n");
             }
+            if (sorted_arrays != this_cmc_server->array_list)
+                free(sorted_arrays);
 
-            {
-                char *format = "</table><p>Allocated SKARABS: %lu</p><p>Up SKARABS: %lu</p><p>Standby SKARABs: %lu</p>";
-                ssize_t needed = (ssize_t) snprintf(NULL, 0, format, this_cmc_server->allocated_skarabs, this_cmc_server->up_skarabs, this_cmc_server->standby_skarabs) + 1;
-                needed += (ssize_t) strlen(cmc_html_rep);
-                //TODO checks
-                cmc_html_rep = realloc(cmc_html_rep, (size_t) needed);
-                sprintf(cmc_html_rep + strlen(cmc_html_rep), format, this_cmc_server->allocated_skarabs, this_cmc_server->up_skarabs, this_cmc_server->standby_skarabs);
-            }
+            strbuf_appendf(html, "</table><p>Allocated SKARABS: %lu</p><p>Up SKARABS: %lu</p><p>Standby SKARABs: %lu</p>", \
+                    this_cmc_server->allocated_skarabs, this_cmc_server->up_skarabs, this_cmc_server->standby_skarabs);
+    }
+}
+
+
+/**
+ * \fn      struct fragment *cmc_server_html_representation(struct cmc_server *this_cmc_server)
+ * \details Bring the CMC server's part of the main page up to date. It's only rendered again if the CMC server or any of its arrays has
+ *          changed since last time.
+ * \param   this_cmc_server A pointer to the cmc_server in question.
+ * \return  The cmc_server's fragment, which belongs to the cmc_server. It's left empty if there was no memory to render it.
+ */
+struct fragment *cmc_server_html_representation(struct cmc_server *this_cmc_server)
+{
+    size_t i;
+    int current = fragment_is_current(this_cmc_server->html_fragment, this_cmc_server->generation);
+    for (i = 0; current && i < this_cmc_server->no_of_arrays; i++)
+        current = array_get_generation(this_cmc_server->array_list[i]) == this_cmc_server->rendered_array_generations[i];
+    if (current)
+        return this_cmc_server->html_fragment;
+
+    //The list only changes length along with the generation, so it's always as long as the array_list when it's looked at above.
+    uint64_t *temp = realloc(this_cmc_server->rendered_array_generations, sizeof(*temp)*(this_cmc_server->no_of_arrays + 1));
+    struct strbuf *html = strbuf_create(0);
+    if (temp == NULL || html == NULL)
+    {
+        if (temp != NULL)
+            this_cmc_server->rendered_array_generations = temp;
+        strbuf_destroy(html);
+        return this_cmc_server->html_fragment;
+    }
+    this_cmc_server->rendered_array_generations = temp;
+    cmc_server_render_html(this_cmc_server, html);
+    if (!strbuf_has_failed(html))
+    {
+        for (i = 0; i < this_cmc_server->no_of_arrays; i++)
+            this_cmc_server->rendered_array_generations[i] = array_get_generation(this_cmc_server->array_list[i]);
+        fragment_store(this_cmc_server->html_fragment, strbuf_see(html), this_cmc_server->generation);
     }
-    return cmc_html_rep;
+    strbuf_destroy(html);
+    return this_cmc_server->html_fragment;
 }
 
 /**
@@ -743,3 +812,43 @@ struct array *cmc_server_get_array(struct cmc_server *this_cmc_server, size_t ar
     else
         return NULL;
 }
+
+
+/**
+ * \fn      int cmc_server_json(struct cmc_server *this_cmc_server, struct json_writer *json, unsigned int fields)
+ * \details Write the CMC server as a JSON object: its name, whether it's connected, its SKARAB counts if info is asked for, and a summary
+ *          of each of its arrays (see array_json_summary()) in the order of its array_list.
+ * \param   this_cmc_server A pointer to the cmc_server in question.
+ * \param   json The json_writer to which the object is written.
+ * \param   fields The JSON_FIELD_* flags saying which fields to write.
+ * \return  0 on success, -1 if the writer has failed.
+ */
+int cmc_server_json(struct cmc_server *this_cmc_server, struct json_writer *json, unsigned int fields)
+{
+    size_t i;
+    json_begin_object(json);
+    json_key_string(json, "name", this_cmc_server->address);
+    switch (this_cmc_server->state) {
+        case CMC_WAIT_CONNECT:
+            json_key_string(json, "state", "connecting");
+            break;
+        case CMC_DISCONNECTED:
+            json_key_string(json, "state", "disconnected");
+            break;
+        default:
+            json_key_string(json, "state", "connected");
+    }
+    if (fields & JSON_FIELD_INFO)
+    {
+        json_key_integer(json, "allocated_skarabs", (long long) this_cmc_server->allocated_skarabs);
+        json_key_integer(json, "up_skarabs", (long long) this_cmc_server->up_skarabs);
+        json_key_integer(json, "standby_skarabs", (long long) this_cmc_server->standby_skarabs);
+    }
+    json_key(json, "arrays");
+    json_begin_array(json);
+    for (i = 0; i < this_cmc_server->no_of_arrays; i++)
+        array_json_summary(this_cmc_server->array_list[i], json, fields);
+    json_end_array(json);
+    json_end_object(json);
+    return json_writer_has_failed(json) ? -1 : 0;
+}
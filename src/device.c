@@ -6,6 +6,8 @@
 
 #include "device.h"
 #include "sensor.h"
+#include "arena.h"
+#include "sensor_table.h"
 
 /// A struct to represent a device - a collection of related sensors in the corr2_sensor_servelet.
 struct device {
@@ -15,56 +17,43 @@ struct device {
     struct sensor **sensor_list;
     /// Number of sensors in the list.
     unsigned int number_of_sensors;
+    /// The arena from which the device and its sensors are allocated.
+    struct arena *arena;
+    /// The table in which the sensors' state is kept.
+    struct sensor_table *table;
+    /// The table's number for this device.
+    size_t id;
 };
 
 
 /**
- * \fn      struct device *device_create(char *new_name)
+ * \fn      struct device *device_create(char *new_name, struct sensor_table *table, size_t host)
  * \details Allocate memory for a device object, populate the members
  *          with sensible default values.
  * \param   new_name A name for the device to be created.
+ * \param   table The table in which to register the device and keep its sensors' state. The device and its sensors come from the
+ *          table's arena, and are freed along with it.
+ * \param   host The table's number for the host on which the device is.
  * \return  A pointer to the newly-created device object.
  */
-struct device *device_create(char *new_name)
+struct device *device_create(char *new_name, struct sensor_table *table, size_t host)
 {
     /*TODO think about sanitising the name*/
-    struct device *new_device = malloc(sizeof(*new_device));
+    struct arena *arena = sensor_table_get_arena(table);
+    struct device *new_device = arena_alloc(arena, sizeof(*new_device));
     if (new_device != NULL)
     {
-        new_device->name = strdup(new_name);
+        new_device->name = arena_strdup(arena, new_name);
         new_device->number_of_sensors = 0;
         new_device->sensor_list = NULL; /*Making this explicit probably not necessary?*/
+        new_device->arena = arena;
+        new_device->table = table;
+        new_device->id = sensor_table_add_device(table, host, new_device->name);
     }
     return new_device;
 }
 
 
-/**
- * \fn      void device_destroy(struct device *this_device)
- * \details Free the memory associated with the device object. Also desetroy
- *          the underlying sensor objects.
- * \param   this_device A pointer to the device to be destroyed.
- * \return  void
- */
-void device_destroy(struct device *this_device)
-{
-    if (this_device != NULL)
-    {
-        if (this_device->name != NULL)
-        {
-            free(this_device->name);
-            unsigned int i;
-            for (i = 0; i < this_device->number_of_sensors; i++)
-            {
-                sensor_destroy(this_device->sensor_list[i]);
-            }
-            free(this_device->sensor_list);
-        }
-        free(this_device);
-    }
-}
-
-
 /**
  * \fn      char *device_get_name(struct device *this_device)
  * \details Get the name of the given device.
@@ -78,22 +67,40 @@ char *device_get_name(struct device *this_device)
 }
 
 
+/**
+ * \fn      uint64_t device_get_generation(struct device *this_device)
+ * \details Get the generation of the latest change to any of the device's sensors.
+ * \param   this_device A pointer to the device in question.
+ * \return  The generation. See sensor_table.h.
+ */
+uint64_t device_get_generation(struct device *this_device)
+{
+    return sensor_table_get_device_generation(this_device->table, this_device->id);
+}
+
+
 /**
  * \fn      int device_add_sensor(struct device *this_device, char *new_sensor_name)
- * \details Add a sensor to the given device.
+ * \details Add a sensor to the given device, unless the device already has a sensor by that name.
  * \param   this_device A pointer to the device to which a sensor will be added.
  * \param   new_sensor_name A char* string with the name of the new sensor.
  * \return  An integer indicating the success of the operation.
  */
 int device_add_sensor(struct device *this_device, char *new_sensor_name)
 {
-    /// TODO check whether the sensor already exists. Update return values accordingly.
-    this_device->sensor_list = realloc(this_device->sensor_list, \
-            sizeof(*(this_device->sensor_list))*(this_device->number_of_sensors + 1));
-    this_device->sensor_list[this_device->number_of_sensors] = sensor_create(new_sensor_name);
+    unsigned int i;
+    for (i = 0; i < this_device->number_of_sensors; i++)
+    {
+        if (!strcmp(new_sensor_name, sensor_get_name(this_device->sensor_list[i])))
+            return 0; //Already there, nothing to do.
+    }
+    struct sensor **temp = arena_list_reserve(this_device->arena, this_device->sensor_list, this_device->number_of_sensors, sizeof(*temp));
+    if (temp == NULL)
+        return -1; /// \retval -1 There wasn't enough memory for the sensor.
+    this_device->sensor_list = temp;
+    this_device->sensor_list[this_device->number_of_sensors] = sensor_create(new_sensor_name, this_device->table, this_device->id);
     this_device->number_of_sensors++;
     return 0;  /// \retval 0 The sensor was successfully created and a device added.
-    /// TODO Figure out how to indicate failure.
 }
 
 
@@ -120,14 +127,13 @@ char *device_get_sensor_value(struct device *this_device, char *sensor_name)
 
 
 /**
- * \fn      char *device_get_sensor_status(struct device *this_device, char *sensor_name)
+ * \fn      enum sensor_status device_get_sensor_status(struct device *this_device, char *sensor_name)
  * \details Query the device for the status of one of its sensors.
  * \param   this_device A pointer to the device to be queried.
  * \param   sensor_name A char* contianing the name of the sensor to be queried.
- * \return  A pointer to the status string of the sensor. The char* is
- *          not newly allocated so therefore must not be free'd.
+ * \return  The status of the sensor, SENSOR_UNKNOWN if it isn't found.
  */
-char *device_get_sensor_status(struct device *this_device, char *sensor_name)
+enum sensor_status device_get_sensor_status(struct device *this_device, char *sensor_name)
 {
     unsigned int i;
     for (i = 0; i < this_device->number_of_sensors; i++)
@@ -137,20 +143,20 @@ char *device_get_sensor_status(struct device *this_device, char *sensor_name)
             return sensor_get_status(this_device->sensor_list[i]);
         }
     }
-    return NULL;
+    return SENSOR_UNKNOWN;
 }
 
 
 /**
- * \fn      int device_update_sensor(struct device *this_device, char *sensor_name, char *new_sensor_value, char *new_sensor_status)
+ * \fn      int device_update_sensor(struct device *this_device, char *sensor_name, char *new_sensor_value, enum sensor_status new_sensor_status)
  * \details Update the value and status of the named sensor underneath the given device.
  * \param   this_device A pointer to the device.
  * \param   sensor_name A string containing the name of the sensor to be updated.
  * \param   new_sensor_value A string to replace the named sensor's stored sensor value
- * \param   new_sensor_status A string to replace the named sensor's stored operational status.
+ * \param   new_sensor_status The named sensor's new operational status.
  * \return  An integer indicating the success of the operation.
  */
-int device_update_sensor(struct device *this_device, char *sensor_name, char *new_sensor_value, char *new_sensor_status)
+int device_update_sensor(struct device *this_device, char *sensor_name, char *new_sensor_value, enum sensor_status new_sensor_status)
 {
     unsigned int i;
     for (i = 0; i < this_device->number_of_sensors; i++)
@@ -166,18 +172,74 @@ int device_update_sensor(struct device *this_device, char *sensor_name, char *ne
 
 
 /**
- * \fn      char *device_html_summary(struct device *this_device)
- * \details Get an HTML summary of the device. This is an HTML5 td with the class set to the status of the
+ * \fn      struct sensor *device_find_sensor(struct device *this_device, char *sensor_name)
+ * \details Find one of the device's sensors by name, so that it can be kept track of directly.
+ * \param   this_device A pointer to the device.
+ * \param   sensor_name A string containing the name of the sensor.
+ * \return  A pointer to the sensor, NULL if the device doesn't have one by that name.
+ */
+struct sensor *device_find_sensor(struct device *this_device, char *sensor_name)
+{
+    unsigned int i;
+    for (i = 0; i < this_device->number_of_sensors; i++)
+    {
+        if (!strcmp(sensor_name, sensor_get_name(this_device->sensor_list[i])))
+        {
+            return this_device->sensor_list[i];
+        }
+    }
+    return NULL;
+}
+
+
+/**
+ * \fn      enum sensor_status device_get_status(struct device *this_device)
+ * \details Get the overall status of the device, i.e. that of its "device-status" sensor.
+ * \param   this_device A pointer to the device.
+ * \return  The status, SENSOR_UNKNOWN if the device doesn't have a "device-status" sensor.
+ */
+enum sensor_status device_get_status(struct device *this_device)
+{
+    return device_get_sensor_status(this_device, "device-status");
+}
+
+
+/**
+ * \fn      int device_html_summary(struct device *this_device, char *cell_id, struct strbuf *html)
+ * \details Append an HTML summary of the device. This is an HTML5 td with the class set to the status of the
  *          "device-status" sensor, so that the higher-level CSS can render the button appropriately.
  * \param   this_device A pointer to the device.
- * \return  A newly allocated string containing the HTML summary of the device.
+ * \param   cell_id The id to give the td, so that the page can find it to update its status.
+ * \param   html The strbuf to which the summary is appended.
+ * \return  0 on success, -1 if the strbuf has failed.
  */
-char *device_html_summary(struct device *this_device)
+int device_html_summary(struct device *this_device, char *cell_id, struct strbuf *html)
 {
-    char format[] = "<td class=\"%s\">%s</td>";
     // TODO some kind of check in case the device doens't have a "device-status" sensor.
-    ssize_t needed = snprintf(NULL, 0, format, device_get_sensor_status(this_device, "device-status"), this_device->name) + 1;
-    char *html_summary = malloc((size_t) needed);
-    sprintf(html_summary, format, device_get_sensor_status(this_device, "device-status"), this_device->name);
-    return html_summary;
+    return strbuf_appendf(html, "<td id=\"%s\" class=\"%s\">%s</td>", cell_id, sensor_status_to_string(device_get_status(this_device)), this_device->name);
+}
+
+
+/**
+ * \fn      int device_json(struct device *this_device, struct json_writer *json, unsigned int fields)
+ * \details Write the device as a JSON object: its name, its status if asked for, and its sensors.
+ * \param   this_device A pointer to the device.
+ * \param   json The json_writer to which the object is written.
+ * \param   fields The JSON_FIELD_* flags saying which fields to write, for the device and its sensors.
+ * \return  0 on success, -1 if the writer has failed.
+ */
+int device_json(struct device *this_device, struct json_writer *json, unsigned int fields)
+{
+    unsigned int i;
+    json_begin_object(json);
+    json_key_string(json, "name", this_device->name);
+    if (fields & JSON_FIELD_STATUS)
+        json_key_string(json, "status", sensor_status_to_string(device_get_status(this_device)));
+    json_key(json, "sensors");
+    json_begin_array(json);
+    for (i = 0; i < this_device->number_of_sensors; i++)
+        sensor_json(this_device->sensor_list[i], json, fields);
+    json_end_array(json);
+    json_end_object(json);
+    return json_writer_has_failed(json) ? -1 : 0;
 }
@@ -1,6 +1,8 @@
 #ifndef _DEVICE_H_
 #define _DEVICE_H_
 #include <time.h>
+#include "sensor.h"
+#include "strbuf.h"
 
 /**
  * \file   device.h
@@ -11,14 +13,17 @@
 
 struct device;
 
-struct device *device_create(char *new_name);
-void device_destroy(struct device *this_device);
+struct device *device_create(char *new_name, struct sensor_table *table, size_t host);
 char *device_get_name(struct device *this_device);
+uint64_t device_get_generation(struct device *this_device);
 int device_add_sensor(struct device *this_device, char *new_sensor_name); /* I don't think we need the capability to remove sensors for the time being. */
 char *device_get_sensor_value(struct device *this_device, char *sensor_name);
-char *device_get_sensor_status(struct device *this_device, char *sensor_name);
-int device_update_sensor(struct device *this_device, char *sensor_name, char *new_sensor_value, char *new_sensor_status);
+enum sensor_status device_get_sensor_status(struct device *this_device, char *sensor_name);
+int device_update_sensor(struct device *this_device, char *sensor_name, char *new_sensor_value, enum sensor_status new_sensor_status);
+struct sensor *device_find_sensor(struct device *this_device, char *sensor_name);
 
-char *device_html_summary(struct device *this_device);
+enum sensor_status device_get_status(struct device *this_device);
+int device_html_summary(struct device *this_device, char *cell_id, struct strbuf *html);
+int device_json(struct device *this_device, struct json_writer *json, unsigned int fields);
 
 #endif
@@ -7,6 +7,8 @@
 #include "engine.h"
 #include "device.h"
 #include "sensor.h"
+#include "arena.h"
+#include "sensor_table.h"
 
 /// A struct to represent an engine on a host.
 struct engine {
@@ -16,53 +18,41 @@ struct engine {
     struct device **device_list;
     /// The number of devices in the list.
     unsigned int number_of_devices;
+    /// The arena from which the engine and its devices are allocated.
+    struct arena *arena;
+    /// The table in which the devices are registered.
+    struct sensor_table *table;
+    /// The table's number for the host on which the engine is.
+    size_t host;
 };
 
 
 /**
- * \fn      struct engine *engine_create(char *new_name)
+ * \fn      struct engine *engine_create(char *new_name, struct sensor_table *table, size_t host)
  * \details Allocate memory for a new engine object, populate the members with NULLs.
  * \param   new_name A string containing the name for the new engine object.
+ * \param   table The table in which to register the engine's devices. The engine and its devices come from the table's arena, and are
+ *          freed along with it.
+ * \param   host The table's number for the host on which the engine is.
  * \return  A pointer to the newly-allocated engine object.
  */
-struct engine *engine_create(char *new_name)
+struct engine *engine_create(char *new_name, struct sensor_table *table, size_t host)
 {
-    struct engine *new_engine = malloc(sizeof(*new_engine));
+    struct arena *arena = sensor_table_get_arena(table);
+    struct engine *new_engine = arena_alloc(arena, sizeof(*new_engine));
     if (new_engine != NULL)
     {
-        new_engine->name = strdup(new_name);
+        new_engine->name = arena_strdup(arena, new_name);
         new_engine->device_list = NULL;
         new_engine->number_of_devices = 0;
+        new_engine->arena = arena;
+        new_engine->table = table;
+        new_engine->host = host;
     }
     return new_engine;
 }
 
 
-/**
- * \fn      void engine_destroy(struct engine *this_engine)
- * \details Free the memory allocated to the engine object, and all its children.
- * \param   this_engine A pointer to the engine to be destroyed.
- * \return  void
- */
-void engine_destroy(struct engine *this_engine)
-{
-    if (this_engine != NULL)
-    {
-        if (this_engine->name != NULL)
-        {
-            free(this_engine->name);
-            unsigned int i;
-            for (i = 0; i < this_engine->number_of_devices; i++)
-            {
-                device_destroy(this_engine->device_list[i]);
-            }
-            free(this_engine->device_list);
-        }
-        free(this_engine);
-    }
-}
-
-
 /**
  * \fn      char *engine_get_name(struct engine *this_engine)
  * \details Get the name of the given engine.
@@ -77,18 +67,24 @@ char *engine_get_name(struct engine *this_engine)
 
 /**
  * \fn      int engine_add_device(struct engine *this_engine, char *new_device_name)
- * \details Add a device to the engine.
+ * \details Add a device to the engine, unless it already has a device by that name.
  * \param   this_engine A pointer to the engine in question.
  * \param   new_device_name A string containing the intended name for the new device.
- * \return  An integer indicating the outcome of the operation. At the moment
- *          this function should always return zero, indicating success.
+ * \return  An integer indicating the outcome of the operation: zero for success, -1 if there wasn't enough memory.
  */
 int engine_add_device(struct engine *this_engine, char *new_device_name)
 {
-    /*TODO make it return -1 if there's a failure.*/
-    this_engine->device_list = realloc(this_engine->device_list, \
-            sizeof(*(this_engine->device_list))*(this_engine->number_of_devices + 1));
-    this_engine->device_list[this_engine->number_of_devices] = device_create(new_device_name);
+    unsigned int i;
+    for (i = 0; i < this_engine->number_of_devices; i++)
+    {
+        if (!strcmp(new_device_name, device_get_name(this_engine->device_list[i])))
+            return 0; //Already there, nothing to do.
+    }
+    struct device **temp = arena_list_reserve(this_engine->arena, this_engine->device_list, this_engine->number_of_devices, sizeof(*temp));
+    if (temp == NULL)
+        return -1;
+    this_engine->device_list = temp;
+    this_engine->device_list[this_engine->number_of_devices] = device_create(new_device_name, this_engine->table, this_engine->host);
     this_engine->number_of_devices++;
     return 0;
 }
@@ -142,15 +138,14 @@ char *engine_get_sensor_value(struct engine *this_engine, char *device_name, cha
 
 
 /**
- * \fn      char *engine_get_sensor_status(struct engine *this_engine, char *device_name, char *sensor_name)
+ * \fn      enum sensor_status engine_get_sensor_status(struct engine *this_engine, char *device_name, char *sensor_name)
  * \details Retrieve the sensor status from a sensor on one of the engine's devices.
  * \param   this_engine A pointer to the engine in question.
  * \param   device_name A string containing the name of the device to be queried.
  * \param   sensor_name A string containing the name of the sensor to be queried.
- * \return  A string containing the sensor's status. This is not newly allocated, and must not be freed.
- *          Returns NULL if the operation was unsuccessful.
+ * \return  The sensor's status, SENSOR_UNKNOWN if it isn't found.
  */
-char *engine_get_sensor_status(struct engine *this_engine, char *device_name, char *sensor_name)
+enum sensor_status engine_get_sensor_status(struct engine *this_engine, char *device_name, char *sensor_name)
 {
     unsigned int i;
     for (i = 0; i < this_engine->number_of_devices; i++)
@@ -160,21 +155,21 @@ char *engine_get_sensor_status(struct engine *this_engine, char *device_name, ch
             return device_get_sensor_status(this_engine->device_list[i], sensor_name);
         }
     }
-    return NULL;
+    return SENSOR_UNKNOWN;
 }
 
 
 /**
- * \fn      int engine_update_sensor(struct engine *this_engine, char *device_name, char *sensor_name, char *new_sensor_value, char *new_sensor_status)
+ * \fn      int engine_update_sensor(struct engine *this_engine, char *device_name, char *sensor_name, char *new_sensor_value, enum sensor_status new_sensor_status)
  * \details Write a new value and status to a sensor on one of the engine's devices.
  * \param   this_engine A pointer to the engine in question.
  * \param   device_name A string containing the name of the device containing the intended sensor.
  * \param   sensor_name A string containing the name of the sensor to be updated.
  * \param   new_sensor_value A string containing the new value to be written to the sensor.
- * \param   new_sensor_status A string contianing the new status to be written to the sensor.
+ * \param   new_sensor_status The new status to be written to the sensor.
  * \return  An integer indicating the outcome of the operation.
  */
-int engine_update_sensor(struct engine *this_engine, char *device_name, char *sensor_name, char *new_sensor_value, char *new_sensor_status)
+int engine_update_sensor(struct engine *this_engine, char *device_name, char *sensor_name, char *new_sensor_value, enum sensor_status new_sensor_status)
 {
     unsigned int i;
     for (i = 0; i < this_engine->number_of_devices; i++)
@@ -186,3 +181,48 @@ int engine_update_sensor(struct engine *this_engine, char *device_name, char *se
     }
     return -1;
 }
+
+
+/**
+ * \fn      struct sensor *engine_find_sensor(struct engine *this_engine, char *device_name, char *sensor_name)
+ * \details Find a sensor on one of the engine's devices.
+ * \param   this_engine A pointer to the engine in question.
+ * \param   device_name A string containing the name of the device containing the intended sensor.
+ * \param   sensor_name A string containing the name of the sensor.
+ * \return  A pointer to the sensor, NULL if it doesn't exist.
+ */
+struct sensor *engine_find_sensor(struct engine *this_engine, char *device_name, char *sensor_name)
+{
+    unsigned int i;
+    for (i = 0; i < this_engine->number_of_devices; i++)
+    {
+        if (!strcmp(device_name, device_get_name(this_engine->device_list[i])))
+        {
+            return device_find_sensor(this_engine->device_list[i], sensor_name);
+        }
+    }
+    return NULL;
+}
+
+
+/**
+ * \fn      int engine_json(struct engine *this_engine, struct json_writer *json, unsigned int fields)
+ * \details Write the engine as a JSON object: its name and its devices.
+ * \param   this_engine A pointer to the engine.
+ * \param   json The json_writer to which the object is written.
+ * \param   fields The JSON_FIELD_* flags saying which fields to write for the devices and their sensors.
+ * \return  0 on success, -1 if the writer has failed.
+ */
+int engine_json(struct engine *this_engine, struct json_writer *json, unsigned int fields)
+{
+    unsigned int i;
+    json_begin_object(json);
+    json_key_string(json, "name", this_engine->name);
+    json_key(json, "devices");
+    json_begin_array(json);
+    for (i = 0; i < this_engine->number_of_devices; i++)
+        device_json(this_engine->device_list[i], json, fields);
+    json_end_array(json);
+    json_end_object(json);
+    return json_writer_has_failed(json) ? -1 : 0;
+}
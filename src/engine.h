@@ -2,6 +2,7 @@
 #define _ENGINE_H_
 
 #include <time.h>
+#include "sensor.h"
 
 /**
  * \file  engine.h
@@ -12,14 +13,15 @@
 
 struct engine;
 
-struct engine *engine_create(char *new_name);
-void engine_destroy(struct engine *this_engine);
+struct engine *engine_create(char *new_name, struct sensor_table *table, size_t host);
 char *engine_get_name(struct engine *this_engine);
 int engine_add_device(struct engine *this_engine, char *new_device_name);
 int engine_add_sensor_to_device(struct engine *this_engine, char *device_name, char *new_sensor_name);
 char *engine_get_sensor_value(struct engine *this_engine, char *device_name, char *sensor_name);
-char *engine_get_sensor_status(struct engine *this_engine, char *device_name, char *sensor_name);
-int engine_update_sensor(struct engine *this_engine, char *device_name, char *sensor_name, char *new_sensor_value, char *new_sensor_status);
+enum sensor_status engine_get_sensor_status(struct engine *this_engine, char *device_name, char *sensor_name);
+int engine_update_sensor(struct engine *this_engine, char *device_name, char *sensor_name, char *new_sensor_value, enum sensor_status new_sensor_status);
+struct sensor *engine_find_sensor(struct engine *this_engine, char *device_name, char *sensor_name);
+int engine_json(struct engine *this_engine, struct json_writer *json, unsigned int fields);
 
 /*debug functions*/
 //void engine_print(struct engine *this_engine);
@@ -0,0 +1,171 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <time.h>
+
+#include "event_stream.h"
+#include "array.h"
+
+/// Marks a cell whose status hasn't been sent yet. It isn't a valid enum sensor_status, so the cell's status always differs from it.
+#define EVENT_STREAM_NOT_SENT 0xff
+
+
+/// A struct to hold what a page has been told about an array so far.
+struct event_stream {
+    /// The cmc_server to which the array belongs.
+    struct cmc_server *cmc;
+    /// The name of the array.
+    char *array_name;
+    /// The array as it was when the stream started. It's only compared with, never followed, since it may have been destroyed since.
+    struct array *array;
+    /// The generation up to which the page is current.
+    uint64_t generation;
+    /// The status last sent for each of the page's cells. See array_get_number_of_cells().
+    unsigned char *cell_status;
+    /// The number of cells.
+    size_t number_of_cells;
+    /// When the array had last been heard from, as last sent.
+    time_t last_updated;
+    /// The number of flushes in a row which had nothing to send.
+    unsigned int quiet_flushes;
+    /// Where the changes are gathered before they're turned into an event.
+    struct strbuf *lines;
+};
+
+
+/**
+ * \fn      struct event_stream *event_stream_create(struct cmc_server *cmc, char *array_name, uint64_t since)
+ * \details Allocate memory for a stream of changes to an array's detail page.
+ * \param   cmc The cmc_server to which the array belongs.
+ * \param   array_name The name of the array.
+ * \param   since The generation at which the page was rendered, zero if it's not known. Anything which has changed since then is sent
+ *          on the first flush.
+ * \return  A pointer to the newly-created event_stream, NULL if there's no such array or no memory.
+ */
+struct event_stream *event_stream_create(struct cmc_server *cmc, char *array_name, uint64_t since)
+{
+    int array_number = cmc_server_check_for_array(cmc, array_name);
+    if (array_number < 0)
+        return NULL;
+    struct array *this_array = cmc_server_get_array(cmc, (size_t) array_number);
+
+    struct event_stream *new_stream = malloc(sizeof(*new_stream));
+    if (new_stream == NULL)
+        return NULL;
+    new_stream->cmc = cmc;
+    new_stream->array_name = strdup(array_name);
+    new_stream->array = this_array;
+    //If the page is from an earlier array of the same name, its generation may well be ahead of this one's. The first flush sees
+    //that and has the page reloaded.
+    new_stream->generation = since;
+    new_stream->number_of_cells = array_get_number_of_cells(this_array);
+    new_stream->cell_status = malloc(new_stream->number_of_cells ? new_stream->number_of_cells : 1);
+    new_stream->last_updated = 0;
+    new_stream->quiet_flushes = 0;
+    new_stream->lines = strbuf_create(0);
+    if (new_stream->array_name == NULL || new_stream->cell_status == NULL || new_stream->lines == NULL)
+    {
+        syslog(LOG_ERR, "Unable to allocate memory for an event stream.");
+        event_stream_destroy(new_stream);
+        return NULL;
+    }
+    //Whatever hasn't changed since the page was rendered is already on the page. The rest is sent on the first flush.
+    memset(new_stream->cell_status, EVENT_STREAM_NOT_SENT, new_stream->number_of_cells);
+    if (since <= array_get_generation(this_array))
+        array_get_cell_statuses(this_array, since, new_stream->cell_status);
+    return new_stream;
+}
+
+
+/**
+ * \fn      void event_stream_destroy(struct event_stream *this_stream)
+ * \details Free the memory associated with the event_stream.
+ * \param   this_stream A pointer to the event_stream to be destroyed.
+ * \return  void
+ */
+void event_stream_destroy(struct event_stream *this_stream)
+{
+    if (this_stream != NULL)
+    {
+        free(this_stream->array_name);
+        free(this_stream->cell_status);
+        strbuf_destroy(this_stream->lines);
+        free(this_stream);
+    }
+}
+
+
+/**
+ * \fn      static void event_stream_append_event(struct strbuf *events, char *name, uint64_t id, char *data)
+ * \details Append an event, with each line of the data on a "data:" line of its own as Server-Sent Events require.
+ */
+static void event_stream_append_event(struct strbuf *events, char *name, uint64_t id, char *data)
+{
+    strbuf_appendf(events, "event: %s\nid: %llu\n", name, (unsigned long long) id);
+    while (*data != '\0')
+    {
+        char *line_end = strchr(data, '\n');
+        size_t length = line_end != NULL ? (size_t) (line_end - data) : strlen(data);
+        strbuf_append(events, "data: ");
+        strbuf_append_length(events, data, length);
+        strbuf_append(events, "\n");
+        data += length + (line_end != NULL);
+    }
+    strbuf_append(events, "\n");
+}
+
+
+/**
+ * \fn      int event_stream_flush(struct event_stream *this_stream, struct strbuf *events)
+ * \details Append events for whatever has changed on the array since the last flush. Cells which changed more than once in between
+ *          are only sent as they are now.
+ * \param   this_stream A pointer to the event_stream in question.
+ * \param   events The strbuf to which the events are appended.
+ * \return  An integer indicating the outcome of the operation.
+ */
+int event_stream_flush(struct event_stream *this_stream, struct strbuf *events)
+{
+    int array_number = cmc_server_check_for_array(this_stream->cmc, this_stream->array_name);
+    struct array *this_array = array_number >= 0 ? cmc_server_get_array(this_stream->cmc, (size_t) array_number) : NULL;
+    //Generations never go backwards in the same array, so an earlier one means that this is a new array at the same address.
+    if (this_array == NULL || this_array != this_stream->array || array_get_generation(this_array) < this_stream->generation || \
+            array_get_number_of_cells(this_array) != this_stream->number_of_cells)
+    {
+        event_stream_append_event(events, "reload", this_stream->generation, "");
+        return 1; /// \retval 1 The page needs loading again, and has been told so. Nothing more will be sent.
+    }
+
+    size_t start = strbuf_get_length(events);
+    uint64_t generation = array_get_generation(this_array);
+    if (generation > this_stream->generation)
+    {
+        strbuf_clear(this_stream->lines);
+        array_html_changes(this_array, this_stream->generation, this_stream->cell_status, this_stream->lines);
+        this_stream->generation = generation;
+        if (strbuf_get_length(this_stream->lines) > 0)
+            event_stream_append_event(events, "update", generation, strbuf_see(this_stream->lines));
+    }
+
+    time_t last_updated = array_get_last_updated(this_array);
+    if (last_updated != this_stream->last_updated)
+    {
+        char heard[64];
+        char time_str[20];
+        strftime(time_str, sizeof(time_str), "%F %T", localtime(&last_updated));
+        snprintf(heard, sizeof(heard), "%d %s", (int) (time(0) - last_updated), time_str);
+        event_stream_append_event(events, "heard", this_stream->generation, heard);
+        this_stream->last_updated = last_updated;
+    }
+
+    if (strbuf_get_length(events) > start)
+        this_stream->quiet_flushes = 0;
+    else if (++this_stream->quiet_flushes >= EVENT_STREAM_HEARTBEAT_FLUSHES)
+    {
+        strbuf_append(events, ":\n\n");
+        this_stream->quiet_flushes = 0;
+    }
+    if (strbuf_has_failed(events))
+        return -1; /// \retval -1 There was no memory for the events.
+    return 0; /// \retval 0 Whatever has changed has been appended.
+}
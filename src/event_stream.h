@@ -0,0 +1,34 @@
+#ifndef _EVENT_STREAM_H_
+#define _EVENT_STREAM_H_
+
+#include <stdint.h>
+
+#include "cmc_server.h"
+#include "strbuf.h"
+
+/**
+ * \file  event_stream.h
+ * \brief The event_stream type keeps an array's detail page up to date over Server-Sent Events, instead of the page reloading itself.
+ *        It remembers the generation (see sensor_table.h) up to which the page is current and the status it last sent for each cell,
+ *        and each time it's flushed it sends only the cells which have changed since, however many times they've changed in between:
+ *
+ *            event: update          one line per cell, "status <id> <status>" or "text <id> <text>"
+ *            event: heard           "<seconds ago> <time>", when the array was last heard from
+ *            event: reload          the array has gone, or its layout has changed, so the page needs loading again
+ *
+ *        A comment is sent now and then when there's nothing else to say, so that the connection doesn't look idle.
+ */
+
+/// How often a stream is flushed, i.e. the longest a change waits before it's sent. Changes in between are sent together.
+#define EVENT_STREAM_FLUSH_MS 1000
+/// The number of flushes with nothing to send after which a comment is sent anyway.
+#define EVENT_STREAM_HEARTBEAT_FLUSHES 15
+
+struct event_stream;
+
+struct event_stream *event_stream_create(struct cmc_server *cmc, char *array_name, uint64_t since);
+void event_stream_destroy(struct event_stream *this_stream);
+
+int event_stream_flush(struct event_stream *this_stream, struct strbuf *events);
+
+#endif
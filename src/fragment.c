@@ -0,0 +1,208 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <syslog.h>
+
+#include "fragment.h"
+
+
+/// The HTML itself. It's kept apart from the fragment so that a response which is still being sent can hang on to it after the
+/// fragment has moved on.
+struct fragment_text {
+    /// The number of holders: the fragment, if it's still the fragment's current text, and any responses.
+    size_t references;
+    /// The length of the HTML, not counting the NUL.
+    size_t length;
+    /// The size of the html member.
+    size_t capacity;
+    /// The HTML, NUL-terminated.
+    char html[];
+};
+
+
+/// A struct to hold a piece of rendered HTML and what it was rendered from.
+struct fragment {
+    /// The HTML. NULL until something has been stored.
+    struct fragment_text *text;
+    /// The generation of the model when the HTML was rendered.
+    uint64_t generation;
+    /// Whether anything has been stored yet. A generation of zero is a real one, so it can't double as "empty".
+    int valid;
+};
+
+
+/**
+ * \fn      struct fragment *fragment_create()
+ * \details Allocate memory for an empty fragment, which isn't current for any generation until something is stored in it.
+ * \return  A pointer to the newly-created fragment, NULL on failure.
+ */
+struct fragment *fragment_create()
+{
+    struct fragment *new_fragment = malloc(sizeof(*new_fragment));
+    if (new_fragment != NULL)
+    {
+        new_fragment->text = NULL;
+        new_fragment->generation = 0;
+        new_fragment->valid = 0;
+    }
+    return new_fragment;
+}
+
+
+/**
+ * \fn      void fragment_destroy(struct fragment *this_fragment)
+ * \details Free the memory associated with the fragment.
+ * \param   this_fragment A pointer to the fragment to be destroyed.
+ * \return  void
+ */
+void fragment_destroy(struct fragment *this_fragment)
+{
+    if (this_fragment != NULL)
+    {
+        fragment_text_release(this_fragment->text);
+        free(this_fragment);
+    }
+}
+
+
+/**
+ * \fn      int fragment_is_current(struct fragment *this_fragment, uint64_t generation)
+ * \details Check whether the fragment's HTML was rendered from the given generation of the model, i.e. whether it can be used as is.
+ * \param   this_fragment A pointer to the fragment in question.
+ * \param   generation The current generation of whatever the fragment shows.
+ * \return  1 if the fragment is current, 0 if it needs to be rendered again.
+ */
+int fragment_is_current(struct fragment *this_fragment, uint64_t generation)
+{
+    return this_fragment->valid && this_fragment->generation == generation;
+}
+
+
+/**
+ * \fn      int fragment_store(struct fragment *this_fragment, char *html, uint64_t generation)
+ * \details Keep a copy of some freshly-rendered HTML, replacing whatever was there before. The old text's buffer is reused if it's
+ *          big enough and nothing else is holding it; otherwise it's left to its other holders and a new one is allocated.
+ * \param   this_fragment A pointer to the fragment in question.
+ * \param   html The HTML. It still belongs to the caller.
+ * \param   generation The generation of the model from which the HTML was rendered.
+ * \return  0 on success, -1 if there was no memory, in which case the fragment is left empty.
+ */
+int fragment_store(struct fragment *this_fragment, char *html, uint64_t generation)
+{
+    size_t length = strlen(html);
+    struct fragment_text *text = this_fragment->text;
+    if (text == NULL || text->references > 1 || length + 1 > text->capacity)
+    {
+        fragment_text_release(text);
+        this_fragment->text = NULL;
+        this_fragment->valid = 0;
+        text = malloc(sizeof(*text) + length + 1);
+        if (text == NULL)
+        {
+            syslog(LOG_ERR, "Unable to allocate %zu bytes for an HTML fragment.", length + 1);
+            return -1;
+        }
+        text->references = 1;
+        text->capacity = length + 1;
+        this_fragment->text = text;
+    }
+    memcpy(text->html, html, length + 1);
+    text->length = length;
+    this_fragment->generation = generation;
+    this_fragment->valid = 1;
+    return 0;
+}
+
+
+/**
+ * \fn      char *fragment_see(struct fragment *this_fragment)
+ * \details Have a look at the fragment's HTML, without copying it.
+ * \param   this_fragment A pointer to the fragment in question.
+ * \return  The HTML, which still belongs to the fragment and is only good until the next fragment_store(). An empty string if
+ *          nothing has been stored.
+ */
+char *fragment_see(struct fragment *this_fragment)
+{
+    return this_fragment->valid ? this_fragment->text->html : "";
+}
+
+
+/**
+ * \fn      size_t fragment_get_length(struct fragment *this_fragment)
+ * \details Get the length of the fragment's HTML.
+ * \param   this_fragment A pointer to the fragment in question.
+ * \return  The length, not counting the terminating NUL.
+ */
+size_t fragment_get_length(struct fragment *this_fragment)
+{
+    return this_fragment->valid ? this_fragment->text->length : 0;
+}
+
+
+/**
+ * \fn      struct fragment_text *fragment_hold(struct fragment *this_fragment)
+ * \details Take hold of the fragment's HTML as it stands, for sending it without copying it. It stays as it is until it's released,
+ *          even if the fragment is rendered again or destroyed in the meantime.
+ * \param   this_fragment A pointer to the fragment in question.
+ * \return  The fragment's text, to be released with fragment_text_release(). NULL if nothing has been stored.
+ */
+struct fragment_text *fragment_hold(struct fragment *this_fragment)
+{
+    if (!this_fragment->valid)
+        return NULL;
+    this_fragment->text->references++;
+    return this_fragment->text;
+}
+
+
+/**
+ * \fn      void fragment_text_release(struct fragment_text *text)
+ * \details Let go of a fragment's text. It's freed when nothing is holding it any more.
+ * \param   text The text, from fragment_hold(). NULL is ignored.
+ * \return  void
+ */
+void fragment_text_release(struct fragment_text *text)
+{
+    if (text != NULL && --text->references == 0)
+        free(text);
+}
+
+
+/**
+ * \fn      char *fragment_text_see(struct fragment_text *text)
+ * \details Have a look at a held text's HTML.
+ * \param   text The text, from fragment_hold().
+ * \return  The HTML, which is good until the text is released.
+ */
+char *fragment_text_see(struct fragment_text *text)
+{
+    return text->html;
+}
+
+
+/**
+ * \fn      size_t fragment_text_get_length(struct fragment_text *text)
+ * \details Get the length of a held text's HTML.
+ * \param   text The text, from fragment_hold().
+ * \return  The length, not counting the terminating NUL.
+ */
+size_t fragment_text_get_length(struct fragment_text *text)
+{
+    return text->length;
+}
+
+
+/**
+ * \fn      char *fragment_copy(struct fragment *this_fragment)
+ * \details Get a copy of the fragment's HTML, for callers which expect to be handed a string of their own to free().
+ * \param   this_fragment A pointer to the fragment in question.
+ * \return  A newly-allocated copy of the HTML, NULL if there was no memory.
+ */
+char *fragment_copy(struct fragment *this_fragment)
+{
+    size_t length = fragment_get_length(this_fragment);
+    char *copy = malloc(length + 1);
+    if (copy != NULL)
+        memcpy(copy, fragment_see(this_fragment), length + 1);
+    return copy;
+}
@@ -0,0 +1,36 @@
+#ifndef _FRAGMENT_H_
+#define _FRAGMENT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * \file  fragment.h
+ * \brief The fragment type holds a piece of rendered HTML along with the generation (see sensor_table.h) of the part of the model
+ *        which it shows. As long as that part's generation hasn't moved on, the HTML can be handed out again instead of being
+ *        rendered from scratch. The fragment's buffer is reused when it's rendered again, so a busy fragment settles at one
+ *        allocation.
+ *
+ *        A response can hold on to a fragment's text (fragment_hold()) to send it straight from the fragment's buffer. Text which is
+ *        held is left alone when the fragment is rendered again; the fragment gets a new buffer instead, and the old one is freed once
+ *        the last holder releases it.
+ */
+
+struct fragment;
+struct fragment_text;
+
+struct fragment *fragment_create();
+void fragment_destroy(struct fragment *this_fragment);
+
+int fragment_is_current(struct fragment *this_fragment, uint64_t generation);
+int fragment_store(struct fragment *this_fragment, char *html, uint64_t generation);
+char *fragment_see(struct fragment *this_fragment);
+size_t fragment_get_length(struct fragment *this_fragment);
+char *fragment_copy(struct fragment *this_fragment);
+
+struct fragment_text *fragment_hold(struct fragment *this_fragment);
+void fragment_text_release(struct fragment_text *text);
+char *fragment_text_see(struct fragment_text *text);
+size_t fragment_text_get_length(struct fragment_text *text);
+
+#endif
@@ -0,0 +1,229 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <syslog.h>
+
+#include "history.h"
+
+/// The number of rings carved out of each slab.
+#define HISTORY_RINGS_PER_SLAB 64
+
+
+/// The last HISTORY_DEPTH changes to one sensor, oldest overwritten first.
+struct history_ring {
+    /// The next ring on the pool's free list. Only meaningful while the ring isn't in use.
+    struct history_ring *next_free;
+    /// Where the next entry will be written.
+    uint32_t head;
+    /// The number of entries written, up to HISTORY_DEPTH.
+    uint32_t count;
+    /// The entries themselves.
+    struct history_entry entries[HISTORY_DEPTH];
+};
+
+
+/// A block of rings, requested from the system in one go. Slabs are kept in a singly-linked list, newest first.
+struct history_slab {
+    /// The previous slab.
+    struct history_slab *next;
+    /// The rings.
+    struct history_ring rings[HISTORY_RINGS_PER_SLAB];
+};
+
+
+/// A struct to keep track of the slabs, and of which rings in them are free.
+struct history_pool {
+    /// All the slabs allocated so far.
+    struct history_slab *slabs;
+    /// Rings which aren't in use, either never handed out or given back.
+    struct history_ring *free_rings;
+    /// The most memory the slabs may take, in bytes.
+    size_t budget;
+    /// The memory the slabs take now, in bytes.
+    size_t used;
+    /// Set once the budget has run out, so that it's only logged once rather than every time a sensor goes without.
+    int exhausted;
+};
+
+
+/**
+ * \fn      struct history_pool *history_pool_create(size_t budget)
+ * \details Create an empty history_pool. No memory is set aside until the first ring is asked for.
+ * \param   budget The most memory, in bytes, which the pool may take for rings. At least one slab's worth is always allowed.
+ * \return  A pointer to the newly-created history_pool, NULL on failure.
+ */
+struct history_pool *history_pool_create(size_t budget)
+{
+    struct history_pool *new_pool = malloc(sizeof(*new_pool));
+    if (new_pool != NULL)
+    {
+        new_pool->slabs = NULL;
+        new_pool->free_rings = NULL;
+        new_pool->budget = budget > sizeof(struct history_slab) ? budget : sizeof(struct history_slab);
+        new_pool->used = 0;
+        new_pool->exhausted = 0;
+    }
+    return new_pool;
+}
+
+
+/**
+ * \fn      void history_pool_destroy(struct history_pool *this_pool)
+ * \details Free the history_pool and all of its slabs. None of the rings handed out may be used afterwards.
+ * \param   this_pool A pointer to the history_pool to be destroyed.
+ * \return  void
+ */
+void history_pool_destroy(struct history_pool *this_pool)
+{
+    if (this_pool != NULL)
+    {
+        struct history_slab *slab = this_pool->slabs;
+        while (slab != NULL)
+        {
+            struct history_slab *next = slab->next;
+            free(slab);
+            slab = next;
+        }
+        free(this_pool);
+    }
+}
+
+
+/**
+ * \fn      size_t history_pool_get_budget(struct history_pool *this_pool)
+ * \details Get the most memory which the pool may take.
+ * \param   this_pool A pointer to the history_pool in question.
+ * \return  The budget, in bytes.
+ */
+size_t history_pool_get_budget(struct history_pool *this_pool)
+{
+    return this_pool->budget;
+}
+
+
+/**
+ * \fn      size_t history_pool_get_used(struct history_pool *this_pool)
+ * \details Get the memory which the pool's slabs take at the moment. It only ever goes up; rings which are given back are kept for
+ *          reuse rather than returned to the system.
+ * \param   this_pool A pointer to the history_pool in question.
+ * \return  The memory used, in bytes.
+ */
+size_t history_pool_get_used(struct history_pool *this_pool)
+{
+    return this_pool->used;
+}
+
+
+/**
+ * \fn      static int history_pool_add_slab(struct history_pool *this_pool)
+ * \details Allocate a new slab, if the budget allows, and put all of its rings on the free list.
+ * \return  0 on success, -1 if the budget is spent or there was no memory.
+ */
+static int history_pool_add_slab(struct history_pool *this_pool)
+{
+    if (this_pool->used + sizeof(struct history_slab) > this_pool->budget)
+    {
+        if (!this_pool->exhausted)
+            syslog(LOG_WARNING, "Sensor history has used its budget of %zu bytes, so some sensors will have none.", this_pool->budget);
+        this_pool->exhausted = 1;
+        return -1;
+    }
+
+    struct history_slab *new_slab = malloc(sizeof(*new_slab));
+    if (new_slab == NULL)
+    {
+        syslog(LOG_ERR, "Unable to allocate a %zu-byte slab for sensor history.", sizeof(*new_slab));
+        return -1;
+    }
+    new_slab->next = this_pool->slabs;
+    this_pool->slabs = new_slab;
+    this_pool->used += sizeof(*new_slab);
+
+    size_t i;
+    for (i = HISTORY_RINGS_PER_SLAB; i > 0; i--)
+    {
+        new_slab->rings[i - 1].next_free = this_pool->free_rings;
+        this_pool->free_rings = &new_slab->rings[i - 1];
+    }
+    return 0;
+}
+
+
+/**
+ * \fn      struct history_ring *history_ring_get(struct history_pool *this_pool)
+ * \details Get an empty ring from the pool.
+ * \param   this_pool A pointer to the history_pool in question.
+ * \return  A pointer to the ring, or NULL if the pool's budget has been spent.
+ */
+struct history_ring *history_ring_get(struct history_pool *this_pool)
+{
+    if (this_pool->free_rings == NULL && history_pool_add_slab(this_pool) < 0)
+        return NULL;
+
+    struct history_ring *ring = this_pool->free_rings;
+    this_pool->free_rings = ring->next_free;
+    ring->next_free = NULL;
+    ring->head = 0;
+    ring->count = 0;
+    return ring;
+}
+
+
+/**
+ * \fn      void history_ring_release(struct history_pool *this_pool, struct history_ring *this_ring)
+ * \details Give a ring back to the pool, for some other sensor to use.
+ * \param   this_pool A pointer to the history_pool from which the ring came.
+ * \param   this_ring A pointer to the ring. NULL is allowed and does nothing.
+ * \return  void
+ */
+void history_ring_release(struct history_pool *this_pool, struct history_ring *this_ring)
+{
+    if (this_ring != NULL)
+    {
+        this_ring->next_free = this_pool->free_rings;
+        this_pool->free_rings = this_ring;
+        this_pool->exhausted = 0; //If it runs out again, that's worth saying again.
+    }
+}
+
+
+/**
+ * \fn      void history_ring_record(struct history_ring *this_ring, time_t time, uint8_t status, char *value)
+ * \details Add a change to a ring, overwriting the oldest one if the ring is full.
+ * \param   this_ring A pointer to the ring in question.
+ * \param   time When the change was seen.
+ * \param   status The new status.
+ * \param   value The new value. Only the first HISTORY_VALUE_SIZE - 1 characters are kept.
+ * \return  void
+ */
+void history_ring_record(struct history_ring *this_ring, time_t time, uint8_t status, char *value)
+{
+    struct history_entry *entry = &this_ring->entries[this_ring->head];
+    entry->time = time;
+    entry->status = status;
+    strncpy(entry->value, value, HISTORY_VALUE_SIZE - 1);
+    entry->value[HISTORY_VALUE_SIZE - 1] = '\0';
+
+    this_ring->head = (this_ring->head + 1) % HISTORY_DEPTH;
+    if (this_ring->count < HISTORY_DEPTH)
+        this_ring->count++;
+}
+
+
+/**
+ * \fn      size_t history_ring_read(struct history_ring *this_ring, struct history_entry *entries, size_t max_entries)
+ * \details Copy the most recent entries out of a ring, oldest first.
+ * \param   this_ring A pointer to the ring in question.
+ * \param   entries Where to put the entries.
+ * \param   max_entries The number of entries for which there is room. If there are more in the ring, the oldest are left out.
+ * \return  The number of entries copied.
+ */
+size_t history_ring_read(struct history_ring *this_ring, struct history_entry *entries, size_t max_entries)
+{
+    size_t n = this_ring->count < max_entries ? this_ring->count : max_entries;
+    size_t i;
+    for (i = 0; i < n; i++)
+        entries[i] = this_ring->entries[(this_ring->head + HISTORY_DEPTH - n + i) % HISTORY_DEPTH];
+    return n;
+}
@@ -0,0 +1,45 @@
+#ifndef _HISTORY_H_
+#define _HISTORY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+/**
+ * \file  history.h
+ * \brief The history types keep a short record of what each sensor has been doing. Every sensor which has changed gets a ring of the
+ *        last HISTORY_DEPTH changes (time, status and value), so that when something goes into error, there's a record of how it got
+ *        there. Rings are carved out of slabs by a history_pool, which is shared by all the arrays and won't take more memory than its
+ *        budget: once that's spent, sensors which haven't got a ring yet simply go without. Rings go back to the pool when their array
+ *        is torn down, for the next array to use.
+ */
+
+/// The number of changes remembered for each sensor.
+#define HISTORY_DEPTH 16
+/// The room for a value in a history entry, including the terminating NUL. Longer values are cut short.
+#define HISTORY_VALUE_SIZE 23
+
+/// One change to a sensor. The sizes are chosen so that it fits in 32 bytes.
+struct history_entry {
+    /// When the change was seen.
+    time_t time;
+    /// The sensor's new status, an enum sensor_status.
+    uint8_t status;
+    /// The sensor's new value.
+    char value[HISTORY_VALUE_SIZE];
+};
+
+struct history_pool;
+struct history_ring;
+
+struct history_pool *history_pool_create(size_t budget);
+void history_pool_destroy(struct history_pool *this_pool);
+size_t history_pool_get_budget(struct history_pool *this_pool);
+size_t history_pool_get_used(struct history_pool *this_pool);
+
+struct history_ring *history_ring_get(struct history_pool *this_pool);
+void history_ring_release(struct history_pool *this_pool, struct history_ring *this_ring);
+void history_ring_record(struct history_ring *this_ring, time_t time, uint8_t status, char *value);
+size_t history_ring_read(struct history_ring *this_ring, struct history_entry *entries, size_t max_entries);
+
+#endif
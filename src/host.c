@@ -7,18 +7,24 @@
 #include "host.h"
 #include "device.h"
 #include "vdevice.h"
+#include "arena.h"
+#include "sensor_table.h"
 
 
 /// A struct to represent an FPGA host, which has some devices and engines on it.
 struct host {
     /// The serial number of the FPGA host.
     char *host_serial;
+    /// The size of the buffer holding the serial number.
+    size_t host_serial_capacity;
     /// The type of gateware present on the host (i.e. 'f' or 'x').
     char type;
     /// The index of the host in its team.
     int host_number;
     /// The name of the input stream - nominally this should represent which antenna or dummy input is being given to an fhost.
     char *host_input_stream_name;
+    /// The size of the buffer holding the input stream name.
+    size_t host_input_stream_capacity;
     /// The list of devices that are on the host.
     struct device **device_list;
     /// The number of devices in the list.
@@ -31,65 +37,79 @@ struct host {
     struct engine **engine_list;
     /// The number of engines in the list.
     size_t number_of_engines;
+    /// The arena from which the host and everything on it are allocated.
+    struct arena *arena;
+    /// The table in which the host and its devices are registered.
+    struct sensor_table *table;
+    /// The table's number for this host.
+    size_t id;
+    /// The generation (see sensor_table.h) at which the serial number or input stream last changed.
+    uint64_t label_generation;
 };
     
 
 /**
- * \fn      struct host *host_create(char type, int host_number)
+ * \fn      static int host_replace_string(struct host *this_host, char **string, size_t *capacity, char *new_string)
+ * \details Replace one of the host's strings. The arena can't take the old one back, so it is overwritten if the new one fits, and only
+ *          otherwise is a bigger buffer taken from the arena. These strings hardly ever change, so not much is lost.
+ * \param   this_host A pointer to the host in question.
+ * \param   string A pointer to the host's string, which may be NULL.
+ * \param   capacity A pointer to the size of the buffer currently holding the string.
+ * \param   new_string The string to store.
+ * \return  0 on success, -1 if no memory could be had.
+ */
+static int host_replace_string(struct host *this_host, char **string, size_t *capacity, char *new_string)
+{
+    size_t length = strlen(new_string) + 1;
+    if (*string == NULL || length > *capacity)
+    {
+        char *new_buffer = arena_alloc(this_host->arena, length);
+        if (new_buffer == NULL)
+            return -1;
+        *string = new_buffer;
+        *capacity = length;
+    }
+    memcpy(*string, new_string, length);
+    return 0;
+}
+
+
+/**
+ * \fn      struct host *host_create(char type, int host_number, struct sensor_table *table)
  * \details Allocate memory for a new host object, initialise members with values indicating that it hasn't got any details yet.
  * \param   type The type ('f' or 'x') of host to create.
  * \param   host_number The host's index in its team. It needs to know this.
+ * \param   table The table in which to register the host. The host and everything on it come from the table's arena, and are freed
+ *          along with it.
  * \return  A pointer to the newly-allocated host.
  */
-struct host *host_create(char type, int host_number)
+struct host *host_create(char type, int host_number, struct sensor_table *table)
 {
-    struct host *new_host = malloc(sizeof(*new_host));
+    struct arena *arena = sensor_table_get_arena(table);
+    struct host *new_host = arena_alloc(arena, sizeof(*new_host));
     if (new_host != NULL)
     {
-        new_host->host_serial = strdup("unknwn");
+        new_host->arena = arena;
+        new_host->table = table;
+        new_host->id = sensor_table_add_host(table, type, host_number);
+        new_host->host_serial = NULL;
+        host_replace_string(new_host, &new_host->host_serial, &new_host->host_serial_capacity, "unknwn");
         new_host->type = type;
         new_host->host_number = host_number;
         new_host->host_input_stream_name = NULL;
+        new_host->host_input_stream_capacity = 0;
         new_host->number_of_devices = 0;
         new_host->device_list = NULL;
         new_host->number_of_vdevices = 0;
         new_host->vdevice_list = NULL;
         new_host->number_of_engines = 0;
         new_host->engine_list = NULL;
+        new_host->label_generation = 0;
     }
     return new_host;
 }
 
 
-/**
- * \fn      void host_destroy(struct host *this_host)
- * \details Free the memory allocated to this host, and its child objects.
- * \param   this_host A pointer to the host in question.
- * \return  void
- */
-void host_destroy(struct host *this_host)
-{
-    if (this_host != NULL)
-    {
-        free(this_host->host_serial);
-        if (this_host->host_input_stream_name)
-            free(this_host->host_input_stream_name);
-        unsigned int i;
-        for (i = 0; i < this_host->number_of_vdevices; i++)
-            vdevice_destroy(this_host->vdevice_list[i]);
-        free(this_host->vdevice_list);
-        for (i = 0; i < this_host->number_of_devices; i++)
-            device_destroy(this_host->device_list[i]);
-        free(this_host->device_list);
-        for (i = 0; i < this_host->number_of_engines; i++)
-            engine_destroy(this_host->engine_list[i]);
-        free(this_host->engine_list);
-        free(this_host);
-        this_host = NULL;
-    }
-}
-
-
 /**
  * \fn      int host_set_serial_no(struct host *this_host, char *host_serial)
  * \details Set the serial number of the host object.
@@ -99,8 +119,12 @@ void host_destroy(struct host *this_host)
  */
 int host_set_serial_no(struct host *this_host, char *host_serial)
 {
-    free(this_host->host_serial);
-    this_host->host_serial = strdup(host_serial);
+    if (strcmp(this_host->host_serial, host_serial))
+    {
+        host_replace_string(this_host, &this_host->host_serial, &this_host->host_serial_capacity, host_serial);
+        sensor_table_touch_host(this_host->table, this_host->id);
+        this_host->label_generation = host_get_generation(this_host);
+    }
     return 1;
 }
 
@@ -124,12 +148,11 @@ int host_add_device(struct host *this_host, char *new_device_name)
         }
     }
     /*If we got here then clearly it doesnt.*/
-    struct device **temp = realloc(this_host->device_list, \
-            sizeof(*(this_host->device_list))*(this_host->number_of_devices + 1));
-    if (temp != NULL) /*i.e. realloc was successful*/
+    struct device **temp = arena_list_reserve(this_host->arena, this_host->device_list, this_host->number_of_devices, sizeof(*temp));
+    if (temp != NULL)
     {
         this_host->device_list = temp;
-        this_host->device_list[this_host->number_of_devices] = device_create(new_device_name);
+        this_host->device_list[this_host->number_of_devices] = device_create(new_device_name, this_host->table, this_host->id);
         this_host->number_of_devices++;
         return (int) this_host->number_of_devices - 1;
     }
@@ -179,12 +202,11 @@ int host_add_engine(struct host *this_host, char *new_engine_name)
         }
     }
     /*Clearly it doesnt.*/
-    struct engine **temp = realloc(this_host->engine_list, \
-            sizeof(*(this_host->engine_list))*(this_host->number_of_engines + 1));
+    struct engine **temp = arena_list_reserve(this_host->arena, this_host->engine_list, this_host->number_of_engines, sizeof(*temp));
     if (temp != NULL)
     {
-        this_host->engine_list = temp;
-        this_host->engine_list[this_host->number_of_engines] = engine_create(new_engine_name);
+        this_host->engine_list = temp; //Only the host refers to the list. The vdevices watch the engines' sensors, which never move.
+        this_host->engine_list[this_host->number_of_engines] = engine_create(new_engine_name, this_host->table, this_host->id);
         this_host->number_of_engines++;
         return (int) this_host->number_of_engines - 1;
     }
@@ -243,15 +265,17 @@ int host_add_sensor_to_engine_device(struct host *this_host, char *engine_name,
         }
         if (i == this_host->number_of_vdevices)
         {
-            struct vdevice **temp = realloc(this_host->vdevice_list, \
-                    sizeof(*(this_host->vdevice_list))*(this_host->number_of_vdevices + 1));
+            struct vdevice **temp = arena_list_reserve(this_host->arena, this_host->vdevice_list, this_host->number_of_vdevices, sizeof(*temp));
             if (temp != NULL)
             {
                 this_host->vdevice_list = temp;
-                this_host->vdevice_list[this_host->number_of_vdevices] = vdevice_create(device_name, &this_host->engine_list, &this_host->number_of_engines);
+                this_host->vdevice_list[this_host->number_of_vdevices] = vdevice_create(device_name, this_host->arena);
                 this_host->number_of_vdevices++;
             }
         }
+        //The vdevice keeps count of its engines' device-statuses, so it needs to know about each one as it arrives.
+        if (i < this_host->number_of_vdevices && !strcmp(new_sensor_name, "device-status"))
+            vdevice_watch(this_host->vdevice_list[i], host_find_engine_sensor(this_host, engine_name, device_name, new_sensor_name));
     }
     return r;
 }
@@ -269,17 +293,50 @@ int host_update_input_stream(struct host *this_host, char *new_input_stream_name
     if (new_input_stream_name != NULL)
     {
         //syslog(LOG_INFO, "%chost%02d receiving input %s.", this_host->type, this_host->host_number, new_input_stream_name);
-        this_host->host_input_stream_name = strdup(new_input_stream_name);
-        size_t last_char = strlen(this_host->host_input_stream_name) - 1;
         //trim the polarisation off the end. We don't need to know that.
-        if (this_host->host_input_stream_name[last_char] == 'h' || this_host->host_input_stream_name[last_char] == 'v')
-            this_host->host_input_stream_name[last_char] = '\0';
+        size_t length = strlen(new_input_stream_name);
+        if (length > 0 && (new_input_stream_name[length - 1] == 'h' || new_input_stream_name[length - 1] == 'v'))
+            length--;
+        if (this_host->host_input_stream_name != NULL && strlen(this_host->host_input_stream_name) == length && \
+                !strncmp(this_host->host_input_stream_name, new_input_stream_name, length))
+            return 0; //Same as before, nothing has changed.
+        if (host_replace_string(this_host, &this_host->host_input_stream_name, &this_host->host_input_stream_capacity, new_input_stream_name) < 0)
+            return -1;
+        this_host->host_input_stream_name[length] = '\0';
+        sensor_table_touch_host(this_host->table, this_host->id);
+        this_host->label_generation = host_get_generation(this_host);
         return 0;
     }
     return -1;
 }
 
 
+/**
+ * \fn      uint64_t host_get_generation(struct host *this_host)
+ * \details Get the generation of the latest change to anything on the host, so that a copy of its rendering can be checked for
+ *          staleness.
+ * \param   this_host A pointer to the host in question.
+ * \return  The generation. See sensor_table.h.
+ */
+uint64_t host_get_generation(struct host *this_host)
+{
+    return sensor_table_get_host_generation(this_host->table, this_host->id);
+}
+
+
+/**
+ * \fn      size_t host_get_status_count(struct host *this_host, enum sensor_status status)
+ * \details Get the number of the host's sensors (in its devices and engines) which have a given status.
+ * \param   this_host A pointer to the host in question.
+ * \param   status The status in question.
+ * \return  The number of sensors. It's kept up to date as sensors change, so it costs nothing to read.
+ */
+size_t host_get_status_count(struct host *this_host, enum sensor_status status)
+{
+    return sensor_table_get_host_status_count(this_host->table, this_host->id, status);
+}
+
+
 /**
  * \fn      char *host_get_input_stream(struct host *this_host)
  * \details Get the input-stream name (normally the MeerKAT antenna name) going to the host.
@@ -317,15 +374,14 @@ char *host_get_sensor_value(struct host *this_host, char *device_name, char *sen
 
 
 /**
- * \fn      char *host_get_sensor_status(struct host *this_host, char *device_name, char *sensor_name)
+ * \fn      enum sensor_status host_get_sensor_status(struct host *this_host, char *device_name, char *sensor_name)
  * \details Get the status from a sensor on the host.
  * \param   this_host A pointer to the host in question.
  * \param   device_name A string with the name of the device which contains the desired sensor.
  * \param   sensor_name A string contianing the name of the sensor to be retrieved.
- * \return  A string containing the sensor status for the desired sensor. This is not newly allocated and must
- *          not be freed. NULL if the process failed.
+ * \return  The status of the desired sensor, SENSOR_UNKNOWN if it isn't found.
  */
-char *host_get_sensor_status(struct host *this_host, char *device_name, char *sensor_name)
+enum sensor_status host_get_sensor_status(struct host *this_host, char *device_name, char *sensor_name)
 {
     int i;
     for (i = 0; i < this_host->number_of_devices; i++)
@@ -345,21 +401,21 @@ char *host_get_sensor_status(struct host *this_host, char *device_name, char *se
             }
         }
     }
-    return NULL;
+    return SENSOR_UNKNOWN;
 }
 
 
 /**
- * \fn      int host_update_sensor(struct host *this_host, char *device_name, char *sensor_name, char *new_sensor_value, char *new_sensor_status)
+ * \fn      int host_update_sensor(struct host *this_host, char *device_name, char *sensor_name, char *new_sensor_value, enum sensor_status new_sensor_status)
  * \details Update the value and status of one of the sensors on the host.
  * \param   this_host A pointer to the host in question.
  * \param   device_name A string with the name of the device which contains the desired sensor.
  * \param   sensor_name A string contianing the name of the sensor to be updated.
  * \param   new_sensor_value A string containing the new value to store in the sensor.
- * \param   new_sensor_status A string containing the new status to store in the sensor.
+ * \param   new_sensor_status The new status to store in the sensor.
  * \return  An integer indicating the outcome of the operation.
  */
-int host_update_sensor(struct host *this_host, char *device_name, char *sensor_name, char *new_sensor_value, char *new_sensor_status)
+int host_update_sensor(struct host *this_host, char *device_name, char *sensor_name, char *new_sensor_value, enum sensor_status new_sensor_status)
 {
     int i;
     for (i = 0; i < this_host->number_of_devices; i++)
@@ -374,17 +430,17 @@ int host_update_sensor(struct host *this_host, char *device_name, char *sensor_n
 
 
 /**
- * \fn      int host_update_engine_sensor(struct host *this_host, char *engine_name, char *device_name, char *sensor_name, char *new_sensor_value, char *new_sensor_status)
+ * \fn      int host_update_engine_sensor(struct host *this_host, char *engine_name, char *device_name, char *sensor_name, char *new_sensor_value, enum sensor_status new_sensor_status)
  * \details Update the value and status of one of the sensors in one of the host's engines.
  * \param   this_host A pointer to the host in question.
  * \param   engine_name A string with the name of the engine which contains the desired device.
  * \param   device_name A string with the name of the device which contains the desired sensor.
  * \param   sensor_name A string contianing the name of the sensor to be updated.
  * \param   new_sensor_value A string containing the new value to store in the sensor.
- * \param   new_sensor_status A string containing the new status to store in the sensor.
+ * \param   new_sensor_status The new status to store in the sensor.
  * \return  An integer indicating the outcome of the operation.
  */
-int host_update_engine_sensor(struct host *this_host, char *engine_name, char *device_name, char *sensor_name, char *new_sensor_value, char *new_sensor_status)
+int host_update_engine_sensor(struct host *this_host, char *engine_name, char *device_name, char *sensor_name, char *new_sensor_value, enum sensor_status new_sensor_status)
 {
     int i;
     for (i = 0; i < this_host->number_of_engines; i++)
@@ -399,44 +455,200 @@ int host_update_engine_sensor(struct host *this_host, char *engine_name, char *d
 
 
 /**
- * \fn      char *host_html_detail(struct host *this_host)
- * \details Get an HTML description of the host by concatenating HTML descriptions of the underlying devices and vdevices in the host.
+ * \fn      struct sensor *host_find_sensor(struct host *this_host, char *device_name, char *sensor_name)
+ * \details Find one of the sensors on the host.
+ * \param   this_host A pointer to the host in question.
+ * \param   device_name A string with the name of the device which contains the desired sensor.
+ * \param   sensor_name A string contianing the name of the sensor.
+ * \return  A pointer to the sensor, NULL if it doesn't exist.
+ */
+struct sensor *host_find_sensor(struct host *this_host, char *device_name, char *sensor_name)
+{
+    int i;
+    for (i = 0; i < this_host->number_of_devices; i++)
+    {
+        if (!strcmp(device_name, device_get_name(this_host->device_list[i])))
+        {
+            return device_find_sensor(this_host->device_list[i], sensor_name);
+        }
+    }
+    return NULL;
+}
+
+
+/**
+ * \fn      struct sensor *host_find_engine_sensor(struct host *this_host, char *engine_name, char *device_name, char *sensor_name)
+ * \details Find one of the sensors in one of the host's engines.
  * \param   this_host A pointer to the host in question.
- * \return  A newly allocated string containing the HTML description of the host.
+ * \param   engine_name A string with the name of the engine which contains the desired device.
+ * \param   device_name A string with the name of the device which contains the desired sensor.
+ * \param   sensor_name A string contianing the name of the sensor.
+ * \return  A pointer to the sensor, NULL if it doesn't exist.
  */
-char *host_html_detail(struct host *this_host)
+struct sensor *host_find_engine_sensor(struct host *this_host, char *engine_name, char *device_name, char *sensor_name)
+{
+    int i;
+    for (i = 0; i < this_host->number_of_engines; i++)
+    {
+        if (!strcmp(engine_name, engine_get_name(this_host->engine_list[i])))
+        {
+            return engine_find_sensor(this_host->engine_list[i], device_name, sensor_name);
+        }
+    }
+    return NULL;
+}
+
+
+/**
+ * \fn      size_t host_get_number_of_cells(struct host *this_host)
+ * \details Get the number of cells with a status (one for each device and vdevice) in the host's part of the detail table.
+ * \param   this_host A pointer to the host in question.
+ * \return  The number of cells.
+ */
+size_t host_get_number_of_cells(struct host *this_host)
+{
+    return this_host->number_of_devices + this_host->number_of_vdevices;
+}
+
+
+/**
+ * \fn      static enum sensor_status host_get_cell_status(struct host *this_host, size_t cell)
+ * \details Get the status shown in one of the host's cells: the devices first, then the vdevices.
+ */
+static enum sensor_status host_get_cell_status(struct host *this_host, size_t cell)
+{
+    if (cell < this_host->number_of_devices)
+        return device_get_status(this_host->device_list[cell]);
+    return vdevice_get_status(this_host->vdevice_list[cell - this_host->number_of_devices]);
+}
+
+
+/**
+ * \fn      void host_get_cell_statuses(struct host *this_host, unsigned char *cell_status)
+ * \details Get the statuses which the host's cells show now, in the order used by host_html_changes().
+ * \param   this_host A pointer to the host in question.
+ * \param   cell_status Filled in with the statuses, one for each cell.
+ * \return  void
+ */
+void host_get_cell_statuses(struct host *this_host, unsigned char *cell_status)
 {
     size_t i;
-    char *host_detail = strdup(""); //need it to be zero length but don't want it to be null
+    for (i = 0; i < host_get_number_of_cells(this_host); i++)
+        cell_status[i] = (unsigned char) host_get_cell_status(this_host, i);
+}
+
 
+/**
+ * \fn      int host_html_detail(struct host *this_host, struct strbuf *html)
+ * \details Append an HTML description of the host, made up of the HTML summaries of the underlying devices and vdevices in the host.
+ *          Each cell gets an id (e.g. "f3-input", "f3-name" and "f3-0" onwards for the devices and vdevices) by which
+ *          host_html_changes() can refer to it.
+ * \param   this_host A pointer to the host in question.
+ * \param   html The strbuf to which the description is appended.
+ * \return  0 on success, -1 if the strbuf has failed.
+ */
+int host_html_detail(struct host *this_host, struct strbuf *html)
+{
+    size_t i;
+    char cell_id[32];
     if (this_host->host_input_stream_name != NULL)
+        strbuf_appendf(html, "<td id=\"%c%d-input\" style=\"width: 1%%\">%s</td>", this_host->type, this_host->host_number, this_host->host_input_stream_name);
+    strbuf_appendf(html, "<td id=\"%c%d-name\">%c%d %s</td>", this_host->type, this_host->host_number, this_host->type, this_host->host_number, this_host->host_serial);
+    for (i = 0; i < this_host->number_of_devices; i++)
     {
-        char format[] = "<td style=\"width: 1%%\">%s</td>";
-        ssize_t needed = snprintf(NULL, 0, format, this_host->host_input_stream_name) + 1;
-        host_detail = realloc(host_detail, (size_t) needed); //TODO checks for errors.
-        sprintf(host_detail, format, this_host->host_input_stream_name);
+        snprintf(cell_id, sizeof(cell_id), "%c%d-%zu", this_host->type, this_host->host_number, i);
+        device_html_summary(this_host->device_list[i], cell_id, html);
     }
+    for (i = 0; i < this_host->number_of_vdevices; i++)
     {
-        char format[] = "<td>%c%d %s</td>";
-        ssize_t needed = snprintf(NULL, 0, format, this_host->type, this_host->host_number, this_host->host_serial) + 1;
-        needed += (ssize_t) strlen(host_detail);
-        host_detail = realloc(host_detail, (size_t) needed); //TODO checks for errors.
-        sprintf(host_detail + strlen(host_detail), format, this_host->type, this_host->host_number, this_host->host_serial);
+        snprintf(cell_id, sizeof(cell_id), "%c%d-%zu", this_host->type, this_host->host_number, this_host->number_of_devices + i);
+        vdevice_html_summary(this_host->vdevice_list[i], cell_id, html);
     }
-    for (i = 0; i < this_host->number_of_devices; i++)
+    return strbuf_has_failed(html) ? -1 : 0;
+}
+
+
+/**
+ * \fn      int host_html_changes(struct host *this_host, uint64_t since, unsigned char *cell_status, struct strbuf *lines)
+ * \details Append a line for each of the host's cells (see host_html_detail()) which no longer shows what a page was last told:
+ *          "status <id> <status>" for a device or vdevice whose status differs from the one in cell_status, and "text <id> <text>" for
+ *          the serial number and input stream if they have changed since the given generation.
+ * \param   this_host A pointer to the host in question.
+ * \param   since The generation up to which the page is known to be current.
+ * \param   cell_status The statuses last sent, one for each of the host's cells, which are brought up to date. Anything which isn't a
+ *          valid enum sensor_status counts as never having been sent.
+ * \param   lines The strbuf to which the lines are appended.
+ * \return  0 on success, -1 if the strbuf has failed.
+ */
+int host_html_changes(struct host *this_host, uint64_t since, unsigned char *cell_status, struct strbuf *lines)
+{
+    size_t i;
+    if (this_host->label_generation > since)
     {
-        char *dev_html_summ = device_html_summary(this_host->device_list[i]);
-        size_t needed = strlen(host_detail) + strlen(dev_html_summ) + 1;
-        host_detail = realloc(host_detail, needed);
-        strcat(host_detail, dev_html_summ);
-        free(dev_html_summ);
+        if (this_host->host_input_stream_name != NULL)
+            strbuf_appendf(lines, "text %c%d-input %s\n", this_host->type, this_host->host_number, this_host->host_input_stream_name);
+        strbuf_appendf(lines, "text %c%d-name %c%d %s\n", this_host->type, this_host->host_number, this_host->type, this_host->host_number, this_host->host_serial);
     }
-    for (i = 0; i < this_host->number_of_vdevices; i++)
+    for (i = 0; i < host_get_number_of_cells(this_host); i++)
+    {
+        enum sensor_status status = host_get_cell_status(this_host, i);
+        if (cell_status[i] != status)
+        {
+            strbuf_appendf(lines, "status %c%d-%zu %s\n", this_host->type, this_host->host_number, i, sensor_status_to_string(status));
+            cell_status[i] = (unsigned char) status;
+        }
+    }
+    return strbuf_has_failed(lines) ? -1 : 0;
+}
+
+
+/**
+ * \fn      int host_json(struct host *this_host, struct json_writer *json, unsigned int fields)
+ * \details Write the host as a JSON object: its id (e.g. "f3"), type and number; its serial number and input stream if info is asked
+ *          for; the number of its sensors with each status if statuses are asked for; and its devices, vdevices and engines.
+ * \param   this_host A pointer to the host.
+ * \param   json The json_writer to which the object is written.
+ * \param   fields The JSON_FIELD_* flags saying which fields to write, for the host and everything on it.
+ * \return  0 on success, -1 if the writer has failed.
+ */
+int host_json(struct host *this_host, struct json_writer *json, unsigned int fields)
+{
+    size_t i;
+    char host_id[16];
+    char type[2] = {this_host->type, '\0'};
+    snprintf(host_id, sizeof(host_id), "%c%d", this_host->type, this_host->host_number);
+    json_begin_object(json);
+    json_key_string(json, "id", host_id);
+    json_key_string(json, "type", type);
+    json_key_integer(json, "number", this_host->host_number);
+    if (fields & JSON_FIELD_INFO)
+    {
+        json_key_string(json, "serial", this_host->host_serial);
+        json_key_string(json, "input_stream", this_host->host_input_stream_name);
+    }
+    if (fields & JSON_FIELD_STATUS)
     {
-        char *vdev_html_summ = vdevice_html_summary(this_host->vdevice_list[i]);
-        host_detail = realloc(host_detail, strlen(host_detail) + strlen(vdev_html_summ) + 1);
-        strcat(host_detail, vdev_html_summ);
-        free(vdev_html_summ);
+        json_key(json, "status_counts");
+        json_begin_object(json);
+        for (i = 0; i < SENSOR_NUMBER_OF_STATUSES; i++)
+            json_key_integer(json, sensor_status_to_string((enum sensor_status) i), (long long) host_get_status_count(this_host, (enum sensor_status) i));
+        json_end_object(json);
     }
-    return host_detail;
+    json_key(json, "devices");
+    json_begin_array(json);
+    for (i = 0; i < this_host->number_of_devices; i++)
+        device_json(this_host->device_list[i], json, fields);
+    json_end_array(json);
+    json_key(json, "vdevices");
+    json_begin_array(json);
+    for (i = 0; i < this_host->number_of_vdevices; i++)
+        vdevice_json(this_host->vdevice_list[i], json, fields);
+    json_end_array(json);
+    json_key(json, "engines");
+    json_begin_array(json);
+    for (i = 0; i < this_host->number_of_engines; i++)
+        engine_json(this_host->engine_list[i], json, fields);
+    json_end_array(json);
+    json_end_object(json);
+    return json_writer_has_failed(json) ? -1 : 0;
 }
@@ -1,5 +1,7 @@
 #ifndef _HOST_H_
 #define _HOST_H_
+#include "sensor.h"
+#include "strbuf.h"
 
 /**
  * \file  host.h
@@ -8,8 +10,7 @@
 
 struct host;
 
-struct host *host_create(char type, int host_number);
-void host_destroy(struct host *this_host);
+struct host *host_create(char type, int host_number, struct sensor_table *table);
 
 int host_set_serial_no(struct host *this_host, char *host_serial);
 
@@ -22,11 +23,19 @@ int host_add_sensor_to_engine_device(struct host *this_host, char *engine_name,
 
 int host_update_input_stream(struct host *this_host, char *new_input_stream_name);
 char *host_get_input_stream(struct host *this_host);
+uint64_t host_get_generation(struct host *this_host);
+size_t host_get_status_count(struct host *this_host, enum sensor_status status);
 
 char *host_get_sensor_value(struct host *this_host, char *device_name, char *sensor_name);
-char *host_get_sensor_status(struct host *this_host, char *device_name, char *sensor_name);
-int host_update_sensor(struct host *this_host, char *device_name, char *sensor_name, char *new_sensor_value, char *new_sensor_status);
-int host_update_engine_sensor(struct host *this_host, char *engine_name, char *device_name, char *sensor_name, char *new_sensor_value, char *new_sensor_status);
-
-char *host_html_detail(struct host *this_host);
+enum sensor_status host_get_sensor_status(struct host *this_host, char *device_name, char *sensor_name);
+int host_update_sensor(struct host *this_host, char *device_name, char *sensor_name, char *new_sensor_value, enum sensor_status new_sensor_status);
+int host_update_engine_sensor(struct host *this_host, char *engine_name, char *device_name, char *sensor_name, char *new_sensor_value, enum sensor_status new_sensor_status);
+struct sensor *host_find_sensor(struct host *this_host, char *device_name, char *sensor_name);
+struct sensor *host_find_engine_sensor(struct host *this_host, char *engine_name, char *device_name, char *sensor_name);
+
+size_t host_get_number_of_cells(struct host *this_host);
+void host_get_cell_statuses(struct host *this_host, unsigned char *cell_status);
+int host_html_detail(struct host *this_host, struct strbuf *html);
+int host_html_changes(struct host *this_host, uint64_t since, unsigned char *cell_status, struct strbuf *lines);
+int host_json(struct host *this_host, struct json_writer *json, unsigned int fields);
 #endif
@@ -26,15 +26,9 @@ char *html_head_open()
 }
 
 
-char *html_title(char *title)
+int html_title(char *title, struct strbuf *html)
 {
-    char format[] = "<title>%s</title>\n";
-    ssize_t needed = snprintf(NULL, 0, format, title) + 1;
-    char *the_title = malloc((size_t) needed);
-    int r = sprintf(the_title, format, title);
-    if (r<0)
-        return NULL;
-    return the_title;
+    return strbuf_appendf(html, "<title>%s</title>\n", title);
 }
 
 
@@ -44,27 +38,22 @@ char *html_script()
 }
 
 
-char *html_style()
+int html_style(struct strbuf *html)
 {
     FILE *style_file = fopen(STYLE_FILE_LOCATION, "r");
     if (style_file == NULL)
     {
         perror("fopen(styles.css)");
-        return NULL;
+        return -1;
     }
 
     char buffer[BUF_SIZE];
-    char *result;
-    char *return_value = strdup("<style>\n");
-    for (result = fgets(buffer, BUF_SIZE, style_file); result != NULL; result = fgets(buffer, BUF_SIZE, style_file))
-    {
-        return_value = realloc(return_value, strlen(return_value) + strlen(buffer) + 1);
-        strcat(return_value, buffer);
-    }
+    size_t bytes_read;
+    strbuf_append(html, "<style>\n");
+    while ((bytes_read = fread(buffer, 1, BUF_SIZE, style_file)) > 0)
+        strbuf_append_length(html, buffer, bytes_read);
     fclose(style_file);
-    return_value = realloc(return_value, strlen(return_value) + strlen("</style>\n") + 1);
-    strcat(return_value, "</style>\n");
-    return return_value;
+    return strbuf_append(html, "</style>\n");
 }
 
 
@@ -80,6 +69,39 @@ char *html_body_open()
 }
 
 
+char *html_body_open_live()
+{
+    return "<body>\n";
+}
+
+
+int html_event_source(char *cmc_name, char *array_name, uint64_t generation, struct strbuf *html)
+{
+    //Keeps the page up to date from /events/<cmc>/<array> (see event_stream.h) instead of reloading it. If the stream can't be had at
+    //all, e.g. because the array has gone, the page falls back to reloading itself.
+    return strbuf_appendf(html, "<script>\n"
+            "var source = new EventSource(\"/events/%s/%s?since=%llu\");\n"
+            "source.addEventListener(\"update\", function(e) {\n"
+            "    e.data.split(\"\\n\").forEach(function(line) {\n"
+            "        var kind = line.indexOf(\" \"), id = line.indexOf(\" \", kind + 1);\n"
+            "        var cell = document.getElementById(line.substring(kind + 1, id));\n"
+            "        if (cell == null) return;\n"
+            "        if (line.substring(0, kind) == \"status\") cell.className = line.substring(id + 1);\n"
+            "        else cell.textContent = line.substring(id + 1);\n"
+            "    });\n"
+            "});\n"
+            "source.addEventListener(\"heard\", function(e) {\n"
+            "    var space = e.data.indexOf(\" \");\n"
+            "    document.getElementById(\"heard-age\").textContent = e.data.substring(0, space);\n"
+            "    document.getElementById(\"heard-time\").textContent = e.data.substring(space + 1);\n"
+            "});\n"
+            "source.addEventListener(\"reload\", function(e) { source.close(); location.reload(true); });\n"
+            "source.onerror = function(e) { if (source.readyState == EventSource.CLOSED) timedRefresh(5000); };\n"
+            "setInterval(function() { var age = document.getElementById(\"heard-age\"); age.textContent = +age.textContent + 1; }, 1000);\n"
+            "</script>\n", cmc_name, array_name, (unsigned long long) generation);
+}
+
+
 char *html_body_close()
 {
     return "</body>\n";
@@ -1,15 +1,21 @@
 #ifndef _HTML_HANDLING_H
 #define _HTML_HANDLING_H
 
+#include <stdint.h>
+
+#include "strbuf.h"
+
 char *html_doctype();
 char *html_open();
 char *html_head_open();
-char *html_title(char *title);
+int html_title(char *title, struct strbuf *html);
 char *html_script();
-char *html_style();
+int html_style(struct strbuf *html);
 char *html_head_close();
 
 char *html_body_open();
+char *html_body_open_live();
+int html_event_source(char *cmc_name, char *array_name, uint64_t generation, struct strbuf *html);
 char *html_body_close();
 
 char *html_close();
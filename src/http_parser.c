@@ -0,0 +1,240 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+
+#include "http_parser.h"
+
+
+/// A struct to hold what has arrived on a connection and hasn't been dealt with yet.
+struct http_parser {
+    /// The bytes received. Those before start have been dealt with.
+    char buffer[HTTP_PARSER_BUFFER_SIZE];
+    /// Where the next request starts.
+    size_t start;
+    /// Where the bytes received so far end.
+    size_t end;
+    /// How much of a request body is still to come, and is to be thrown away when it does.
+    unsigned long long body_left;
+};
+
+
+/**
+ * \fn      struct http_parser *http_parser_create()
+ * \details Allocate memory for a parser with an empty buffer.
+ * \return  A pointer to the newly-created http_parser, NULL on failure.
+ */
+struct http_parser *http_parser_create()
+{
+    struct http_parser *new_parser = malloc(sizeof(*new_parser));
+    if (new_parser != NULL)
+    {
+        new_parser->start = 0;
+        new_parser->end = 0;
+        new_parser->body_left = 0;
+    }
+    return new_parser;
+}
+
+
+/**
+ * \fn      void http_parser_destroy(struct http_parser *this_parser)
+ * \details Free the memory associated with the parser.
+ * \param   this_parser A pointer to the http_parser to be destroyed.
+ * \return  void
+ */
+void http_parser_destroy(struct http_parser *this_parser)
+{
+    free(this_parser);
+}
+
+
+/**
+ * \fn      char *http_parser_get_space(struct http_parser *this_parser, size_t *space)
+ * \details Find out where the next bytes from the connection should be read to. Whatever has been dealt with is moved out of the way
+ *          first.
+ * \param   this_parser A pointer to the http_parser in question.
+ * \param   space Set to the number of bytes which can be read. Zero means that the buffer is full of requests which are still waiting.
+ * \return  Where to read to.
+ */
+char *http_parser_get_space(struct http_parser *this_parser, size_t *space)
+{
+    if (this_parser->start > 0)
+    {
+        memmove(this_parser->buffer, this_parser->buffer + this_parser->start, this_parser->end - this_parser->start);
+        this_parser->end -= this_parser->start;
+        this_parser->start = 0;
+    }
+    *space = HTTP_PARSER_BUFFER_SIZE - this_parser->end;
+    return this_parser->buffer + this_parser->end;
+}
+
+
+/**
+ * \fn      void http_parser_commit(struct http_parser *this_parser, size_t length)
+ * \details Tell the parser how many bytes were read into the space from http_parser_get_space().
+ * \param   this_parser A pointer to the http_parser in question.
+ * \param   length The number of bytes read.
+ * \return  void
+ */
+void http_parser_commit(struct http_parser *this_parser, size_t length)
+{
+    this_parser->end += length;
+}
+
+
+/**
+ * \fn      static char *http_parser_next_line(char *line, char *end, char **line_end)
+ * \details Find the end of the line which starts at line. Lines should end in CRLF, but a bare LF is accepted too.
+ * \param   line Where the line starts.
+ * \param   end Where the received bytes end.
+ * \param   line_end Set to where the line's text ends, i.e. just before the CR or LF.
+ * \return  Where the next line starts, NULL if the line isn't complete yet.
+ */
+static char *http_parser_next_line(char *line, char *end, char **line_end)
+{
+    char *newline = memchr(line, '\n', (size_t) (end - line));
+    if (newline == NULL)
+        return NULL;
+    *line_end = (newline > line && newline[-1] == '\r') ? newline - 1 : newline;
+    return newline + 1;
+}
+
+
+/**
+ * \fn      static int http_parser_has_token(char *value, char *value_end, char *token)
+ * \details Check whether a comma-separated header value, e.g. that of Connection, has the given token in it. Case doesn't matter.
+ * \return  1 if it does, 0 if not.
+ */
+static int http_parser_has_token(char *value, char *value_end, char *token)
+{
+    size_t token_length = strlen(token);
+    while (value < value_end)
+    {
+        while (value < value_end && (*value == ' ' || *value == '\t' || *value == ','))
+            value++;
+        char *item = value;
+        while (value < value_end && *value != ',')
+            value++;
+        char *item_end = value;
+        while (item_end > item && (item_end[-1] == ' ' || item_end[-1] == '\t'))
+            item_end--;
+        if ((size_t) (item_end - item) == token_length && !strncasecmp(item, token, token_length))
+            return 1;
+    }
+    return 0;
+}
+
+
+/**
+ * \fn      static int http_parser_request_line(char *line, char *line_end, struct http_request *request)
+ * \details Parse a request line, e.g. "GET /cmc2/array0 HTTP/1.1".
+ * \return  0 on success, -1 if the line is malformed or too long, or isn't HTTP/1.x.
+ */
+static int http_parser_request_line(char *line, char *line_end, struct http_request *request)
+{
+    char *method_end = memchr(line, ' ', (size_t) (line_end - line));
+    if (method_end == NULL || method_end == line || method_end - line >= HTTP_METHOD_SIZE)
+        return -1;
+    char *target = method_end + 1;
+    char *target_end = memchr(target, ' ', (size_t) (line_end - target));
+    if (target_end == NULL || target_end == target || target_end - target >= HTTP_TARGET_SIZE)
+        return -1;
+    char *version = target_end + 1;
+    if (line_end - version != 8 || strncmp(version, "HTTP/1.", 7) || !isdigit((unsigned char) version[7]))
+        return -1;
+
+    memcpy(request->method, line, (size_t) (method_end - line));
+    request->method[method_end - line] = '\0';
+    memcpy(request->target, target, (size_t) (target_end - target));
+    request->target[target_end - target] = '\0';
+    request->version_minor = version[7] - '0';
+    return 0;
+}
+
+
+/**
+ * \fn      int http_parser_next(struct http_parser *this_parser, struct http_request *request)
+ * \details Pick the next complete request out of the buffer, if there is one. Anything that's left of the last request's body is thrown
+ *          away first.
+ * \param   this_parser A pointer to the http_parser in question.
+ * \param   request Filled in with the request.
+ * \return  An integer indicating the outcome of the operation.
+ */
+int http_parser_next(struct http_parser *this_parser, struct http_request *request)
+{
+    char *buffer_end = this_parser->buffer + this_parser->end;
+    if (this_parser->body_left > 0)
+    {
+        size_t available = this_parser->end - this_parser->start;
+        size_t skip = this_parser->body_left < available ? (size_t) this_parser->body_left : available;
+        this_parser->start += skip;
+        this_parser->body_left -= skip;
+        if (this_parser->body_left > 0)
+            return 0;
+    }
+
+    //Blank lines ahead of a request are allowed, and ignored.
+    char *line = this_parser->buffer + this_parser->start;
+    char *line_end;
+    char *next;
+    while ((next = http_parser_next_line(line, buffer_end, &line_end)) != NULL && line_end == line)
+    {
+        line = next;
+        this_parser->start = (size_t) (line - this_parser->buffer);
+    }
+    if (next == NULL)
+        goto incomplete;
+    if (http_parser_request_line(line, line_end, request) < 0)
+        return -1; /// \retval -1 The request is malformed, and the connection can't be trusted to make sense after it.
+
+    int connection_close = 0;
+    int connection_keep_alive = 0;
+    unsigned long long content_length = 0;
+    for (line = next; (next = http_parser_next_line(line, buffer_end, &line_end)) != NULL; line = next)
+    {
+        if (line_end == line) //The blank line at the end of the headers.
+            break;
+        char *colon = memchr(line, ':', (size_t) (line_end - line));
+        if (colon == NULL || colon == line)
+            return -1;
+        char *value = colon + 1;
+        while (value < line_end && (*value == ' ' || *value == '\t'))
+            value++;
+        size_t name_length = (size_t) (colon - line);
+
+        if (name_length == strlen("Connection") && !strncasecmp(line, "Connection", name_length))
+        {
+            connection_close |= http_parser_has_token(value, line_end, "close");
+            connection_keep_alive |= http_parser_has_token(value, line_end, "keep-alive");
+        }
+        else if (name_length == strlen("Content-Length") && !strncasecmp(line, "Content-Length", name_length))
+        {
+            char number[24];
+            size_t length = (size_t) (line_end - value);
+            while (length > 0 && (value[length - 1] == ' ' || value[length - 1] == '\t'))
+                length--;
+            if (length == 0 || length >= sizeof(number) || strspn(value, "0123456789") < length)
+                return -1;
+            memcpy(number, value, length);
+            number[length] = '\0';
+            content_length = strtoull(number, NULL, 10);
+        }
+        else if (name_length == strlen("Transfer-Encoding") && !strncasecmp(line, "Transfer-Encoding", name_length))
+            return -1; //There's no way of knowing where a chunked body ends without decoding it, and no request here needs a body.
+    }
+    if (next == NULL)
+        goto incomplete;
+
+    request->keep_alive = request->version_minor >= 1 ? !connection_close : (connection_keep_alive && !connection_close);
+    this_parser->start = (size_t) (next - this_parser->buffer);
+    this_parser->body_left = content_length;
+    return 1; /// \retval 1 A request has been picked out.
+
+incomplete:
+    //If the buffer is already full, the rest of the headers will never fit.
+    if (this_parser->start == 0 && this_parser->end == HTTP_PARSER_BUFFER_SIZE)
+        return -1;
+    return 0; /// \retval 0 There isn't a complete request yet.
+}
@@ -0,0 +1,46 @@
+#ifndef _HTTP_PARSER_H_
+#define _HTTP_PARSER_H_
+
+#include <stddef.h>
+
+/**
+ * \file  http_parser.h
+ * \brief The http_parser type takes the bytes which arrive on a web client's connection, in whatever pieces they come, and picks
+ *        complete HTTP/1.x requests out of them one at a time. Bytes are read straight into the parser's buffer (see
+ *        http_parser_get_space()). Requests which the client has pipelined simply wait in the buffer until they're asked for, so the
+ *        buffer is the queue; when it's full, the connection isn't read again until some of it has been dealt with.
+ *
+ *        Only the request line and the headers which matter here (Connection, Content-Length) are looked at. A request body is
+ *        skipped.
+ */
+
+/// The size of the buffer. A request's line and headers have to fit in this, and pipelined requests beyond it wait in the socket.
+#define HTTP_PARSER_BUFFER_SIZE 16384
+/// Room for a method, including the NUL.
+#define HTTP_METHOD_SIZE 16
+/// Room for a request target, including the NUL.
+#define HTTP_TARGET_SIZE 2048
+
+/// A request, as picked out of the buffer.
+struct http_request {
+    /// The method, e.g. "GET".
+    char method[HTTP_METHOD_SIZE];
+    /// The request target, e.g. "/cmc2/array0".
+    char target[HTTP_TARGET_SIZE];
+    /// The minor version, i.e. 0 for HTTP/1.0 and 1 for HTTP/1.1.
+    int version_minor;
+    /// Whether the connection is to stay open after the response: the default for HTTP/1.1 unless the client said "Connection: close",
+    /// and for HTTP/1.0 only if it said "Connection: keep-alive".
+    int keep_alive;
+};
+
+struct http_parser;
+
+struct http_parser *http_parser_create();
+void http_parser_destroy(struct http_parser *this_parser);
+
+char *http_parser_get_space(struct http_parser *this_parser, size_t *space);
+void http_parser_commit(struct http_parser *this_parser, size_t length);
+int http_parser_next(struct http_parser *this_parser, struct http_request *request);
+
+#endif
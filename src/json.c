@@ -0,0 +1,322 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+
+#include "json.h"
+
+
+/// A struct to hold where a json_writer is in the JSON which it's writing.
+struct json_writer {
+    /// Where the JSON goes.
+    struct strbuf *output;
+    /// How deeply nested the writer is in objects and arrays.
+    size_t depth;
+    /// For each level of nesting, whether anything has been written at that level yet, i.e. whether the next thing needs a comma.
+    unsigned char has_members[JSON_WRITER_MAX_DEPTH + 1];
+    /// Set just after a key has been written, so that its value doesn't get a comma.
+    int after_key;
+    /// Set if the nesting went too deep or came undone. Nothing more is written from then on.
+    int failed;
+};
+
+
+/**
+ * \fn      struct json_writer *json_writer_create(struct strbuf *output)
+ * \details Allocate memory for a json_writer which writes to the given strbuf.
+ * \param   output The strbuf to which the JSON is appended. It still belongs to the caller.
+ * \return  A pointer to the newly-created json_writer, NULL on failure.
+ */
+struct json_writer *json_writer_create(struct strbuf *output)
+{
+    struct json_writer *new_writer = malloc(sizeof(*new_writer));
+    if (new_writer != NULL)
+    {
+        new_writer->output = output;
+        new_writer->depth = 0;
+        new_writer->has_members[0] = 0;
+        new_writer->after_key = 0;
+        new_writer->failed = 0;
+    }
+    return new_writer;
+}
+
+
+/**
+ * \fn      void json_writer_destroy(struct json_writer *this_writer)
+ * \details Free the memory associated with the json_writer. The strbuf is left as it is.
+ * \param   this_writer A pointer to the json_writer to be destroyed.
+ * \return  void
+ */
+void json_writer_destroy(struct json_writer *this_writer)
+{
+    free(this_writer);
+}
+
+
+/**
+ * \fn      int json_writer_has_failed(struct json_writer *this_writer)
+ * \details Check whether the JSON written so far can be trusted.
+ * \param   this_writer A pointer to the json_writer in question.
+ * \return  1 if the nesting went wrong or the strbuf has failed, 0 if not.
+ */
+int json_writer_has_failed(struct json_writer *this_writer)
+{
+    return this_writer->failed || strbuf_has_failed(this_writer->output);
+}
+
+
+/**
+ * \fn      static int json_writer_start_value(struct json_writer *this_writer)
+ * \details Get ready to write a value (or a key): put a comma in if it isn't the first thing at this level, unless it's the value of a
+ *          key which has just been written.
+ * \return  0 if the value can be written, -1 if the writer has failed.
+ */
+static int json_writer_start_value(struct json_writer *this_writer)
+{
+    if (this_writer->failed)
+        return -1;
+    if (this_writer->after_key)
+        this_writer->after_key = 0;
+    else
+    {
+        if (this_writer->has_members[this_writer->depth])
+            strbuf_append(this_writer->output, ",");
+        this_writer->has_members[this_writer->depth] = 1;
+    }
+    return 0;
+}
+
+
+/**
+ * \fn      static void json_writer_open(struct json_writer *this_writer, char *bracket)
+ * \details Open an object or an array one level further in.
+ */
+static void json_writer_open(struct json_writer *this_writer, char *bracket)
+{
+    if (json_writer_start_value(this_writer) < 0)
+        return;
+    if (this_writer->depth == JSON_WRITER_MAX_DEPTH)
+    {
+        syslog(LOG_ERR, "JSON nested more than %d deep.", JSON_WRITER_MAX_DEPTH);
+        this_writer->failed = 1;
+        return;
+    }
+    strbuf_append(this_writer->output, bracket);
+    this_writer->has_members[++this_writer->depth] = 0;
+}
+
+
+/**
+ * \fn      static void json_writer_close(struct json_writer *this_writer, char *bracket)
+ * \details Close the object or array at the current level.
+ */
+static void json_writer_close(struct json_writer *this_writer, char *bracket)
+{
+    if (this_writer->failed)
+        return;
+    if (this_writer->depth == 0 || this_writer->after_key)
+    {
+        this_writer->failed = 1;
+        return;
+    }
+    this_writer->depth--;
+    strbuf_append(this_writer->output, bracket);
+}
+
+
+/**
+ * \fn      void json_begin_object(struct json_writer *this_writer)
+ * \details Start an object. Its members are written as keys and values, and it's finished with json_end_object().
+ * \param   this_writer A pointer to the json_writer in question.
+ * \return  void
+ */
+void json_begin_object(struct json_writer *this_writer)
+{
+    json_writer_open(this_writer, "{");
+}
+
+
+/**
+ * \fn      void json_end_object(struct json_writer *this_writer)
+ * \details Finish the object which was started last.
+ * \param   this_writer A pointer to the json_writer in question.
+ * \return  void
+ */
+void json_end_object(struct json_writer *this_writer)
+{
+    json_writer_close(this_writer, "}");
+}
+
+
+/**
+ * \fn      void json_begin_array(struct json_writer *this_writer)
+ * \details Start an array. Its elements are whatever is written until json_end_array().
+ * \param   this_writer A pointer to the json_writer in question.
+ * \return  void
+ */
+void json_begin_array(struct json_writer *this_writer)
+{
+    json_writer_open(this_writer, "[");
+}
+
+
+/**
+ * \fn      void json_end_array(struct json_writer *this_writer)
+ * \details Finish the array which was started last.
+ * \param   this_writer A pointer to the json_writer in question.
+ * \return  void
+ */
+void json_end_array(struct json_writer *this_writer)
+{
+    json_writer_close(this_writer, "]");
+}
+
+
+/**
+ * \fn      static void json_writer_append_escaped(struct strbuf *output, char *text)
+ * \details Append a string in double quotes, escaping whatever JSON requires to be escaped. Anything else, UTF-8 included, is passed
+ *          through as it is. Runs of ordinary characters are appended in one go.
+ */
+static void json_writer_append_escaped(struct strbuf *output, char *text)
+{
+    strbuf_append(output, "\"");
+    while (*text != '\0')
+    {
+        size_t run = 0;
+        while (text[run] != '\0' && text[run] != '"' && text[run] != '\\' && (unsigned char) text[run] >= 0x20)
+            run++;
+        strbuf_append_length(output, text, run);
+        text += run;
+        if (*text == '\0')
+            break;
+        switch (*text)
+        {
+            case '"': strbuf_append(output, "\\\""); break;
+            case '\\': strbuf_append(output, "\\\\"); break;
+            case '\n': strbuf_append(output, "\\n"); break;
+            case '\r': strbuf_append(output, "\\r"); break;
+            case '\t': strbuf_append(output, "\\t"); break;
+            default: strbuf_appendf(output, "\\u%04x", (unsigned char) *text);
+        }
+        text++;
+    }
+    strbuf_append(output, "\"");
+}
+
+
+/**
+ * \fn      void json_key(struct json_writer *this_writer, char *key)
+ * \details Write the key of an object's member. The member's value is whatever is written next.
+ * \param   this_writer A pointer to the json_writer in question.
+ * \param   key The key.
+ * \return  void
+ */
+void json_key(struct json_writer *this_writer, char *key)
+{
+    if (json_writer_start_value(this_writer) < 0)
+        return;
+    json_writer_append_escaped(this_writer->output, key);
+    strbuf_append(this_writer->output, ":");
+    this_writer->after_key = 1;
+}
+
+
+/**
+ * \fn      void json_string(struct json_writer *this_writer, char *value)
+ * \details Write a string value.
+ * \param   this_writer A pointer to the json_writer in question.
+ * \param   value The string. NULL is written as null.
+ * \return  void
+ */
+void json_string(struct json_writer *this_writer, char *value)
+{
+    if (json_writer_start_value(this_writer) < 0)
+        return;
+    if (value == NULL)
+        strbuf_append(this_writer->output, "null");
+    else
+        json_writer_append_escaped(this_writer->output, value);
+}
+
+
+/**
+ * \fn      void json_integer(struct json_writer *this_writer, long long value)
+ * \details Write an integer value.
+ * \param   this_writer A pointer to the json_writer in question.
+ * \param   value The integer.
+ * \return  void
+ */
+void json_integer(struct json_writer *this_writer, long long value)
+{
+    if (json_writer_start_value(this_writer) < 0)
+        return;
+    strbuf_appendf(this_writer->output, "%lld", value);
+}
+
+
+/**
+ * \fn      void json_key_string(struct json_writer *this_writer, char *key, char *value)
+ * \details Write an object member with a string value (NULL for null).
+ * \param   this_writer A pointer to the json_writer in question.
+ * \param   key The member's key.
+ * \param   value The member's value.
+ * \return  void
+ */
+void json_key_string(struct json_writer *this_writer, char *key, char *value)
+{
+    json_key(this_writer, key);
+    json_string(this_writer, value);
+}
+
+
+/**
+ * \fn      void json_key_integer(struct json_writer *this_writer, char *key, long long value)
+ * \details Write an object member with an integer value.
+ * \param   this_writer A pointer to the json_writer in question.
+ * \param   key The member's key.
+ * \param   value The member's value.
+ * \return  void
+ */
+void json_key_integer(struct json_writer *this_writer, char *key, long long value)
+{
+    json_key(this_writer, key);
+    json_integer(this_writer, value);
+}
+
+
+/**
+ * \fn      unsigned int json_fields_from_string(char *field_list)
+ * \details Work out which JSON_FIELD_* flags are wanted from a comma-separated list of their names, e.g. "status,value". The names are
+ *          "status", "value", "updated", "info" and "all". Anything else is ignored.
+ * \param   field_list The list.
+ * \return  The flags.
+ */
+unsigned int json_fields_from_string(char *field_list)
+{
+    static const struct {
+        char *name;
+        unsigned int flag;
+    } field_names[] = {
+        {"status", JSON_FIELD_STATUS},
+        {"value", JSON_FIELD_VALUE},
+        {"updated", JSON_FIELD_UPDATED},
+        {"info", JSON_FIELD_INFO},
+        {"all", JSON_FIELD_ALL},
+    };
+    unsigned int fields = 0;
+    while (*field_list != '\0')
+    {
+        size_t length = strcspn(field_list, ",");
+        size_t i;
+        for (i = 0; i < sizeof(field_names)/sizeof(*field_names); i++)
+        {
+            if (strlen(field_names[i].name) == length && !strncmp(field_list, field_names[i].name, length))
+                fields |= field_names[i].flag;
+        }
+        field_list += length;
+        if (*field_list == ',')
+            field_list++;
+    }
+    return fields;
+}
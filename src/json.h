@@ -0,0 +1,48 @@
+#ifndef _JSON_H_
+#define _JSON_H_
+
+#include "strbuf.h"
+
+/**
+ * \file  json.h
+ * \brief The json_writer type writes JSON straight into a strbuf as the model is walked, with nothing built up in between. It keeps
+ *        track of the nesting and puts the commas in; strings are escaped as they're written.
+ *
+ *        The model's *_json() functions take a set of JSON_FIELD_* flags saying which of their optional fields to write, so that a
+ *        client which only cares about statuses isn't sent values and serial numbers as well. Names are always written.
+ */
+
+/// Statuses, and the number of sensors with each status.
+#define JSON_FIELD_STATUS   0x01
+/// Sensor values.
+#define JSON_FIELD_VALUE    0x02
+/// When sensors last changed, and when an array was last heard from.
+#define JSON_FIELD_UPDATED  0x04
+/// Everything else: serial numbers, input streams, config files and the like.
+#define JSON_FIELD_INFO     0x08
+/// All of the above.
+#define JSON_FIELD_ALL      0x0f
+
+/// The deepest the nesting can go.
+#define JSON_WRITER_MAX_DEPTH 16
+
+struct json_writer;
+
+struct json_writer *json_writer_create(struct strbuf *output);
+void json_writer_destroy(struct json_writer *this_writer);
+int json_writer_has_failed(struct json_writer *this_writer);
+
+void json_begin_object(struct json_writer *this_writer);
+void json_end_object(struct json_writer *this_writer);
+void json_begin_array(struct json_writer *this_writer);
+void json_end_array(struct json_writer *this_writer);
+void json_key(struct json_writer *this_writer, char *key);
+void json_string(struct json_writer *this_writer, char *value);
+void json_integer(struct json_writer *this_writer, long long value);
+
+void json_key_string(struct json_writer *this_writer, char *key, char *value);
+void json_key_integer(struct json_writer *this_writer, char *key, long long value);
+
+unsigned int json_fields_from_string(char *field_list);
+
+#endif
@@ -0,0 +1,154 @@
+#include <stdlib.h>
+#include <string.h>
+#include <katcl.h>
+
+#include "katcp_dispatch.h"
+
+/// A cheap hash of a message name: its length and first character. It can be worked out at compile time, so the known names can be
+/// case labels. None of them share both, and a match is confirmed with strcmp anyway.
+#define KATCP_NAME_KEY(length, first) (((unsigned int) (length) << 8) | (unsigned char) (first))
+/// The key of a string literal, given its first character as well (which a case label can't take from the literal itself).
+#define KATCP_LITERAL_KEY(literal, first) KATCP_NAME_KEY(sizeof(literal) - 1, first)
+
+
+/**
+ * \fn      enum katcp_message_name katcp_message_name_lookup(char *name)
+ * \details Work out which message a name refers to. The switch is on a hash of the name, so at most one strcmp is done.
+ * \param   name The message's name, without the type character. May be NULL.
+ * \return  The message, KATCP_OTHER if it isn't one of the known ones.
+ */
+enum katcp_message_name katcp_message_name_lookup(char *name)
+{
+    if (name == NULL)
+        return KATCP_OTHER;
+
+    enum katcp_message_name candidate;
+    const char *candidate_string;
+    switch (KATCP_NAME_KEY(strlen(name), name[0]))
+    {
+        case KATCP_LITERAL_KEY("sensor-status", 's'):
+            candidate = KATCP_SENSOR_STATUS;
+            candidate_string = "sensor-status";
+            break;
+        case KATCP_LITERAL_KEY("sensor-value", 's'):
+            candidate = KATCP_SENSOR_VALUE;
+            candidate_string = "sensor-value";
+            break;
+        case KATCP_LITERAL_KEY("sensor-sampling", 's'):
+            candidate = KATCP_SENSOR_SAMPLING;
+            candidate_string = "sensor-sampling";
+            break;
+        case KATCP_LITERAL_KEY("sensor-list", 's'):
+            candidate = KATCP_SENSOR_LIST;
+            candidate_string = "sensor-list";
+            break;
+        case KATCP_LITERAL_KEY("log-local", 'l'):
+            candidate = KATCP_LOG_LOCAL;
+            candidate_string = "log-local";
+            break;
+        case KATCP_LITERAL_KEY("client-config", 'c'):
+            candidate = KATCP_CLIENT_CONFIG;
+            candidate_string = "client-config";
+            break;
+        case KATCP_LITERAL_KEY("array-list", 'a'):
+            candidate = KATCP_ARRAY_LIST;
+            candidate_string = "array-list";
+            break;
+        case KATCP_LITERAL_KEY("resource-list", 'r'):
+            candidate = KATCP_RESOURCE_LIST;
+            candidate_string = "resource-list";
+            break;
+        case KATCP_LITERAL_KEY("version-connect", 'v'):
+            candidate = KATCP_VERSION_CONNECT;
+            candidate_string = "version-connect";
+            break;
+        default:
+            return KATCP_OTHER;
+    }
+    return strcmp(name, candidate_string) ? KATCP_OTHER : candidate;
+}
+
+
+/**
+ * \fn      static char *katcp_dispatch_split_id(struct katcp_dispatch *message, char *name)
+ * \details Separate a message ID from the end of a message's name, e.g. "sensor-value[12]".
+ * \param   message The message in question. Its id is set, and its name_buffer used if there was an ID.
+ * \param   name The name, without the type character.
+ * \return  The name without the ID: either name itself, if there wasn't one, or the message's name_buffer.
+ */
+static char *katcp_dispatch_split_id(struct katcp_dispatch *message, char *name)
+{
+    message->id = -1;
+    char *bracket = strchr(name, '[');
+    if (bracket == NULL)
+        return name;
+
+    size_t name_length = (size_t) (bracket - name);
+    char *end;
+    long id = strtol(bracket + 1, &end, 10);
+    if (end == bracket + 1 || end[0] != ']' || end[1] != '\0' || id < 0 || name_length > KATCP_DISPATCH_NAME_SIZE)
+        return name; //Not an ID after all, leave it for the name lookup to reject.
+
+    memcpy(message->name_buffer, name, name_length);
+    message->name_buffer[name_length] = '\0';
+    message->id = id;
+    return message->name_buffer;
+}
+
+
+/**
+ * \fn      int katcp_dispatch_read(struct katcl_line *line, struct katcp_dispatch *message)
+ * \details Fetch the message which the katcl_line has just parsed (i.e. after have_katcl() has returned a positive number), asking
+ *          for each argument only once. A message ID is separated from the name.
+ * \param   line The katcl_line in question.
+ * \param   message Filled in with the message's type, name, ID and arguments.
+ * \return  0 on success, -1 if the line has no message or its name is missing.
+ */
+int katcp_dispatch_read(struct katcl_line *line, struct katcp_dispatch *message)
+{
+    unsigned int i;
+    message->argc = arg_count_katcl(line);
+    for (i = 0; i < KATCP_DISPATCH_MAX_ARGS; i++)
+        message->args[i] = i < message->argc ? arg_string_katcl(line, i) : NULL;
+
+    if (message->args[0] == NULL || message->args[0][0] == '\0')
+    {
+        message->type = '\0';
+        message->name = KATCP_OTHER;
+        message->name_string = "";
+        message->id = -1;
+        return -1;
+    }
+    message->type = message->args[0][0];
+    message->name_string = katcp_dispatch_split_id(message, message->args[0] + 1);
+    message->name = katcp_message_name_lookup(message->name_string);
+    return 0;
+}
+
+
+/**
+ * \fn      char *katcp_parse_host(char *sensor_name, char *host_type, size_t *host_number)
+ * \details Pick the host out of the front of a sensor name of the form "fhostNN.<rest>" or "xhostNN.<rest>", in place.
+ * \param   sensor_name The sensor name. It isn't modified.
+ * \param   host_type Set to the host's type, 'f' or 'x'.
+ * \param   host_number Set to the host's number.
+ * \return  A pointer to the rest of the name, after the dot, or NULL if the name doesn't start with a host.
+ */
+char *katcp_parse_host(char *sensor_name, char *host_type, size_t *host_number)
+{
+    if (sensor_name == NULL || (sensor_name[0] != 'f' && sensor_name[0] != 'x') || strncmp(sensor_name + 1, "host", 4))
+        return NULL;
+
+    char *c = sensor_name + 5;
+    if (*c < '0' || *c > '9')
+        return NULL;
+    size_t number = 0;
+    for (; *c >= '0' && *c <= '9'; c++)
+        number = number*10 + (size_t) (*c - '0');
+    if (*c != '.')
+        return NULL;
+
+    *host_type = sensor_name[0];
+    *host_number = number;
+    return c + 1;
+}
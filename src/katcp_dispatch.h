@@ -0,0 +1,60 @@
+#ifndef _KATCP_DISPATCH_H_
+#define _KATCP_DISPATCH_H_
+
+#include <stddef.h>
+#include <katcl.h>
+
+/**
+ * \file  katcp_dispatch.h
+ * \brief Helpers for handling received KATCP messages in a single pass. katcp_dispatch_read() fetches each argument of the message
+ *        from the katcl_line once, and works out which message it is from a hash of its name, so that handlers can switch on the
+ *        result instead of running strcmp chains and asking katcl for the same argument again and again. A message ID (the n in
+ *        "!name[n]"), if there is one, is separated from the name, so that replies can be matched to the requests which caused them.
+ *        The host part of a sensor name (e.g. "xhost03" in "xhost03.xeng.vacc.device-status") can be picked apart in place, without
+ *        copying.
+ */
+
+/// The longest message name which can be separated from a message ID, not counting the terminating NUL.
+#define KATCP_DISPATCH_NAME_SIZE 63
+
+/// The most arguments kept. KATCP sensor informs have six (name, timestamp, count, sensor name, status, value); anything past the
+/// limit can still be had from the katcl_line itself.
+#define KATCP_DISPATCH_MAX_ARGS 8
+
+/// The messages which something in the dashboard cares about. Anything else is KATCP_OTHER.
+enum katcp_message_name {
+    KATCP_OTHER,
+    KATCP_SENSOR_STATUS,
+    KATCP_SENSOR_VALUE,
+    KATCP_SENSOR_SAMPLING,
+    KATCP_SENSOR_LIST,
+    KATCP_LOG_LOCAL,
+    KATCP_CLIENT_CONFIG,
+    KATCP_ARRAY_LIST,
+    KATCP_RESOURCE_LIST,
+    KATCP_VERSION_CONNECT,
+};
+
+/// A received message, with its arguments. The strings belong to the katcl_line, and are only good until it parses the next line.
+struct katcp_dispatch {
+    /// The message type: '?' for a request, '!' for a reply or '#' for an inform.
+    char type;
+    /// Which message it is.
+    enum katcp_message_name name;
+    /// The message's name, without the type character or message ID.
+    char *name_string;
+    /// The message ID (the n in "!name[n]"), or -1 if the message didn't carry one.
+    long id;
+    /// Where the name is copied to if it has to be separated from a message ID. name_string points here in that case.
+    char name_buffer[KATCP_DISPATCH_NAME_SIZE + 1];
+    /// The number of arguments, including the name, as katcl counts them. May be more than KATCP_DISPATCH_MAX_ARGS.
+    unsigned int argc;
+    /// The arguments, with the name (type character and all) at 0. Any which weren't sent are NULL.
+    char *args[KATCP_DISPATCH_MAX_ARGS];
+};
+
+enum katcp_message_name katcp_message_name_lookup(char *name);
+int katcp_dispatch_read(struct katcl_line *line, struct katcp_dispatch *message);
+char *katcp_parse_host(char *sensor_name, char *host_type, size_t *host_number);
+
+#endif
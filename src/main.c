@@ -32,12 +32,17 @@
 #include "tokenise.h"
 #include "utils.h"
 #include "web.h"
+#include "reactor.h"
+#include "timers.h"
+#include "history.h"
+#include "pipeline.h"
+#include "sensor_template.h"
 
 #define BUF_SIZE 1024
+/// The memory set aside for sensor history, in MiB, unless another amount is given on the command line.
+#define DEFAULT_HISTORY_BUDGET_MIB 16
 #define CMC_CONFIG_FILE "/etc/cbf_sensor_dashboard/cmc_list.conf"
-/* This is handy for keeping track of the number of file descriptors. */
-#undef max
-#define max(x,y) ((x) > (y) ? (x) : (y))
+#define SENSOR_LIST_CONFIG_FILE "/etc/cbf_sensor_dashboard/sensor_list.conf"
 
 
 /********   SECTION    ***********
@@ -53,6 +58,8 @@ static char args_doc[] = "LISTEN_PORT";
 
 static struct argp_option options[] = {
   {"verbose",  'v', "VERBOS_LVL",      0,  "Level of verbosity for the output logs, according to rsyslog's standard levels." },
+  {"history-budget", 'H', "MIB",        0,  "Memory to set aside for the history of sensor changes, shared by all arrays (default 16 MiB)." },
+  {"request-window", 'w', "N",          0,  "Most KATCP requests to have in flight on each connection, if the server supports message IDs (default 32)." },
   { 0 }
 };
 
@@ -60,6 +67,8 @@ struct arguments
 {
   char *args[1];                /* only listen_port at the moment */
   int verbose;
+  size_t history_budget_mib;
+  size_t request_window;
 };
 
 static error_t parse_opt (int key, char *arg, struct argp_state *state)
@@ -74,6 +83,16 @@ static error_t parse_opt (int key, char *arg, struct argp_state *state)
       arguments->verbose = atoi(arg);
       break;
 
+    case 'H':
+      arguments->history_budget_mib = (size_t) strtoul(arg, NULL, 10);
+      break;
+
+    case 'w':
+      arguments->request_window = (size_t) strtoul(arg, NULL, 10);
+      if (arguments->request_window == 0)
+        argp_error (state, "The request window must be at least 1.");
+      break;
+
     case ARGP_KEY_ARG:
       if (state->arg_num >= 1)
         /* Too many arguments. */
@@ -129,6 +148,51 @@ static void handler(int signo)
 }
 
 
+/********   SECTION    ***********
+ * Accepting new web clients.
+ *********************************/
+
+/// What the listening socket's callback needs in order to hand new web clients their context.
+struct web_listener {
+    /// The reactor with which new clients get registered.
+    struct reactor *reactor;
+    /// The timers on which new clients' idle timeouts go.
+    struct timers *timers;
+    /// The program's list of cmc_servers.
+    struct cmc_server **cmc_list;
+    /// The number of cmc_servers in the list.
+    size_t num_cmcs;
+};
+
+static void web_listener_accept(struct reactor *this_reactor, int fd, uint32_t events, void *data)
+{
+    struct web_listener *listener = data;
+    unsigned int len;
+    struct sockaddr_in client_address;
+    memset(&client_address, 0, len = sizeof(client_address));
+    int r = accept(fd, (struct sockaddr *) &client_address, &len);
+    if (r == -1)
+    {
+        perror("accept()");
+        return;
+    }
+    //syslog(LOG_DEBUG, "Connection from %s:%u (FD %d)\n", inet_ntoa(client_address.sin_addr), client_address.sin_port, r);
+    if (web_client_create(r, this_reactor, listener->timers, listener->cmc_list, listener->num_cmcs) == NULL)
+    {
+        shutdown(r, SHUT_RDWR);
+        close(r);
+        syslog(LOG_ERR, "Unable to set up another web client.\n");
+    }
+}
+
+
+/// Called by the reactor every time it wakes up.
+static void refresh_clock(void *data)
+{
+    timers_update_clock(data);
+}
+
+
 /********   SECTION    ***********
  * main()
  *********************************/
@@ -182,6 +246,8 @@ int main(int argc, char **argv)
 
     struct arguments arguments;
     arguments.verbose = 0; //default
+    arguments.history_budget_mib = DEFAULT_HISTORY_BUDGET_MIB;
+    arguments.request_window = PIPELINE_DEFAULT_WINDOW;
     argp_parse (&argp, argc, argv, 0, 0, &arguments);
     setlogmask(LOG_UPTO(arguments.verbose));
 
@@ -196,6 +262,36 @@ int main(int argc, char **argv)
         return -1;
     }
 
+    struct reactor *reactor = reactor_create();
+    if (reactor == NULL)
+    {
+        syslog(LOG_CRIT, "Unable to create the reactor!");
+        return -1;
+    }
+    struct timers *timers = timers_create();
+    if (timers == NULL)
+    {
+        syslog(LOG_CRIT, "Unable to create the timers!");
+        return -1;
+    }
+    //Refresh the cached clock each time the reactor wakes up, so that everything done in one pass sees the same time.
+    reactor_set_wakeup_callback(reactor, refresh_clock, timers);
+    struct history_pool *history_pool = history_pool_create(arguments.history_budget_mib*1024*1024);
+    if (history_pool == NULL)
+    {
+        syslog(LOG_CRIT, "Unable to create the sensor history pool!");
+        return -1;
+    }
+    //Read once here, rather than every time an array is activated.
+    struct sensor_template *sensor_template = sensor_template_load(SENSOR_LIST_CONFIG_FILE);
+    if (sensor_template == NULL)
+    {
+        syslog(LOG_CRIT, "Unable to load the sensor list!");
+        return -1;
+    }
+    //Used for jittering the reconnection attempts, so it doesn't need to be anything special.
+    srandom((unsigned int) (time(0) ^ getpid()));
+
     struct cmc_server **cmc_list = NULL;
     size_t num_cmcs = 0;
     
@@ -222,7 +318,7 @@ int main(int argc, char **argv)
             }
             else
             {
-                temp[num_cmcs] = cmc_server_create(tokens[0], (uint16_t) atoi(tokens[1]));
+                temp[num_cmcs] = cmc_server_create(tokens[0], (uint16_t) atoi(tokens[1]), reactor, timers, history_pool, sensor_template, arguments.request_window);
                 if (temp[num_cmcs] == NULL)
                 {
                     perror("New CMC server allocation"); //Not sure if perror is appropriate here.
@@ -258,177 +354,46 @@ int main(int argc, char **argv)
      * setup web client management
      *********************************/
 
-    struct web_client **client_list = NULL;
-    size_t num_web_clients = 0;
+    //Web clients register themselves with the reactor when they're accepted, and destroy themselves when they disconnect.
+    struct web_listener listener = { reactor, timers, cmc_list, num_cmcs };
+    if (reactor_add(reactor, server_fd, REACTOR_READ, web_listener_accept, &listener) < 0)
+    {
+        syslog(LOG_CRIT, "Unable to watch listening socket!\n");
+        return -1;
+    }
 
     /********   SECTION    ***********
-     * select() loop
+     * event loop
      *********************************/
 
-    time_t last_array_list_poll = time(0);
-    struct timespec timeout;
-    timeout.tv_sec = 1;
-    timeout.tv_nsec = 0;
-
     while (!stop)
     {
-        //printf("new select() loop\n");
-        int nfds = 0;
-        fd_set rd, wr;
-
-        FD_ZERO(&rd);
-        FD_ZERO(&wr);
-
-        FD_SET(server_fd, &rd);
-        nfds = max(nfds, server_fd);
-
-        if ((time(0) - last_array_list_poll) >= 60) //check for a change
-        {
-            for (i = 0; i < num_cmcs; i++)
-                cmc_server_poll_array_list(cmc_list[i]);
-            last_array_list_poll = time(0);
-        }
-
         for (i = 0; i < num_cmcs; i++)
         {
             cmc_server_setup_katcp_writes(cmc_list[i]);
-            cmc_server_set_fds(cmc_list[i], &rd, &wr, &nfds);
         }
 
-        for (i = 0; i < num_web_clients; i++)
-        {
-            web_client_set_fds(client_list[i], &rd, &wr, &nfds);
-        }
-        
-        r = pselect(nfds + 1, &rd, &wr, NULL, &timeout, &orig_mask);
+        //Sleep until either a file descriptor is ready or the next timer is due. Periodic work all lives on the timers.
+        int timeout_ms = timers_next_expiry(timers);
+
+        //Only the file descriptors which are actually ready get handled, each by its owner's callback.
+        r = reactor_run_once(reactor, timeout_ms, &orig_mask);
 
         if (r == -1 && errno == EINTR)
             continue; // Just interrupted, not a problem.
 
         if (r < 0)
         {
-            syslog(LOG_CRIT, "pselect() error! Must exit now.");
-            perror("pselect()");
+            syslog(LOG_CRIT, "epoll_pwait() error! Must exit now.");
+            perror("epoll_pwait()");
             exit(EXIT_FAILURE);
         }
 
-        if (r == 0) //timeout
-        {
-            for (i = 0; i < num_cmcs; i++)
-            {
-                //This will only do something if it has disconnected.
-                cmc_server_try_reconnect(cmc_list[i]);
-            }
-        }
-
-        if (r > 0) 
-        {
-            //handle reads and writes from the CMC servers, to let them update anything that they need to.
-            //This will include the underlying arrays, which are on separate FDs (and ports) but at the same IP address.
-            for (i = 0; i < num_cmcs; i++)
-            {
-                cmc_server_socket_read_write(cmc_list[i], &rd, &wr);
-                cmc_server_handle_received_katcl_lines(cmc_list[i]);
-            }
-
-            //CMCs have been polled for their arrays at this point, set up the aggregator
-            struct cmc_aggregator* cmc_agg = cmc_aggregator_create(cmc_list, num_cmcs);
-            
-            //Check with the web server to see if a new client wants to connect.
-            if (FD_ISSET(server_fd, &rd))
-            {
-                unsigned int len;
-                struct sockaddr_in client_address;
-                memset(&client_address, 0, len = sizeof(client_address));
-                r = accept(server_fd, (struct sockaddr *) &client_address, &len);
-                if (r == -1)
-                {
-                    perror("accept()");
-                }
-                else
-                {
-                    //syslog(LOG_DEBUG, "Connection from %s:%u (FD %d)\n", inet_ntoa(client_address.sin_addr), client_address.sin_port, r);
-                    struct web_client **temp = realloc(client_list, sizeof(*client_list)*(num_web_clients + 1));
-                    if (temp)
-                    {
-                        client_list = temp;
-                        client_list[num_web_clients] = web_client_create(r);
-                        num_web_clients++;
-                    }
-                    else
-                    {
-                        shutdown(r, SHUT_RDWR);
-                        close(r);
-                        perror("realloc");
-                        syslog(LOG_ERR, "Unable to allocate memory for another web client.\n");
-                    }
-                }
-            }
-
-            //Handle the web clients that have sent us stuff.
-            for (i = 0; i < num_web_clients; i++)
-            {
-                r = web_client_socket_read(client_list[i], &rd);
-                
-                if (r < 0)
-                {
-                    web_client_destroy(client_list[i]);
-                    if (num_web_clients == 1)
-                    {
-                        free(client_list);
-                        client_list = NULL;
-                        num_web_clients = 0;
-                    }
-                    else
-                    {
-                        memmove(&client_list[i], &client_list[i+1], sizeof(*client_list)*(num_web_clients - i - 1));
-                        client_list = realloc(client_list, sizeof(*client_list)*(num_web_clients - 1));
-                        num_web_clients--;
-                        i--;
-                    }
-                }
-                else
-                {
-                    //TODO handle requests.
-                    web_client_handle_requests(client_list[i], cmc_list, num_cmcs, cmc_agg);
-                }
-            }
-            
-            cmc_aggregator_destroy(cmc_agg);
-
-           //Handle web clients that we want to write to.
-           //Looping through list a second time because number may have changed, some of them may have disconnected.
-           //Prevents segfaults.
-           for (i = 0; i < num_web_clients; i++)
-           {
-               r = web_client_socket_write(client_list[i], &wr);
-
-                if (r < 0)
-                {
-                    web_client_destroy(client_list[i]);
-                    if (num_web_clients == 1)
-                    {
-                        free(client_list);
-                        client_list = NULL;
-                        num_web_clients = 0;
-                    }
-                    else
-                    {
-                        memmove(&client_list[i], &client_list[i+1], sizeof(*client_list)*(num_web_clients - i - 1));
-                        struct web_client **temp = realloc(client_list, sizeof(*client_list)*(num_web_clients - 1));
-                        if (temp)
-                        {
-                            client_list = temp;
-                            num_web_clients--;
-                            i--;
-                        }
-                    }
-                }
-            }
-        }
+        //Reconnection attempts, array-list polls and the like.
+        timers_run(timers);
     }
 
-    syslog(LOG_INFO, "Exited select loop.");
+    syslog(LOG_INFO, "Exited event loop.");
     /********   SECTION    ***********
      * cleanup
      *********************************/
@@ -438,6 +403,12 @@ int main(int argc, char **argv)
     }
     free(cmc_list);
     cmc_list = NULL;
+    reactor_remove(reactor, server_fd);
+    close(server_fd);
+    reactor_destroy(reactor);
+    timers_destroy(timers);
+    history_pool_destroy(history_pool);
+    sensor_template_destroy(sensor_template);
     syslog(LOG_INFO, "Cleanup complete.");
 
     closelog();
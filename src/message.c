@@ -2,9 +2,14 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdarg.h>
+#include <stdint.h>
 
 #include "message.h"
 
+/// FNV-1a parameters, 64-bit flavour.
+#define FNV_OFFSET_BASIS 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
 /// A struct to hold a list of words to compose a KATCP message with.
 struct message {
     /// ? (request), ! (reply) or # (inform), but for the purposes we'll probably just be using ?.
@@ -46,11 +51,6 @@ void message_destroy(struct message *this_message)
 {
     if (this_message != NULL)
     {
-        {
-            char *composed_message = message_compose(this_message);
-            free(composed_message);
-            composed_message = NULL;
-        }
         size_t i;
         for (i = 0; i < this_message->number_of_words; i++)
             free(this_message->word_list[i]);
@@ -151,14 +151,62 @@ char *message_compose(struct message *this_message)
     }
     message_length++; //null character
     char *composed_message = malloc(message_length);
-    sprintf(composed_message, "%c%s", this_message->message_type, this_message->word_list[0]);
+    if (composed_message == NULL)
+        return NULL;
+    //The length worked out above is enough for all the words, so they can be copied straight in.
+    char *end = composed_message + sprintf(composed_message, "%c%s", this_message->message_type, this_message->word_list[0]);
     for (i = 1; i < this_message->number_of_words; i++)
     {
-        composed_message = realloc(composed_message, strlen(composed_message) + strlen(this_message->word_list[i]) + 1);
-        strcat(composed_message, " ");
-        strcat(composed_message, this_message->word_list[i]);
+        end += sprintf(end, " %s", this_message->word_list[i]);
     }
-    composed_message[message_length - 2] = '\0'; //to remove the trailiing space
 
     return composed_message;
 }
+
+
+/**
+ * \fn      uint64_t message_digest(struct message *this_message)
+ * \details Hash the message's type and words with FNV-1a, without composing it. Messages which are equal (see message_equal()) have
+ *          the same digest.
+ * \param   this_message A pointer to the message in question.
+ * \return  The digest.
+ */
+uint64_t message_digest(struct message *this_message)
+{
+    uint64_t hash = FNV_OFFSET_BASIS;
+    hash ^= (unsigned char) this_message->message_type;
+    hash *= FNV_PRIME;
+    size_t i;
+    for (i = 0; i < this_message->number_of_words; i++)
+    {
+        unsigned char *c;
+        for (c = (unsigned char *) this_message->word_list[i]; *c != '\0'; c++)
+        {
+            hash ^= *c;
+            hash *= FNV_PRIME;
+        }
+        hash *= FNV_PRIME; //Hashing the terminating NUL too, so that "ab c" and "a bc" come out differently.
+    }
+    return hash;
+}
+
+
+/**
+ * \fn      int message_equal(struct message *first_message, struct message *second_message)
+ * \details Check whether two messages are the same, i.e. of the same type and with the same words, without composing them.
+ * \param   first_message A pointer to one message.
+ * \param   second_message A pointer to the other.
+ * \return  1 if they are the same, 0 otherwise.
+ */
+int message_equal(struct message *first_message, struct message *second_message)
+{
+    if (first_message->message_type != second_message->message_type || first_message->number_of_words != second_message->number_of_words)
+        return 0;
+    size_t i;
+    for (i = 0; i < first_message->number_of_words; i++)
+    {
+        if (strcmp(first_message->word_list[i], second_message->word_list[i]))
+            return 0;
+    }
+    return 1;
+}
@@ -1,6 +1,8 @@
 #ifndef _MESSAGE_H_
 #define _MESSAGE_H_
 
+#include <stdint.h>
+
 
 /**
  * \file  message.h
@@ -19,5 +21,7 @@ int message_add_word(struct message *this_message, char *new_word);
 char *message_see_word(struct message *this_message, size_t this_word);
 int message_get_number_of_words(struct message *this_message);
 char *message_compose(struct message *this_message);
+uint64_t message_digest(struct message *this_message);
+int message_equal(struct message *first_message, struct message *second_message);
 
 #endif
@@ -0,0 +1,384 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <syslog.h>
+#include <katcp.h>
+#include <katcl.h>
+
+#include "pipeline.h"
+#include "message.h"
+#include "queue.h"
+#include "katcp_dispatch.h"
+
+/// Room for the first word of a request: type character, name and "[id]".
+#define PIPELINE_FIRST_WORD_SIZE (KATCP_DISPATCH_NAME_SIZE + 16)
+
+
+/// A request which has been sent and is waiting for its reply.
+struct pipeline_entry {
+    /// The ID with which the request was sent, 0 if it was sent without one.
+    unsigned long id;
+    /// The request itself.
+    struct message *message;
+};
+
+
+/// A struct to keep track of the requests in flight on one KATCP connection.
+struct pipeline {
+    /// The most requests which may be in flight at once, if the server supports message IDs.
+    size_t window;
+    /// The requests in flight, oldest first.
+    struct pipeline_entry *entries;
+    /// The number of requests in flight.
+    size_t in_flight;
+    /// Whether the server has said that it supports message IDs.
+    int use_ids;
+    /// The ID which the next request will be sent with. IDs start at 1 and aren't reused on the same connection.
+    unsigned long next_id;
+    /// Whether the server has said that it supports bulk sensor sampling.
+    int use_bulk;
+    /// Sensor-sampling requests split out of a bulk request which failed. They're sent individually, ahead of the outgoing queue, so
+    /// that the one which caused the failure doesn't take the rest down with it again.
+    struct queue *retry_queue;
+};
+
+
+/**
+ * \fn      struct pipeline *pipeline_create(size_t window)
+ * \details Allocate memory for a pipeline. Message IDs aren't used until the server says that it supports them.
+ * \param   window The most requests to have in flight at once when message IDs are in use. At least 1.
+ * \return  A pointer to the newly-created pipeline, NULL on failure.
+ */
+struct pipeline *pipeline_create(size_t window)
+{
+    struct pipeline *new_pipeline = malloc(sizeof(*new_pipeline));
+    if (new_pipeline != NULL)
+    {
+        new_pipeline->window = window ? window : 1;
+        new_pipeline->entries = malloc(sizeof(*(new_pipeline->entries))*new_pipeline->window);
+        new_pipeline->retry_queue = queue_create();
+        if (new_pipeline->entries == NULL || new_pipeline->retry_queue == NULL)
+        {
+            free(new_pipeline->entries);
+            queue_destroy(new_pipeline->retry_queue);
+            free(new_pipeline);
+            return NULL;
+        }
+        new_pipeline->in_flight = 0;
+        new_pipeline->use_ids = 0;
+        new_pipeline->use_bulk = 0;
+        new_pipeline->next_id = 1;
+    }
+    return new_pipeline;
+}
+
+
+/**
+ * \fn      void pipeline_destroy(struct pipeline *this_pipeline)
+ * \details Free the memory associated with the pipeline, and the requests still in flight.
+ * \param   this_pipeline A pointer to the pipeline to be destroyed.
+ * \return  void
+ */
+void pipeline_destroy(struct pipeline *this_pipeline)
+{
+    if (this_pipeline != NULL)
+    {
+        pipeline_reset(this_pipeline);
+        free(this_pipeline->entries);
+        queue_destroy(this_pipeline->retry_queue);
+        free(this_pipeline);
+    }
+}
+
+
+/**
+ * \fn      void pipeline_reset(struct pipeline *this_pipeline)
+ * \details Forget about the requests in flight (and any waiting to be retried), and go back to one at a time without message IDs or
+ *          bulk requests. For a new connection, on which whatever was in flight on the last one will never be replied to, and the server
+ *          might be a different version.
+ * \param   this_pipeline A pointer to the pipeline in question.
+ * \return  void
+ */
+void pipeline_reset(struct pipeline *this_pipeline)
+{
+    size_t i;
+    for (i = 0; i < this_pipeline->in_flight; i++)
+        message_destroy(this_pipeline->entries[i].message);
+    while (queue_sizeof(this_pipeline->retry_queue))
+        message_destroy(queue_pop(this_pipeline->retry_queue));
+    this_pipeline->in_flight = 0;
+    this_pipeline->use_ids = 0;
+    this_pipeline->use_bulk = 0;
+    this_pipeline->next_id = 1;
+}
+
+
+/**
+ * \fn      void pipeline_handle_version_connect(struct pipeline *this_pipeline, struct katcp_dispatch *inform)
+ * \details Look at a #version-connect inform for the KATCP protocol version, which servers send on every new connection, and start
+ *          using message IDs if the server supports them. That's KATCP v5 or later with the I flag, e.g. "5.0-MI". Bulk sensor sampling
+ *          needs v5.1 or later with the B flag, e.g. "5.1-MIB".
+ * \param   this_pipeline A pointer to the pipeline in question.
+ * \param   inform The #version-connect inform. Those for anything other than katcp-protocol are ignored.
+ * \return  void
+ */
+void pipeline_handle_version_connect(struct pipeline *this_pipeline, struct katcp_dispatch *inform)
+{
+    if (inform->args[1] == NULL || strcmp(inform->args[1], "katcp-protocol") || inform->args[2] == NULL)
+        return;
+
+    int major = 0, minor = 0;
+    sscanf(inform->args[2], "%d.%d", &major, &minor);
+    char *flags = strchr(inform->args[2], '-');
+    this_pipeline->use_ids = major >= 5 && flags != NULL && strchr(flags, 'I') != NULL;
+    this_pipeline->use_bulk = (major > 5 || (major == 5 && minor >= 1)) && flags != NULL && strchr(flags, 'B') != NULL;
+    syslog(LOG_DEBUG, "KATCP protocol %s, %s%s.", inform->args[2],
+            this_pipeline->use_ids ? "pipelining requests with message IDs" : "sending requests one at a time",
+            this_pipeline->use_bulk ? ", bulk sensor sampling" : "");
+}
+
+
+/**
+ * \fn      int pipeline_uses_ids(struct pipeline *this_pipeline)
+ * \details Check whether requests are being sent with message IDs.
+ * \param   this_pipeline A pointer to the pipeline in question.
+ * \return  1 if they are, 0 otherwise.
+ */
+int pipeline_uses_ids(struct pipeline *this_pipeline)
+{
+    return this_pipeline->use_ids;
+}
+
+
+/**
+ * \fn      int pipeline_uses_bulk(struct pipeline *this_pipeline)
+ * \details Check whether sensor-sampling requests are being combined into bulk requests.
+ * \param   this_pipeline A pointer to the pipeline in question.
+ * \return  1 if they are, 0 otherwise.
+ */
+int pipeline_uses_bulk(struct pipeline *this_pipeline)
+{
+    return this_pipeline->use_bulk;
+}
+
+
+/**
+ * \fn      size_t pipeline_get_in_flight(struct pipeline *this_pipeline)
+ * \details Get the number of requests which have been sent but not yet replied to.
+ * \param   this_pipeline A pointer to the pipeline in question.
+ * \return  The number of requests in flight.
+ */
+size_t pipeline_get_in_flight(struct pipeline *this_pipeline)
+{
+    return this_pipeline->in_flight;
+}
+
+
+/**
+ * \fn      static int pipeline_append_message(struct katcl_line *line, struct message *this_message, unsigned long id)
+ * \details Insert a message into the katcl_line, word for word.
+ * \param   line The katcl_line in question.
+ * \param   this_message The message to be sent.
+ * \param   id The message ID to tag the message with, 0 for none.
+ * \return  0 on success, -1 if the message can't be sent.
+ */
+static int pipeline_append_message(struct katcl_line *line, struct message *this_message, unsigned long id)
+{
+    int n = message_get_number_of_words(this_message);
+    if (n <= 0)
+        return -1;
+
+    char first_word[PIPELINE_FIRST_WORD_SIZE];
+    int length;
+    if (id)
+        length = snprintf(first_word, sizeof(first_word), "%c%s[%lu]", message_get_type(this_message), message_see_word(this_message, 0), id);
+    else
+        length = snprintf(first_word, sizeof(first_word), "%c%s", message_get_type(this_message), message_see_word(this_message, 0));
+    if (length < 0 || (size_t) length >= sizeof(first_word))
+        return -1;
+
+    if (n == 1)
+        append_string_katcl(line, KATCP_FLAG_FIRST | KATCP_FLAG_LAST, first_word);
+    else
+    {
+        append_string_katcl(line, KATCP_FLAG_FIRST, first_word);
+        size_t j;
+        for (j = 1; j < (size_t) n - 1; j++)
+        {
+            append_string_katcl(line, 0, message_see_word(this_message, j));
+        }
+        append_string_katcl(line, KATCP_FLAG_LAST, message_see_word(this_message, (size_t) n - 1));
+    }
+    return 0;
+}
+
+
+/**
+ * \fn      static int pipeline_can_batch(struct message *this_message, struct message *first_message)
+ * \details Check whether a request can go into a bulk request: it has to be a ?sensor-sampling for a single sensor, with the same
+ *          strategy as the first request in the batch.
+ * \param   this_message The request in question.
+ * \param   first_message The first request in the batch, or NULL if this_message would be the first.
+ * \return  1 if it can, 0 otherwise.
+ */
+static int pipeline_can_batch(struct message *this_message, struct message *first_message)
+{
+    if (message_get_type(this_message) != '?' || message_get_number_of_words(this_message) != 3)
+        return 0;
+    if (strcmp(message_see_word(this_message, 0), "sensor-sampling") || strchr(message_see_word(this_message, 1), ',') != NULL)
+        return 0;
+    return first_message == NULL || !strcmp(message_see_word(this_message, 2), message_see_word(first_message, 2));
+}
+
+
+/**
+ * \fn      static struct message *pipeline_batch(struct queue *outgoing_queue, struct message *first_message)
+ * \details Take as many of the requests waiting at the front of the queue as can go in the same bulk request as the first one, and
+ *          combine them, e.g. "?sensor-sampling a,b,c auto".
+ * \param   outgoing_queue The queue of messages waiting to be sent.
+ * \param   first_message The request which has just been popped off the front of the queue.
+ * \return  The bulk request, which replaces the ones which went into it, or first_message as it was if nothing could be combined.
+ */
+static struct message *pipeline_batch(struct queue *outgoing_queue, struct message *first_message)
+{
+    if (!pipeline_can_batch(first_message, NULL) || queue_peek(outgoing_queue) == NULL || !pipeline_can_batch(queue_peek(outgoing_queue), first_message))
+        return first_message;
+
+    size_t capacity = 1024;
+    char *names = malloc(capacity);
+    if (names == NULL)
+        return first_message;
+    size_t length = (size_t) sprintf(names, "%s", message_see_word(first_message, 1));
+
+    size_t n;
+    for (n = 1; n < PIPELINE_BULK_MAX && queue_peek(outgoing_queue) != NULL && pipeline_can_batch(queue_peek(outgoing_queue), first_message); n++)
+    {
+        char *name = message_see_word(queue_peek(outgoing_queue), 1);
+        size_t needed = length + 1 + strlen(name) + 1;
+        if (needed > capacity)
+        {
+            char *temp = realloc(names, 2*needed);
+            if (temp == NULL)
+                break;
+            names = temp;
+            capacity = 2*needed;
+        }
+        length += (size_t) sprintf(names + length, ",%s", name);
+        message_destroy(queue_pop(outgoing_queue));
+    }
+
+    struct message *bulk_message = message_create('?');
+    message_add_word(bulk_message, "sensor-sampling");
+    message_add_word(bulk_message, names);
+    message_add_word(bulk_message, message_see_word(first_message, 2));
+    free(names);
+    message_destroy(first_message);
+    return bulk_message;
+}
+
+
+/**
+ * \fn      size_t pipeline_fill(struct pipeline *this_pipeline, struct queue *outgoing_queue, struct katcl_line *line)
+ * \details Move messages from the front of the queue into the katcl_line, until the queue is empty or the window is full. Requests
+ *          waiting to be retried after a failed bulk request go first. The katcl_line still has to be flushed to the file descriptor
+ *          afterwards.
+ * \param   this_pipeline A pointer to the pipeline in question.
+ * \param   outgoing_queue The queue of messages waiting to be sent.
+ * \param   line The katcl_line for the connection.
+ * \return  The number of messages sent.
+ */
+size_t pipeline_fill(struct pipeline *this_pipeline, struct queue *outgoing_queue, struct katcl_line *line)
+{
+    size_t window = this_pipeline->use_ids ? this_pipeline->window : 1;
+    size_t sent = 0;
+    while (this_pipeline->in_flight < window && (queue_sizeof(this_pipeline->retry_queue) || queue_sizeof(outgoing_queue)))
+    {
+        struct message *this_message;
+        if (queue_sizeof(this_pipeline->retry_queue))
+            this_message = queue_pop(this_pipeline->retry_queue);
+        else
+        {
+            this_message = queue_pop(outgoing_queue);
+            if (this_pipeline->use_bulk)
+                this_message = pipeline_batch(outgoing_queue, this_message);
+        }
+        unsigned long id = this_pipeline->use_ids ? this_pipeline->next_id++ : 0;
+        if (pipeline_append_message(line, this_message, id) < 0)
+        {
+            char *composed_message = message_compose(this_message);
+            syslog(LOG_WARNING, "Could not send [%s], dropping it.", composed_message ? composed_message : "");
+            free(composed_message);
+            message_destroy(this_message);
+            continue;
+        }
+        this_pipeline->entries[this_pipeline->in_flight].id = id;
+        this_pipeline->entries[this_pipeline->in_flight].message = this_message;
+        this_pipeline->in_flight++;
+        sent++;
+    }
+    return sent;
+}
+
+
+/**
+ * \fn      struct message *pipeline_complete(struct pipeline *this_pipeline, struct katcp_dispatch *reply)
+ * \details Find the request to which a reply belongs, and take it out of the pipeline. A reply with an ID is matched by ID; one
+ *          without is matched to the oldest request of the same name.
+ * \param   this_pipeline A pointer to the pipeline in question.
+ * \param   reply The reply which has been received.
+ * \return  The request, which now belongs to the caller, or NULL if the reply doesn't match anything in flight.
+ */
+struct message *pipeline_complete(struct pipeline *this_pipeline, struct katcp_dispatch *reply)
+{
+    size_t i;
+    for (i = 0; i < this_pipeline->in_flight; i++)
+    {
+        struct pipeline_entry *entry = &this_pipeline->entries[i];
+        if (reply->id >= 0 ? entry->id == (unsigned long) reply->id : !strcmp(message_see_word(entry->message, 0), reply->name_string))
+        {
+            struct message *this_message = entry->message;
+            memmove(entry, entry + 1, sizeof(*entry)*(this_pipeline->in_flight - i - 1));
+            this_pipeline->in_flight--;
+            return this_message;
+        }
+    }
+    return NULL;
+}
+
+
+/**
+ * \fn      size_t pipeline_split(struct pipeline *this_pipeline, struct message *failed_request)
+ * \details Deal with a bulk request which failed. The whole request fails if any one of its sensors can't be sampled, so it's split
+ *          back into single requests, which are sent ahead of anything else on the queue. Those can then fail (or not) on their own.
+ * \param   this_pipeline A pointer to the pipeline in question.
+ * \param   failed_request A request which got a fail reply, from pipeline_complete().
+ * \return  The number of requests which it was split into, in which case the pipeline has taken care of it. 0 if it wasn't a bulk
+ *          request, in which case it still belongs to the caller.
+ */
+size_t pipeline_split(struct pipeline *this_pipeline, struct message *failed_request)
+{
+    if (message_get_number_of_words(failed_request) == 3 && !strcmp(message_see_word(failed_request, 0), "sensor-sampling")
+            && strchr(message_see_word(failed_request, 1), ',') != NULL)
+    {
+        char *names = strdup(message_see_word(failed_request, 1));
+        if (names == NULL)
+            return 0;
+        size_t n = 0;
+        char *name;
+        char *saveptr;
+        for (name = strtok_r(names, ",", &saveptr); name != NULL; name = strtok_r(NULL, ",", &saveptr))
+        {
+            struct message *new_message = message_create('?');
+            message_add_word(new_message, "sensor-sampling");
+            message_add_word(new_message, name);
+            message_add_word(new_message, message_see_word(failed_request, 2));
+            queue_push(this_pipeline->retry_queue, new_message);
+            n++;
+        }
+        free(names);
+        syslog(LOG_INFO, "Bulk sensor-sampling request failed, retrying its %zu sensors one by one.", n);
+        message_destroy(failed_request);
+        return n;
+    }
+    return 0;
+}
@@ -0,0 +1,43 @@
+#ifndef _PIPELINE_H_
+#define _PIPELINE_H_
+
+#include <stddef.h>
+#include <katcl.h>
+
+#include "message.h"
+#include "queue.h"
+#include "katcp_dispatch.h"
+
+/**
+ * \file  pipeline.h
+ * \brief The pipeline type keeps track of the requests which have been sent on a KATCP connection and not yet replied to. If the
+ *        server supports message IDs (which it says in its #version-connect katcp-protocol inform), each request is tagged with an
+ *        ID, e.g. "?sensor-sampling[12] ...", and up to a window's worth are sent without waiting for replies, which are matched to
+ *        their requests by ID. Otherwise only one request is outstanding at a time, and the reply is matched by name, as before.
+ *
+ *        If the server also supports bulk sensor sampling (KATCP v5.1 with the B flag), consecutive ?sensor-sampling requests with the
+ *        same strategy are sent as one, with the sensor names separated by commas, so that a family such as the n-squared
+ *        missing-pkts counters costs a handful of requests rather than thousands. The servlet still sends a #sensor-status for each.
+ */
+
+/// The number of requests allowed in flight on each connection, unless another number is given on the command line.
+#define PIPELINE_DEFAULT_WINDOW 32
+/// The most sensors to name in one bulk ?sensor-sampling request.
+#define PIPELINE_BULK_MAX 256
+
+struct pipeline;
+
+struct pipeline *pipeline_create(size_t window);
+void pipeline_destroy(struct pipeline *this_pipeline);
+void pipeline_reset(struct pipeline *this_pipeline);
+
+void pipeline_handle_version_connect(struct pipeline *this_pipeline, struct katcp_dispatch *inform);
+int pipeline_uses_ids(struct pipeline *this_pipeline);
+int pipeline_uses_bulk(struct pipeline *this_pipeline);
+size_t pipeline_get_in_flight(struct pipeline *this_pipeline);
+
+size_t pipeline_fill(struct pipeline *this_pipeline, struct queue *outgoing_queue, struct katcl_line *line);
+struct message *pipeline_complete(struct pipeline *this_pipeline, struct katcp_dispatch *reply);
+size_t pipeline_split(struct pipeline *this_pipeline, struct message *failed_request);
+
+#endif
@@ -1,17 +1,38 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdint.h>
 #include <syslog.h>
 
 #include "message.h"
 #include "queue.h"
 
+/// The number of messages that a new queue has room for before it needs to grow. Must be a power of two.
+#define QUEUE_INITIAL_CAPACITY 16
+
+
+/// A message on the queue, along with its digest so that it can be found in the set again when it's popped.
+struct queue_entry {
+    /// The digest of the message, from message_digest().
+    uint64_t digest;
+    /// The message itself. A NULL message means that a slot in the set is empty.
+    struct message *message;
+};
+
+
 /// A struct to hold a list of messages.
 struct queue {
-    /// An array of message pointers.
-    struct message **message_queue;
-    /// The number of messages currently on the array.
+    /// A ring buffer of the messages, in the order in which they'll be popped.
+    struct queue_entry *ring;
+    /// The number of entries in the ring, always a power of two.
+    size_t capacity;
+    /// Where the front of the queue is in the ring.
+    size_t head;
+    /// The number of messages currently on the queue.
     size_t queue_length;
+    /// The same messages again, hashed by digest so that duplicates can be spotted without looking through the whole queue.
+    /// Collisions are resolved by linear probing. It has twice as many slots as the ring, so it's never more than half full.
+    struct queue_entry *set;
 };
 
 
@@ -25,8 +46,18 @@ struct queue *queue_create()
     struct queue *new_queue = malloc(sizeof(*new_queue));
     if (new_queue != NULL)
     {
+        new_queue->ring = malloc(sizeof(*(new_queue->ring))*QUEUE_INITIAL_CAPACITY);
+        new_queue->set = calloc(2*QUEUE_INITIAL_CAPACITY, sizeof(*(new_queue->set)));
+        if (new_queue->ring == NULL || new_queue->set == NULL)
+        {
+            free(new_queue->ring);
+            free(new_queue->set);
+            free(new_queue);
+            return NULL;
+        }
+        new_queue->capacity = QUEUE_INITIAL_CAPACITY;
+        new_queue->head = 0;
         new_queue->queue_length = 0;
-        new_queue->message_queue = NULL; /*otherwise the kraken comes...*/
     }
     return new_queue;
 }
@@ -45,20 +76,96 @@ void queue_destroy(struct queue *this_queue)
         size_t i;
         for (i = 0; i < this_queue->queue_length; i++)
         {
-            message_destroy(this_queue->message_queue[i]);
+            message_destroy(this_queue->ring[(this_queue->head + i) & (this_queue->capacity - 1)].message);
         }
-        if (this_queue->message_queue != NULL)
-            free(this_queue->message_queue);
-        this_queue->message_queue = NULL;
+        free(this_queue->ring);
+        free(this_queue->set);
         free(this_queue);
         this_queue = NULL;
     }
 }
 
 
+/**
+ * \fn      static struct queue_entry *queue_set_probe(struct queue_entry *set, size_t number_of_slots, uint64_t digest, struct message *this_message)
+ * \details Find the slot in the set which holds a message equal to the given one, or the empty slot where it would go if there isn't one.
+ */
+static struct queue_entry *queue_set_probe(struct queue_entry *set, size_t number_of_slots, uint64_t digest, struct message *this_message)
+{
+    size_t mask = number_of_slots - 1;
+    size_t i = (size_t) digest & mask;
+    while (set[i].message != NULL)
+    {
+        if (set[i].digest == digest && message_equal(set[i].message, this_message))
+            break;
+        i = (i + 1) & mask;
+    }
+    return &set[i];
+}
+
+
+/**
+ * \fn      static void queue_set_remove(struct queue *this_queue, struct queue_entry *slot)
+ * \details Empty a slot in the set, then move back any later entries in the same run which would no longer be found past the gap.
+ *          That way there's no need for tombstones.
+ */
+static void queue_set_remove(struct queue *this_queue, struct queue_entry *slot)
+{
+    size_t mask = 2*this_queue->capacity - 1;
+    size_t gap = (size_t) (slot - this_queue->set);
+    size_t i = gap;
+    this_queue->set[gap].message = NULL;
+    for (i = (i + 1) & mask; this_queue->set[i].message != NULL; i = (i + 1) & mask)
+    {
+        size_t home = (size_t) this_queue->set[i].digest & mask;
+        //The entry can fill the gap unless its home slot lies (cyclically) after the gap and at or before where it is now.
+        if (((i - home) & mask) >= ((i - gap) & mask))
+        {
+            this_queue->set[gap] = this_queue->set[i];
+            this_queue->set[i].message = NULL;
+            gap = i;
+        }
+    }
+}
+
+
+/**
+ * \fn      static int queue_grow(struct queue *this_queue)
+ * \details Double the size of the ring (unwrapping it in the process) and of the set, and move everything across.
+ * \return  0 on success, -1 if there was no memory, in which case the queue is unchanged.
+ */
+static int queue_grow(struct queue *this_queue)
+{
+    size_t new_capacity = 2*this_queue->capacity;
+    struct queue_entry *new_ring = malloc(sizeof(*new_ring)*new_capacity);
+    struct queue_entry *new_set = calloc(2*new_capacity, sizeof(*new_set));
+    if (new_ring == NULL || new_set == NULL)
+    {
+        free(new_ring);
+        free(new_set);
+        return -1;
+    }
+
+    size_t i;
+    for (i = 0; i < this_queue->queue_length; i++)
+    {
+        new_ring[i] = this_queue->ring[(this_queue->head + i) & (this_queue->capacity - 1)];
+        *queue_set_probe(new_set, 2*new_capacity, new_ring[i].digest, new_ring[i].message) = new_ring[i];
+    }
+    free(this_queue->ring);
+    free(this_queue->set);
+    this_queue->ring = new_ring;
+    this_queue->set = new_set;
+    this_queue->capacity = new_capacity;
+    this_queue->head = 0;
+    return 0;
+}
+
+
 /**
  * \fn      int queue_push(struct queue *this_queue, struct message *new_message)
- * \details Push a message onto the end of the queue.
+ * \details Push a message onto the end of the queue, which takes ownership of it. If an identical message is already waiting on the
+ *          queue, the new one is destroyed instead, because there's no need to be sending duplicates.
  * \param   this_queue A pointer to the queue in question.
  * \param   new_message A pointer to a (previously composed) message to be pushed onto the queue.
  * \return  An integer indicating the outcome of the operation.
@@ -79,41 +186,31 @@ int queue_push(struct queue *this_queue, struct message *new_message)
         return -2; /// \retval -2 Operation failed: the message was NULL.
     }
 
-    // First we're going to check whether the message already exists on the queue. No need to be sending duplicates.
-    size_t i;
-    for (i = 0; i < this_queue->queue_length; i++)
+    uint64_t digest = message_digest(new_message);
+    struct queue_entry *slot = queue_set_probe(this_queue->set, 2*this_queue->capacity, digest, new_message);
+    if (slot->message != NULL)
     {
-        char *already_queued = message_compose(this_queue->message_queue[i]);
-        char *composed_new_message = message_compose(new_message);
-        if (!strcmp(already_queued, composed_new_message))
-        {
-            syslog(LOG_DEBUG, "Message [%s] already on the queue, not pushing.", already_queued);
-            free(already_queued);
-            free(composed_new_message);
-            return 0; // Pretend that we've added the message to the queue because it's already there.
-        }
-        free(already_queued);
-        free(composed_new_message);
+        message_destroy(new_message);
+        return 0; // Pretend that we've added the message to the queue because it's already there.
     }
 
-    struct message **temp = realloc(this_queue->message_queue, sizeof(*(this_queue->message_queue))*(this_queue->queue_length + 1));
-    if (temp != NULL)
+    if (this_queue->queue_length == this_queue->capacity)
     {
-        char *composed_message = message_compose(new_message);
-        //syslog(LOG_DEBUG, "Pushing message %s onto queue, now %zd messages long.", composed_message, queue_sizeof(this_queue));
-        free(composed_message);
-        composed_message = NULL;
-        temp[this_queue->queue_length] = new_message;
-        this_queue->message_queue = temp;
-        this_queue->queue_length++;
-        return 0; /// \retval 0 Success.
-    }
-    else
-    {
-        perror("realloc");
-        syslog(LOG_ERR, "Couldn't reallocate message queue.");
-        return -3; /// \retval -3 The operation failed, realloc error.
+        if (queue_grow(this_queue) < 0)
+        {
+            syslog(LOG_ERR, "Couldn't grow message queue beyond %zu messages.", this_queue->capacity);
+            message_destroy(new_message);
+            return -3; /// \retval -3 The operation failed, allocation error.
+        }
+        slot = queue_set_probe(this_queue->set, 2*this_queue->capacity, digest, new_message);
     }
+
+    struct queue_entry *tail = &this_queue->ring[(this_queue->head + this_queue->queue_length) & (this_queue->capacity - 1)];
+    tail->digest = digest;
+    tail->message = new_message;
+    *slot = *tail;
+    this_queue->queue_length++;
+    return 0; /// \retval 0 Success.
 }
 
 
@@ -121,7 +218,7 @@ int queue_push(struct queue *this_queue, struct message *new_message)
  * \fn      struct message *queue_pop(struct queue *this_queue)
  * \details Pop a message off the front of the queue.
  * \param   this_queue A pointer to the queue in question.
- * \return  A pointer to the message that was previously at the front of the queue.
+ * \return  A pointer to the message that was previously at the front of the queue, which now belongs to the caller.
  */
 struct message *queue_pop(struct queue *this_queue)
 {
@@ -136,40 +233,25 @@ struct message *queue_pop(struct queue *this_queue)
         return NULL;
     }
 
-    char *composed_message = message_compose(this_queue->message_queue[0]);
-    //syslog(LOG_DEBUG, "Popping message %s from queue, now %zd messages long.", composed_message, queue_sizeof(this_queue));
-    free(composed_message);
-    composed_message = NULL;
+    struct queue_entry front = this_queue->ring[this_queue->head];
+    queue_set_remove(this_queue, queue_set_probe(this_queue->set, 2*this_queue->capacity, front.digest, front.message));
+    this_queue->head = (this_queue->head + 1) & (this_queue->capacity - 1);
+    this_queue->queue_length--;
+    return front.message;
+}
 
-    struct message *front_message = message_create(message_get_type(this_queue->message_queue[0]));
-    size_t i;
-    for (i = 0; i < message_get_number_of_words(this_queue->message_queue[0]); i++)
-    {
-        message_add_word(front_message, message_see_word(this_queue->message_queue[0], i));
-    }
-    message_destroy(this_queue->message_queue[0]);
-    memmove(&this_queue->message_queue[0],
-            &this_queue->message_queue[1],
-            sizeof(*(this_queue->message_queue))*(this_queue->queue_length - 1));
-    struct message **temp = realloc(this_queue->message_queue, sizeof(*(this_queue->message_queue))*(this_queue->queue_length - 1));
-    if (temp != NULL)
-    {
-        this_queue->message_queue = temp;
-        this_queue->queue_length--;
-    }
-    else
-    {
-        if (this_queue->queue_length == 1)
-        {
-            this_queue->message_queue = NULL;
-            this_queue->queue_length = 0;
-        }
-        else
-        {
-            syslog(LOG_ERR, "Unable to realloc() memory for newly-shortened queue!");
-        }
-    }
-    return front_message;
+
+/**
+ * \fn      struct message *queue_peek(struct queue *this_queue)
+ * \details Have a look at the message at the front of the queue, without popping it.
+ * \param   this_queue A pointer to the queue in question.
+ * \return  A pointer to the message at the front of the queue, which still belongs to the queue, or NULL if the queue is empty.
+ */
+struct message *queue_peek(struct queue *this_queue)
+{
+    if (this_queue == NULL || this_queue->queue_length == 0)
+        return NULL;
+    return this_queue->ring[this_queue->head].message;
 }
 
 
@@ -6,7 +6,8 @@
 
 /**
  * \file  queue.h
- * \brief The queue type stores a list of messages waiting to be sent.
+ * \brief The queue type stores a list of messages waiting to be sent, in a ring buffer. The messages are also kept in a hash set, so
+ *        that a message which is already waiting isn't queued twice. Pushing and popping take constant time, without copying.
  */
 
 
@@ -17,6 +18,7 @@ void queue_destroy(struct queue *this_queue);
 
 int queue_push(struct queue *this_queue, struct message *new_message);
 struct message *queue_pop(struct queue *this_queue);
+struct message *queue_peek(struct queue *this_queue);
 size_t queue_sizeof(struct queue *this_queue);
 
 #endif
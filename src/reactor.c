@@ -0,0 +1,304 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <syslog.h>
+#include <sys/epoll.h>
+
+#include "reactor.h"
+
+/// The maximum number of ready file descriptors collected from the kernel in one go. More than this simply get picked up on the next pass.
+#define REACTOR_MAX_EVENTS 256
+
+
+/// A struct to hold a single file descriptor's registration with the reactor.
+struct reactor_handler {
+    /// The file descriptor being watched.
+    int fd;
+    /// The events currently asked for. Kept here so that redundant epoll_ctl() calls can be skipped.
+    uint32_t events;
+    /// The function to call when the file descriptor is ready.
+    reactor_callback callback;
+    /// An opaque pointer handed back to the callback, normally the object which owns the file descriptor.
+    void *data;
+    /// Set when the handler has been removed, but events for it may still be waiting in the current batch.
+    int removed;
+};
+
+
+/// A struct to manage the epoll instance and all of the file descriptors registered with it.
+struct reactor {
+    /// The epoll file descriptor.
+    int epoll_fd;
+    /// Handlers indexed by file descriptor, so that lookups for modify and remove are O(1).
+    struct reactor_handler **handler_list;
+    /// The number of slots in the handler_list.
+    size_t handler_list_length;
+    /// The number of file descriptors currently registered.
+    size_t number_of_fds;
+    /// Handlers which have been removed, but can't be freed until the current batch of events has been dispatched.
+    struct reactor_handler **retired_list;
+    /// The number of handlers in the retired_list.
+    size_t number_retired;
+    /// Space for the kernel to return ready events.
+    struct epoll_event events[REACTOR_MAX_EVENTS];
+    /// A function called every time the reactor wakes up, before any of the file descriptors' callbacks.
+    reactor_wakeup_callback wakeup_callback;
+    /// An opaque pointer handed to the wakeup callback.
+    void *wakeup_data;
+};
+
+
+/**
+ * \fn      struct reactor *reactor_create()
+ * \details Allocate memory for a reactor object and create the underlying epoll instance.
+ * \return  A pointer to the newly-created reactor, NULL if the epoll instance couldn't be created.
+ */
+struct reactor *reactor_create()
+{
+    struct reactor *new_reactor = malloc(sizeof(*new_reactor));
+    if (new_reactor != NULL)
+    {
+        new_reactor->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        if (new_reactor->epoll_fd < 0)
+        {
+            perror("epoll_create1");
+            free(new_reactor);
+            return NULL;
+        }
+        new_reactor->handler_list = NULL;
+        new_reactor->handler_list_length = 0;
+        new_reactor->number_of_fds = 0;
+        new_reactor->retired_list = NULL;
+        new_reactor->number_retired = 0;
+        new_reactor->wakeup_callback = NULL;
+        new_reactor->wakeup_data = NULL;
+    }
+    return new_reactor;
+}
+
+
+/**
+ * \fn      static void reactor_free_retired(struct reactor *this_reactor)
+ * \details Free the handlers which were removed during the last batch of events.
+ * \param   this_reactor A pointer to the reactor in question.
+ * \return  void
+ */
+static void reactor_free_retired(struct reactor *this_reactor)
+{
+    size_t i;
+    for (i = 0; i < this_reactor->number_retired; i++)
+    {
+        free(this_reactor->retired_list[i]);
+    }
+    free(this_reactor->retired_list);
+    this_reactor->retired_list = NULL;
+    this_reactor->number_retired = 0;
+}
+
+
+/**
+ * \fn      void reactor_destroy(struct reactor *this_reactor)
+ * \details Free the memory associated with the reactor. The registered file descriptors are not closed, they belong to whoever registered them.
+ * \param   this_reactor A pointer to the reactor to be destroyed.
+ * \return  void
+ */
+void reactor_destroy(struct reactor *this_reactor)
+{
+    if (this_reactor != NULL)
+    {
+        size_t i;
+        for (i = 0; i < this_reactor->handler_list_length; i++)
+        {
+            free(this_reactor->handler_list[i]);
+        }
+        free(this_reactor->handler_list);
+        reactor_free_retired(this_reactor);
+        close(this_reactor->epoll_fd);
+        free(this_reactor);
+    }
+}
+
+
+/**
+ * \fn      int reactor_add(struct reactor *this_reactor, int fd, uint32_t events, reactor_callback callback, void *data)
+ * \details Register a file descriptor with the reactor. The registration persists until reactor_remove() is called, and only the
+ *          interest set needs updating (with reactor_modify()) after that.
+ * \param   this_reactor A pointer to the reactor in question.
+ * \param   fd The file descriptor to watch.
+ * \param   events The events of interest, some combination of REACTOR_READ and REACTOR_WRITE.
+ * \param   callback The function to be called when the file descriptor is ready.
+ * \param   data An opaque pointer to be handed back to the callback.
+ * \return  An integer indicating the outcome of the operation.
+ */
+int reactor_add(struct reactor *this_reactor, int fd, uint32_t events, reactor_callback callback, void *data)
+{
+    if (this_reactor == NULL || fd < 0 || callback == NULL)
+        return -1; /// \retval -1 The arguments were invalid.
+
+    if ((size_t) fd >= this_reactor->handler_list_length)
+    {
+        size_t new_length = this_reactor->handler_list_length ? this_reactor->handler_list_length : 64;
+        while (new_length <= (size_t) fd)
+            new_length *= 2;
+        struct reactor_handler **temp = realloc(this_reactor->handler_list, sizeof(*(this_reactor->handler_list))*new_length);
+        if (temp == NULL)
+        {
+            syslog(LOG_ERR, "Unable to grow the reactor's handler list to accommodate fd %d.", fd);
+            return -2; /// \retval -2 Memory allocation failed.
+        }
+        memset(temp + this_reactor->handler_list_length, 0, sizeof(*temp)*(new_length - this_reactor->handler_list_length));
+        this_reactor->handler_list = temp;
+        this_reactor->handler_list_length = new_length;
+    }
+    if (this_reactor->handler_list[fd] != NULL)
+    {
+        syslog(LOG_ERR, "fd %d is already registered with the reactor.", fd);
+        return -3; /// \retval -3 The file descriptor was already registered.
+    }
+
+    struct reactor_handler *new_handler = malloc(sizeof(*new_handler));
+    if (new_handler == NULL)
+        return -2;
+    new_handler->fd = fd;
+    new_handler->events = events;
+    new_handler->callback = callback;
+    new_handler->data = data;
+    new_handler->removed = 0;
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.ptr = new_handler;
+    if (epoll_ctl(this_reactor->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0)
+    {
+        syslog(LOG_ERR, "epoll_ctl(ADD) failed on fd %d: %s", fd, strerror(errno));
+        free(new_handler);
+        return -4; /// \retval -4 The kernel refused the registration.
+    }
+    this_reactor->handler_list[fd] = new_handler;
+    this_reactor->number_of_fds++;
+    return 0; /// \retval 0 The file descriptor was registered successfully.
+}
+
+
+/**
+ * \fn      int reactor_modify(struct reactor *this_reactor, int fd, uint32_t events)
+ * \details Change the events of interest for a file descriptor that is already registered. If nothing has changed, the system call is skipped.
+ * \param   this_reactor A pointer to the reactor in question.
+ * \param   fd The file descriptor in question.
+ * \param   events The new events of interest.
+ * \return  An integer indicating the outcome of the operation.
+ */
+int reactor_modify(struct reactor *this_reactor, int fd, uint32_t events)
+{
+    if (this_reactor == NULL || fd < 0 || (size_t) fd >= this_reactor->handler_list_length || this_reactor->handler_list[fd] == NULL)
+        return -1; /// \retval -1 The file descriptor is not registered.
+
+    struct reactor_handler *handler = this_reactor->handler_list[fd];
+    if (handler->events == events)
+        return 0; /// \retval 0 The operation was successful.
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.ptr = handler;
+    if (epoll_ctl(this_reactor->epoll_fd, EPOLL_CTL_MOD, fd, &ev) < 0)
+    {
+        syslog(LOG_ERR, "epoll_ctl(MOD) failed on fd %d: %s", fd, strerror(errno));
+        return -2; /// \retval -2 The kernel refused the change.
+    }
+    handler->events = events;
+    return 0;
+}
+
+
+/**
+ * \fn      int reactor_remove(struct reactor *this_reactor, int fd)
+ * \details Stop watching a file descriptor. This must be done before the file descriptor is closed. It's safe to call this from inside
+ *          a callback, even for a file descriptor which still has events waiting in the current batch; they will simply be dropped.
+ * \param   this_reactor A pointer to the reactor in question.
+ * \param   fd The file descriptor to stop watching.
+ * \return  An integer indicating the outcome of the operation.
+ */
+int reactor_remove(struct reactor *this_reactor, int fd)
+{
+    if (this_reactor == NULL || fd < 0 || (size_t) fd >= this_reactor->handler_list_length || this_reactor->handler_list[fd] == NULL)
+        return -1; /// \retval -1 The file descriptor is not registered.
+
+    struct reactor_handler *handler = this_reactor->handler_list[fd];
+    epoll_ctl(this_reactor->epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+    this_reactor->handler_list[fd] = NULL;
+    this_reactor->number_of_fds--;
+
+    handler->removed = 1;
+    struct reactor_handler **temp = realloc(this_reactor->retired_list, sizeof(*(this_reactor->retired_list))*(this_reactor->number_retired + 1));
+    if (temp == NULL)
+    {
+        //Leaking the handler is better than risking a callback on freed memory.
+        syslog(LOG_ERR, "Unable to retire the reactor handler for fd %d.", fd);
+        return 0;
+    }
+    this_reactor->retired_list = temp;
+    this_reactor->retired_list[this_reactor->number_retired++] = handler;
+    return 0; /// \retval 0 The operation was successful.
+}
+
+
+/**
+ * \fn      void reactor_set_wakeup_callback(struct reactor *this_reactor, reactor_wakeup_callback callback, void *data)
+ * \details Set a function to be called every time the reactor wakes up (whether there are events or not), before any of the callbacks of
+ *          the ready file descriptors. This is the place to refresh anything that the callbacks expect to be current, like a cached clock.
+ * \param   this_reactor A pointer to the reactor in question.
+ * \param   callback The function to call, NULL for none.
+ * \param   data An opaque pointer to be handed to the function.
+ * \return  void
+ */
+void reactor_set_wakeup_callback(struct reactor *this_reactor, reactor_wakeup_callback callback, void *data)
+{
+    this_reactor->wakeup_callback = callback;
+    this_reactor->wakeup_data = data;
+}
+
+
+/**
+ * \fn      int reactor_run_once(struct reactor *this_reactor, int timeout_ms, const sigset_t *sigmask)
+ * \details Wait for any of the registered file descriptors to become ready, and call the callbacks of those that are.
+ *          The signal mask is swapped in atomically for the duration of the wait, just like pselect() does.
+ * \param   this_reactor A pointer to the reactor in question.
+ * \param   timeout_ms The maximum time to wait, in milliseconds. -1 waits indefinitely.
+ * \param   sigmask The signal mask to use while waiting, NULL to leave it unchanged.
+ * \return  The number of file descriptors which were ready, or -1 with errno set on failure. EINTR indicates that a signal arrived.
+ */
+int reactor_run_once(struct reactor *this_reactor, int timeout_ms, const sigset_t *sigmask)
+{
+    int r = epoll_pwait(this_reactor->epoll_fd, this_reactor->events, REACTOR_MAX_EVENTS, timeout_ms, sigmask);
+    if (r < 0)
+        return r;
+
+    if (this_reactor->wakeup_callback != NULL)
+        this_reactor->wakeup_callback(this_reactor->wakeup_data);
+
+    int i;
+    for (i = 0; i < r; i++)
+    {
+        struct reactor_handler *handler = this_reactor->events[i].data.ptr;
+        if (!handler->removed)
+            handler->callback(this_reactor, handler->fd, this_reactor->events[i].events, handler->data);
+    }
+    reactor_free_retired(this_reactor);
+    return r;
+}
+
+
+/**
+ * \fn      size_t reactor_get_number_of_fds(struct reactor *this_reactor)
+ * \details Get the number of file descriptors currently registered with the reactor.
+ * \param   this_reactor A pointer to the reactor in question.
+ * \return  The number of registered file descriptors.
+ */
+size_t reactor_get_number_of_fds(struct reactor *this_reactor)
+{
+    return this_reactor->number_of_fds;
+}
@@ -0,0 +1,38 @@
+#ifndef _REACTOR_H_
+#define _REACTOR_H_
+
+#include <stdint.h>
+#include <signal.h>
+#include <sys/epoll.h>
+
+/**
+ * \file  reactor.h
+ * \brief The reactor type multiplexes all of the program's file descriptors. Each file descriptor is registered once, along with a
+ *        callback, and the callback is only invoked when the file descriptor is actually ready. The current implementation uses epoll,
+ *        but users of the reactor only ever see the REACTOR_* event flags and the callbacks.
+ */
+
+/// The file descriptor is ready to be read.
+#define REACTOR_READ    EPOLLIN
+/// The file descriptor is ready to be written (or a non-blocking connect() has completed).
+#define REACTOR_WRITE   EPOLLOUT
+/// An error or a hang-up occurred. These are always reported, whether they were asked for or not.
+#define REACTOR_ERROR   (EPOLLERR | EPOLLHUP)
+
+struct reactor;
+
+typedef void (*reactor_callback)(struct reactor *this_reactor, int fd, uint32_t events, void *data);
+typedef void (*reactor_wakeup_callback)(void *data);
+
+struct reactor *reactor_create();
+void reactor_destroy(struct reactor *this_reactor);
+
+int reactor_add(struct reactor *this_reactor, int fd, uint32_t events, reactor_callback callback, void *data);
+int reactor_modify(struct reactor *this_reactor, int fd, uint32_t events);
+int reactor_remove(struct reactor *this_reactor, int fd);
+
+void reactor_set_wakeup_callback(struct reactor *this_reactor, reactor_wakeup_callback callback, void *data);
+int reactor_run_once(struct reactor *this_reactor, int timeout_ms, const sigset_t *sigmask);
+size_t reactor_get_number_of_fds(struct reactor *this_reactor);
+
+#endif
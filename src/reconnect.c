@@ -0,0 +1,110 @@
+#include <stdlib.h>
+
+#include "reconnect.h"
+#include "timers.h"
+
+
+/// A struct to hold the backoff state for one endpoint.
+struct reconnect {
+    /// The timeout which fires the next attempt.
+    struct timeout *timeout;
+    /// The wait after the first failure, and what the backoff resets to once a connection succeeds.
+    unsigned int initial_ms;
+    /// The ceiling for the backoff.
+    unsigned int max_ms;
+    /// The backoff which will be used for the next attempt.
+    unsigned int current_ms;
+    /// The function which makes a connection attempt.
+    reconnect_callback attempt;
+    /// An opaque pointer handed back to the attempt function, normally the object which owns the connection.
+    void *data;
+};
+
+
+/**
+ * \fn      static void reconnect_fire(struct timeout *this_timeout, void *data)
+ * \details The timeout callback, which just hands over to the owner's attempt function.
+ */
+static void reconnect_fire(struct timeout *this_timeout, void *data)
+{
+    (void) this_timeout;
+    struct reconnect *this_reconnect = data;
+    this_reconnect->attempt(this_reconnect->data);
+}
+
+
+/**
+ * \fn      struct reconnect *reconnect_create(struct timers *timers, unsigned int initial_ms, unsigned int max_ms, reconnect_callback attempt, void *data)
+ * \details Allocate memory for a reconnect object. Nothing is scheduled until reconnect_schedule() is called.
+ * \param   timers The timers object which will drive the attempts.
+ * \param   initial_ms The backoff after the first failure, in milliseconds.
+ * \param   max_ms The maximum backoff, in milliseconds.
+ * \param   attempt The function to call to make a connection attempt.
+ * \param   data An opaque pointer to be handed to the attempt function.
+ * \return  A pointer to the newly-allocated reconnect object.
+ */
+struct reconnect *reconnect_create(struct timers *timers, unsigned int initial_ms, unsigned int max_ms, reconnect_callback attempt, void *data)
+{
+    struct reconnect *new_reconnect = malloc(sizeof(*new_reconnect));
+    if (new_reconnect != NULL)
+    {
+        new_reconnect->timeout = timeout_create(timers, reconnect_fire, new_reconnect);
+        new_reconnect->initial_ms = initial_ms;
+        new_reconnect->max_ms = max_ms;
+        new_reconnect->current_ms = initial_ms;
+        new_reconnect->attempt = attempt;
+        new_reconnect->data = data;
+    }
+    return new_reconnect;
+}
+
+
+/**
+ * \fn      void reconnect_destroy(struct reconnect *this_reconnect)
+ * \details Cancel any pending attempt and free the memory associated with the reconnect object.
+ * \param   this_reconnect A pointer to the reconnect object to be destroyed.
+ * \return  void
+ */
+void reconnect_destroy(struct reconnect *this_reconnect)
+{
+    if (this_reconnect != NULL)
+    {
+        timeout_destroy(this_reconnect->timeout);
+        free(this_reconnect);
+    }
+}
+
+
+/**
+ * \fn      void reconnect_schedule(struct reconnect *this_reconnect)
+ * \details Schedule the next connection attempt, and double the backoff for the one after that. The actual wait is somewhere between half
+ *          and all of the current backoff.
+ *          This should also be called as soon as an attempt has been started. If the attempt succeeds, reconnect_succeeded() cancels the
+ *          timeout, otherwise it doubles as a deadline for a connect() which is taking too long.
+ * \param   this_reconnect A pointer to the reconnect object in question.
+ * \return  void
+ */
+void reconnect_schedule(struct reconnect *this_reconnect)
+{
+    unsigned int half = this_reconnect->current_ms/2;
+    unsigned int delay = half + (unsigned int) (random() % (half + 1));
+    timeout_schedule(this_reconnect->timeout, delay);
+
+    if (this_reconnect->current_ms < this_reconnect->max_ms/2)
+        this_reconnect->current_ms *= 2;
+    else
+        this_reconnect->current_ms = this_reconnect->max_ms;
+}
+
+
+/**
+ * \fn      void reconnect_succeeded(struct reconnect *this_reconnect)
+ * \details Note that the connection has been made. Any pending attempt is cancelled and the backoff goes back to its initial value.
+ * \param   this_reconnect A pointer to the reconnect object in question.
+ * \return  void
+ */
+void reconnect_succeeded(struct reconnect *this_reconnect)
+{
+    timeout_cancel(this_reconnect->timeout);
+    this_reconnect->current_ms = this_reconnect->initial_ms;
+}
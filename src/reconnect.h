@@ -0,0 +1,27 @@
+#ifndef _RECONNECT_H_
+#define _RECONNECT_H_
+
+#include "timers.h"
+
+/**
+ * \file  reconnect.h
+ * \brief The reconnect type schedules connection attempts to a single KATCP endpoint. The wait between attempts doubles after every
+ *        failure up to a maximum, with random jitter so that many connections to the same restarting CMC don't all retry in lockstep.
+ */
+
+/// The wait before the first retry, in milliseconds.
+#define RECONNECT_INITIAL_MS 1000
+/// The longest that a connection will wait between retries, in milliseconds.
+#define RECONNECT_MAX_MS 30000
+
+struct reconnect;
+
+typedef void (*reconnect_callback)(void *data);
+
+struct reconnect *reconnect_create(struct timers *timers, unsigned int initial_ms, unsigned int max_ms, reconnect_callback attempt, void *data);
+void reconnect_destroy(struct reconnect *this_reconnect);
+
+void reconnect_schedule(struct reconnect *this_reconnect);
+void reconnect_succeeded(struct reconnect *this_reconnect);
+
+#endif
@@ -0,0 +1,324 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <syslog.h>
+#include <sys/uio.h>
+
+#include "response.h"
+
+/// The most segments handed to writev() at once. Anything beyond this goes in the next call.
+#define RESPONSE_IOV_MAX 64
+
+
+/// A piece of the body: either a run of the body strbuf, or a fragment's text.
+struct response_segment {
+    /// The fragment's text, held until the response is cleared. NULL if the segment is in the body strbuf.
+    struct fragment_text *text;
+    /// Where the segment starts, in the body strbuf or the fragment's text.
+    size_t offset;
+    /// The length of the segment.
+    size_t length;
+};
+
+
+/// A struct to hold an HTTP response and how much of it has been sent.
+struct response {
+    /// The status line and headers.
+    struct strbuf *header;
+    /// The text of the body, apart from the fragments.
+    struct strbuf *body;
+    /// The body, in order.
+    struct response_segment *segment_list;
+    /// The number of segments.
+    size_t number_of_segments;
+    /// The number of segments there's room for.
+    size_t segment_capacity;
+    /// How much of the body strbuf is already covered by segments. Anything after this is the start of the next segment.
+    size_t body_covered;
+    /// The total length of the segments.
+    size_t body_length;
+    /// How much of the header has been sent.
+    size_t header_sent;
+    /// The segment which is being sent.
+    size_t current_segment;
+    /// How much of the current segment has been sent.
+    size_t current_offset;
+};
+
+
+/**
+ * \fn      struct response *response_create()
+ * \details Allocate memory for an empty response.
+ * \return  A pointer to the newly-created response, NULL on failure.
+ */
+struct response *response_create()
+{
+    struct response *new_response = malloc(sizeof(*new_response));
+    if (new_response == NULL)
+        return NULL;
+    new_response->header = strbuf_create(256);
+    new_response->body = strbuf_create(0);
+    if (new_response->header == NULL || new_response->body == NULL)
+    {
+        strbuf_destroy(new_response->header);
+        strbuf_destroy(new_response->body);
+        free(new_response);
+        return NULL;
+    }
+    new_response->segment_list = NULL;
+    new_response->number_of_segments = 0;
+    new_response->segment_capacity = 0;
+    new_response->body_covered = 0;
+    new_response->body_length = 0;
+    new_response->header_sent = 0;
+    new_response->current_segment = 0;
+    new_response->current_offset = 0;
+    return new_response;
+}
+
+
+/**
+ * \fn      void response_destroy(struct response *this_response)
+ * \details Free the memory associated with the response, and let go of any fragments it's holding.
+ * \param   this_response A pointer to the response to be destroyed.
+ * \return  void
+ */
+void response_destroy(struct response *this_response)
+{
+    if (this_response != NULL)
+    {
+        response_clear(this_response);
+        strbuf_destroy(this_response->header);
+        strbuf_destroy(this_response->body);
+        free(this_response->segment_list);
+        free(this_response);
+    }
+}
+
+
+/**
+ * \fn      static int response_add_segment(struct response *this_response, struct fragment_text *text, size_t offset, size_t length)
+ * \details Add a segment to the end of the body.
+ * \return  0 on success, -1 if there was no memory.
+ */
+static int response_add_segment(struct response *this_response, struct fragment_text *text, size_t offset, size_t length)
+{
+    if (this_response->number_of_segments == this_response->segment_capacity)
+    {
+        size_t new_capacity = this_response->segment_capacity ? this_response->segment_capacity*2 : 8;
+        struct response_segment *temp = realloc(this_response->segment_list, sizeof(*temp)*new_capacity);
+        if (temp == NULL)
+        {
+            syslog(LOG_ERR, "Unable to allocate memory for a response's segments.");
+            return -1;
+        }
+        this_response->segment_list = temp;
+        this_response->segment_capacity = new_capacity;
+    }
+    struct response_segment *segment = &this_response->segment_list[this_response->number_of_segments++];
+    segment->text = text;
+    segment->offset = offset;
+    segment->length = length;
+    this_response->body_length += length;
+    return 0;
+}
+
+
+/**
+ * \fn      static int response_cover_body(struct response *this_response)
+ * \details Make a segment of whatever has been appended to the body strbuf since the last segment was added.
+ * \return  0 on success, -1 if there was no memory.
+ */
+static int response_cover_body(struct response *this_response)
+{
+    size_t length = strbuf_get_length(this_response->body);
+    if (length == this_response->body_covered)
+        return 0;
+    if (response_add_segment(this_response, NULL, this_response->body_covered, length - this_response->body_covered) < 0)
+        return -1;
+    this_response->body_covered = length;
+    return 0;
+}
+
+
+/**
+ * \fn      struct strbuf *response_get_header(struct response *this_response)
+ * \details Get the strbuf for the status line and headers, which are sent ahead of the body.
+ * \param   this_response A pointer to the response in question.
+ * \return  The header strbuf, which belongs to the response.
+ */
+struct strbuf *response_get_header(struct response *this_response)
+{
+    return this_response->header;
+}
+
+
+/**
+ * \fn      struct strbuf *response_get_body(struct response *this_response)
+ * \details Get the strbuf to which the body's text is appended. Whatever is appended goes into the body after everything added so far,
+ *          fragments included.
+ * \param   this_response A pointer to the response in question.
+ * \return  The body strbuf, which belongs to the response.
+ */
+struct strbuf *response_get_body(struct response *this_response)
+{
+    return this_response->body;
+}
+
+
+/**
+ * \fn      int response_add_fragment(struct response *this_response, struct fragment *this_fragment)
+ * \details Add a fragment's HTML to the end of the body, as it stands now. It's sent from the fragment's own buffer, which is held until
+ *          the response is cleared, so the fragment can carry on being rendered in the meantime.
+ * \param   this_response A pointer to the response in question.
+ * \param   this_fragment The fragment. An empty fragment adds nothing.
+ * \return  0 on success, -1 if there was no memory.
+ */
+int response_add_fragment(struct response *this_response, struct fragment *this_fragment)
+{
+    if (response_cover_body(this_response) < 0)
+        return -1;
+    struct fragment_text *text = fragment_hold(this_fragment);
+    if (text == NULL)
+        return 0;
+    size_t length = fragment_text_get_length(text);
+    if (length == 0)
+    {
+        fragment_text_release(text);
+        return 0;
+    }
+    if (response_add_segment(this_response, text, 0, length) < 0)
+    {
+        fragment_text_release(text);
+        return -1;
+    }
+    return 0;
+}
+
+
+/**
+ * \fn      size_t response_get_body_length(struct response *this_response)
+ * \details Get the length of the body, fragments included, for the Content-Length header.
+ * \param   this_response A pointer to the response in question.
+ * \return  The length of the body in bytes.
+ */
+size_t response_get_body_length(struct response *this_response)
+{
+    response_cover_body(this_response);
+    return this_response->body_length;
+}
+
+
+/**
+ * \fn      int response_is_pending(struct response *this_response)
+ * \details Check whether the response has anything which hasn't been sent yet.
+ * \param   this_response A pointer to the response in question.
+ * \return  1 if there's something to send, 0 if not.
+ */
+int response_is_pending(struct response *this_response)
+{
+    return this_response->header_sent < strbuf_get_length(this_response->header) || \
+            this_response->current_segment < this_response->number_of_segments || \
+            strbuf_get_length(this_response->body) > this_response->body_covered;
+}
+
+
+/**
+ * \fn      static void response_advance(struct response *this_response, size_t bytes)
+ * \details Move past bytes which writev() has taken, header first and then segments in order.
+ */
+static void response_advance(struct response *this_response, size_t bytes)
+{
+    size_t header_left = strbuf_get_length(this_response->header) - this_response->header_sent;
+    if (bytes <= header_left)
+    {
+        this_response->header_sent += bytes;
+        return;
+    }
+    this_response->header_sent += header_left;
+    bytes -= header_left;
+    while (bytes > 0 && this_response->current_segment < this_response->number_of_segments)
+    {
+        size_t segment_left = this_response->segment_list[this_response->current_segment].length - this_response->current_offset;
+        if (bytes < segment_left)
+        {
+            this_response->current_offset += bytes;
+            return;
+        }
+        bytes -= segment_left;
+        this_response->current_segment++;
+        this_response->current_offset = 0;
+    }
+}
+
+
+/**
+ * \fn      int response_write(struct response *this_response, int fd)
+ * \details Send as much of the response as the socket will take. The header and the segments are gathered up and handed to writev()
+ *          together, and that's repeated until everything has been sent or the socket would block, so a large page goes out in as few
+ *          system calls as the socket allows.
+ * \param   this_response A pointer to the response in question.
+ * \param   fd The socket, which should be non-blocking.
+ * \return  An integer indicating the outcome of the operation.
+ */
+int response_write(struct response *this_response, int fd)
+{
+    if (response_cover_body(this_response) < 0)
+        return -1; /// \retval -1 The response couldn't be sent, and the connection should be closed.
+
+    while (response_is_pending(this_response))
+    {
+        struct iovec iov[RESPONSE_IOV_MAX];
+        int n_iov = 0;
+        size_t header_length = strbuf_get_length(this_response->header);
+        if (this_response->header_sent < header_length)
+        {
+            iov[n_iov].iov_base = strbuf_see(this_response->header) + this_response->header_sent;
+            iov[n_iov++].iov_len = header_length - this_response->header_sent;
+        }
+        size_t i;
+        for (i = this_response->current_segment; i < this_response->number_of_segments && n_iov < RESPONSE_IOV_MAX; i++)
+        {
+            struct response_segment *segment = &this_response->segment_list[i];
+            size_t skip = (i == this_response->current_segment) ? this_response->current_offset : 0;
+            char *base = segment->text != NULL ? fragment_text_see(segment->text) : strbuf_see(this_response->body);
+            iov[n_iov].iov_base = base + segment->offset + skip;
+            iov[n_iov++].iov_len = segment->length - skip;
+        }
+
+        ssize_t r = writev(fd, iov, n_iov);
+        if (r < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return 1; /// \retval 1 The socket is full, and the rest will have to wait until it's writable again.
+            syslog(LOG_WARNING, "Unable to send a response on FD %d: %m", fd);
+            return -1;
+        }
+        response_advance(this_response, (size_t) r);
+    }
+    return 0; /// \retval 0 The whole response has been sent.
+}
+
+
+/**
+ * \fn      void response_clear(struct response *this_response)
+ * \details Empty the response so that it can be used for the next one, letting go of any fragments it's holding. The buffers are kept.
+ * \param   this_response A pointer to the response in question.
+ * \return  void
+ */
+void response_clear(struct response *this_response)
+{
+    size_t i;
+    for (i = 0; i < this_response->number_of_segments; i++)
+        fragment_text_release(this_response->segment_list[i].text);
+    this_response->number_of_segments = 0;
+    strbuf_clear(this_response->header);
+    strbuf_clear(this_response->body);
+    this_response->body_covered = 0;
+    this_response->body_length = 0;
+    this_response->header_sent = 0;
+    this_response->current_segment = 0;
+    this_response->current_offset = 0;
+}
@@ -0,0 +1,31 @@
+#ifndef _RESPONSE_H_
+#define _RESPONSE_H_
+
+#include <stddef.h>
+
+#include "strbuf.h"
+#include "fragment.h"
+
+/**
+ * \file  response.h
+ * \brief The response type holds an HTTP response while it's being put together and sent. It's a list of segments: runs of text
+ *        appended to the response's own body strbuf, and cached fragments, which are sent straight from the fragment's buffer rather
+ *        than copied. The header is kept separately, since it can't be written until the length of the body is known. The whole
+ *        lot is sent with writev(), as much as the socket will take at a time.
+ */
+
+struct response;
+
+struct response *response_create();
+void response_destroy(struct response *this_response);
+
+struct strbuf *response_get_header(struct response *this_response);
+struct strbuf *response_get_body(struct response *this_response);
+int response_add_fragment(struct response *this_response, struct fragment *this_fragment);
+size_t response_get_body_length(struct response *this_response);
+
+int response_is_pending(struct response *this_response);
+int response_write(struct response *this_response, int fd);
+void response_clear(struct response *this_response);
+
+#endif
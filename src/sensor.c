@@ -1,56 +1,109 @@
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 #include <time.h>
 
 #include "sensor.h"
+#include "arena.h"
+#include "sensor_table.h"
 
-/// A struct to represent an individual sensor on corr2_sensor_servelet.
+/// A struct to represent an individual sensor on corr2_sensor_servelet. Its value, status and so on are kept in a row of the array's
+/// sensor_table, so the sensor is really just a named view onto that row.
 struct sensor {
     /// The sensor's name.
     char *name;
-    /// The sensor's value.
-    char *value;
-    /// The sensor's status - this could be one of [nominal, warn, error, failure, unknown, unreachable, inactive] according to the KATCP spec.
-    char *status;
+    /// The table in which the sensor's row is.
+    struct sensor_table *table;
+    /// The sensor's row in the table.
+    size_t row;
+    /// Something to be told when the sensor's status changes, NULL if nothing is interested.
+    sensor_watcher watcher;
+    /// What to pass to the watcher.
+    void *watcher_data;
+};
+
+
+/// The KATCP names of the statuses, which double as the CSS classes used to render them. Indexed by enum sensor_status.
+static char *sensor_status_names[] = {
+    [SENSOR_UNKNOWN] = "unknown",
+    [SENSOR_NOMINAL] = "nominal",
+    [SENSOR_WARN] = "warn",
+    [SENSOR_ERROR] = "error",
+    [SENSOR_FAILURE] = "failure",
+    [SENSOR_UNREACHABLE] = "unreachable",
+    [SENSOR_INACTIVE] = "inactive",
 };
 
 
 /**
- * \fn      struct sensor *sensor_create(char *new_name)
- * \details Allocate memory for a sensor object and populate the members
- *          with sensible default values.
- * \param   new_name A name for the sensor to be created.
- * \return  A pointer to the newly-created sensor object.
+ * \fn      enum sensor_status sensor_status_from_string(char *status_string)
+ * \details Parse the status field of a KATCP sensor message.
+ * \param   status_string The status as received, e.g. "nominal". May be NULL.
+ * \return  The corresponding status, SENSOR_UNKNOWN if the string isn't recognised.
  */
-struct sensor *sensor_create(char *new_name)
+enum sensor_status sensor_status_from_string(char *status_string)
 {
-    /* TODO think about sanitising the name a bit perhaps. */
-    struct sensor *new_sensor = malloc(sizeof(*new_sensor));
-    if (new_sensor != NULL)
+    if (status_string == NULL)
+        return SENSOR_UNKNOWN;
+    //Switching on the first letter means that at most one strcmp is needed.
+    switch (status_string[0])
     {
-        new_sensor->name = strdup(new_name);
-        new_sensor->value = strdup("unused");
-        new_sensor->status = strdup("unknown");
+        case 'n':
+            return strcmp(status_string, "nominal") ? SENSOR_UNKNOWN : SENSOR_NOMINAL;
+        case 'w':
+            return strcmp(status_string, "warn") ? SENSOR_UNKNOWN : SENSOR_WARN;
+        case 'e':
+            return strcmp(status_string, "error") ? SENSOR_UNKNOWN : SENSOR_ERROR;
+        case 'f':
+            return strcmp(status_string, "failure") ? SENSOR_UNKNOWN : SENSOR_FAILURE;
+        case 'i':
+            return strcmp(status_string, "inactive") ? SENSOR_UNKNOWN : SENSOR_INACTIVE;
+        case 'u':
+            return strcmp(status_string, "unreachable") ? SENSOR_UNKNOWN : SENSOR_UNREACHABLE;
+        default:
+            return SENSOR_UNKNOWN;
     }
-    return new_sensor;
 }
 
 
 /**
- * \fn      void sensor_destroy(struct sensor *this_sensor)
- * \details Free the memory associated with the sensor object.
- * \param   this_sensor A pointer to the sensor to be destroyed.
- * \return  void
+ * \fn      char *sensor_status_to_string(enum sensor_status status)
+ * \details Get the KATCP name of a status. This is also the CSS class used to render it.
+ * \param   status The status in question.
+ * \return  A static string, which must not be freed.
  */
-void sensor_destroy(struct sensor *this_sensor)
+char *sensor_status_to_string(enum sensor_status status)
 {
-    if (this_sensor != NULL)
+    if ((unsigned int) status >= sizeof(sensor_status_names)/sizeof(*sensor_status_names))
+        return sensor_status_names[SENSOR_UNKNOWN];
+    return sensor_status_names[status];
+}
+
+
+/**
+ * \fn      struct sensor *sensor_create(char *new_name, struct sensor_table *table, size_t device)
+ * \details Allocate memory for a sensor object and give it a row in the table, with sensible default values.
+ * \param   new_name A name for the sensor to be created.
+ * \param   table The table in which to keep the sensor's state. The sensor itself comes from the table's arena, and is freed along with it.
+ * \param   device The table's number for the device to which the sensor belongs, SENSOR_TABLE_NONE for a top-level sensor.
+ * \return  A pointer to the newly-created sensor object, NULL on failure.
+ */
+struct sensor *sensor_create(char *new_name, struct sensor_table *table, size_t device)
+{
+    /* TODO think about sanitising the name a bit perhaps. */
+    struct arena *arena = sensor_table_get_arena(table);
+    struct sensor *new_sensor = arena_alloc(arena, sizeof(*new_sensor));
+    if (new_sensor != NULL)
     {
-        free(this_sensor->name);
-        free(this_sensor->value);
-        free(this_sensor->status);
-        free(this_sensor);
+        new_sensor->name = arena_strdup(arena, new_name);
+        new_sensor->table = table;
+        new_sensor->watcher = NULL;
+        new_sensor->watcher_data = NULL;
+        new_sensor->row = sensor_table_add_sensor(table, device, new_sensor);
+        if (new_sensor->row == SENSOR_TABLE_NONE)
+            return NULL;
     }
+    return new_sensor;
 }
 
 
@@ -72,50 +125,166 @@ char *sensor_get_name(struct sensor *this_sensor)
  * \details Get the value of the given sensor.
  * \param   this_sensor A pointer to the sensor to be queried.
  * \return  A pointer to the value string of the sensor. The char pointer is
- *          not newly allocated so therefore must not be free'd.
+ *          not newly allocated so therefore must not be free'd, and it is
+ *          only good until the next sensor in the array is created or updated.
  */
 char *sensor_get_value(struct sensor *this_sensor)
 {
-    return this_sensor->value;
+    return sensor_table_get_value(this_sensor->table, this_sensor->row);
 }
 
 
 /**
- * \fn      char *sensor_get_status(struct sensor *this_sensor)
+ * \fn      enum sensor_status sensor_get_status(struct sensor *this_sensor)
  * \details Get the status of the given sensor.
  * \param   this_sensor A pointer to the sensor to be queried.
- * \return  A pointer to the status string of the sensor. The char pointer is
- *          not newly allocated so therefore must not be free'd.
+ * \return  The status of the sensor.
+ */
+enum sensor_status sensor_get_status(struct sensor *this_sensor)
+{
+    return sensor_table_get_status(this_sensor->table, this_sensor->row);
+}
+
+
+/**
+ * \fn      time_t sensor_get_last_updated(struct sensor *this_sensor)
+ * \details Get the time at which the given sensor was last updated.
+ * \param   this_sensor A pointer to the sensor to be queried.
+ * \return  The time of the last update, 0 if there hasn't been one.
  */
-char *sensor_get_status(struct sensor *this_sensor)
+time_t sensor_get_last_updated(struct sensor *this_sensor)
 {
-    return this_sensor->status;
+    return sensor_table_get_last_updated(this_sensor->table, this_sensor->row);
 }
 
 
 /**
- * \fn      int sensor_update(struct sensor *this_sensor, char *new_value, char *new_status)
- * \details Update the given sensor's value and status.
+ * \fn      size_t sensor_get_history(struct sensor *this_sensor, struct history_entry *entries, size_t max_entries)
+ * \details Get the latest changes to the given sensor's value or status, oldest first. At most HISTORY_DEPTH are remembered, and
+ *          values are cut short at HISTORY_VALUE_SIZE - 1 characters.
+ * \param   this_sensor A pointer to the sensor to be queried.
+ * \param   entries Where to put the changes.
+ * \param   max_entries The number of entries for which there is room. If there have been more changes, only the latest are given.
+ * \return  The number of entries filled in. Zero if the sensor hasn't changed, or if no room could be found for its history.
+ */
+size_t sensor_get_history(struct sensor *this_sensor, struct history_entry *entries, size_t max_entries)
+{
+    return sensor_table_get_history(this_sensor->table, this_sensor->row, entries, max_entries);
+}
+
+
+/**
+ * \fn      size_t sensor_get_row(struct sensor *this_sensor)
+ * \details Get the given sensor's row in its table, for code which would rather look at the table's columns directly.
+ * \param   this_sensor A pointer to the sensor to be queried.
+ * \return  The row number.
+ */
+size_t sensor_get_row(struct sensor *this_sensor)
+{
+    return this_sensor->row;
+}
+
+
+/**
+ * \fn      void sensor_set_full_name(struct sensor *this_sensor, char *full_name)
+ * \details Give the sensor its full KATCP name (e.g. "xhost03.xeng.vacc.device-status"), by which it can be asked for again.
+ * \param   this_sensor A pointer to the sensor in question.
+ * \param   full_name The name. It isn't copied, so it needs to last as long as the sensor.
+ * \return  void
+ */
+void sensor_set_full_name(struct sensor *this_sensor, char *full_name)
+{
+    sensor_table_set_full_name(this_sensor->table, this_sensor->row, full_name);
+}
+
+
+/**
+ * \fn      char *sensor_get_full_name(struct sensor *this_sensor)
+ * \details Get the full KATCP name of the given sensor.
+ * \param   this_sensor A pointer to the sensor to be queried.
+ * \return  The name, or NULL if it hasn't been given one. It must not be freed.
+ */
+char *sensor_get_full_name(struct sensor *this_sensor)
+{
+    return sensor_table_get_full_name(this_sensor->table, this_sensor->row);
+}
+
+
+/**
+ * \fn      int sensor_update(struct sensor *this_sensor, char *new_value, enum sensor_status new_status)
+ * \details Update the given sensor's value and status, timestamped with the local time. See sensor_update_timestamped().
  * \param   this_sensor A pointer to the sensor to be updated.
  * \param   new_value A string to replace the given sensor's stored sensor value.
- * \param   new_status A string to replace the given sensor's stored operational status.
+ * \param   new_status The sensor's new operational status.
+ * \return  An integer indicating the success of the operation, as for sensor_update_timestamped().
+ */
+int sensor_update(struct sensor *this_sensor, char *new_value, enum sensor_status new_status)
+{
+    return sensor_update_timestamped(this_sensor, new_value, new_status, 0);
+}
+
+
+/**
+ * \fn      int sensor_update_timestamped(struct sensor *this_sensor, char *new_value, enum sensor_status new_status, time_t timestamp)
+ * \details Update the given sensor's value and status, in its row of the table. If the status changes, the watcher (if any) is told.
+ * \param   this_sensor A pointer to the sensor to be updated.
+ * \param   new_value A string to replace the given sensor's stored sensor value.
+ * \param   new_status The sensor's new operational status.
+ * \param   timestamp The time of the update according to its source, i.e. the timestamp of the KATCP inform. 0 for the local time.
  * \return  An integer indicating the success of the operation.
  */
-int sensor_update(struct sensor *this_sensor, char *new_value, char *new_status)
+int sensor_update_timestamped(struct sensor *this_sensor, char *new_value, enum sensor_status new_status, time_t timestamp)
 {
     if (this_sensor == NULL)
         return -2; /// \retval -2 The sensor pointer was null - the sensor has not yet been created.
-    if (this_sensor->value != NULL)
-        free(this_sensor->value);
-    if (this_sensor->status != NULL)
-        free(this_sensor->status);
-    this_sensor->value = strdup(new_value);
-    this_sensor->status = strdup(new_status);
-
-    if (this_sensor->value != NULL && this_sensor->status != NULL)
-    {
-        return 0; /// \retval 0 The update was successful.
-    }
-    else
-        return -1; /// \retval -1 The sensor object exists but its member strings weren't successfully updated.
+    enum sensor_status old_status = sensor_table_get_status(this_sensor->table, this_sensor->row);
+    /// \retval 1 The value and status were the same as before, so nothing needed doing.
+    /// \retval -1 The sensor object exists but there wasn't memory for its new value.
+    /// \retval 0 The update was successful.
+    int r = sensor_table_update(this_sensor->table, this_sensor->row, new_value, new_status, timestamp);
+    if (r == 0 && old_status != new_status && this_sensor->watcher != NULL)
+        this_sensor->watcher(this_sensor->watcher_data, old_status, new_status);
+    return r;
+}
+
+
+/**
+ * \fn      int sensor_set_watcher(struct sensor *this_sensor, sensor_watcher watcher, void *data)
+ * \details Arrange for something to be told whenever the sensor's status changes. A sensor has only one watcher; setting another
+ *          replaces it.
+ * \param   this_sensor A pointer to the sensor in question.
+ * \param   watcher The function to call.
+ * \param   data What to pass to the function.
+ * \return  An integer indicating the outcome of the operation.
+ */
+int sensor_set_watcher(struct sensor *this_sensor, sensor_watcher watcher, void *data)
+{
+    if (this_sensor->watcher == watcher && this_sensor->watcher_data == data)
+        return 1; /// \retval 1 The sensor was already being watched by this watcher, so nothing changed.
+    this_sensor->watcher = watcher;
+    this_sensor->watcher_data = data;
+    return 0; /// \retval 0 The watcher was set.
+}
+
+
+/**
+ * \fn      int sensor_json(struct sensor *this_sensor, struct json_writer *json, unsigned int fields)
+ * \details Write the sensor as a JSON object: its name, and whichever of its status, value and time of last update are asked for.
+ * \param   this_sensor A pointer to the sensor.
+ * \param   json The json_writer to which the object is written.
+ * \param   fields The JSON_FIELD_* flags saying which fields to write.
+ * \return  0 on success, -1 if the writer has failed.
+ */
+int sensor_json(struct sensor *this_sensor, struct json_writer *json, unsigned int fields)
+{
+    json_begin_object(json);
+    json_key_string(json, "name", this_sensor->name);
+    if (fields & JSON_FIELD_STATUS)
+        json_key_string(json, "status", sensor_status_to_string(sensor_get_status(this_sensor)));
+    if (fields & JSON_FIELD_VALUE)
+        json_key_string(json, "value", sensor_get_value(this_sensor));
+    if (fields & JSON_FIELD_UPDATED)
+        json_key_integer(json, "updated", (long long) sensor_get_last_updated(this_sensor));
+    json_end_object(json);
+    return json_writer_has_failed(json) ? -1 : 0;
 }
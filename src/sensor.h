@@ -1,21 +1,54 @@
 #ifndef _SENSOR_H_
 #define _SENSOR_H_
 #include <time.h>
+#include <stdint.h>
+#include "history.h"
+#include "json.h"
 
 /**
  * \file   sensor.h
- * \brief  The sensor type stores the name, value and status of a sensor.
- *         It is meant to be a member of a device object.
+ * \brief  The sensor type gives the name, value and status of a sensor.
+ *         It is meant to be a member of a device object. The value and status
+ *         themselves are kept in the array's sensor_table, along with a
+ *         short history of the sensor's recent changes.
  */
 
+/// The statuses that a sensor can have, according to the KATCP spec. Anything unrecognised is treated as unknown.
+enum sensor_status {
+    SENSOR_UNKNOWN,
+    SENSOR_NOMINAL,
+    SENSOR_WARN,
+    SENSOR_ERROR,
+    SENSOR_FAILURE,
+    SENSOR_UNREACHABLE,
+    SENSOR_INACTIVE,
+};
+/// The number of different statuses, for sizing arrays indexed by them.
+#define SENSOR_NUMBER_OF_STATUSES (SENSOR_INACTIVE + 1)
+
 struct sensor;
+struct sensor_table;
+
+/// Called when a sensor's status changes, with the data given to sensor_set_watcher().
+typedef void (*sensor_watcher)(void *data, enum sensor_status old_status, enum sensor_status new_status);
 
-struct sensor *sensor_create(char *new_name);
-void sensor_destroy(struct sensor *this_sensor);
+enum sensor_status sensor_status_from_string(char *status_string);
+char *sensor_status_to_string(enum sensor_status status);
+
+struct sensor *sensor_create(char *new_name, struct sensor_table *table, size_t device);
 char *sensor_get_name(struct sensor *this_sensor);
 char *sensor_get_value(struct sensor *this_sensor);
-char *sensor_get_status(struct sensor *this_sensor);
-int sensor_update(struct sensor *this_sensor, char *new_value, char *new_status);
+enum sensor_status sensor_get_status(struct sensor *this_sensor);
+time_t sensor_get_last_updated(struct sensor *this_sensor);
+size_t sensor_get_history(struct sensor *this_sensor, struct history_entry *entries, size_t max_entries);
+size_t sensor_get_row(struct sensor *this_sensor);
+void sensor_set_full_name(struct sensor *this_sensor, char *full_name);
+char *sensor_get_full_name(struct sensor *this_sensor);
+int sensor_update(struct sensor *this_sensor, char *new_value, enum sensor_status new_status);
+int sensor_update_timestamped(struct sensor *this_sensor, char *new_value, enum sensor_status new_status, time_t timestamp);
+int sensor_set_watcher(struct sensor *this_sensor, sensor_watcher watcher, void *data);
+
+int sensor_json(struct sensor *this_sensor, struct json_writer *json, unsigned int fields);
 
 #endif
 
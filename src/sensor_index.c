@@ -0,0 +1,212 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <syslog.h>
+
+#include "sensor_index.h"
+#include "sensor.h"
+#include "arena.h"
+
+/// The number of slots that a new index starts with. Must be a power of two.
+#define SENSOR_INDEX_INITIAL_SLOTS 256
+
+/// FNV-1a parameters, 64-bit flavour.
+#define FNV_OFFSET_BASIS 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+
+/// A single slot in the index. A NULL name means the slot is empty.
+struct sensor_index_slot {
+    /// The hash of the name, kept so that most mismatches can be rejected without a strcmp, and so that growing needn't rehash.
+    uint64_t hash;
+    /// The full name of the sensor.
+    char *name;
+    /// The sensor itself.
+    struct sensor *sensor;
+};
+
+
+/// A struct to hold the hash table.
+struct sensor_index {
+    /// The slots of the table. Collisions are resolved by linear probing.
+    struct sensor_index_slot *slot_list;
+    /// The number of slots in the table, always a power of two.
+    size_t number_of_slots;
+    /// The number of slots in use. Kept below half of the number of slots so that probe sequences stay short.
+    size_t number_of_sensors;
+    /// Where the copies of the names are kept.
+    struct arena *arena;
+};
+
+
+/**
+ * \fn      static uint64_t sensor_index_hash(char *full_name)
+ * \details Hash a sensor name with FNV-1a.
+ */
+static uint64_t sensor_index_hash(char *full_name)
+{
+    uint64_t hash = FNV_OFFSET_BASIS;
+    unsigned char *c;
+    for (c = (unsigned char *) full_name; *c != '\0'; c++)
+    {
+        hash ^= *c;
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+
+/**
+ * \fn      struct sensor_index *sensor_index_create(struct arena *arena)
+ * \details Allocate memory for an empty sensor_index.
+ * \param   arena The arena in which to keep the index's copies of the names, normally the one holding the sensors themselves.
+ * \return  A pointer to the newly-allocated sensor_index, NULL on failure.
+ */
+struct sensor_index *sensor_index_create(struct arena *arena)
+{
+    struct sensor_index *new_index = malloc(sizeof(*new_index));
+    if (new_index != NULL)
+    {
+        new_index->slot_list = calloc(SENSOR_INDEX_INITIAL_SLOTS, sizeof(*(new_index->slot_list)));
+        if (new_index->slot_list == NULL)
+        {
+            free(new_index);
+            return NULL;
+        }
+        new_index->number_of_slots = SENSOR_INDEX_INITIAL_SLOTS;
+        new_index->number_of_sensors = 0;
+        new_index->arena = arena;
+    }
+    return new_index;
+}
+
+
+/**
+ * \fn      void sensor_index_destroy(struct sensor_index *this_index)
+ * \details Free the memory associated with the sensor_index. The sensors and the names are left to their arena.
+ * \param   this_index A pointer to the sensor_index to be destroyed.
+ * \return  void
+ */
+void sensor_index_destroy(struct sensor_index *this_index)
+{
+    if (this_index != NULL)
+    {
+        free(this_index->slot_list);
+        free(this_index);
+    }
+}
+
+
+/**
+ * \fn      static struct sensor_index_slot *sensor_index_probe(struct sensor_index_slot *slot_list, size_t number_of_slots, uint64_t hash, char *full_name)
+ * \details Find the slot which holds the given name, or the empty slot where it would go if it isn't there.
+ */
+static struct sensor_index_slot *sensor_index_probe(struct sensor_index_slot *slot_list, size_t number_of_slots, uint64_t hash, char *full_name)
+{
+    size_t mask = number_of_slots - 1;
+    size_t i = (size_t) hash & mask;
+    while (slot_list[i].name != NULL)
+    {
+        if (slot_list[i].hash == hash && !strcmp(slot_list[i].name, full_name))
+            break;
+        i = (i + 1) & mask;
+    }
+    return &slot_list[i];
+}
+
+
+/**
+ * \fn      static int sensor_index_grow(struct sensor_index *this_index)
+ * \details Double the number of slots in the index, and move everything across.
+ */
+static int sensor_index_grow(struct sensor_index *this_index)
+{
+    size_t new_number_of_slots = this_index->number_of_slots*2;
+    struct sensor_index_slot *new_slot_list = calloc(new_number_of_slots, sizeof(*new_slot_list));
+    if (new_slot_list == NULL)
+        return -1;
+
+    size_t i;
+    for (i = 0; i < this_index->number_of_slots; i++)
+    {
+        if (this_index->slot_list[i].name != NULL)
+        {
+            //The names are known to be unique, so there's no need to compare them; the first free slot will do.
+            size_t j = (size_t) this_index->slot_list[i].hash & (new_number_of_slots - 1);
+            while (new_slot_list[j].name != NULL)
+                j = (j + 1) & (new_number_of_slots - 1);
+            new_slot_list[j] = this_index->slot_list[i];
+        }
+    }
+    free(this_index->slot_list);
+    this_index->slot_list = new_slot_list;
+    this_index->number_of_slots = new_number_of_slots;
+    return 0;
+}
+
+
+/**
+ * \fn      int sensor_index_insert(struct sensor_index *this_index, char *full_name, struct sensor *this_sensor)
+ * \details Add a sensor to the index under its full name. If the name is already there, it is simply pointed at the given sensor.
+ *          The sensor is given the index's copy of the name, so that it can be asked for by name later.
+ * \param   this_index A pointer to the sensor_index in question.
+ * \param   full_name The full KATCP name of the sensor, as it will appear in #sensor-status informs.
+ * \param   this_sensor A pointer to the sensor object.
+ * \return  An integer indicating the outcome of the operation.
+ */
+int sensor_index_insert(struct sensor_index *this_index, char *full_name, struct sensor *this_sensor)
+{
+    if (this_index == NULL || full_name == NULL || this_sensor == NULL)
+        return -1; /// \retval -1 The arguments were invalid, e.g. the sensor doesn't exist.
+
+    if ((this_index->number_of_sensors + 1)*2 > this_index->number_of_slots)
+    {
+        if (sensor_index_grow(this_index) < 0)
+        {
+            syslog(LOG_ERR, "Unable to grow the sensor index to fit %s.", full_name);
+            return -2; /// \retval -2 Memory allocation failed.
+        }
+    }
+
+    uint64_t hash = sensor_index_hash(full_name);
+    struct sensor_index_slot *slot = sensor_index_probe(this_index->slot_list, this_index->number_of_slots, hash, full_name);
+    if (slot->name == NULL)
+    {
+        slot->name = arena_strdup(this_index->arena, full_name);
+        if (slot->name == NULL)
+            return -2;
+        slot->hash = hash;
+        this_index->number_of_sensors++;
+    }
+    slot->sensor = this_sensor;
+    sensor_set_full_name(this_sensor, slot->name);
+    return 0; /// \retval 0 The sensor was added.
+}
+
+
+/**
+ * \fn      struct sensor *sensor_index_find(struct sensor_index *this_index, char *full_name)
+ * \details Look up a sensor by its full name.
+ * \param   this_index A pointer to the sensor_index in question.
+ * \param   full_name The full KATCP name of the sensor.
+ * \return  A pointer to the sensor, or NULL if there isn't one by that name.
+ */
+struct sensor *sensor_index_find(struct sensor_index *this_index, char *full_name)
+{
+    if (this_index == NULL || full_name == NULL)
+        return NULL;
+    uint64_t hash = sensor_index_hash(full_name);
+    return sensor_index_probe(this_index->slot_list, this_index->number_of_slots, hash, full_name)->sensor;
+}
+
+
+/**
+ * \fn      size_t sensor_index_get_size(struct sensor_index *this_index)
+ * \details Get the number of sensors in the index.
+ * \param   this_index A pointer to the sensor_index in question.
+ * \return  The number of sensors in the index.
+ */
+size_t sensor_index_get_size(struct sensor_index *this_index)
+{
+    return this_index->number_of_sensors;
+}
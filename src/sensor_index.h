@@ -0,0 +1,25 @@
+#ifndef _SENSOR_INDEX_H_
+#define _SENSOR_INDEX_H_
+
+#include <stddef.h>
+#include "sensor.h"
+
+/**
+ * \file  sensor_index.h
+ * \brief The sensor_index type maps full KATCP sensor names (e.g. "xhost03.xeng.vacc.device-status") straight to the sensor objects in
+ *        an array's tree, so that incoming updates don't need to be tokenised and walked down team, host and device. It is an
+ *        open-addressing hash table. The index doesn't own the sensors, and keeps its copies of their names in the
+ *        same arena as them.
+ */
+
+struct sensor_index;
+struct arena;
+
+struct sensor_index *sensor_index_create(struct arena *arena);
+void sensor_index_destroy(struct sensor_index *this_index);
+
+int sensor_index_insert(struct sensor_index *this_index, char *full_name, struct sensor *this_sensor);
+struct sensor *sensor_index_find(struct sensor_index *this_index, char *full_name);
+size_t sensor_index_get_size(struct sensor_index *this_index);
+
+#endif
@@ -0,0 +1,931 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <syslog.h>
+
+#include "sensor_table.h"
+#include "sensor.h"
+#include "history.h"
+#include "timers.h"
+
+/// The number of rows, hosts or devices for which room is made at first. The columns double from there.
+#define SENSOR_TABLE_INITIAL_CAPACITY 64
+/// The space set aside in the value pool for each new row. Counters, booleans and the like all fit, so only the odd long value needs more.
+#define SENSOR_TABLE_VALUE_SIZE 32
+/// What a sensor's value is before anything has been heard from it.
+#define SENSOR_TABLE_INITIAL_VALUE "unused"
+
+
+/// A struct to hold the columns. Row, host and device numbers are indices into the respective columns.
+/// The number of rows with each status is also kept for each host and team and for the table as a whole, and moved from one count to
+/// another as statuses change, so that questions like "how many sensors in the array are in error" cost nothing to answer.
+/// Rows whose sensors have a full KATCP name (i.e. those which can be asked for again) are also threaded onto a recency list, in the
+/// order in which they were last heard from (whether or not anything changed), so that the ones which have gone quiet are always at
+/// the front and can be found without looking at the rest. A row which has been asked for again is parked, i.e. taken off the list,
+/// and only goes back on when it changes: a sensor which is subscribed with the "auto" strategy and never changes is never heard
+/// from, and would otherwise be asked for again every time it went quiet for long enough.
+/// Every change is stamped with a generation number, taken from a counter which only goes up. Each row, device, host and team
+/// remembers the generation of the latest change in or beneath it, and the table's own generation is that of the latest change
+/// anywhere. Something which has rendered (or cached, or sent) part of the model need only remember the generation at the time, and
+/// can tell that the part is still current if its generation hasn't moved past that.
+struct sensor_table {
+    /// Where the sensors and the rest of the array's model live. The table only hands it out.
+    struct arena *arena;
+    /// Where rows get their history rings from. NULL if history isn't being kept.
+    struct history_pool *history_pool;
+    /// Whose cached clock says when rows were heard from. NULL if staleness isn't being kept track of.
+    struct timers *timers;
+    /// The generation of the latest change to anything in the table.
+    uint64_t generation;
+    /// The number of rows with each status, indexed by enum sensor_status.
+    uint32_t status_count[SENSOR_NUMBER_OF_STATUSES];
+
+    /// The status of each row, an enum sensor_status. It only needs a byte.
+    uint8_t *status;
+    /// Where each row's value starts in value_pool.
+    uint32_t *value_offset;
+    /// How much space each row has in value_pool.
+    uint32_t *value_capacity;
+    /// When each row was last updated, according to the source of the update. This is what's shown, but staleness isn't judged by it:
+    /// it's on the servlet's clock, and a sensor's timestamp is that of its last change, which a reply to a request for it repeats.
+    time_t *last_updated;
+    /// When each row was last heard from, in milliseconds on the monotonic clock of the timers, so that the system clock being set
+    /// doesn't make every row look stale at once (or none). Rows which have never been heard from have the time they were added.
+    uint64_t *last_heard;
+    /// Whether each row is on the recency list. Rows without a full name never are, and parked rows are taken off it.
+    uint8_t *recent_listed;
+    /// The row on the recency list heard from just before each row, SENSOR_TABLE_NONE for the one heard from longest ago.
+    uint32_t *recent_prev;
+    /// The row on the recency list heard from just after each row, SENSOR_TABLE_NONE for the one heard from most recently.
+    uint32_t *recent_next;
+    /// The full KATCP name of each row's sensor, NULL if it hasn't been given one (in which case the row isn't on the recency list).
+    /// Not a copy.
+    char **full_name;
+    /// The host which owns each row, SENSOR_TABLE_NONE for top-level sensors.
+    uint32_t *host;
+    /// The device which owns each row, SENSOR_TABLE_NONE for top-level sensors.
+    uint32_t *device;
+    /// The sensor object which is a view onto each row, for when a scan needs a sensor's name.
+    struct sensor **sensor;
+    /// The generation of the latest change to each row.
+    uint64_t *row_generation;
+    /// The recent changes to each row. A row only gets a ring when it first changes, and goes without if the pool has none to spare.
+    struct history_ring **history;
+    /// The number of rows in use.
+    size_t number_of_rows;
+    /// The number of rows for which the columns have room.
+    size_t row_capacity;
+    /// The row heard from longest ago, SENSOR_TABLE_NONE if the recency list is empty.
+    uint32_t recent_head;
+    /// The row heard from most recently, SENSOR_TABLE_NONE if the recency list is empty.
+    uint32_t recent_tail;
+
+    /// The values themselves, NUL-terminated, back to back.
+    char *value_pool;
+    /// The number of bytes of value_pool handed out.
+    size_t value_pool_used;
+    /// The size of value_pool.
+    size_t value_pool_size;
+
+    /// The type ('f' or 'x') of each team. Teams aren't added explicitly; one appears when the first host of its type does.
+    char *team_type;
+    /// The generation of the latest change to anything in each team.
+    uint64_t *team_generation;
+    /// The number of each team's rows with each status.
+    uint32_t (*team_status_count)[SENSOR_NUMBER_OF_STATUSES];
+    /// The number of teams. There are only ever a handful, so the columns are simply grown by one each time.
+    size_t number_of_teams;
+
+    /// The type ('f' or 'x') of each host.
+    char *host_type;
+    /// The team to which each host belongs.
+    uint32_t *host_team;
+    /// The generation of the latest change to anything on each host.
+    uint64_t *host_generation;
+    /// The number of each host's rows with each status.
+    uint32_t (*host_status_count)[SENSOR_NUMBER_OF_STATUSES];
+    /// The number of each host in its team.
+    int *host_number;
+    /// The number of hosts registered.
+    size_t number_of_hosts;
+    /// The number of hosts for which there is room.
+    size_t host_capacity;
+
+    /// The host to which each device belongs.
+    uint32_t *device_host;
+    /// The name of each device. Not a copy - the device's own name, which lives as long as the table does.
+    char **device_name;
+    /// The generation of the latest change to each device's sensors.
+    uint64_t *device_generation;
+    /// The number of devices registered.
+    size_t number_of_devices;
+    /// The number of devices for which there is room.
+    size_t device_capacity;
+};
+
+
+/**
+ * \fn      static int sensor_table_grow_column(void *column, size_t new_capacity, size_t element_size)
+ * \details Resize one column. The column is only replaced on success, so a failure part-way through growing several columns leaves
+ *          them all usable at the old capacity.
+ * \param   column A pointer to the column pointer.
+ * \param   new_capacity The number of elements wanted.
+ * \param   element_size The size of each element.
+ * \return  0 on success, -1 on failure.
+ */
+static int sensor_table_grow_column(void *column, size_t new_capacity, size_t element_size)
+{
+    void **column_pointer = column;
+    void *temp = realloc(*column_pointer, new_capacity*element_size);
+    if (temp == NULL)
+        return -1;
+    *column_pointer = temp;
+    return 0;
+}
+
+
+/**
+ * \fn      static char *sensor_table_reserve_value(struct sensor_table *this_table, size_t size, uint32_t *offset)
+ * \details Set aside space at the end of the value pool, growing the pool if need be. The pool may move, so pointers into it mustn't be
+ *          kept across calls to this.
+ * \param   this_table A pointer to the table in question.
+ * \param   size The number of bytes wanted.
+ * \param   offset Set to where in the pool the space starts.
+ * \return  A pointer to the space, NULL on failure.
+ */
+static char *sensor_table_reserve_value(struct sensor_table *this_table, size_t size, uint32_t *offset)
+{
+    if (this_table->value_pool_used + size > this_table->value_pool_size)
+    {
+        size_t new_size = this_table->value_pool_size ? this_table->value_pool_size : SENSOR_TABLE_INITIAL_CAPACITY*SENSOR_TABLE_VALUE_SIZE;
+        while (new_size < this_table->value_pool_used + size)
+            new_size *= 2;
+        if (new_size > UINT32_MAX || sensor_table_grow_column(&this_table->value_pool, new_size, 1) < 0)
+            return NULL;
+        this_table->value_pool_size = new_size;
+    }
+    *offset = (uint32_t) this_table->value_pool_used;
+    this_table->value_pool_used += size;
+    return this_table->value_pool + *offset;
+}
+
+
+/**
+ * \fn      struct sensor_table *sensor_table_create(struct arena *arena, struct history_pool *history_pool, struct timers *timers)
+ * \details Allocate memory for an empty sensor_table.
+ * \param   arena The arena in which the array's model is being built. The table itself doesn't use it, but it's what the model's
+ *          objects get it from, so that only the table needs to be passed around.
+ * \param   history_pool The pool from which to take history rings for the rows, NULL to keep no history.
+ * \param   timers The timers whose cached monotonic clock tells when rows were last heard from. NULL to leave every row heard from at
+ *          time zero, where nothing will look for stale rows.
+ * \return  A pointer to the newly-allocated sensor_table, NULL on failure.
+ */
+struct sensor_table *sensor_table_create(struct arena *arena, struct history_pool *history_pool, struct timers *timers)
+{
+    struct sensor_table *new_table = calloc(1, sizeof(*new_table)); //Every column starts out NULL and empty.
+    if (new_table != NULL)
+    {
+        new_table->arena = arena;
+        new_table->history_pool = history_pool;
+        new_table->timers = timers;
+        new_table->recent_head = SENSOR_TABLE_NONE;
+        new_table->recent_tail = SENSOR_TABLE_NONE;
+    }
+    return new_table;
+}
+
+
+/**
+ * \fn      void sensor_table_destroy(struct sensor_table *this_table)
+ * \details Free the memory associated with the sensor_table, and give the rows' history rings back to the pool. The sensor objects
+ *          belong to the arena and are left alone.
+ * \param   this_table A pointer to the sensor_table to be destroyed.
+ * \return  void
+ */
+void sensor_table_destroy(struct sensor_table *this_table)
+{
+    if (this_table != NULL)
+    {
+        if (this_table->history_pool != NULL)
+        {
+            size_t i;
+            for (i = 0; i < this_table->number_of_rows; i++)
+                history_ring_release(this_table->history_pool, this_table->history[i]);
+        }
+        free(this_table->history);
+        free(this_table->status);
+        free(this_table->value_offset);
+        free(this_table->value_capacity);
+        free(this_table->last_updated);
+        free(this_table->last_heard);
+        free(this_table->recent_listed);
+        free(this_table->recent_prev);
+        free(this_table->recent_next);
+        free(this_table->full_name);
+        free(this_table->host);
+        free(this_table->device);
+        free(this_table->sensor);
+        free(this_table->row_generation);
+        free(this_table->value_pool);
+        free(this_table->team_type);
+        free(this_table->team_generation);
+        free(this_table->team_status_count);
+        free(this_table->host_type);
+        free(this_table->host_team);
+        free(this_table->host_number);
+        free(this_table->host_generation);
+        free(this_table->host_status_count);
+        free(this_table->device_host);
+        free(this_table->device_name);
+        free(this_table->device_generation);
+        free(this_table);
+    }
+}
+
+
+/**
+ * \fn      struct arena *sensor_table_get_arena(struct sensor_table *this_table)
+ * \details Get the arena from which the array's model is allocated.
+ * \param   this_table A pointer to the sensor_table in question.
+ * \return  A pointer to the arena.
+ */
+struct arena *sensor_table_get_arena(struct sensor_table *this_table)
+{
+    return this_table->arena;
+}
+
+
+/**
+ * \fn      static size_t sensor_table_find_team(struct sensor_table *this_table, char type)
+ * \details Find the team of hosts of the given type.
+ * \return  The table's number for the team, SENSOR_TABLE_NONE if there isn't one yet.
+ */
+static size_t sensor_table_find_team(struct sensor_table *this_table, char type)
+{
+    size_t i;
+    for (i = 0; i < this_table->number_of_teams; i++)
+    {
+        if (this_table->team_type[i] == type)
+            return i;
+    }
+    return SENSOR_TABLE_NONE;
+}
+
+
+/**
+ * \fn      size_t sensor_table_add_host(struct sensor_table *this_table, char type, int host_number)
+ * \details Register a host with the table.
+ * \param   this_table A pointer to the sensor_table in question.
+ * \param   type The host's type ('f' or 'x').
+ * \param   host_number The host's number in its team.
+ * \return  The host's number in the table, SENSOR_TABLE_NONE on failure.
+ */
+size_t sensor_table_add_host(struct sensor_table *this_table, char type, int host_number)
+{
+    size_t team = sensor_table_find_team(this_table, type);
+    if (team == SENSOR_TABLE_NONE)
+    {
+        team = this_table->number_of_teams;
+        if (sensor_table_grow_column(&this_table->team_type, team + 1, sizeof(*(this_table->team_type))) < 0 ||
+                sensor_table_grow_column(&this_table->team_generation, team + 1, sizeof(*(this_table->team_generation))) < 0 ||
+                sensor_table_grow_column(&this_table->team_status_count, team + 1, sizeof(*(this_table->team_status_count))) < 0)
+        {
+            syslog(LOG_ERR, "Unable to make room in the sensor table for the %c-team.", type);
+            return SENSOR_TABLE_NONE;
+        }
+        this_table->team_type[team] = type;
+        this_table->team_generation[team] = this_table->generation;
+        memset(this_table->team_status_count[team], 0, sizeof(this_table->team_status_count[team]));
+        this_table->number_of_teams++;
+    }
+
+    if (this_table->number_of_hosts == this_table->host_capacity)
+    {
+        size_t new_capacity = this_table->host_capacity ? this_table->host_capacity*2 : SENSOR_TABLE_INITIAL_CAPACITY;
+        if (sensor_table_grow_column(&this_table->host_type, new_capacity, sizeof(*(this_table->host_type))) < 0 ||
+                sensor_table_grow_column(&this_table->host_team, new_capacity, sizeof(*(this_table->host_team))) < 0 ||
+                sensor_table_grow_column(&this_table->host_number, new_capacity, sizeof(*(this_table->host_number))) < 0 ||
+                sensor_table_grow_column(&this_table->host_generation, new_capacity, sizeof(*(this_table->host_generation))) < 0 ||
+                sensor_table_grow_column(&this_table->host_status_count, new_capacity, sizeof(*(this_table->host_status_count))) < 0)
+        {
+            syslog(LOG_ERR, "Unable to make room in the sensor table for %chost%02d.", type, host_number);
+            return SENSOR_TABLE_NONE;
+        }
+        this_table->host_capacity = new_capacity;
+    }
+    this_table->host_type[this_table->number_of_hosts] = type;
+    this_table->host_team[this_table->number_of_hosts] = (uint32_t) team;
+    this_table->host_number[this_table->number_of_hosts] = host_number;
+    this_table->host_generation[this_table->number_of_hosts] = this_table->generation;
+    memset(this_table->host_status_count[this_table->number_of_hosts], 0, sizeof(this_table->host_status_count[this_table->number_of_hosts]));
+    return this_table->number_of_hosts++;
+}
+
+
+/**
+ * \fn      size_t sensor_table_add_device(struct sensor_table *this_table, size_t host, char *name)
+ * \details Register a device with the table. The device, its host and its team get a new generation.
+ * \param   this_table A pointer to the sensor_table in question.
+ * \param   host The table's number for the host on which the device is.
+ * \param   name The device's name. It isn't copied, so it needs to last as long as the table.
+ * \return  The device's number in the table, SENSOR_TABLE_NONE on failure.
+ */
+size_t sensor_table_add_device(struct sensor_table *this_table, size_t host, char *name)
+{
+    if (this_table->number_of_devices == this_table->device_capacity)
+    {
+        size_t new_capacity = this_table->device_capacity ? this_table->device_capacity*2 : SENSOR_TABLE_INITIAL_CAPACITY;
+        if (sensor_table_grow_column(&this_table->device_host, new_capacity, sizeof(*(this_table->device_host))) < 0 ||
+                sensor_table_grow_column(&this_table->device_name, new_capacity, sizeof(*(this_table->device_name))) < 0 ||
+                sensor_table_grow_column(&this_table->device_generation, new_capacity, sizeof(*(this_table->device_generation))) < 0)
+        {
+            syslog(LOG_ERR, "Unable to make room in the sensor table for device %s.", name);
+            return SENSOR_TABLE_NONE;
+        }
+        this_table->device_capacity = new_capacity;
+    }
+    uint64_t generation = ++this_table->generation;
+    this_table->device_host[this_table->number_of_devices] = (uint32_t) host;
+    this_table->device_name[this_table->number_of_devices] = name;
+    this_table->device_generation[this_table->number_of_devices] = generation;
+    this_table->host_generation[host] = generation;
+    this_table->team_generation[this_table->host_team[host]] = generation;
+    return this_table->number_of_devices++;
+}
+
+
+/**
+ * \fn      static void sensor_table_count_status(struct sensor_table *this_table, size_t row, enum sensor_status status, int delta)
+ * \details Add to (or take from) the counts of a status for a row's host, its team and the whole table.
+ */
+static void sensor_table_count_status(struct sensor_table *this_table, size_t row, enum sensor_status status, int delta)
+{
+    this_table->status_count[status] += (uint32_t) delta;
+    size_t host = this_table->host[row];
+    if (host != SENSOR_TABLE_NONE)
+    {
+        this_table->host_status_count[host][status] += (uint32_t) delta;
+        this_table->team_status_count[this_table->host_team[host]][status] += (uint32_t) delta;
+    }
+}
+
+
+/**
+ * \fn      static uint64_t sensor_table_now(struct sensor_table *this_table)
+ * \details Get the time by which rows are heard from: the timers' cached monotonic clock, in milliseconds, or zero if there are none.
+ */
+static uint64_t sensor_table_now(struct sensor_table *this_table)
+{
+    return this_table->timers != NULL ? timers_now(this_table->timers) : 0;
+}
+
+
+/**
+ * \fn      static void sensor_table_recent_append(struct sensor_table *this_table, size_t row)
+ * \details Put a row at the back of the recency list, as the one heard from most recently. It mustn't be on the list already.
+ */
+static void sensor_table_recent_append(struct sensor_table *this_table, size_t row)
+{
+    this_table->recent_prev[row] = this_table->recent_tail;
+    this_table->recent_next[row] = SENSOR_TABLE_NONE;
+    if (this_table->recent_tail == SENSOR_TABLE_NONE)
+        this_table->recent_head = (uint32_t) row;
+    else
+        this_table->recent_next[this_table->recent_tail] = (uint32_t) row;
+    this_table->recent_tail = (uint32_t) row;
+    this_table->recent_listed[row] = 1;
+}
+
+
+/**
+ * \fn      static void sensor_table_recent_unlink(struct sensor_table *this_table, size_t row)
+ * \details Take a row off the recency list.
+ */
+static void sensor_table_recent_unlink(struct sensor_table *this_table, size_t row)
+{
+    uint32_t prev = this_table->recent_prev[row];
+    uint32_t next = this_table->recent_next[row];
+    if (prev == SENSOR_TABLE_NONE)
+        this_table->recent_head = next;
+    else
+        this_table->recent_next[prev] = next;
+    if (next == SENSOR_TABLE_NONE)
+        this_table->recent_tail = prev;
+    else
+        this_table->recent_prev[next] = prev;
+    this_table->recent_listed[row] = 0;
+}
+
+
+/**
+ * \fn      size_t sensor_table_add_sensor(struct sensor_table *this_table, size_t device, struct sensor *this_sensor)
+ * \details Add a row for a sensor. It starts out with an unknown status and the value "unused". The row and everything above it get a
+ *          new generation, since there's now something more to show.
+ * \param   this_table A pointer to the sensor_table in question.
+ * \param   device The table's number for the device which owns the sensor, SENSOR_TABLE_NONE for a top-level sensor.
+ * \param   this_sensor The sensor object which will be the view onto the row.
+ * \return  The new row's number, SENSOR_TABLE_NONE on failure.
+ */
+size_t sensor_table_add_sensor(struct sensor_table *this_table, size_t device, struct sensor *this_sensor)
+{
+    if (this_table->number_of_rows == this_table->row_capacity)
+    {
+        size_t new_capacity = this_table->row_capacity ? this_table->row_capacity*2 : SENSOR_TABLE_INITIAL_CAPACITY;
+        if (sensor_table_grow_column(&this_table->status, new_capacity, sizeof(*(this_table->status))) < 0 ||
+                sensor_table_grow_column(&this_table->value_offset, new_capacity, sizeof(*(this_table->value_offset))) < 0 ||
+                sensor_table_grow_column(&this_table->value_capacity, new_capacity, sizeof(*(this_table->value_capacity))) < 0 ||
+                sensor_table_grow_column(&this_table->last_updated, new_capacity, sizeof(*(this_table->last_updated))) < 0 ||
+                sensor_table_grow_column(&this_table->last_heard, new_capacity, sizeof(*(this_table->last_heard))) < 0 ||
+                sensor_table_grow_column(&this_table->recent_listed, new_capacity, sizeof(*(this_table->recent_listed))) < 0 ||
+                sensor_table_grow_column(&this_table->recent_prev, new_capacity, sizeof(*(this_table->recent_prev))) < 0 ||
+                sensor_table_grow_column(&this_table->recent_next, new_capacity, sizeof(*(this_table->recent_next))) < 0 ||
+                sensor_table_grow_column(&this_table->full_name, new_capacity, sizeof(*(this_table->full_name))) < 0 ||
+                sensor_table_grow_column(&this_table->host, new_capacity, sizeof(*(this_table->host))) < 0 ||
+                sensor_table_grow_column(&this_table->device, new_capacity, sizeof(*(this_table->device))) < 0 ||
+                sensor_table_grow_column(&this_table->sensor, new_capacity, sizeof(*(this_table->sensor))) < 0 ||
+                sensor_table_grow_column(&this_table->row_generation, new_capacity, sizeof(*(this_table->row_generation))) < 0 ||
+                sensor_table_grow_column(&this_table->history, new_capacity, sizeof(*(this_table->history))) < 0)
+        {
+            syslog(LOG_ERR, "Unable to make room in the sensor table for another %zu rows.", new_capacity - this_table->row_capacity);
+            return SENSOR_TABLE_NONE;
+        }
+        this_table->row_capacity = new_capacity;
+    }
+
+    size_t row = this_table->number_of_rows;
+    char *value = sensor_table_reserve_value(this_table, SENSOR_TABLE_VALUE_SIZE, &this_table->value_offset[row]);
+    if (value == NULL)
+        return SENSOR_TABLE_NONE;
+    strcpy(value, SENSOR_TABLE_INITIAL_VALUE);
+    this_table->value_capacity[row] = SENSOR_TABLE_VALUE_SIZE;
+    this_table->status[row] = SENSOR_UNKNOWN;
+    this_table->last_updated[row] = 0;
+    this_table->device[row] = (uint32_t) device;
+    this_table->host[row] = device == SENSOR_TABLE_NONE ? SENSOR_TABLE_NONE : this_table->device_host[device];
+    this_table->sensor[row] = this_sensor;
+    this_table->row_generation[row] = ++this_table->generation;
+    if (device != SENSOR_TABLE_NONE)
+    {
+        this_table->device_generation[device] = this_table->generation;
+        this_table->host_generation[this_table->host[row]] = this_table->generation;
+        this_table->team_generation[this_table->host_team[this_table->host[row]]] = this_table->generation;
+    }
+    this_table->history[row] = NULL;
+    this_table->full_name[row] = NULL;
+    this_table->last_heard[row] = sensor_table_now(this_table);
+    this_table->recent_listed[row] = 0;
+    sensor_table_count_status(this_table, row, SENSOR_UNKNOWN, 1);
+    this_table->number_of_rows++;
+    return row;
+}
+
+
+/**
+ * \fn      size_t sensor_table_get_number_of_rows(struct sensor_table *this_table)
+ * \details Get the number of rows in the table, i.e. the number of sensors.
+ * \param   this_table A pointer to the sensor_table in question.
+ * \return  The number of rows. Rows are numbered from zero up to this.
+ */
+size_t sensor_table_get_number_of_rows(struct sensor_table *this_table)
+{
+    return this_table->number_of_rows;
+}
+
+
+/**
+ * \fn      size_t sensor_table_get_number_of_devices(struct sensor_table *this_table)
+ * \details Get the number of devices registered with the table.
+ * \param   this_table A pointer to the sensor_table in question.
+ * \return  The number of devices. Devices are numbered from zero up to this.
+ */
+size_t sensor_table_get_number_of_devices(struct sensor_table *this_table)
+{
+    return this_table->number_of_devices;
+}
+
+
+/**
+ * \fn      char sensor_table_get_host_type(struct sensor_table *this_table, size_t host)
+ * \details Get the type of a host registered with the table.
+ * \param   this_table A pointer to the sensor_table in question.
+ * \param   host The table's number for the host.
+ * \return  The host's type ('f' or 'x').
+ */
+char sensor_table_get_host_type(struct sensor_table *this_table, size_t host)
+{
+    return this_table->host_type[host];
+}
+
+
+/**
+ * \fn      int sensor_table_get_host_number(struct sensor_table *this_table, size_t host)
+ * \details Get the team number of a host registered with the table.
+ * \param   this_table A pointer to the sensor_table in question.
+ * \param   host The table's number for the host.
+ * \return  The host's number in its team.
+ */
+int sensor_table_get_host_number(struct sensor_table *this_table, size_t host)
+{
+    return this_table->host_number[host];
+}
+
+
+/**
+ * \fn      size_t sensor_table_get_device_host(struct sensor_table *this_table, size_t device)
+ * \details Get the host to which a device belongs.
+ * \param   this_table A pointer to the sensor_table in question.
+ * \param   device The table's number for the device.
+ * \return  The table's number for the device's host.
+ */
+size_t sensor_table_get_device_host(struct sensor_table *this_table, size_t device)
+{
+    return this_table->device_host[device];
+}
+
+
+/**
+ * \fn      char *sensor_table_get_device_name(struct sensor_table *this_table, size_t device)
+ * \details Get the name of a device registered with the table.
+ * \param   this_table A pointer to the sensor_table in question.
+ * \param   device The table's number for the device.
+ * \return  The device's name. It must not be freed.
+ */
+char *sensor_table_get_device_name(struct sensor_table *this_table, size_t device)
+{
+    return this_table->device_name[device];
+}
+
+
+/**
+ * \fn      enum sensor_status sensor_table_get_status(struct sensor_table *this_table, size_t row)
+ * \details Get the status of the sensor in a row.
+ * \param   this_table A pointer to the sensor_table in question.
+ * \param   row The row number.
+ * \return  The sensor's status.
+ */
+enum sensor_status sensor_table_get_status(struct sensor_table *this_table, size_t row)
+{
+    return (enum sensor_status) this_table->status[row];
+}
+
+
+/**
+ * \fn      char *sensor_table_get_value(struct sensor_table *this_table, size_t row)
+ * \details Get the value of the sensor in a row.
+ * \param   this_table A pointer to the sensor_table in question.
+ * \param   row The row number.
+ * \return  The sensor's value. It must not be freed, and is only good until the next change to the table.
+ */
+char *sensor_table_get_value(struct sensor_table *this_table, size_t row)
+{
+    return this_table->value_pool + this_table->value_offset[row];
+}
+
+
+/**
+ * \fn      time_t sensor_table_get_last_updated(struct sensor_table *this_table, size_t row)
+ * \details Get the time at which the sensor in a row was last updated.
+ * \param   this_table A pointer to the sensor_table in question.
+ * \param   row The row number.
+ * \return  The time of the last update, 0 if there hasn't been one.
+ */
+time_t sensor_table_get_last_updated(struct sensor_table *this_table, size_t row)
+{
+    return this_table->last_updated[row];
+}
+
+
+/**
+ * \fn      size_t sensor_table_get_stale_rows(struct sensor_table *this_table, uint64_t quiet_ms, size_t *rows, size_t max_rows)
+ * \details Find the named rows which haven't been heard from for a given time, longest-silent first. Only the stale rows are looked
+ *          at (and one more, to find where they end), because they're all at the front of the recency list. Parked rows aren't found.
+ * \param   this_table A pointer to the sensor_table in question.
+ * \param   quiet_ms Rows which haven't been heard from for longer than this many milliseconds are stale.
+ * \param   rows Where to put the row numbers. May be NULL if max_rows is 0.
+ * \param   max_rows The number of row numbers for which there is room.
+ * \return  The number of row numbers filled in.
+ */
+size_t sensor_table_get_stale_rows(struct sensor_table *this_table, uint64_t quiet_ms, size_t *rows, size_t max_rows)
+{
+    size_t n = 0;
+    uint64_t now = sensor_table_now(this_table);
+    uint32_t row = this_table->recent_head;
+    while (n < max_rows && row != SENSOR_TABLE_NONE && now - this_table->last_heard[row] > quiet_ms)
+    {
+        rows[n++] = row;
+        row = this_table->recent_next[row];
+    }
+    return n;
+}
+
+
+/**
+ * \fn      void sensor_table_park_row(struct sensor_table *this_table, size_t row)
+ * \details Take a row off the recency list once it has been asked for again, so that it isn't found stale again and again if it never
+ *          changes. It goes back onto the list the next time its value or status changes.
+ * \param   this_table A pointer to the sensor_table in question.
+ * \param   row The row number.
+ * \return  void
+ */
+void sensor_table_park_row(struct sensor_table *this_table, size_t row)
+{
+    if (this_table->recent_listed[row])
+        sensor_table_recent_unlink(this_table, row);
+}
+
+
+/**
+ * \fn      void sensor_table_set_full_name(struct sensor_table *this_table, size_t row, char *full_name)
+ * \details Record the full KATCP name of the sensor in a row, so that it can be asked for again by name. The first time a row gets a
+ *          name, it goes onto the back of the recency list, as though it had just been heard from.
+ * \param   this_table A pointer to the sensor_table in question.
+ * \param   row The row number.
+ * \param   full_name The name. It isn't copied, so it needs to last as long as the table.
+ * \return  void
+ */
+void sensor_table_set_full_name(struct sensor_table *this_table, size_t row, char *full_name)
+{
+    if (this_table->full_name[row] == NULL)
+    {
+        this_table->last_heard[row] = sensor_table_now(this_table);
+        sensor_table_recent_append(this_table, row);
+    }
+    this_table->full_name[row] = full_name;
+}
+
+
+/**
+ * \fn      char *sensor_table_get_full_name(struct sensor_table *this_table, size_t row)
+ * \details Get the full KATCP name of the sensor in a row.
+ * \param   this_table A pointer to the sensor_table in question.
+ * \param   row The row number.
+ * \return  The name, or NULL if the row hasn't been given one. It must not be freed.
+ */
+char *sensor_table_get_full_name(struct sensor_table *this_table, size_t row)
+{
+    return this_table->full_name[row];
+}
+
+
+/**
+ * \fn      size_t sensor_table_get_row_host(struct sensor_table *this_table, size_t row)
+ * \details Get the host which owns the sensor in a row.
+ * \param   this_table A pointer to the sensor_table in question.
+ * \param   row The row number.
+ * \return  The table's number for the host, SENSOR_TABLE_NONE for a top-level sensor.
+ */
+size_t sensor_table_get_row_host(struct sensor_table *this_table, size_t row)
+{
+    return this_table->host[row];
+}
+
+
+/**
+ * \fn      size_t sensor_table_get_row_device(struct sensor_table *this_table, size_t row)
+ * \details Get the device which owns the sensor in a row.
+ * \param   this_table A pointer to the sensor_table in question.
+ * \param   row The row number.
+ * \return  The table's number for the device, SENSOR_TABLE_NONE for a top-level sensor.
+ */
+size_t sensor_table_get_row_device(struct sensor_table *this_table, size_t row)
+{
+    return this_table->device[row];
+}
+
+
+/**
+ * \fn      struct sensor *sensor_table_get_row_sensor(struct sensor_table *this_table, size_t row)
+ * \details Get the sensor object whose row it is.
+ * \param   this_table A pointer to the sensor_table in question.
+ * \param   row The row number.
+ * \return  A pointer to the sensor.
+ */
+struct sensor *sensor_table_get_row_sensor(struct sensor_table *this_table, size_t row)
+{
+    return this_table->sensor[row];
+}
+
+
+/**
+ * \fn      size_t sensor_table_get_history(struct sensor_table *this_table, size_t row, struct history_entry *entries, size_t max_entries)
+ * \details Get the recent changes to the sensor in a row.
+ * \param   this_table A pointer to the sensor_table in question.
+ * \param   row The row number.
+ * \param   entries Where to put the changes, oldest first.
+ * \param   max_entries The number of entries for which there is room. If there have been more changes, only the latest are given.
+ * \return  The number of entries filled in, zero if the row has no history.
+ */
+size_t sensor_table_get_history(struct sensor_table *this_table, size_t row, struct history_entry *entries, size_t max_entries)
+{
+    if (this_table->history[row] == NULL)
+        return 0;
+    return history_ring_read(this_table->history[row], entries, max_entries);
+}
+
+
+/**
+ * \fn      int sensor_table_update(struct sensor_table *this_table, size_t row, char *new_value, enum sensor_status new_status, time_t timestamp)
+ * \details Update the value and status in a row. The value is copied into the row's space in the pool, which is only moved to the end of
+ *          the pool if the value has outgrown it. If nothing has changed, only the times of the update are written; otherwise the
+ *          change is added to the row's history. Either way, the row moves to the back of the recency list, unless it's parked and
+ *          nothing has changed.
+ * \param   this_table A pointer to the sensor_table in question.
+ * \param   row The row number.
+ * \param   new_value The new value.
+ * \param   new_status The new status.
+ * \param   timestamp The time of the update according to its source, e.g. a KATCP inform's timestamp. 0 to use the local time.
+ * \return  An integer indicating the outcome of the operation.
+ */
+int sensor_table_update(struct sensor_table *this_table, size_t row, char *new_value, enum sensor_status new_status, time_t timestamp)
+{
+    this_table->last_updated[row] = timestamp ? timestamp : time(0);
+    this_table->last_heard[row] = sensor_table_now(this_table);
+    char *value = this_table->value_pool + this_table->value_offset[row];
+    int unchanged = this_table->status[row] == new_status && !strcmp(value, new_value);
+    if (this_table->full_name[row] != NULL && this_table->recent_tail != row && (this_table->recent_listed[row] || !unchanged))
+    {
+        if (this_table->recent_listed[row])
+            sensor_table_recent_unlink(this_table, row);
+        sensor_table_recent_append(this_table, row);
+    }
+
+    if (unchanged)
+        return 1; /// \retval 1 The value and status were the same as before, so nothing needed doing.
+
+    size_t needed = strlen(new_value) + 1;
+    if (needed > this_table->value_capacity[row])
+    {
+        //Double up, so that a value which keeps growing doesn't leave too much behind in the pool.
+        size_t capacity = this_table->value_capacity[row];
+        while (capacity < needed)
+            capacity *= 2;
+        uint32_t offset;
+        value = sensor_table_reserve_value(this_table, capacity, &offset);
+        if (value == NULL)
+            return -1; /// \retval -1 There wasn't memory for the new value.
+        this_table->value_offset[row] = offset;
+        this_table->value_capacity[row] = (uint32_t) capacity;
+    }
+    memcpy(value, new_value, needed);
+    if (this_table->status[row] != new_status)
+    {
+        sensor_table_count_status(this_table, row, (enum sensor_status) this_table->status[row], -1);
+        sensor_table_count_status(this_table, row, new_status, 1);
+        this_table->status[row] = (uint8_t) new_status;
+    }
+
+    if (this_table->history[row] == NULL && this_table->history_pool != NULL)
+        this_table->history[row] = history_ring_get(this_table->history_pool);
+    if (this_table->history[row] != NULL)
+        history_ring_record(this_table->history[row], this_table->last_updated[row], (uint8_t) new_status, new_value);
+
+    //Stamp the row and everything above it with a new generation.
+    uint64_t generation = ++this_table->generation;
+    this_table->row_generation[row] = generation;
+    size_t device = this_table->device[row];
+    if (device != SENSOR_TABLE_NONE)
+    {
+        size_t host = this_table->device_host[device];
+        this_table->device_generation[device] = generation;
+        this_table->host_generation[host] = generation;
+        this_table->team_generation[this_table->host_team[host]] = generation;
+    }
+    return 0; /// \retval 0 The update was successful.
+}
+
+
+/**
+ * \fn      void sensor_table_touch_host(struct sensor_table *this_table, size_t host)
+ * \details Record a change to something about a host other than its sensors, e.g. its serial number, so that it and its team get a
+ *          new generation.
+ * \param   this_table A pointer to the sensor_table in question.
+ * \param   host The table's number for the host.
+ * \return  void
+ */
+void sensor_table_touch_host(struct sensor_table *this_table, size_t host)
+{
+    uint64_t generation = ++this_table->generation;
+    this_table->host_generation[host] = generation;
+    this_table->team_generation[this_table->host_team[host]] = generation;
+}
+
+
+/**
+ * \fn      void sensor_table_touch(struct sensor_table *this_table)
+ * \details Record a change to something about the array as a whole which isn't in the table, e.g. its config file, so that the
+ *          table's generation moves on.
+ * \param   this_table A pointer to the sensor_table in question.
+ * \return  void
+ */
+void sensor_table_touch(struct sensor_table *this_table)
+{
+    this_table->generation++;
+}
+
+
+/**
+ * \fn      size_t sensor_table_get_status_count(struct sensor_table *this_table, enum sensor_status status)
+ * \details Get the number of sensors in the table with a given status.
+ * \param   this_table A pointer to the sensor_table in question.
+ * \param   status The status in question.
+ * \return  The number of sensors.
+ */
+size_t sensor_table_get_status_count(struct sensor_table *this_table, enum sensor_status status)
+{
+    return this_table->status_count[status];
+}
+
+
+/**
+ * \fn      size_t sensor_table_get_team_status_count(struct sensor_table *this_table, char type, enum sensor_status status)
+ * \details Get the number of sensors in a team with a given status.
+ * \param   this_table A pointer to the sensor_table in question.
+ * \param   type The type of the team's hosts ('f' or 'x').
+ * \param   status The status in question.
+ * \return  The number of sensors, zero if there is no such team.
+ */
+size_t sensor_table_get_team_status_count(struct sensor_table *this_table, char type, enum sensor_status status)
+{
+    size_t team = sensor_table_find_team(this_table, type);
+    return team == SENSOR_TABLE_NONE ? 0 : this_table->team_status_count[team][status];
+}
+
+
+/**
+ * \fn      size_t sensor_table_get_host_status_count(struct sensor_table *this_table, size_t host, enum sensor_status status)
+ * \details Get the number of sensors on a host with a given status.
+ * \param   this_table A pointer to the sensor_table in question.
+ * \param   host The table's number for the host.
+ * \param   status The status in question.
+ * \return  The number of sensors.
+ */
+size_t sensor_table_get_host_status_count(struct sensor_table *this_table, size_t host, enum sensor_status status)
+{
+    return this_table->host_status_count[host][status];
+}
+
+
+/**
+ * \fn      uint64_t sensor_table_get_generation(struct sensor_table *this_table)
+ * \details Get the generation of the latest change to anything in the table.
+ * \param   this_table A pointer to the sensor_table in question.
+ * \return  The generation, zero if nothing has changed yet.
+ */
+uint64_t sensor_table_get_generation(struct sensor_table *this_table)
+{
+    return this_table->generation;
+}
+
+
+/**
+ * \fn      uint64_t sensor_table_get_team_generation(struct sensor_table *this_table, char type)
+ * \details Get the generation of the latest change to anything in a team.
+ * \param   this_table A pointer to the sensor_table in question.
+ * \param   type The type of the team's hosts ('f' or 'x').
+ * \return  The generation, zero if there is no such team or nothing in it has changed yet.
+ */
+uint64_t sensor_table_get_team_generation(struct sensor_table *this_table, char type)
+{
+    size_t team = sensor_table_find_team(this_table, type);
+    return team == SENSOR_TABLE_NONE ? 0 : this_table->team_generation[team];
+}
+
+
+/**
+ * \fn      uint64_t sensor_table_get_host_generation(struct sensor_table *this_table, size_t host)
+ * \details Get the generation of the latest change to anything on a host.
+ * \param   this_table A pointer to the sensor_table in question.
+ * \param   host The table's number for the host.
+ * \return  The generation.
+ */
+uint64_t sensor_table_get_host_generation(struct sensor_table *this_table, size_t host)
+{
+    return this_table->host_generation[host];
+}
+
+
+/**
+ * \fn      uint64_t sensor_table_get_device_generation(struct sensor_table *this_table, size_t device)
+ * \details Get the generation of the latest change to a device's sensors.
+ * \param   this_table A pointer to the sensor_table in question.
+ * \param   device The table's number for the device.
+ * \return  The generation.
+ */
+uint64_t sensor_table_get_device_generation(struct sensor_table *this_table, size_t device)
+{
+    return this_table->device_generation[device];
+}
+
+
+/**
+ * \fn      uint64_t sensor_table_get_row_generation(struct sensor_table *this_table, size_t row)
+ * \details Get the generation of the latest change to a row.
+ * \param   this_table A pointer to the sensor_table in question.
+ * \param   row The row number.
+ * \return  The generation.
+ */
+uint64_t sensor_table_get_row_generation(struct sensor_table *this_table, size_t row)
+{
+    return this_table->row_generation[row];
+}
@@ -0,0 +1,73 @@
+#ifndef _SENSOR_TABLE_H_
+#define _SENSOR_TABLE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include "sensor.h"
+#include "history.h"
+#include "timers.h"
+
+/**
+ * \file  sensor_table.h
+ * \brief The sensor_table type keeps the changing state of all of an array's sensors in flat, parallel columns (status, value,
+ *        last-update time and owning host and device), one row per sensor. The sensor objects in the team/host/device tree are views
+ *        onto their rows, so the tree is only needed for finding a sensor by name; anything which wants to look at many sensors at
+ *        once can scan the columns instead. Hosts and devices are registered with the table as well, so that rows can say who owns
+ *        them. Every change is stamped with a generation number at each level (row, device, host, team and the table as a whole), so
+ *        that anything which keeps a copy of part of the model can tell whether it's still current. Each row also keeps a short
+ *        history of its changes, if a history_pool is given and has room. The number of sensors with each status is kept for each host,
+ *        each team and the whole table, and updated as statuses change. Rows are kept in order of when they were last heard from (on
+ *        the monotonic clock), so that the stale ones can be found without a scan; a row which has been asked for again is parked
+ *        until it changes.
+ */
+
+/// Used as the host or device of a row which doesn't have one, i.e. a top-level sensor.
+#define SENSOR_TABLE_NONE UINT32_MAX
+
+struct sensor_table;
+struct arena;
+
+struct sensor_table *sensor_table_create(struct arena *arena, struct history_pool *history_pool, struct timers *timers);
+void sensor_table_destroy(struct sensor_table *this_table);
+struct arena *sensor_table_get_arena(struct sensor_table *this_table);
+
+size_t sensor_table_add_host(struct sensor_table *this_table, char type, int host_number);
+size_t sensor_table_add_device(struct sensor_table *this_table, size_t host, char *name);
+size_t sensor_table_add_sensor(struct sensor_table *this_table, size_t device, struct sensor *this_sensor);
+
+size_t sensor_table_get_number_of_rows(struct sensor_table *this_table);
+size_t sensor_table_get_number_of_devices(struct sensor_table *this_table);
+
+char sensor_table_get_host_type(struct sensor_table *this_table, size_t host);
+int sensor_table_get_host_number(struct sensor_table *this_table, size_t host);
+size_t sensor_table_get_device_host(struct sensor_table *this_table, size_t device);
+char *sensor_table_get_device_name(struct sensor_table *this_table, size_t device);
+
+enum sensor_status sensor_table_get_status(struct sensor_table *this_table, size_t row);
+char *sensor_table_get_value(struct sensor_table *this_table, size_t row);
+time_t sensor_table_get_last_updated(struct sensor_table *this_table, size_t row);
+size_t sensor_table_get_stale_rows(struct sensor_table *this_table, uint64_t quiet_ms, size_t *rows, size_t max_rows);
+void sensor_table_park_row(struct sensor_table *this_table, size_t row);
+void sensor_table_set_full_name(struct sensor_table *this_table, size_t row, char *full_name);
+char *sensor_table_get_full_name(struct sensor_table *this_table, size_t row);
+size_t sensor_table_get_row_host(struct sensor_table *this_table, size_t row);
+size_t sensor_table_get_row_device(struct sensor_table *this_table, size_t row);
+struct sensor *sensor_table_get_row_sensor(struct sensor_table *this_table, size_t row);
+size_t sensor_table_get_history(struct sensor_table *this_table, size_t row, struct history_entry *entries, size_t max_entries);
+
+int sensor_table_update(struct sensor_table *this_table, size_t row, char *new_value, enum sensor_status new_status, time_t timestamp);
+void sensor_table_touch_host(struct sensor_table *this_table, size_t host);
+void sensor_table_touch(struct sensor_table *this_table);
+
+size_t sensor_table_get_status_count(struct sensor_table *this_table, enum sensor_status status);
+size_t sensor_table_get_team_status_count(struct sensor_table *this_table, char type, enum sensor_status status);
+size_t sensor_table_get_host_status_count(struct sensor_table *this_table, size_t host, enum sensor_status status);
+
+uint64_t sensor_table_get_generation(struct sensor_table *this_table);
+uint64_t sensor_table_get_team_generation(struct sensor_table *this_table, char type);
+uint64_t sensor_table_get_host_generation(struct sensor_table *this_table, size_t host);
+uint64_t sensor_table_get_device_generation(struct sensor_table *this_table, size_t device);
+uint64_t sensor_table_get_row_generation(struct sensor_table *this_table, size_t row);
+
+#endif
@@ -0,0 +1,299 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+
+#include "sensor_template.h"
+
+#define BUF_SIZE 1024
+
+
+/// One line of sensor_list.conf, parsed.
+struct sensor_template_line {
+    /// What the line describes.
+    enum sensor_template_scope scope;
+    /// The type of host, 'f' or 'x'. Not used for top-level sensors.
+    char team_type;
+    /// For engine lines, what the engines' names start with, e.g. "xeng". NULL otherwise.
+    char *engine_prefix;
+    /// The device's name, NULL for top-level sensors.
+    char *device_name;
+    /// The sensor's name. For host-pair lines, a printf format with a single integer conversion for the other host's number.
+    char *sensor_name;
+};
+
+
+/// A struct to hold the parsed lines of the config file.
+struct sensor_template {
+    /// The lines, in the order in which they appear in the file.
+    struct sensor_template_line *line_list;
+    /// The number of lines.
+    size_t number_of_lines;
+};
+
+
+/**
+ * \fn      static int sensor_template_check_pattern(char *pattern)
+ * \details Check that a host-pair sensor name has exactly one conversion in it, and that it's an integer one, e.g. "fhost%02d-cnt",
+ *          so that it's safe to hand to snprintf().
+ * \return  0 if it's fine, -1 if not.
+ */
+static int sensor_template_check_pattern(char *pattern)
+{
+    char *percent = strchr(pattern, '%');
+    if (percent == NULL || strchr(percent + 1, '%') != NULL)
+        return -1;
+    size_t length = strspn(percent + 1, "0123456789-");
+    return percent[1 + length] == 'd' ? 0 : -1;
+}
+
+
+/**
+ * \fn      static int sensor_template_parse_line(char *buffer, struct sensor_template_line *line)
+ * \details Parse a line of the config file, which is a sensor name with the host numbers (and engine numbers) left out. One word is a
+ *          top-level sensor, two are a team and device, and three are either a team, engine and device, or a team, device and sensor.
+ * \param   buffer The line, which is modified in the process.
+ * \param   line Filled in with what the line describes.
+ * \return  0 on success, -1 if the line is malformed.
+ */
+static int sensor_template_parse_line(char *buffer, struct sensor_template_line *line)
+{
+    char *tokens[3];
+    size_t n_tokens = 0;
+    char *token;
+    char *saveptr;
+    for (token = strtok_r(buffer, ".", &saveptr); token != NULL; token = strtok_r(NULL, ".", &saveptr))
+    {
+        if (n_tokens == 3)
+            return -1;
+        tokens[n_tokens++] = token;
+    }
+    if (n_tokens == 0)
+        return -1;
+
+    line->engine_prefix = NULL;
+    line->device_name = NULL;
+    if (n_tokens == 1)
+    {
+        line->scope = SENSOR_TEMPLATE_TOP_LEVEL;
+        line->team_type = '\0';
+        line->sensor_name = strdup(tokens[0]);
+        return line->sensor_name != NULL ? 0 : -1;
+    }
+
+    if ((tokens[0][0] != 'f' && tokens[0][0] != 'x') || strcmp(tokens[0] + 1, "host"))
+        return -1;
+    line->team_type = tokens[0][0];
+
+    if (n_tokens == 2)
+    {
+        line->scope = SENSOR_TEMPLATE_HOST;
+        line->device_name = strdup(tokens[1]);
+        line->sensor_name = strdup("device-status");
+    }
+    else if (strstr(tokens[1], "eng")) //i.e. host.eng.device, with the ".device-status" part being implicit.
+    {
+        line->scope = SENSOR_TEMPLATE_ENGINE;
+        line->engine_prefix = strdup(tokens[1]);
+        line->device_name = strdup(tokens[2]);
+        line->sensor_name = strdup("device-status");
+    }
+    else //i.e. host.device.sensor, with the sensor named after the other host. Only xhost.missing-pkts.fhost%02d-cnt for now.
+    {
+        if (sensor_template_check_pattern(tokens[2]) < 0)
+            return -1;
+        line->scope = SENSOR_TEMPLATE_HOST_PAIR;
+        line->device_name = strdup(tokens[1]);
+        line->sensor_name = strdup(tokens[2]);
+    }
+    if (line->device_name == NULL || line->sensor_name == NULL || (line->scope == SENSOR_TEMPLATE_ENGINE && line->engine_prefix == NULL))
+    {
+        free(line->engine_prefix);
+        free(line->device_name);
+        free(line->sensor_name);
+        return -1;
+    }
+    return 0;
+}
+
+
+/**
+ * \fn      struct sensor_template *sensor_template_load(char *filename)
+ * \details Read and parse a sensor list config file. Blank lines and lines starting with # are skipped. Malformed lines are logged and
+ *          left out.
+ * \param   filename The path of the config file.
+ * \return  A pointer to the newly-created sensor_template, NULL if the file couldn't be read or there was no memory.
+ */
+struct sensor_template *sensor_template_load(char *filename)
+{
+    FILE *config_file = fopen(filename, "r");
+    if (config_file == NULL)
+    {
+        syslog(LOG_ERR, "Unable to open sensor list %s: %m", filename);
+        return NULL;
+    }
+
+    struct sensor_template *new_template = malloc(sizeof(*new_template));
+    if (new_template == NULL)
+    {
+        fclose(config_file);
+        return NULL;
+    }
+    new_template->line_list = NULL;
+    new_template->number_of_lines = 0;
+
+    char buffer[BUF_SIZE];
+    while (fgets(buffer, BUF_SIZE, config_file) != NULL)
+    {
+        buffer[strcspn(buffer, "\r\n")] = '\0';
+        if (buffer[0] == '\0' || buffer[0] == '#')
+            continue;
+
+        struct sensor_template_line *temp = realloc(new_template->line_list, sizeof(*temp)*(new_template->number_of_lines + 1));
+        if (temp == NULL)
+        {
+            syslog(LOG_ERR, "Unable to allocate memory for the sensor list.");
+            sensor_template_destroy(new_template);
+            fclose(config_file);
+            return NULL;
+        }
+        new_template->line_list = temp;
+
+        char original[BUF_SIZE];
+        strcpy(original, buffer);
+        if (sensor_template_parse_line(buffer, &new_template->line_list[new_template->number_of_lines]) < 0)
+            syslog(LOG_ERR, "%s has a malformed sensor name: %s.", filename, original);
+        else
+            new_template->number_of_lines++;
+    }
+    fclose(config_file);
+    syslog(LOG_INFO, "Read %zu sensor families from %s.", new_template->number_of_lines, filename);
+    return new_template;
+}
+
+
+/**
+ * \fn      void sensor_template_destroy(struct sensor_template *this_template)
+ * \details Free the memory associated with the sensor_template.
+ * \param   this_template A pointer to the sensor_template to be destroyed.
+ * \return  void
+ */
+void sensor_template_destroy(struct sensor_template *this_template)
+{
+    if (this_template != NULL)
+    {
+        size_t i;
+        for (i = 0; i < this_template->number_of_lines; i++)
+        {
+            free(this_template->line_list[i].engine_prefix);
+            free(this_template->line_list[i].device_name);
+            free(this_template->line_list[i].sensor_name);
+        }
+        free(this_template->line_list);
+        free(this_template);
+    }
+}
+
+
+/**
+ * \fn      size_t sensor_template_expand(struct sensor_template *this_template, size_t n_antennas, sensor_template_callback callback, void *data)
+ * \details Go through every sensor which the template describes for an array of the given size, and hand each to the callback. Each
+ *          name is formatted once, straight into a buffer on the stack. Sensors whose names wouldn't fit are left out, and logged once
+ *          for each line of the template which they came from.
+ * \param   this_template A pointer to the sensor_template in question.
+ * \param   n_antennas The number of antennas in the array, i.e. the number of hosts in each team.
+ * \param   callback The function to call for each sensor.
+ * \param   data An opaque pointer handed to the callback, normally the array being activated.
+ * \return  The number of sensors handed to the callback.
+ */
+size_t sensor_template_expand(struct sensor_template *this_template, size_t n_antennas, sensor_template_callback callback, void *data)
+{
+    char full_name[SENSOR_TEMPLATE_NAME_SIZE];
+    char engine_name[SENSOR_TEMPLATE_NAME_SIZE];
+    char sensor_name[SENSOR_TEMPLATE_NAME_SIZE];
+    struct sensor_template_sensor sensor;
+    size_t count = 0;
+    size_t skipped;
+    size_t i, host, other;
+    int length;
+
+    for (i = 0; i < this_template->number_of_lines; i++)
+    {
+        struct sensor_template_line *line = &this_template->line_list[i];
+        sensor.scope = line->scope;
+        sensor.team_type = line->team_type;
+        sensor.host_number = 0;
+        sensor.engine_name = NULL;
+        sensor.device_name = line->device_name;
+        sensor.sensor_name = line->sensor_name;
+        sensor.full_name = full_name;
+        skipped = 0;
+
+        switch (line->scope) {
+            case SENSOR_TEMPLATE_TOP_LEVEL:
+                sensor.full_name = line->sensor_name;
+                callback(&sensor, data);
+                count++;
+                break;
+
+            case SENSOR_TEMPLATE_HOST:
+                for (host = 0; host < n_antennas; host++)
+                {
+                    length = snprintf(full_name, sizeof(full_name), "%chost%02zu.%s.%s", line->team_type, host, line->device_name, line->sensor_name);
+                    if (length < 0 || (size_t) length >= sizeof(full_name))
+                    {
+                        skipped++;
+                        continue;
+                    }
+                    sensor.host_number = host;
+                    callback(&sensor, data);
+                    count++;
+                }
+                break;
+
+            case SENSOR_TEMPLATE_ENGINE:
+                sensor.engine_name = engine_name;
+                for (host = 0; host < n_antennas; host++)
+                {
+                    for (other = 0; other < SENSOR_TEMPLATE_ENGINES_PER_HOST; other++)
+                    {
+                        snprintf(engine_name, sizeof(engine_name), "%s%zu", line->engine_prefix, other);
+                        length = snprintf(full_name, sizeof(full_name), "%chost%02zu.%s.%s.%s", line->team_type, host, engine_name, line->device_name, line->sensor_name);
+                        if (length < 0 || (size_t) length >= sizeof(full_name))
+                        {
+                            skipped++;
+                            continue;
+                        }
+                        sensor.host_number = host;
+                        callback(&sensor, data);
+                        count++;
+                    }
+                }
+                break;
+
+            case SENSOR_TEMPLATE_HOST_PAIR:
+                sensor.sensor_name = sensor_name;
+                for (host = 0; host < n_antennas; host++)
+                {
+                    for (other = 0; other < n_antennas; other++) //each xengine gets packets from each fengine
+                    {
+                        snprintf(sensor_name, sizeof(sensor_name), line->sensor_name, (int) other);
+                        length = snprintf(full_name, sizeof(full_name), "%chost%02zu.%s.%s", line->team_type, host, line->device_name, sensor_name);
+                        if (length < 0 || (size_t) length >= sizeof(full_name))
+                        {
+                            skipped++;
+                            continue;
+                        }
+                        sensor.host_number = host;
+                        callback(&sensor, data);
+                        count++;
+                    }
+                }
+                break;
+        }
+        if (skipped)
+            syslog(LOG_ERR, "Left out %zu sensor%s of %chost.%s.%s from the sensor list: the names are too long.", skipped, \
+                    skipped == 1 ? "" : "s", line->team_type, line->device_name, line->sensor_name);
+    }
+    return count;
+}
@@ -0,0 +1,59 @@
+#ifndef _SENSOR_TEMPLATE_H_
+#define _SENSOR_TEMPLATE_H_
+
+#include <stddef.h>
+
+/**
+ * \file  sensor_template.h
+ * \brief The sensor_template type holds sensor_list.conf, parsed once at startup. Each line of the file describes a family of sensors:
+ *        a top-level sensor ("feng-rxtime-ok"), a device-status sensor on every host of a team ("fhost.pfb"), one on every engine of
+ *        every host ("xhost.xeng.vacc"), or a sensor for every pair of hosts ("xhost.missing-pkts.fhost%02d-cnt", where the number is
+ *        that of the other host). Activating an array expands the template for the array's size, so that the config file needn't be
+ *        read again.
+ */
+
+/// The number of engines on each host, for the lines which describe engine sensors.
+#define SENSOR_TEMPLATE_ENGINES_PER_HOST 4
+/// Room for a sensor's full name, including the terminating NUL. Sensors with longer names are left out, and logged.
+#define SENSOR_TEMPLATE_NAME_SIZE 128
+
+/// What a line of the template describes.
+enum sensor_template_scope {
+    /// A sensor which belongs to the array itself.
+    SENSOR_TEMPLATE_TOP_LEVEL,
+    /// A device-status sensor on each host in a team.
+    SENSOR_TEMPLATE_HOST,
+    /// A device-status sensor on each engine of each host in a team.
+    SENSOR_TEMPLATE_ENGINE,
+    /// A sensor on each host in a team for each host in the array, e.g. packets missing from each fhost on each xhost.
+    SENSOR_TEMPLATE_HOST_PAIR,
+};
+
+/// One sensor, as the template expands. The strings are only good for the duration of the callback.
+struct sensor_template_sensor {
+    /// The kind of line which the sensor came from.
+    enum sensor_template_scope scope;
+    /// The type of host, 'f' or 'x'. Not used for top-level sensors.
+    char team_type;
+    /// The index of the host in its team. Not used for top-level sensors.
+    size_t host_number;
+    /// The engine's name, e.g. "xeng2", for engine sensors, NULL otherwise.
+    char *engine_name;
+    /// The device's name, NULL for top-level sensors.
+    char *device_name;
+    /// The sensor's name within its device (or the array, for top-level sensors).
+    char *sensor_name;
+    /// The full KATCP name, e.g. "xhost03.xeng2.vacc.device-status".
+    char *full_name;
+};
+
+typedef void (*sensor_template_callback)(struct sensor_template_sensor *sensor, void *data);
+
+struct sensor_template;
+
+struct sensor_template *sensor_template_load(char *filename);
+void sensor_template_destroy(struct sensor_template *this_template);
+
+size_t sensor_template_expand(struct sensor_template *this_template, size_t n_antennas, sensor_template_callback callback, void *data);
+
+#endif
@@ -0,0 +1,219 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <syslog.h>
+
+#include "strbuf.h"
+
+/// What a strbuf starts with if it's not told otherwise. Enough for a small page without growing.
+#define STRBUF_DEFAULT_SIZE 4096
+
+
+/// A struct to hold a string which is being put together.
+struct strbuf {
+    /// The string, always NUL-terminated.
+    char *text;
+    /// The length of the string, not counting the NUL.
+    size_t length;
+    /// The size of the buffer.
+    size_t capacity;
+    /// Set if an allocation has failed. Appends are ignored from then on, until the strbuf is cleared.
+    int failed;
+};
+
+
+/**
+ * \fn      struct strbuf *strbuf_create(size_t initial_size)
+ * \details Allocate memory for an empty strbuf.
+ * \param   initial_size How many bytes to allocate up front, including the NUL. Zero picks a default.
+ * \return  A pointer to the newly-created strbuf, NULL on failure.
+ */
+struct strbuf *strbuf_create(size_t initial_size)
+{
+    struct strbuf *new_strbuf = malloc(sizeof(*new_strbuf));
+    if (new_strbuf == NULL)
+        return NULL;
+    new_strbuf->capacity = initial_size > 0 ? initial_size : STRBUF_DEFAULT_SIZE;
+    new_strbuf->text = malloc(new_strbuf->capacity);
+    if (new_strbuf->text == NULL)
+    {
+        free(new_strbuf);
+        return NULL;
+    }
+    new_strbuf->text[0] = '\0';
+    new_strbuf->length = 0;
+    new_strbuf->failed = 0;
+    return new_strbuf;
+}
+
+
+/**
+ * \fn      void strbuf_destroy(struct strbuf *this_strbuf)
+ * \details Free the memory associated with the strbuf.
+ * \param   this_strbuf A pointer to the strbuf to be destroyed.
+ * \return  void
+ */
+void strbuf_destroy(struct strbuf *this_strbuf)
+{
+    if (this_strbuf != NULL)
+    {
+        free(this_strbuf->text);
+        free(this_strbuf);
+    }
+}
+
+
+/**
+ * \fn      static int strbuf_reserve(struct strbuf *this_strbuf, size_t extra)
+ * \details Make sure that there's room for another extra bytes and the NUL, at least doubling the buffer if it has to grow.
+ * \param   this_strbuf A pointer to the strbuf in question.
+ * \param   extra The number of bytes about to be appended.
+ * \return  0 on success, -1 if there was no memory, in which case the strbuf is marked as failed.
+ */
+static int strbuf_reserve(struct strbuf *this_strbuf, size_t extra)
+{
+    if (this_strbuf->failed)
+        return -1;
+    size_t needed = this_strbuf->length + extra + 1;
+    if (needed <= this_strbuf->capacity)
+        return 0;
+
+    size_t new_capacity = this_strbuf->capacity*2;
+    if (new_capacity < needed)
+        new_capacity = needed;
+    char *temp = realloc(this_strbuf->text, new_capacity);
+    if (temp == NULL)
+    {
+        syslog(LOG_ERR, "Unable to grow a string buffer to %zu bytes.", new_capacity);
+        this_strbuf->failed = 1;
+        return -1;
+    }
+    this_strbuf->text = temp;
+    this_strbuf->capacity = new_capacity;
+    return 0;
+}
+
+
+/**
+ * \fn      int strbuf_append_length(struct strbuf *this_strbuf, char *text, size_t length)
+ * \details Append the first length bytes of some text, for when the length is already known.
+ * \param   this_strbuf A pointer to the strbuf in question.
+ * \param   text The text to be appended. It needn't be NUL-terminated.
+ * \param   length The number of bytes to append.
+ * \return  0 on success, -1 if the strbuf has failed.
+ */
+int strbuf_append_length(struct strbuf *this_strbuf, char *text, size_t length)
+{
+    if (strbuf_reserve(this_strbuf, length) < 0)
+        return -1;
+    memcpy(this_strbuf->text + this_strbuf->length, text, length);
+    this_strbuf->length += length;
+    this_strbuf->text[this_strbuf->length] = '\0';
+    return 0;
+}
+
+
+/**
+ * \fn      int strbuf_append(struct strbuf *this_strbuf, char *text)
+ * \details Append a string.
+ * \param   this_strbuf A pointer to the strbuf in question.
+ * \param   text The string to be appended. NULL is ignored, so that a renderer which has returned NULL doesn't need checking first.
+ * \return  0 on success, -1 if the strbuf has failed.
+ */
+int strbuf_append(struct strbuf *this_strbuf, char *text)
+{
+    if (text == NULL)
+        return this_strbuf->failed ? -1 : 0;
+    return strbuf_append_length(this_strbuf, text, strlen(text));
+}
+
+
+/**
+ * \fn      int strbuf_appendf(struct strbuf *this_strbuf, char *format, ...)
+ * \details Append formatted text, as printf() would produce it. The text is formatted straight into the space at the end of the
+ *          buffer, so it's formatted twice only on the occasions that the buffer needs to grow.
+ * \param   this_strbuf A pointer to the strbuf in question.
+ * \param   format A printf format string.
+ * \return  0 on success, -1 if the strbuf has failed or the formatting did.
+ */
+int strbuf_appendf(struct strbuf *this_strbuf, char *format, ...)
+{
+    if (this_strbuf->failed)
+        return -1;
+
+    va_list args;
+    va_start(args, format);
+    size_t room = this_strbuf->capacity - this_strbuf->length;
+    int needed = vsnprintf(this_strbuf->text + this_strbuf->length, room, format, args);
+    va_end(args);
+    if (needed < 0)
+    {
+        this_strbuf->text[this_strbuf->length] = '\0';
+        return -1;
+    }
+
+    if ((size_t) needed >= room)
+    {
+        if (strbuf_reserve(this_strbuf, (size_t) needed) < 0)
+        {
+            this_strbuf->text[this_strbuf->length] = '\0';
+            return -1;
+        }
+        va_start(args, format);
+        vsnprintf(this_strbuf->text + this_strbuf->length, (size_t) needed + 1, format, args);
+        va_end(args);
+    }
+    this_strbuf->length += (size_t) needed;
+    return 0;
+}
+
+
+/**
+ * \fn      char *strbuf_see(struct strbuf *this_strbuf)
+ * \details Have a look at the string, without copying it.
+ * \param   this_strbuf A pointer to the strbuf in question.
+ * \return  The string, which still belongs to the strbuf and is only good until the next append.
+ */
+char *strbuf_see(struct strbuf *this_strbuf)
+{
+    return this_strbuf->text;
+}
+
+
+/**
+ * \fn      size_t strbuf_get_length(struct strbuf *this_strbuf)
+ * \details Get the length of the string.
+ * \param   this_strbuf A pointer to the strbuf in question.
+ * \return  The length, not counting the terminating NUL.
+ */
+size_t strbuf_get_length(struct strbuf *this_strbuf)
+{
+    return this_strbuf->length;
+}
+
+
+/**
+ * \fn      int strbuf_has_failed(struct strbuf *this_strbuf)
+ * \details Check whether anything has gone missing from the string because there was no memory for it.
+ * \param   this_strbuf A pointer to the strbuf in question.
+ * \return  1 if an append has failed since the strbuf was created or last cleared, 0 otherwise.
+ */
+int strbuf_has_failed(struct strbuf *this_strbuf)
+{
+    return this_strbuf->failed;
+}
+
+
+/**
+ * \fn      void strbuf_clear(struct strbuf *this_strbuf)
+ * \details Empty the strbuf, keeping its buffer for whatever is put together next.
+ * \param   this_strbuf A pointer to the strbuf in question.
+ * \return  void
+ */
+void strbuf_clear(struct strbuf *this_strbuf)
+{
+    this_strbuf->text[0] = '\0';
+    this_strbuf->length = 0;
+    this_strbuf->failed = 0;
+}
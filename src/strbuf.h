@@ -0,0 +1,31 @@
+#ifndef _STRBUF_H_
+#define _STRBUF_H_
+
+#include <stddef.h>
+
+/**
+ * \file  strbuf.h
+ * \brief The strbuf type is a growable string, for putting together HTML a piece at a time. It keeps track of its own length, so
+ *        appending costs only as much as what is appended, and its buffer grows by doubling, so that a page of any size takes a handful
+ *        of allocations. Renderers append straight into the strbuf they're given, rather than each handing back a string of its own
+ *        to be copied into the next one up.
+ *
+ *        If an allocation fails, the strbuf remembers it and ignores anything appended afterwards, so a renderer can make all its
+ *        appends and check once at the end.
+ */
+
+struct strbuf;
+
+struct strbuf *strbuf_create(size_t initial_size);
+void strbuf_destroy(struct strbuf *this_strbuf);
+
+int strbuf_append(struct strbuf *this_strbuf, char *text);
+int strbuf_append_length(struct strbuf *this_strbuf, char *text, size_t length);
+int strbuf_appendf(struct strbuf *this_strbuf, char *format, ...) __attribute__((format(printf, 2, 3)));
+
+char *strbuf_see(struct strbuf *this_strbuf);
+size_t strbuf_get_length(struct strbuf *this_strbuf);
+int strbuf_has_failed(struct strbuf *this_strbuf);
+void strbuf_clear(struct strbuf *this_strbuf);
+
+#endif
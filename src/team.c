@@ -5,6 +5,8 @@
 
 #include "team.h"
 #include "host.h"
+#include "arena.h"
+#include "sensor_table.h"
 
 
 /// A struct for organising host objects of a similar type together.
@@ -15,56 +17,41 @@ struct team {
     size_t number_of_antennas;
     /// A list of hosts that are members of the team. The number of hosts is equal to the number of antennas because of MeerKAT's design.
     struct host **host_list;
+    /// The table in which the hosts are registered.
+    struct sensor_table *table;
 };
 
 
 /**
- * \fn      struct team *team_create(char type, size_t number_of_antennas)
+ * \fn      struct team *team_create(char type, size_t number_of_antennas, struct sensor_table *table)
  * \details Allocate memory for the team object, create the underlying host objects according to the number of antennas specified.
  * \param   type The type of hosts to create ('f' or 'x').
  * \param   number_of_antennas The number of antennas that the parent array has.
+ * \param   table The table in which to register the hosts. The team and its hosts come from the table's arena, and are freed along with it.
  * \return  A pointer to the newly-created team object.
  */
-struct team *team_create(char type, size_t number_of_antennas)
+struct team *team_create(char type, size_t number_of_antennas, struct sensor_table *table)
 {
-    struct team *new_team = malloc(sizeof(*new_team));
+    struct arena *arena = sensor_table_get_arena(table);
+    struct team *new_team = arena_alloc(arena, sizeof(*new_team));
     if (new_team != NULL)
     {
         new_team->host_type = type;
         new_team->number_of_antennas = number_of_antennas;
-        new_team->host_list = malloc(sizeof(new_team->host_list)*new_team->number_of_antennas);
+        new_team->table = table;
+        new_team->host_list = arena_alloc(arena, sizeof(*(new_team->host_list))*new_team->number_of_antennas);
+        if (new_team->host_list == NULL)
+            return NULL;
         int i;
         for (i = 0; i < new_team->number_of_antennas; i++)
         {
-            new_team->host_list[i] = host_create(type, i);
+            new_team->host_list[i] = host_create(type, i, table);
         }
     }
     return new_team;
 }
 
 
-/**
- * \fn      void team_destroy(struct team *this_team)
- * \details Free the memory associated with the team object.
- * \param   this_team A pointer to the team in question.
- * \return  void
- */
-void team_destroy(struct team *this_team)
-{
-    if (this_team != NULL)
-    {
-        unsigned int i;
-        for (i = 0; i < this_team->number_of_antennas; i++)
-        {
-            host_destroy(this_team->host_list[i]);
-        }
-        free(this_team->host_list);
-        free(this_team);
-        this_team = NULL;
-    }
-}
-
-
 /**
  * \fn      int team_add_device_sensor(struct team *this_team, size_t host_number, char *device_name, char *sensor_name)
  * \details Add a device and sensor to the specified host in this team. If the parent structures already exist, simply add a sensor to it.
@@ -142,6 +129,63 @@ int team_set_host_serial_no(struct team *this_team, size_t host_number, char *ho
 }
 
 
+/**
+ * \fn      uint64_t team_get_generation(struct team *this_team)
+ * \details Get the generation of the latest change to anything in the team.
+ * \param   this_team A pointer to the team in question.
+ * \return  The generation. See sensor_table.h.
+ */
+uint64_t team_get_generation(struct team *this_team)
+{
+    return sensor_table_get_team_generation(this_team->table, this_team->host_type);
+}
+
+
+/**
+ * \fn      size_t team_get_status_count(struct team *this_team, enum sensor_status status)
+ * \details Get the number of sensors on all of the team's hosts which have a given status.
+ * \param   this_team A pointer to the team in question.
+ * \param   status The status in question.
+ * \return  The number of sensors. It's kept up to date as sensors change, so it costs nothing to read.
+ */
+size_t team_get_status_count(struct team *this_team, enum sensor_status status)
+{
+    return sensor_table_get_team_status_count(this_team->table, this_team->host_type, status);
+}
+
+
+/**
+ * \fn      uint64_t team_get_host_generation(struct team *this_team, size_t host_number)
+ * \details Get the generation of the latest change to anything on one of the team's hosts.
+ * \param   this_team A pointer to the team in question.
+ * \param   host_number The number of the host in the team.
+ * \return  The generation, zero if there's no such host. See sensor_table.h.
+ */
+uint64_t team_get_host_generation(struct team *this_team, size_t host_number)
+{
+    if (host_number < this_team->number_of_antennas)
+        return host_get_generation(this_team->host_list[host_number]);
+    return 0;
+}
+
+
+/**
+ * \fn      size_t team_get_host_status_count(struct team *this_team, size_t host_number, enum sensor_status status)
+ * \details Get the number of sensors on one of the team's hosts which have a given status, e.g. to find the hosts which aren't
+ *          nominal.
+ * \param   this_team A pointer to the team in question.
+ * \param   host_number The number of the host in the team.
+ * \param   status The status in question.
+ * \return  The number of sensors, zero if there's no such host.
+ */
+size_t team_get_host_status_count(struct team *this_team, size_t host_number, enum sensor_status status)
+{
+    if (host_number < this_team->number_of_antennas)
+        return host_get_status_count(this_team->host_list[host_number], status);
+    return 0;
+}
+
+
 /**
  * \fn      char team_get_type(struct team *this_team)
  * \details Get the type ('f' or 'x') of the hosts grouped together in the team.
@@ -190,19 +234,19 @@ char *team_get_fhost_input_stream(struct team *this_team, size_t fhost_number)
 
 
 /**
- * \fn      int team_update_sensor(struct team *this_team, size_t host_number, char *device_name, char*sensor_name, char *new_sensor_value, char *new_sensor_status)
+ * \fn      int team_update_sensor(struct team *this_team, size_t host_number, char *device_name, char*sensor_name, char *new_sensor_value, enum sensor_status new_sensor_status)
  * \details Update a sensor on one of the hosts in the team.
  * \param   this_team A pointer to the team in question.
  * \param   host_number The index of the host in question.
  * \param   device_name A string containing the name of the device in question.
  * \param   sensor_name A string containing the name of the sensor to be updated.
  * \param   new_sensor_value A string containing the new sensor value.
- * \param   new_sensor_status A string containing the new status of the sensor.
+ * \param   new_sensor_status The new status of the sensor.
  * \return  An integer indicating the outcome of the operation.
  */
-int team_update_sensor(struct team *this_team, size_t host_number, char *device_name, char *sensor_name, char *new_sensor_value, char *new_sensor_status)
+int team_update_sensor(struct team *this_team, size_t host_number, char *device_name, char *sensor_name, char *new_sensor_value, enum sensor_status new_sensor_status)
 {
-    //syslog(LOG_DEBUG, "Updating %chost%lu.%s.%s with %s - %s.", this_team->host_type, host_number, device_name, sensor_name, new_sensor_value, new_sensor_status);
+    //syslog(LOG_DEBUG, "Updating %chost%lu.%s.%s with %s - %s.", this_team->host_type, host_number, device_name, sensor_name, new_sensor_value, sensor_status_to_string(new_sensor_status));
     if (this_team != NULL)
     {
         if (host_number >= this_team->number_of_antennas)
@@ -214,7 +258,7 @@ int team_update_sensor(struct team *this_team, size_t host_number, char *device_
 
 
 /**
- * \fn      int team_update_engine_sensor(struct team *this_team, size_t host_number, char *engine_name, char *device_name, char*sensor_name, char *new_sensor_value, char *new_sensor_status)
+ * \fn      int team_update_engine_sensor(struct team *this_team, size_t host_number, char *engine_name, char *device_name, char*sensor_name, char *new_sensor_value, enum sensor_status new_sensor_status)
  * \details Update a sensor (underneath an engine) on one of the hosts in the team.
  * \param   this_team A pointer to the team in question.
  * \param   host_number The index of the host in question.
@@ -222,12 +266,12 @@ int team_update_sensor(struct team *this_team, size_t host_number, char *device_
  * \param   device_name A string containing the name of the device in question.
  * \param   sensor_name A string containing the name of the sensor to be updated.
  * \param   new_sensor_value A string containing the new sensor value.
- * \param   new_sensor_status A string containing the new status of the sensor.
+ * \param   new_sensor_status The new status of the sensor.
  * \return  An integer indicating the outcome of the operation.
  */
-int team_update_engine_sensor(struct team *this_team, size_t host_number, char *engine_name, char *device_name, char *sensor_name, char *new_sensor_value, char *new_sensor_status)
+int team_update_engine_sensor(struct team *this_team, size_t host_number, char *engine_name, char *device_name, char *sensor_name, char *new_sensor_value, enum sensor_status new_sensor_status)
 {
-    syslog(LOG_DEBUG, "Updating %chost%lu.%s.%s.%s with %s - %s.", this_team->host_type, host_number, engine_name, device_name, sensor_name, new_sensor_value, new_sensor_status);
+    syslog(LOG_DEBUG, "Updating %chost%lu.%s.%s.%s with %s - %s.", this_team->host_type, host_number, engine_name, device_name, sensor_name, new_sensor_value, sensor_status_to_string(new_sensor_status));
     if (this_team != NULL)
     {
         if (host_number >= this_team->number_of_antennas)
@@ -238,6 +282,41 @@ int team_update_engine_sensor(struct team *this_team, size_t host_number, char *
 }
 
 
+/**
+ * \fn      struct sensor *team_find_sensor(struct team *this_team, size_t host_number, char *device_name, char *sensor_name)
+ * \details Find a sensor on one of the hosts in the team.
+ * \param   this_team A pointer to the team in question.
+ * \param   host_number The index of the host in question.
+ * \param   device_name A string containing the name of the device in question.
+ * \param   sensor_name A string containing the name of the sensor.
+ * \return  A pointer to the sensor, NULL if it doesn't exist.
+ */
+struct sensor *team_find_sensor(struct team *this_team, size_t host_number, char *device_name, char *sensor_name)
+{
+    if (this_team != NULL && host_number < this_team->number_of_antennas)
+        return host_find_sensor(this_team->host_list[host_number], device_name, sensor_name);
+    return NULL;
+}
+
+
+/**
+ * \fn      struct sensor *team_find_engine_sensor(struct team *this_team, size_t host_number, char *engine_name, char *device_name, char *sensor_name)
+ * \details Find a sensor (underneath an engine) on one of the hosts in the team.
+ * \param   this_team A pointer to the team in question.
+ * \param   host_number The index of the host in question.
+ * \param   engine_name The name of the engine in question.
+ * \param   device_name A string containing the name of the device in question.
+ * \param   sensor_name A string containing the name of the sensor.
+ * \return  A pointer to the sensor, NULL if it doesn't exist.
+ */
+struct sensor *team_find_engine_sensor(struct team *this_team, size_t host_number, char *engine_name, char *device_name, char *sensor_name)
+{
+    if (this_team != NULL && host_number < this_team->number_of_antennas)
+        return host_find_engine_sensor(this_team->host_list[host_number], engine_name, device_name, sensor_name);
+    return NULL;
+}
+
+
 /**
  * \fn      char *team_get_sensor_value(struct team *this_team, size_t host_number, char *device_name, char *sensor_name)
  * \details Get the value for the sensor specified.
@@ -259,39 +338,105 @@ char *team_get_sensor_value(struct team *this_team, size_t host_number, char *de
 
 
 /**
- * \fn      char *team_get_sensor_status(struct team *this_team, size_t host_number, char *device_name, char *sensor_name)
+ * \fn      enum sensor_status team_get_sensor_status(struct team *this_team, size_t host_number, char *device_name, char *sensor_name)
  * \details Get the status for the sensor specified.
  * \param   this_team A pointer to the team in question.
  * \param   host_number The index of the host in question.
  * \param   device_name A string containing the name of the device in question.
  * \param   sensor_name A string containing the name of the sensor to be updated.
- * \return  A string containing the status of the queried sensor. This string is not newly allocated and must not be freed.
+ * \return  The status of the queried sensor, SENSOR_UNKNOWN if it isn't found.
  */
-char *team_get_sensor_status(struct team *this_team, size_t host_number, char *device_name, char *sensor_name)
+enum sensor_status team_get_sensor_status(struct team *this_team, size_t host_number, char *device_name, char *sensor_name)
 {
     if  (this_team != NULL)
     {
         if (host_number < this_team->number_of_antennas)
             return host_get_sensor_status(this_team->host_list[host_number], device_name, sensor_name);
     }
-    return NULL;
+    return SENSOR_UNKNOWN;
 
 }
 
 
 /**
- * \fn      char *team_get_host_html_detail(struct team *this_team, size_t host_number)
- * \details Get an HTML representation of the host at the specified index.
+ * \fn      int team_get_host_html_detail(struct team *this_team, size_t host_number, struct strbuf *html)
+ * \details Append an HTML representation of the host at the specified index.
  * \param   this_team A pointer to the team in question.
  * \param   host_number The index of the host in question.
- * \return  If the host exists, a newly-allocated string containing the HTML representation of the host. Otherwise, NULL.
+ * \param   html The strbuf to which the representation is appended.
+ * \return  0 on success, -1 if the host doesn't exist or the strbuf has failed.
  */
-char *team_get_host_html_detail(struct team *this_team, size_t host_number)
+int team_get_host_html_detail(struct team *this_team, size_t host_number, struct strbuf *html)
 {
     if (host_number < this_team->number_of_antennas)
     {
-        return host_html_detail(this_team->host_list[host_number]);
+        return host_html_detail(this_team->host_list[host_number], html);
     }
     else
-        return NULL;
+        return -1;
+}
+
+
+/**
+ * \fn      size_t team_get_host_number_of_cells(struct team *this_team, size_t host_number)
+ * \details Get the number of cells with a status in the detail table for the host at the specified index.
+ * \param   this_team A pointer to the team in question.
+ * \param   host_number The index of the host in question.
+ * \return  The number of cells, zero if the host doesn't exist.
+ */
+size_t team_get_host_number_of_cells(struct team *this_team, size_t host_number)
+{
+    if (host_number < this_team->number_of_antennas)
+        return host_get_number_of_cells(this_team->host_list[host_number]);
+    return 0;
+}
+
+
+/**
+ * \fn      void team_get_host_cell_statuses(struct team *this_team, size_t host_number, unsigned char *cell_status)
+ * \details Get the statuses which the cells of the host at the specified index show now. See host_get_cell_statuses().
+ * \param   this_team A pointer to the team in question.
+ * \param   host_number The index of the host in question.
+ * \param   cell_status Filled in with the statuses.
+ * \return  void
+ */
+void team_get_host_cell_statuses(struct team *this_team, size_t host_number, unsigned char *cell_status)
+{
+    if (host_number < this_team->number_of_antennas)
+        host_get_cell_statuses(this_team->host_list[host_number], cell_status);
+}
+
+
+/**
+ * \fn      int team_get_host_html_changes(struct team *this_team, size_t host_number, uint64_t since, unsigned char *cell_status, struct strbuf *lines)
+ * \details Append the changes to the cells of the host at the specified index. See host_html_changes().
+ * \param   this_team A pointer to the team in question.
+ * \param   host_number The index of the host in question.
+ * \param   since The generation up to which the page is known to be current.
+ * \param   cell_status The statuses last sent for the host's cells.
+ * \param   lines The strbuf to which the changes are appended.
+ * \return  0 on success, -1 if the host doesn't exist or the strbuf has failed.
+ */
+int team_get_host_html_changes(struct team *this_team, size_t host_number, uint64_t since, unsigned char *cell_status, struct strbuf *lines)
+{
+    if (host_number < this_team->number_of_antennas)
+        return host_html_changes(this_team->host_list[host_number], since, cell_status, lines);
+    return -1;
+}
+
+
+/**
+ * \fn      int team_get_host_json(struct team *this_team, size_t host_number, struct json_writer *json, unsigned int fields)
+ * \details Write the host at the specified index as a JSON object. See host_json().
+ * \param   this_team A pointer to the team in question.
+ * \param   host_number The index of the host in question.
+ * \param   json The json_writer to which the object is written.
+ * \param   fields The JSON_FIELD_* flags saying which fields to write.
+ * \return  0 on success, -1 if the host doesn't exist or the writer has failed.
+ */
+int team_get_host_json(struct team *this_team, size_t host_number, struct json_writer *json, unsigned int fields)
+{
+    if (host_number < this_team->number_of_antennas)
+        return host_json(this_team->host_list[host_number], json, fields);
+    return -1;
 }
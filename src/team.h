@@ -1,5 +1,7 @@
 #ifndef _TEAM_H_
 #define _TEAM_H_
+#include "sensor.h"
+#include "strbuf.h"
 
 /**
  * \file  team.h
@@ -9,8 +11,7 @@
 
 struct team;
 
-struct team *team_create(char type, size_t number_of_antennas);
-void team_destroy(struct team *this_team);
+struct team *team_create(char type, size_t number_of_antennas, struct sensor_table *table);
 
 int team_add_device_sensor(struct team *this_team, size_t host_number, char *device_name, char *sensor_name);
 int team_add_engine_device_sensor(struct team *this_team, size_t host_number, char *engine_name, char *device_name, char *sensor_name);
@@ -18,14 +19,24 @@ int team_add_engine_device_sensor(struct team *this_team, size_t host_number, ch
 int team_set_host_serial_no(struct team *this_team, size_t host_number, char *host_serial);
 
 char team_get_type(struct team *this_team);
+uint64_t team_get_generation(struct team *this_team);
+uint64_t team_get_host_generation(struct team *this_team, size_t host_number);
+size_t team_get_status_count(struct team *this_team, enum sensor_status status);
+size_t team_get_host_status_count(struct team *this_team, size_t host_number, enum sensor_status status);
 
 int team_set_fhost_input_stream(struct team *this_team, char *input_stream_name, size_t fhost_number);
 char *team_get_fhost_input_stream(struct team *this_team, size_t fhost_number);
-int team_update_sensor(struct team *this_team, size_t host_number, char *device_name, char*sensor_name, char *new_sensor_value, char *new_sensor_status);
-int team_update_engine_sensor(struct team *this_team, size_t host_number, char *engine_name, char *device_name, char *sensor_name, char *new_sensor_value, char *new_sensor_status);
+int team_update_sensor(struct team *this_team, size_t host_number, char *device_name, char*sensor_name, char *new_sensor_value, enum sensor_status new_sensor_status);
+int team_update_engine_sensor(struct team *this_team, size_t host_number, char *engine_name, char *device_name, char *sensor_name, char *new_sensor_value, enum sensor_status new_sensor_status);
+struct sensor *team_find_sensor(struct team *this_team, size_t host_number, char *device_name, char *sensor_name);
+struct sensor *team_find_engine_sensor(struct team *this_team, size_t host_number, char *engine_name, char *device_name, char *sensor_name);
 
 char *team_get_sensor_value(struct team *this_team, size_t host_number, char *device_name, char *sensor_name);
-char *team_get_sensor_status(struct team *this_team, size_t host_number, char *device_name, char *sensor_name);
+enum sensor_status team_get_sensor_status(struct team *this_team, size_t host_number, char *device_name, char *sensor_name);
 
-char *team_get_host_html_detail(struct team *this_team, size_t host_number);
+int team_get_host_html_detail(struct team *this_team, size_t host_number, struct strbuf *html);
+size_t team_get_host_number_of_cells(struct team *this_team, size_t host_number);
+void team_get_host_cell_statuses(struct team *this_team, size_t host_number, unsigned char *cell_status);
+int team_get_host_html_changes(struct team *this_team, size_t host_number, uint64_t since, unsigned char *cell_status, struct strbuf *lines);
+int team_get_host_json(struct team *this_team, size_t host_number, struct json_writer *json, unsigned int fields);
 #endif
@@ -0,0 +1,329 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <syslog.h>
+#include <time.h>
+
+#include "timers.h"
+
+/// The number of levels in the timing wheel.
+#define TIMERS_LEVELS 4
+/// The number of bits of the tick count that each level covers.
+#define TIMERS_SLOT_BITS 6
+/// The number of slots in each level.
+#define TIMERS_SLOTS (1 << TIMERS_SLOT_BITS)
+#define TIMERS_SLOT_MASK (TIMERS_SLOTS - 1)
+/// The furthest ahead (in ticks) that a timeout can be placed. About 46 hours with 10 ms ticks; anything further gets clamped.
+#define TIMERS_MAX_TICKS (((uint64_t) 1 << (TIMERS_LEVELS*TIMERS_SLOT_BITS)) - 1)
+
+
+/// A struct to hold a single timeout.
+struct timeout {
+    /// The timers object to which the timeout belongs.
+    struct timers *timers;
+    /// The tick on which the timeout should fire.
+    uint64_t expiry;
+    /// The next timeout in the same slot.
+    struct timeout *next;
+    /// Whichever pointer points at this timeout (the slot's head, or the previous timeout's next), NULL if the timeout isn't scheduled.
+    /// Keeping this makes removal from the middle of a slot O(1).
+    struct timeout **pprev;
+    /// The function to call when the timeout fires.
+    timeout_callback callback;
+    /// An opaque pointer handed back to the callback.
+    void *data;
+};
+
+
+/// A struct to hold all of the scheduled timeouts. Level 0 has a slot for each of the next TIMERS_SLOTS ticks, and each higher level has a
+/// slot for each TIMERS_SLOTS-times-longer stretch of time. When the lower level wraps around, the next slot up is emptied and its
+/// timeouts are spread out over the level below.
+struct timers {
+    /// The slots of the wheel, each holding a singly-linked list of timeouts.
+    struct timeout *wheel[TIMERS_LEVELS][TIMERS_SLOTS];
+    /// The last tick which has been processed.
+    uint64_t current_tick;
+    /// The cached monotonic time, in milliseconds.
+    uint64_t now_ms;
+    /// The number of timeouts currently scheduled.
+    size_t number_scheduled;
+};
+
+
+/**
+ * \fn      static uint64_t timers_read_clock()
+ * \details Read the monotonic clock, which doesn't jump around when the wall clock is adjusted.
+ * \return  The current monotonic time in milliseconds.
+ */
+static uint64_t timers_read_clock()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000 + (uint64_t) now.tv_nsec / 1000000;
+}
+
+
+/**
+ * \fn      struct timers *timers_create()
+ * \details Allocate memory for an empty timers object, starting the wheel at the current time.
+ * \return  A pointer to the newly-allocated timers object.
+ */
+struct timers *timers_create()
+{
+    struct timers *new_timers = calloc(1, sizeof(*new_timers));
+    if (new_timers != NULL)
+    {
+        new_timers->now_ms = timers_read_clock();
+        new_timers->current_tick = new_timers->now_ms / TIMERS_TICK_MS;
+        new_timers->number_scheduled = 0;
+    }
+    return new_timers;
+}
+
+
+/**
+ * \fn      void timers_destroy(struct timers *this_timers)
+ * \details Free the memory associated with the timers object. The timeouts themselves belong to whoever created them, and must be destroyed
+ *          first.
+ * \param   this_timers A pointer to the timers object to be destroyed.
+ * \return  void
+ */
+void timers_destroy(struct timers *this_timers)
+{
+    free(this_timers);
+}
+
+
+/**
+ * \fn      static void timers_place(struct timers *this_timers, struct timeout *this_timeout)
+ * \details Put a timeout into the slot which corresponds to its expiry tick, on the lowest level that reaches that far.
+ */
+static void timers_place(struct timers *this_timers, struct timeout *this_timeout)
+{
+    uint64_t delta = this_timeout->expiry - this_timers->current_tick;
+    size_t level = 0;
+    while (level < TIMERS_LEVELS - 1 && delta >= ((uint64_t) 1 << ((level + 1)*TIMERS_SLOT_BITS)))
+        level++;
+    size_t slot = (size_t) (this_timeout->expiry >> (level*TIMERS_SLOT_BITS)) & TIMERS_SLOT_MASK;
+
+    struct timeout **head = &this_timers->wheel[level][slot];
+    this_timeout->next = *head;
+    if (*head != NULL)
+        (*head)->pprev = &this_timeout->next;
+    *head = this_timeout;
+    this_timeout->pprev = head;
+}
+
+
+/**
+ * \fn      static void timers_unlink(struct timeout *this_timeout)
+ * \details Take a timeout out of whichever slot it's in.
+ */
+static void timers_unlink(struct timeout *this_timeout)
+{
+    *this_timeout->pprev = this_timeout->next;
+    if (this_timeout->next != NULL)
+        this_timeout->next->pprev = this_timeout->pprev;
+    this_timeout->next = NULL;
+    this_timeout->pprev = NULL;
+}
+
+
+/**
+ * \fn      struct timeout *timeout_create(struct timers *this_timers, timeout_callback callback, void *data)
+ * \details Allocate memory for a timeout. It isn't scheduled until timeout_schedule() is called.
+ * \param   this_timers The timers object which will keep track of the timeout.
+ * \param   callback The function to be called when the timeout fires.
+ * \param   data An opaque pointer to be handed back to the callback.
+ * \return  A pointer to the newly-allocated timeout.
+ */
+struct timeout *timeout_create(struct timers *this_timers, timeout_callback callback, void *data)
+{
+    struct timeout *new_timeout = malloc(sizeof(*new_timeout));
+    if (new_timeout != NULL)
+    {
+        new_timeout->timers = this_timers;
+        new_timeout->expiry = 0;
+        new_timeout->next = NULL;
+        new_timeout->pprev = NULL;
+        new_timeout->callback = callback;
+        new_timeout->data = data;
+    }
+    return new_timeout;
+}
+
+
+/**
+ * \fn      void timeout_destroy(struct timeout *this_timeout)
+ * \details Cancel the timeout if it's scheduled, and free the memory associated with it.
+ * \param   this_timeout A pointer to the timeout to be destroyed.
+ * \return  void
+ */
+void timeout_destroy(struct timeout *this_timeout)
+{
+    if (this_timeout != NULL)
+    {
+        timeout_cancel(this_timeout);
+        free(this_timeout);
+    }
+}
+
+
+/**
+ * \fn      int timeout_schedule(struct timeout *this_timeout, unsigned int delay_ms)
+ * \details Schedule the timeout to fire after the given delay, measured from the cached clock. If it was already scheduled, the old expiry
+ *          time is replaced. The delay is rounded up to a whole number of ticks, so a timeout never fires early.
+ * \param   this_timeout A pointer to the timeout in question.
+ * \param   delay_ms The delay in milliseconds from now.
+ * \return  An integer indicating the outcome of the operation. At present this is always 0.
+ */
+int timeout_schedule(struct timeout *this_timeout, unsigned int delay_ms)
+{
+    struct timers *this_timers = this_timeout->timers;
+    timeout_cancel(this_timeout);
+
+    uint64_t expiry = (this_timers->now_ms + delay_ms + TIMERS_TICK_MS - 1) / TIMERS_TICK_MS;
+    if (expiry <= this_timers->current_tick)
+        expiry = this_timers->current_tick + 1; //That tick has already been processed, so the next one is the soonest possible.
+    if (expiry - this_timers->current_tick > TIMERS_MAX_TICKS)
+        expiry = this_timers->current_tick + TIMERS_MAX_TICKS;
+    this_timeout->expiry = expiry;
+
+    timers_place(this_timers, this_timeout);
+    this_timers->number_scheduled++;
+    return 0; /// \retval 0 The timeout was scheduled.
+}
+
+
+/**
+ * \fn      void timeout_cancel(struct timeout *this_timeout)
+ * \details Remove the timeout from the schedule. It's fine to cancel a timeout which isn't scheduled.
+ * \param   this_timeout A pointer to the timeout in question.
+ * \return  void
+ */
+void timeout_cancel(struct timeout *this_timeout)
+{
+    if (this_timeout == NULL || this_timeout->pprev == NULL)
+        return;
+    timers_unlink(this_timeout);
+    this_timeout->timers->number_scheduled--;
+}
+
+
+/**
+ * \fn      int timeout_is_scheduled(struct timeout *this_timeout)
+ * \details Query whether the timeout is waiting to fire.
+ * \param   this_timeout A pointer to the timeout in question.
+ * \return  1 if the timeout is scheduled, 0 if not.
+ */
+int timeout_is_scheduled(struct timeout *this_timeout)
+{
+    return this_timeout->pprev != NULL;
+}
+
+
+/**
+ * \fn      void timers_update_clock(struct timers *this_timers)
+ * \details Refresh the cached clock. This should be done once per pass through the event loop.
+ * \param   this_timers A pointer to the timers object in question.
+ * \return  void
+ */
+void timers_update_clock(struct timers *this_timers)
+{
+    this_timers->now_ms = timers_read_clock();
+}
+
+
+/**
+ * \fn      uint64_t timers_now(struct timers *this_timers)
+ * \details Get the cached monotonic time, which is cheaper than reading the clock and consistent for everything done in one pass of the
+ *          event loop.
+ * \param   this_timers A pointer to the timers object in question.
+ * \return  The cached monotonic time, in milliseconds.
+ */
+uint64_t timers_now(struct timers *this_timers)
+{
+    return this_timers->now_ms;
+}
+
+
+/**
+ * \fn      int timers_next_expiry(struct timers *this_timers)
+ * \details Work out how long the event loop can wait before timers_run() needs to be called. Only the bottom level of the wheel is searched,
+ *          so if the next timeout is further away than that, the answer is the time until the bottom level needs to be refilled.
+ * \param   this_timers A pointer to the timers object in question.
+ * \return  The number of milliseconds to wait, 0 if something is already due, or -1 if nothing is scheduled at all.
+ */
+int timers_next_expiry(struct timers *this_timers)
+{
+    if (this_timers->number_scheduled == 0)
+        return -1;
+
+    uint64_t now_tick = this_timers->now_ms / TIMERS_TICK_MS;
+    uint64_t tick;
+    for (tick = this_timers->current_tick + 1; tick <= this_timers->current_tick + TIMERS_SLOTS; tick++)
+    {
+        if (this_timers->wheel[0][tick & TIMERS_SLOT_MASK] != NULL || (tick & TIMERS_SLOT_MASK) == 0)
+            break; //Either something fires on this tick, or a higher level gets cascaded down.
+    }
+    if (tick <= now_tick)
+        return 0;
+    return (int) (tick*TIMERS_TICK_MS - this_timers->now_ms);
+}
+
+
+/**
+ * \fn      static void timers_cascade(struct timers *this_timers, size_t level)
+ * \details Empty the slot of the given level which the current tick has just moved into, and spread its timeouts out over the lower levels.
+ *          If this level has also wrapped around, the level above it is cascaded first.
+ */
+static void timers_cascade(struct timers *this_timers, size_t level)
+{
+    size_t slot = (size_t) (this_timers->current_tick >> (level*TIMERS_SLOT_BITS)) & TIMERS_SLOT_MASK;
+    if (slot == 0 && level + 1 < TIMERS_LEVELS)
+        timers_cascade(this_timers, level + 1);
+
+    struct timeout *list = this_timers->wheel[level][slot];
+    this_timers->wheel[level][slot] = NULL;
+    while (list != NULL)
+    {
+        struct timeout *this_timeout = list;
+        list = list->next;
+        timers_place(this_timers, this_timeout);
+    }
+}
+
+
+/**
+ * \fn      void timers_run(struct timers *this_timers)
+ * \details Advance the wheel up to the cached clock, firing all of the timeouts which are due. Callbacks are free to schedule or cancel
+ *          timeouts, including their own.
+ * \param   this_timers A pointer to the timers object in question.
+ * \return  void
+ */
+void timers_run(struct timers *this_timers)
+{
+    uint64_t now_tick = this_timers->now_ms / TIMERS_TICK_MS;
+    if (this_timers->number_scheduled == 0)
+    {
+        //Nothing to fire, so there's no need to walk through every tick in between.
+        this_timers->current_tick = now_tick;
+        return;
+    }
+
+    while (this_timers->current_tick < now_tick)
+    {
+        this_timers->current_tick++;
+        size_t slot = (size_t) this_timers->current_tick & TIMERS_SLOT_MASK;
+        if (slot == 0)
+            timers_cascade(this_timers, 1);
+
+        struct timeout **head = &this_timers->wheel[0][slot];
+        while (*head != NULL)
+        {
+            struct timeout *due = *head;
+            timers_unlink(due);
+            this_timers->number_scheduled--;
+            due->callback(due, due->data);
+        }
+    }
+}
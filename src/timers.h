@@ -0,0 +1,37 @@
+#ifndef _TIMERS_H_
+#define _TIMERS_H_
+
+#include <stdint.h>
+
+/**
+ * \file  timers.h
+ * \brief The timers type keeps track of timeouts which need to fire at some point in the future. Each timeout is created once, and can
+ *        then be scheduled and cancelled as many times as needed, both in constant time. Timeouts live on a hierarchical timing wheel
+ *        with a resolution of TIMERS_TICK_MS.
+ *        The clock is cached: the event loop calls timers_update_clock() once per pass, and everything in that pass sees the same time.
+ *        It then asks how long it may sleep with timers_next_expiry(), and calls timers_run() once it wakes up.
+ */
+
+/// The resolution of the timing wheel, in milliseconds.
+#define TIMERS_TICK_MS 10
+
+struct timers;
+struct timeout;
+
+typedef void (*timeout_callback)(struct timeout *this_timeout, void *data);
+
+struct timers *timers_create();
+void timers_destroy(struct timers *this_timers);
+
+struct timeout *timeout_create(struct timers *this_timers, timeout_callback callback, void *data);
+void timeout_destroy(struct timeout *this_timeout);
+int timeout_schedule(struct timeout *this_timeout, unsigned int delay_ms);
+void timeout_cancel(struct timeout *this_timeout);
+int timeout_is_scheduled(struct timeout *this_timeout);
+
+void timers_update_clock(struct timers *this_timers);
+uint64_t timers_now(struct timers *this_timers);
+int timers_next_expiry(struct timers *this_timers);
+void timers_run(struct timers *this_timers);
+
+#endif
@@ -8,7 +8,7 @@ size_t tokenise_string(char* input_string, char delim, char ***tokens)
     char *string = strdup(input_string);
     size_t string_len = strlen(string);
     //If the string ends in a \n we want to remove it.
-    if (string[string_len-1] == '\n')
+    if (string_len > 0 && string[string_len-1] == '\n')
     {
         string[string_len-1] = '\0';
         string_len--;
@@ -17,7 +17,7 @@ size_t tokenise_string(char* input_string, char delim, char ***tokens)
     size_t previous_delim_location = 0;
 
     int prev_state = 0;
-    int curr_state;
+    int curr_state = 0;
 
     size_t num_tokens = 0;
 
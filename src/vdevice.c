@@ -6,6 +6,7 @@
 
 #include "vdevice.h"
 #include "engine.h"
+#include "arena.h"
 
 #undef max
 #define max(x,y) ((x) > (y) ? (x) : (y))
@@ -15,109 +16,88 @@
 struct vdevice {
     /// The name of the vdevice
     char *name;
-    /// Pointer to a list of engines.
-    struct engine ***engine_list;
-    /// Number of engines that share a host.
-    size_t *number_of_engines;
-    /// Status of the vdevice. Note that the vdevice has no (directly) underlying sensors, it only queries the "device-status" sensors for the corresponding actual devices in the underlying engines. This is updated each time the vdevice's status is retrieved. The virtual sensor doesn't have a value, just a status.
-    char *status; 
+    /// How many of the underlying "device-status" sensors currently have each status, indexed by enum sensor_status. The vdevice has
+    /// no sensor of its own; it watches those of the corresponding actual devices in the engines, and these counts are kept up to date
+    /// as they change.
+    unsigned int status_count[SENSOR_NUMBER_OF_STATUSES];
+    /// Status of the vdevice, worked out from the counts whenever they change. The virtual sensor doesn't have a value, just a status.
+    enum sensor_status status;
 };
 
 
 /**
- * \fn      static int vdevice_update_status(struct vdevice *this_vdevice)
- * \details Query the corresponding actual devices in each engine on the host. The vdevice status is the "worst" status of the corresponding
- *          actual devices.
- *          Function is static because it's only used internally to this object.
- * \param   this_vdevice A pointer to the vdevice to be queried.
- * \return  Function in its current state should always return zero, indicating success.
+ * \fn      static void vdevice_update_status(struct vdevice *this_vdevice)
+ * \details Work out the vdevice's status from the counts. The vdevice takes the "worst" status of the corresponding actual devices,
+ *          where error is worse than warn, which is worse than nominal. Any other status doesn't count, so if none of the engines is
+ *          nominal, warn or error, the vdevice is unknown.
+ * \param   this_vdevice A pointer to the vdevice in question.
+ * \return  void
  */
-static int vdevice_update_status(struct vdevice *this_vdevice)
+static void vdevice_update_status(struct vdevice *this_vdevice)
 {
-    /*Logic: loop through engines' sensors three times, each having a higher priority than the previous.
-     * If any of them are nominal, it'll get written to the device status the first time.
-     * On subsequent loops, a value of "warn" or "error" will overwrite the nominal one.
-     * I can't personally think of a better way to do this.
-     */
-    if (this_vdevice->status != NULL)
-    {
-        free(this_vdevice->status);
-        this_vdevice->status = NULL;
-    }
-    this_vdevice->status = strdup("unknown"); /*If none of the below triggers, this will remain.*/
-    size_t i;
-    for (i = 0; i < *(this_vdevice->number_of_engines); i++)
-    {
-        if (!strcmp(engine_get_sensor_status((*this_vdevice->engine_list)[i], this_vdevice->name, "device-status"), "nominal"))
-        {
-            if (this_vdevice->status != NULL)
-                free(this_vdevice->status);
-            this_vdevice->status = strdup("nominal");
-        }
-    }
-    for (i = 0; i < *(this_vdevice->number_of_engines); i++)
-    {
-        if (!strcmp(engine_get_sensor_status((*this_vdevice->engine_list)[i], this_vdevice->name, "device-status"), "warn"))
-        {
-            if (this_vdevice->status != NULL)
-                free(this_vdevice->status);
-            this_vdevice->status = strdup("warn");
-        }
-    }
-    for (i = 0; i < *(this_vdevice->number_of_engines); i++)
-    {
-        if (!strcmp(engine_get_sensor_status((*this_vdevice->engine_list)[i], this_vdevice->name, "device-status"), "error"))
-        {
-            if (this_vdevice->status != NULL)
-                free(this_vdevice->status);
-            this_vdevice->status = strdup("error");
-        }
-    }
-    return 0;
+    if (this_vdevice->status_count[SENSOR_ERROR])
+        this_vdevice->status = SENSOR_ERROR;
+    else if (this_vdevice->status_count[SENSOR_WARN])
+        this_vdevice->status = SENSOR_WARN;
+    else if (this_vdevice->status_count[SENSOR_NOMINAL])
+        this_vdevice->status = SENSOR_NOMINAL;
+    else
+        this_vdevice->status = SENSOR_UNKNOWN;
 }
 
+
 /**
- * \fn      struct vdevice *vdevice_create(char *new_name, struct engine ***engine_list, size_t *number_of_engines)
- * \details Allocate memory for a vdevice object, connect to the engines which it needs to watch.
+ * \fn      static void vdevice_sensor_changed(void *data, enum sensor_status old_status, enum sensor_status new_status)
+ * \details Called when one of the underlying "device-status" sensors changes status, to move it from one count to another.
+ */
+static void vdevice_sensor_changed(void *data, enum sensor_status old_status, enum sensor_status new_status)
+{
+    struct vdevice *this_vdevice = data;
+    this_vdevice->status_count[old_status]--;
+    this_vdevice->status_count[new_status]++;
+    vdevice_update_status(this_vdevice);
+}
+
+
+/**
+ * \fn      struct vdevice *vdevice_create(char *new_name, struct arena *arena)
+ * \details Allocate memory for a vdevice object. It starts out watching nothing; the engines' sensors are added with vdevice_watch().
  * \param   new_name A name for the vdevice to be created.
- * \param   engine_list A pointer to a list of pointers to engine objects.
- * \param   number_of_engines The number of engines in the list.
+ * \param   arena The arena from which to allocate the vdevice. It is freed along with the arena.
  * \return  A newly allocated pointer to the newly-created vdevice object.
  */
-struct vdevice *vdevice_create(char *new_name, struct engine ***engine_list, size_t *number_of_engines)
+struct vdevice *vdevice_create(char *new_name, struct arena *arena)
 {
-    struct vdevice *new_vdevice = malloc(sizeof(*new_vdevice));
+    struct vdevice *new_vdevice = arena_alloc(arena, sizeof(*new_vdevice));
     if (new_vdevice != NULL)
     {
-        new_vdevice->name = strdup(new_name);
-        new_vdevice->engine_list = engine_list;
-        new_vdevice->number_of_engines = number_of_engines;
-        new_vdevice->status = strdup("unknown");
-        //vdevice_update_status(new_vdevice); //possibly not really needed.
+        new_vdevice->name = arena_strdup(arena, new_name);
+        memset(new_vdevice->status_count, 0, sizeof(new_vdevice->status_count));
+        new_vdevice->status = SENSOR_UNKNOWN;
     }
     return new_vdevice;
 }
 
 
 /**
- * \fn      void vdevice_destroy(struct vdevice *this_vdevice)
- * \details Free the memory associated with the vdevice object.
- * \param   this_vdevice A pointer to the vdevice to be destroyed.
- * \return  void
+ * \fn      int vdevice_watch(struct vdevice *this_vdevice, struct sensor *engine_sensor)
+ * \details Start watching the "device-status" sensor of one of the corresponding actual devices in an engine.
+ * \param   this_vdevice A pointer to the vdevice in question.
+ * \param   engine_sensor A pointer to the sensor.
+ * \return  An integer indicating the outcome of the operation.
  */
-void vdevice_destroy(struct vdevice *this_vdevice)
+int vdevice_watch(struct vdevice *this_vdevice, struct sensor *engine_sensor)
 {
-    /* Not going to free the engine list because it will be freed
-     * by the host that contains it.
-     */
-    if (this_vdevice != NULL)
-    {
-        free(this_vdevice->name);
-        free(this_vdevice->status);
-        free(this_vdevice);
-    }
+    if (engine_sensor == NULL)
+        return -1; /// \retval -1 The sensor doesn't exist.
+    if (sensor_set_watcher(engine_sensor, vdevice_sensor_changed, this_vdevice) > 0)
+        return 0; /// \retval 0 The sensor is being watched, which it may already have been, e.g. after the array was activated again.
+    this_vdevice->status_count[sensor_get_status(engine_sensor)]++;
+    vdevice_update_status(this_vdevice);
+    return 0;
 }
 
+
 /**
  * \fn      char *vdevice_get_name(struct vdevice *this_vdevice)
  * \details Get the name of the given vdevice.
@@ -132,43 +112,47 @@ char *vdevice_get_name(struct vdevice *this_vdevice)
 
 
 /**
- * \fn      char *vdevice_get_status(struct vdevice *this_device)
- * \details Query the vdevice for its latest status.
+ * \fn      enum sensor_status vdevice_get_status(struct vdevice *this_device)
+ * \details Query the vdevice for its latest status. This is kept up to date as the engines' sensors change, so it costs nothing to read.
  * \param   this_vdevice A pointer to the vdevice to be queried.
- * \return  A pointer to the status string of the vdevice. The char* is
- *          not newly allocated so therefore must not be free'd.
+ * \return  The status of the vdevice.
  */
-char *vdevice_get_status(struct vdevice *this_vdevice)
+enum sensor_status vdevice_get_status(struct vdevice *this_vdevice)
 {
-    //TODO: vdevice_update_status can probably be merged with vdevice_get_status - there's not really any reason not to at this point. Either that or, update_status any time the sensor-value is updated. That's going to be a bit more tricky though.
-    vdevice_update_status(this_vdevice);
     return this_vdevice->status;
 }
 
 
 /**
- * \fn      char *vdevice_html_summary(struct vdevice *this_vdevice)
- * \details Get an HTML summary of the vdevice. This is an HTML5 td with the class set to the vdevice's status,
+ * \fn      int vdevice_html_summary(struct vdevice *this_vdevice, char *cell_id, struct strbuf *html)
+ * \details Append an HTML summary of the vdevice. This is an HTML5 td with the class set to the vdevice's status,
  *          so that the higher-level CSS can render the button appropriately.
  * \param   this_vdevice A pointer to the vdevice.
- * \return  A newly allocated string containing the HTML summary of the vdevice.
+ * \param   cell_id The id to give the td, so that the page can find it to update its status.
+ * \param   html The strbuf to which the summary is appended.
+ * \return  0 on success, -1 if the strbuf has failed.
+ */
+int vdevice_html_summary(struct vdevice *this_vdevice, char *cell_id, struct strbuf *html)
+{
+    return strbuf_appendf(html, "<td id=\"%s\" class=\"%s\">%s</td>", cell_id, sensor_status_to_string(vdevice_get_status(this_vdevice)), this_vdevice->name);
+}
+
+
+/**
+ * \fn      int vdevice_json(struct vdevice *this_vdevice, struct json_writer *json, unsigned int fields)
+ * \details Write the vdevice as a JSON object: its name, and its status if asked for. The sensors behind it are written with the
+ *          engines.
+ * \param   this_vdevice A pointer to the vdevice.
+ * \param   json The json_writer to which the object is written.
+ * \param   fields The JSON_FIELD_* flags saying which fields to write.
+ * \return  0 on success, -1 if the writer has failed.
  */
-char *vdevice_html_summary(struct vdevice *this_vdevice)
+int vdevice_json(struct vdevice *this_vdevice, struct json_writer *json, unsigned int fields)
 {
-    //char format[] = "<td class=\"%s\">%s (%u)</td>";
-    char format[] = "<td class=\"%s\">%s</td>";
-    //time_t last_updated = 0;
-    //int i;
-    //for (i = 0; i < *(this_vdevice->number_of_engines); i++)
-    //{
-    //    time_t temp_time = engine_get_sensor_time((*this_vdevice->engine_list)[i], this_vdevice->name, "device-status");
-    //    last_updated = max(last_updated, temp_time);
-    //}
-    //last_updated = time(0) - last_updated; // to get the time since last updated, instead of absolute time.
-    //ssize_t needed = snprintf(NULL, 0, format, vdevice_get_status(this_vdevice), this_vdevice->name, last_updated) + 1;
-    ssize_t needed = snprintf(NULL, 0, format, vdevice_get_status(this_vdevice), this_vdevice->name) + 1;
-    char *html_summary = malloc((size_t) needed);
-    //sprintf(html_summary, format, vdevice_get_status(this_vdevice), this_vdevice->name, last_updated);
-    sprintf(html_summary, format, vdevice_get_status(this_vdevice), this_vdevice->name);
-    return html_summary;
+    json_begin_object(json);
+    json_key_string(json, "name", this_vdevice->name);
+    if (fields & JSON_FIELD_STATUS)
+        json_key_string(json, "status", sensor_status_to_string(vdevice_get_status(this_vdevice)));
+    json_end_object(json);
+    return json_writer_has_failed(json) ? -1 : 0;
 }
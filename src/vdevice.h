@@ -1,6 +1,7 @@
 #ifndef _VDEVICE_H_
 #define _VDEVICE_H_
 #include "engine.h"
+#include "strbuf.h"
 
 /**
  * \file  vdevice.h
@@ -10,12 +11,14 @@
  */
 
 struct vdevice;
+struct arena;
 
-struct vdevice *vdevice_create(char *new_name, struct engine ***engine_list, size_t *number_of_engines);
-void vdevice_destroy(struct vdevice *this_vdevice);
+struct vdevice *vdevice_create(char *new_name, struct arena *arena);
+int vdevice_watch(struct vdevice *this_vdevice, struct sensor *engine_sensor);
 
 char *vdevice_get_name(struct vdevice *this_vdevice);
-char *vdevice_get_status(struct vdevice *this_vdevice);
+enum sensor_status vdevice_get_status(struct vdevice *this_vdevice);
 
-char *vdevice_html_summary(struct vdevice *this_vdevice);
+int vdevice_html_summary(struct vdevice *this_vdevice, char *cell_id, struct strbuf *html);
+int vdevice_json(struct vdevice *this_vdevice, struct json_writer *json, unsigned int fields);
 #endif
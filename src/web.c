@@ -4,54 +4,121 @@
 #include <unistd.h>
 #include <string.h>
 #include <ctype.h>
+#include <fcntl.h>
+#include <errno.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 
 #include "web.h"
 #include "html.h"
+#include "strbuf.h"
+#include "response.h"
+#include "http_parser.h"
+#include "event_stream.h"
+#include "json.h"
 #include "tokenise.h"
 
-//TODO think about moving these definitions to some central place. Could introduce bugs if not modified properly.
-#define BUF_SIZE 1024
-#define max(x,y) ((x) > (y) ? (x) : (y))
+/// How long a connection may sit idle, with nothing coming in or going out, before it's closed. Browsers which poll every few seconds
+/// keep the same connection open well within this.
+#define WEB_CLIENT_IDLE_TIMEOUT_MS 30000
 
 /// A struct to hold the information required to service an HTTP connection from a web browser.
 struct web_client {
-    /// The data to be sent to the client in response to an HTTP GET request.
-    char *buffer;
-    /// The number of bytes available in the buffer.
-    size_t bytes_available;
-    /// The number of bytes already written from the buffer to the file descriptor.
-    size_t bytes_written;
+    /// The response to the request being dealt with, while it's being put together and sent.
+    struct response *response;
+    /// What the client has sent and hasn't been dealt with yet, including any requests it has pipelined.
+    struct http_parser *parser;
+    /// The request being dealt with.
+    struct http_request request;
     /// The file decsriptor associated with the connection.
     int fd;
-    /// A flag indicating that the client has sent a GET and is waiting for a response.
-    int get_received;
-    /// The resource which the client requested.
-    char *requested_resource;
+    /// A flag indicating that the connection is to be closed once the current response has been sent.
+    int close_after_response;
+    /// A flag indicating that the client has closed its side of the connection. Whatever it sent before that is still answered.
+    int peer_closed;
+    /// Closes the connection when it has been idle for too long.
+    struct timeout *idle_timeout;
+    /// The timers on which the client's timeouts go.
+    struct timers *timers;
+    /// The event stream which the connection has been handed over to, NULL if it's an ordinary connection.
+    struct event_stream *stream;
+    /// Flushes the event stream every EVENT_STREAM_FLUSH_MS.
+    struct timeout *stream_flush;
+    /// The reactor which watches the client's file descriptor.
+    struct reactor *reactor;
+    /// The program's list of cmc_servers, needed to compose responses.
+    struct cmc_server **cmc_list;
+    /// The number of cmc_servers in the list.
+    size_t num_cmcs;
 };
 
 
+static void web_client_socket_event(struct reactor *this_reactor, int fd, uint32_t events, void *data);
+static void web_client_service(struct web_client *client);
+
+
+/**
+ * \fn      static void web_client_idle_timeout(struct timeout *this_timeout, void *data)
+ * \details The timeout callback for a connection which has been idle for too long. The client is destroyed.
+ * \param   this_timeout The client's idle timeout.
+ * \param   data A pointer to the web_client.
+ * \return  void
+ */
+static void web_client_idle_timeout(struct timeout *this_timeout, void *data)
+{
+    web_client_destroy(data);
+}
+
+
 /**
- * \fn      struct web_client *web_client_create(int fd)
- * \details Allocate memory for a web_client object and populate the members with NULL values.
+ * \fn      struct web_client *web_client_create(int fd, struct reactor *reactor, struct timers *timers, struct cmc_server **cmc_list, size_t num_cmcs)
+ * \details Allocate memory for a web_client object, populate the members with NULL values and register the file descriptor with the reactor.
+ *          From then on the web_client looks after itself, and destroys itself when the connection is closed or has been idle for too long.
  * \param   fd The file descriptor on which the browser client connetion has been made.
- * \return  A pointer to the newly-created web_client object.
+ * \param   reactor The reactor with which to register the file descriptor.
+ * \param   timers The timers on which the client's idle timeout goes.
+ * \param   cmc_list The program's list of cmc_server objects, which the client will use to compose its responses.
+ * \param   num_cmcs The number of cmc_server objects in the list.
+ * \return  A pointer to the newly-created web_client object, NULL if the client couldn't be registered with the reactor.
  */
-struct web_client *web_client_create(int fd)
+struct web_client *web_client_create(int fd, struct reactor *reactor, struct timers *timers, struct cmc_server **cmc_list, size_t num_cmcs)
 {
     struct web_client *new_client = malloc(sizeof(*new_client));
-    new_client->buffer = malloc(1);
-    new_client->buffer[0] = '\0';
-    new_client->bytes_available = 0;
-    new_client->bytes_written = 0;
+    if (new_client == NULL)
+        return NULL;
+    new_client->response = response_create();
+    new_client->parser = http_parser_create();
+    new_client->idle_timeout = timeout_create(timers, web_client_idle_timeout, new_client);
+    if (new_client->response == NULL || new_client->parser == NULL || new_client->idle_timeout == NULL)
+        goto fail;
     new_client->fd = fd;
-
-    new_client->get_received = 0;
-    new_client->requested_resource = NULL;
+    //Responses are sent for as long as the socket will take them, so it mustn't block when it's full.
+    int flags = fcntl(fd, F_GETFL);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)
+        syslog(LOG_WARNING, "Unable to make web client FD %d non-blocking: %m", fd);
+
+    new_client->close_after_response = 0;
+    new_client->peer_closed = 0;
+    new_client->timers = timers;
+    new_client->stream = NULL;
+    new_client->stream_flush = NULL;
+
+    new_client->reactor = reactor;
+    new_client->cmc_list = cmc_list;
+    new_client->num_cmcs = num_cmcs;
+    if (reactor_add(reactor, fd, REACTOR_READ, web_client_socket_event, new_client) < 0)
+        goto fail;
+    timeout_schedule(new_client->idle_timeout, WEB_CLIENT_IDLE_TIMEOUT_MS);
 
     return new_client;
+
+fail:
+    timeout_destroy(new_client->idle_timeout);
+    http_parser_destroy(new_client->parser);
+    response_destroy(new_client->response);
+    free(new_client);
+    return NULL;
 }
 
 
@@ -64,6 +131,7 @@ struct web_client *web_client_create(int fd)
 void web_client_destroy(struct web_client *client)
 {
     int r;
+    reactor_remove(client->reactor, client->fd);
     r = shutdown(client->fd, SHUT_RDWR);
     if (r < 0)
     {
@@ -75,199 +143,291 @@ void web_client_destroy(struct web_client *client)
         perror("close"); // for completeness, one really should be more rigorous about this...
     }
 
-    free(client->buffer);
+    timeout_destroy(client->stream_flush);
+    event_stream_destroy(client->stream);
+    timeout_destroy(client->idle_timeout);
+    http_parser_destroy(client->parser);
+    response_destroy(client->response);
     free(client);
 }
 
 
 /**
  * \fn      int web_client_buffer_add(struct web_client *client, char *html_text)
- * \details Add some text to the web_client's send buffer.
+ * \details Add some text to the body of the response which the web_client is putting together.
  * \param   client A pointer to the web_client in question.
  * \param   html_text A string containing the text (ostensibly HTML-formatted, but not completely necessary) to be sent to the client.
  * \return  An integer indicating the success of the operation.
  */
 int web_client_buffer_add(struct web_client *client, char *html_text)
 {
-    /* checks because they seem to be needed */
-    if (client->buffer == NULL || html_text == NULL)
+    if (html_text == NULL)
         return -1; /// \retval -1 The operation returned failure.
-    size_t needed = strlen(client->buffer) + strlen(html_text) + 1;
-    char *temp = realloc(client->buffer, needed);
-    if (temp)
-    {
-        client->buffer = temp;
-        strcat(client->buffer, html_text);
-        client->bytes_available += strlen(html_text);
-        return 0; /// \retval 0 The operation was successful.
-    }
-    return -1;
+    return strbuf_append(response_get_body(client->response), html_text); /// \retval 0 The operation was successful.
 }
 
 
 /**
- * \fn      static int web_client_buffer_write(struct web_client *client)
- * \details Write the buffer out to the client connection's file descriptor.
+ * \fn      static int web_client_socket_read(struct web_client *client)
+ * \details Read everything that's waiting on the web_client's file descriptor into its parser. Requests can arrive in any number of
+ *          pieces, and several can arrive together; the parser sorts that out. If the parser's buffer is full, the rest is left in the
+ *          socket until some of the requests have been answered.
  * \param   client A pointer to the web_client in question.
- * \return  An integer indicating the success of the operation.
+ * \return  An integer indicating the outcome of the operation.
  */
-static int web_client_buffer_write(struct web_client *client)
+static int web_client_socket_read(struct web_client *client)
 {
-    ssize_t r;
-    size_t bytes_ready = client->bytes_available - client->bytes_written;
-    size_t bytes_to_write = (bytes_ready > BUF_SIZE) ? BUF_SIZE : bytes_ready;
-
-    if (client->bytes_written == 0) /* i.e. this is a new thing, we can send the http header */
+    for (;;)
     {
-        char format[] = "HTTP/1.1 200 OK\nContent-Length: %ld\nConnection: close\n\n";
-        int needed = snprintf(NULL, 0, format, client->bytes_available) + 1; // snprintf can return a negative value on failure.
-        if (needed < 1) //this means there was a problem somehow.
+        size_t space;
+        char *space_start = http_parser_get_space(client->parser, &space);
+        if (space == 0)
+            break;
+        ssize_t r = read(client->fd, space_start, space);
+        if (r < 0)
         {
-            perror("snprintf");
-            return -1; /// \retval -1 The operation has failed.
-        }
-        char *http_ok_message = malloc((size_t) needed); // int guaranteed non-negative so can safely cast.
-        sprintf(http_ok_message, format, client->bytes_available);
-        r = write(client->fd, http_ok_message, strlen(http_ok_message));
-        if (r<0)
-        {
-            perror("write()");
-            return -1;
-        }
-        if ((ssize_t) bytes_to_write + r > BUF_SIZE)
-            bytes_to_write -= (size_t) r; // so we don't send more than one buffer size this round, to take
-                                          // into account http ok message. cast is fine because we tested <0 previously.
-        free(http_ok_message);
-    }
-
-    r = write(client->fd, client->buffer + client->bytes_written, bytes_to_write);
-    if (r < 0)
-    {
-        perror("write()");
-        return -1; /* minus one means an error */
-    }
-    client->bytes_written += (unsigned long) r; //we previously made certain it's not negative.
-    if (client->bytes_written == client->bytes_available)
-    {
-        char *temp = realloc(client->buffer, 1);
-        if (temp)
-        {
-            client->buffer = temp;
-            client->buffer[0] = 0;
-            client->bytes_available = 0;
-            client->bytes_written = 0;
-            return 0; /// \retval 0 The operation has succeeded, and the client's buffer is now empty.
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            perror("read");
+            return -2; /// \retval -2 The read operation failed.
         }
-        else
-            return -1;
+        if (r == 0)
+            return -1; /// \retval -1 The client has closed its side of the connection. Whatever it sent before that is still in the parser.
+        http_parser_commit(client->parser, (size_t) r);
     }
-    return 1; /// \retval 1 The operation has succeeded, but the client's buffer still has some data left to send.
+    return 0; /// \retval 0 Everything there was to read has been read, or the parser's buffer is full.
 }
 
 
 /**
- * \fn      static int web_client_have_buffer(struct web_client *client)
- * \details Query whether or not the buffer has data ready to be written.
- * \param   client A pointer to the client in question.
- * \return  An integer indicating whether or not the buffer has valid data.
+ * \fn      static void web_client_respond_error(struct web_client *client, char *status, char *extra_header)
+ * \details Put together a short plain-text error response. The connection is kept open after it if close_after_response allows.
+ * \param   client A pointer to the web_client in question.
+ * \param   status The status code and reason, e.g. "400 Bad Request".
+ * \param   extra_header Another header line to send, including its CRLF, or an empty string.
+ * \return  void
  */
-static int web_client_have_buffer(struct web_client *client)
+static void web_client_respond_error(struct web_client *client, char *status, char *extra_header)
 {
-    if (client->bytes_available > client->bytes_written)
-        return 1; /// \retval 1 The buffer has data available.
-    else
-        return 0; /// \retval 0 The buffer has no data.
+    strbuf_appendf(response_get_body(client->response), "%s\n", status);
+    strbuf_appendf(response_get_header(client->response), \
+            "HTTP/1.1 %s\r\nContent-Type: text/plain\r\nContent-Length: %zu\r\n%sConnection: %s\r\n\r\n", \
+            status, response_get_body_length(client->response), extra_header, client->close_after_response ? "close" : "keep-alive");
 }
 
 
-/** 
- * \fn      void web_client_set_fds(struct web_client *client, fd_set *rd, fd_set *wr, int *nfds)
- * \details Set file-descriptor sets according to what's happening in the client object. Read will always be set, but write will only
- *          ever be set if the buffer has data ready.
+/**
+ * \fn      static void web_client_add_array_detail(struct web_client *client, struct array *this_array)
+ * \details Add an array's detail page to the response: the heading, which is rendered afresh, and the table, which is sent straight from
+ *          the array's cache. Rather than reloading itself, the page listens to the array's event stream for changes from the
+ *          generation at which it was rendered.
  * \param   client A pointer to the web_client in question.
- * \param   rd A pointer to the fd_set indicating ready to read.
- * \param   wr A pointer to the fd_set indicating ready to write.
- * \param   nfds A pointer to an integer indicating the number of file descriptors in the above sets.
+ * \param   this_array A pointer to the array.
+ * \return  void
+ */
+static void web_client_add_array_detail(struct web_client *client, struct array *this_array)
+{
+    struct strbuf *body = response_get_body(client->response);
+    uint64_t generation = array_get_generation(this_array);
+    web_client_buffer_add(client, html_body_open_live());
+    array_html_heading(this_array, body);
+    response_add_fragment(client->response, array_html_table(this_array));
+    html_event_source(array_get_cmc_address(this_array), array_get_name(this_array), generation, body);
+}
+
+
+/**
+ * \fn      static void web_client_stream_flush_due(struct timeout *this_timeout, void *data)
+ * \details The timeout callback which flushes a client's event stream. If the client hasn't taken the last lot of events yet, it's left
+ *          alone, and the changes pile up in the array until it has. Once the stream has told the page to reload, the connection is
+ *          closed after that.
+ * \param   this_timeout The client's stream_flush timeout.
+ * \param   data A pointer to the web_client.
  * \return  void
  */
-void web_client_set_fds(struct web_client *client, fd_set *rd, fd_set *wr, int *nfds)
+static void web_client_stream_flush_due(struct timeout *this_timeout, void *data)
 {
-    FD_SET(client->fd, rd);
-    if (web_client_have_buffer(client))
+    struct web_client *client = data;
+    if (!response_is_pending(client->response))
     {
-        FD_SET(client->fd, wr);
+        if (event_stream_flush(client->stream, response_get_body(client->response)) != 0)
+            client->close_after_response = 1;
     }
-    *nfds = max(*nfds, client->fd);
+    if (!client->close_after_response)
+        timeout_schedule(this_timeout, EVENT_STREAM_FLUSH_MS);
+    web_client_service(client);
 }
 
 
 /**
- * \fn      int web_client_socket_read(struct web_client *client, fd_set *rd)
- * \details Read from the web_client's file descriptor (if it's set), check what it wants. Respond only to a GET request.
+ * \fn      static int web_client_start_event_stream(struct web_client *client, struct cmc_server **cmc_list, size_t num_cmcs)
+ * \details Hand the connection over to an event stream for the array named in the request, i.e. /events/<cmc>/<array>, optionally
+ *          followed by ?since=<generation>. The stream has no length, so it goes on until either side closes the connection, and
+ *          nothing else is answered on it.
  * \param   client A pointer to the web_client in question.
- * \param   rd A pointer to the fd_set indicating a read is ready.
- * \return  An integer indicating the outcome of the operation.
+ * \param   cmc_list The program's list of cmc_server objects.
+ * \param   num_cmcs The number of cmc_server objects in the list.
+ * \return  0 if the stream has started, -1 if there's no such array (a 404 is sent instead) or no memory.
  */
-int web_client_socket_read(struct web_client *client, fd_set *rd)
+static int web_client_start_event_stream(struct web_client *client, struct cmc_server **cmc_list, size_t num_cmcs)
 {
-    ssize_t r = 0;
-    char buffer[BUF_SIZE];
+    char *path = client->request.target + strlen("/events/");
+    uint64_t since = 0;
+    char *query = strchr(path, '?');
+    if (query != NULL)
+    {
+        *query = '\0';
+        char *since_string = strstr(query + 1, "since=");
+        if (since_string != NULL)
+            since = strtoull(since_string + strlen("since="), NULL, 10);
+    }
 
-    if (FD_ISSET(client->fd, rd))
+    char **tokens = NULL;
+    size_t n_tokens = tokenise_string(path, '/', &tokens);
+    size_t i;
+    if (n_tokens == 2)
     {
-        r = read(client->fd, buffer, BUF_SIZE - 1);
-        if (r<0)
-        {
-            perror("read");
-            return -2; /// \retval -2 The read operation failed.
-        }
-        if (r==0)
+        for (i = 0; i < num_cmcs; i++)
         {
-            return -1; /// \retval -1 The file descriptor has nothing left to say. No error, but the socket probably needs closing.
+            if (!strcmp(tokens[0], cmc_server_get_name(cmc_list[i])))
+            {
+                client->stream = event_stream_create(cmc_list[i], tokens[1], since);
+                break;
+            }
         }
+    }
+    for (i = 0; i < n_tokens; i++)
+        free(tokens[i]);
+    free(tokens);
 
-        buffer[r] = '\0'; //just for good safety.
-        char first_word[BUF_SIZE];
-        sprintf(first_word, "%s", strtok(buffer, " "));
-        if (!strcmp(first_word, "GET"))
+    if (client->stream == NULL)
+    {
+        web_client_respond_error(client, "404 Not Found", "");
+        return -1;
+    }
+    client->stream_flush = timeout_create(client->timers, web_client_stream_flush_due, client);
+    if (client->stream_flush == NULL)
+    {
+        event_stream_destroy(client->stream);
+        client->stream = NULL;
+        client->close_after_response = 1;
+        web_client_respond_error(client, "503 Service Unavailable", "");
+        return -1;
+    }
+
+    client->close_after_response = 0;
+    strbuf_append(response_get_header(client->response), \
+            "HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\nCache-Control: no-cache\r\nConnection: close\r\n\r\n");
+    //If the connection drops, the browser tries again after this many milliseconds.
+    strbuf_append(response_get_body(client->response), "retry: 5000\n\n");
+    if (event_stream_flush(client->stream, response_get_body(client->response)) != 0)
+        client->close_after_response = 1;
+    else
+        timeout_schedule(client->stream_flush, EVENT_STREAM_FLUSH_MS);
+    return 0;
+}
+
+
+/**
+ * \fn      static int web_client_write_api_resource(struct json_writer *json, char **tokens, size_t n_tokens, struct cmc_server **cmc_list, size_t num_cmcs, unsigned int fields)
+ * \details Write the JSON for the API resource named by the tokens of its path: ["cmcs"], [<cmc>, <array>] or
+ *          [<cmc>, <array>, "hosts", <host>], where the host is given as on the detail page, e.g. "f3".
+ * \return  0 if it has been written, 1 if there's no such resource, -1 if the writer has failed.
+ */
+static int web_client_write_api_resource(struct json_writer *json, char **tokens, size_t n_tokens, struct cmc_server **cmc_list, size_t num_cmcs, unsigned int fields)
+{
+    size_t i;
+    if (n_tokens == 1 && !strcmp(tokens[0], "cmcs"))
+    {
+        json_begin_array(json);
+        for (i = 0; i < num_cmcs; i++)
+            cmc_server_json(cmc_list[i], json, fields);
+        json_end_array(json);
+        return json_writer_has_failed(json) ? -1 : 0;
+    }
+    if (n_tokens != 2 && !(n_tokens == 4 && !strcmp(tokens[2], "hosts")))
+        return 1;
+    for (i = 0; i < num_cmcs; i++)
+    {
+        if (!strcmp(tokens[0], cmc_server_get_name(cmc_list[i])))
         {
-            client->get_received = 1;
-            client->requested_resource = strdup(strtok(NULL, " "));
-            //syslog(LOG_DEBUG, "Client on FD %d requested %s.", client->fd, client->requested_resource);
-            return 1; /// \retval 1 Read successful, GET request identified.
+            int array_number = cmc_server_check_for_array(cmc_list[i], tokens[1]);
+            if (array_number < 0)
+                return 1;
+            struct array *this_array = cmc_server_get_array(cmc_list[i], (size_t) array_number);
+            if (n_tokens == 2)
+                return array_json(this_array, json, fields);
+            return array_json_host(this_array, tokens[3], json, fields);
         }
-        //We're basically ignoring everything except GET requests. We don't even really care about the other stuff.
     }
-    return 0; /// \retval 0 This client's file descriptor is not marked for read (should not occur in normal operation) or 
-              ///           the received data was not a GET request.
-    ///TODO At the moment this is just quick-and-dirty - check for a GET and what resource was requested. Decide whether or not 
-    ///to make it fully compliant with the HTML standards.
+    return 1;
 }
 
 
 /**
- * \fn      int web_client_socket_write(struct web_client *client, fd_set *wr)
- * \details Write to the web_client's file descriptor, if it is available.
+ * \fn      static void web_client_respond_api(struct web_client *client, struct cmc_server **cmc_list, size_t num_cmcs)
+ * \details Answer a request for the JSON API, i.e. /api/cmcs, /api/<cmc>/<array> or /api/<cmc>/<array>/hosts/<host>, optionally
+ *          followed by ?fields=<list> to ask for only some of the fields (see json_fields_from_string()), e.g. ?fields=status. The JSON
+ *          is written straight from the model into the response's body.
  * \param   client A pointer to the web_client in question.
- * \param   wr A pointter to the df_set indicating that a write is ready.
- * \return  An integer indicating the outcome of the operation.
+ * \param   cmc_list The program's list of cmc_server objects.
+ * \param   num_cmcs The number of cmc_server objects in the list.
+ * \return  void
  */
-int web_client_socket_write(struct web_client *client, fd_set *wr)
+static void web_client_respond_api(struct web_client *client, struct cmc_server **cmc_list, size_t num_cmcs)
 {
-    int r = 0;
+    char *path = client->request.target + strlen("/api/");
+    unsigned int fields = JSON_FIELD_ALL;
+    char *query = strchr(path, '?');
+    if (query != NULL)
+    {
+        *query = '\0';
+        char *field_list = strstr(query + 1, "fields=");
+        if (field_list != NULL)
+        {
+            field_list += strlen("fields=");
+            field_list[strcspn(field_list, "&")] = '\0';
+            fields = json_fields_from_string(field_list);
+        }
+    }
 
-    if (FD_ISSET(client->fd, wr))
+    struct strbuf *body = response_get_body(client->response);
+    struct json_writer *json = json_writer_create(body);
+    char *status = "503 Service Unavailable";
+    if (json != NULL)
     {
-        r = web_client_buffer_write(client);
+        char **tokens = NULL;
+        size_t n_tokens = tokenise_string(path, '/', &tokens);
+        size_t i;
+        int result = web_client_write_api_resource(json, tokens, n_tokens, cmc_list, num_cmcs, fields);
+        for (i = 0; i < n_tokens; i++)
+            free(tokens[i]);
+        free(tokens);
+        json_writer_destroy(json);
+        if (result == 0)
+            status = "200 OK";
+        else if (result > 0)
+            status = "404 Not Found";
     }
-    return r; //no read
+
+    if (strcmp(status, "200 OK"))
+    {
+        strbuf_clear(body);
+        strbuf_appendf(body, "{\"error\":\"%s\"}", status);
+    }
+    strbuf_append(body, "\n");
+    strbuf_appendf(response_get_header(client->response), \
+            "HTTP/1.1 %s\r\nContent-Type: application/json\r\nCache-Control: no-cache\r\nContent-Length: %zu\r\nConnection: %s\r\n\r\n", \
+            status, response_get_body_length(client->response), client->close_after_response ? "close" : "keep-alive");
 }
 
 
 /**
  * \fn      int web_client_handle_requests(struct web_client *client, struct cmc_server **cmc_list, size_t num_cmcs, struct cmc_aggregator *cmc_agg)
- * \details Compose a response to the client based on the requested resource, and the current state of stored data. Push the composed response onto the
- *          web_client's buffer for sending when it's ready.
+ * \details Compose a response to the client's current request, based on the requested resource and the current state of stored data. Push
+ *          the composed response onto the web_client's buffer for sending when it's ready. Only GET is answered; anything else gets a 405.
  * \param   client A pointer to the web_client in question.
  * \param   cmc_list A pointer to the program's list of cmc_server objects, to be able to retrieve the data needed to compose a response.
  * \param   num_cmcs The number of cmc_server objects in the list.
@@ -278,22 +438,34 @@ int web_client_handle_requests(struct web_client *client, struct cmc_server **cm
 {
     //TODO: check requested resource before sending anything. Probably the correct thing to do is to
     //send a 404 in that case.
-    if (client->get_received == 1)
+    client->close_after_response = !client->request.keep_alive;
+    if (strcmp(client->request.method, "GET"))
+    {
+        web_client_respond_error(client, "405 Method Not Allowed", "Allow: GET\r\n");
+        return 0;
+    }
+    char *requested_resource = client->request.target;
+    if (!strncmp(requested_resource, "/events/", strlen("/events/")))
+    {
+        web_client_start_event_stream(client, cmc_list, num_cmcs);
+        return 0;
+    }
+    if (!strncmp(requested_resource, "/api/", strlen("/api/")))
+    {
+        web_client_respond_api(client, cmc_list, num_cmcs);
+        return 0;
+    }
     {
+        struct strbuf *body = response_get_body(client->response);
         web_client_buffer_add(client, html_doctype());
         web_client_buffer_add(client, html_open());
         web_client_buffer_add(client, html_head_open());
 
-        if (!strcmp(client->requested_resource, "/"))
+        if (!strcmp(requested_resource, "/"))
         {
-            char *title = html_title("CBF Sensor Dashboard");
-            web_client_buffer_add(client, title);
-            free(title);
+            html_title("CBF Sensor Dashboard", body);
             web_client_buffer_add(client, html_script());
-
-            char *styles = html_style();
-            web_client_buffer_add(client, styles);
-            free(styles);
+            html_style(body);
 
             web_client_buffer_add(client, html_head_close());
 
@@ -306,17 +478,13 @@ int web_client_handle_requests(struct web_client *client, struct cmc_server **cm
             {
                 size_t i;
                 for (i = 0; i < num_cmcs; i++)
-                {
-                    char *cmc_server_html_rep = cmc_server_html_representation(cmc_list[i]);
-                    web_client_buffer_add(client, cmc_server_html_rep);
-                    free(cmc_server_html_rep);
-                }
+                    response_add_fragment(client->response, cmc_server_html_representation(cmc_list[i]));
             }
         }
         else
         {
             char **tokens = NULL;
-            size_t n_tokens = tokenise_string(client->requested_resource, '/', &tokens);
+            size_t n_tokens = tokenise_string(requested_resource, '/', &tokens);
 
             char *requested_cmc;
             char *requested_array = strdup("");
@@ -324,7 +492,7 @@ int web_client_handle_requests(struct web_client *client, struct cmc_server **cm
 
             switch (n_tokens) {
                 default:
-                syslog(LOG_WARNING, "Requested URL (%s) too long. Expect <cmc>/<array_name> only. Ignoring everything else.", client->requested_resource);
+                syslog(LOG_WARNING, "Requested URL (%s) too long. Expect <cmc>/<array_name> only. Ignoring everything else.", requested_resource);
                 case 3: // we're ignoring the actual content of the third token, but if it's there, we'll show missing-pkts.
                     requested_missing_pkts = 1;
                 case 2: // This means, we're requesting an array that's in one of the CMCs.
@@ -334,26 +502,12 @@ int web_client_handle_requests(struct web_client *client, struct cmc_server **cm
                     requested_cmc = strdup(tokens[0]);
             }
 
-            {
-                char format[] = "CBF Sensor Dashboard: %s/%s";
-                ssize_t needed = snprintf(NULL, 0, format, requested_cmc, requested_array) + 1;
-                char *title_string = malloc((size_t) needed);
-                sprintf(title_string, format, requested_cmc, requested_array);
-                char *title = html_title(title_string);
-                web_client_buffer_add(client, title);
-                free(title_string);
-                free(title);
-
-                char *styles = html_style();
-                web_client_buffer_add(client, styles);
-                free(styles);
-
-                web_client_buffer_add(client, html_script());
-                web_client_buffer_add(client, html_head_close());
-            }
-
-            web_client_buffer_add(client, html_body_open());
+            strbuf_appendf(body, "<title>CBF Sensor Dashboard: %s/%s</title>\n", requested_cmc, requested_array);
+            html_style(body);
+            web_client_buffer_add(client, html_script());
+            web_client_buffer_add(client, html_head_close());
 
+            //An array's detail page keeps itself up to date (see web_client_add_array_detail()), and everything else reloads itself.
             if (strcmp("", requested_array)) //will return a true value if they are not equal, i.e. an array has been requested.
             {
                 size_t i;
@@ -364,12 +518,8 @@ int web_client_handle_requests(struct web_client *client, struct cmc_server **cm
                 }
                 if (i == num_cmcs)
                 {
-                    char format[] = "<p>No cmc named %s.</p>";
-                    ssize_t needed = snprintf(NULL, 0, format, requested_cmc) + 1;
-                    char *message = malloc((size_t) needed);
-                    sprintf(message, format, requested_cmc);
-                    web_client_buffer_add(client, message);
-                    free(message);
+                    web_client_buffer_add(client, html_body_open());
+                    strbuf_appendf(body, "<p>No cmc named %s.</p>", requested_cmc);
                 }
                 else
                 {
@@ -378,25 +528,16 @@ int web_client_handle_requests(struct web_client *client, struct cmc_server **cm
                     {
                         if (requested_missing_pkts)
                         {
-                            char *missing_pkts_detail = array_html_missing_pkt_view(cmc_server_get_array(cmc_list[i], (size_t) r));
-                            web_client_buffer_add(client, missing_pkts_detail);
-                            free(missing_pkts_detail);
+                            web_client_buffer_add(client, html_body_open());
+                            array_html_missing_pkt_view(cmc_server_get_array(cmc_list[i], (size_t) r), body);
                         }
                         else
-                        {
-                            char *array_detail = array_html_detail(cmc_server_get_array(cmc_list[i], (size_t) r));
-                            web_client_buffer_add(client, array_detail);
-                            free(array_detail);
-                        }
+                            web_client_add_array_detail(client, cmc_server_get_array(cmc_list[i], (size_t) r));
                     }
                     else
                     {
-                        char format[] = "<p>%s does not have an array named %s.</p>";
-                        ssize_t needed = snprintf(NULL, 0, format, requested_cmc, requested_array) + 1;
-                        char *message = malloc((size_t) needed);
-                        sprintf(message, format, requested_cmc, requested_array);
-                        web_client_buffer_add(client, message);
-                        free(message);
+                        web_client_buffer_add(client, html_body_open());
+                        strbuf_appendf(body, "<p>%s does not have an array named %s.</p>", requested_cmc, requested_array);
                     }
                 }
             }
@@ -418,19 +559,11 @@ int web_client_handle_requests(struct web_client *client, struct cmc_server **cm
                     nth_array = cmc_aggregator_get_array(cmc_agg, r - 1); // minus one so that we can start indexing at 1.
                 }
                 if (nth_array != NULL)
-                {
-                    char *array_detail = array_html_detail(nth_array);
-                    web_client_buffer_add(client, array_detail);
-                    free(array_detail);
-                }
+                    web_client_add_array_detail(client, nth_array);
                 else
                 {
-                    char format[] = "<p>Requsted array %s not accessible! Are you sure it's there?";
-                    ssize_t needed = snprintf(NULL, 0, format, requested_cmc) + 1;
-                    char *message = malloc((size_t) needed);
-                    sprintf(message, format, requested_cmc);
-                    web_client_buffer_add(client, message);
-                    free(message);
+                    web_client_buffer_add(client, html_body_open());
+                    strbuf_appendf(body, "<p>Requsted array %s not accessible! Are you sure it's there?", requested_cmc);
                 }
             }
 
@@ -444,12 +577,118 @@ int web_client_handle_requests(struct web_client *client, struct cmc_server **cm
 
         web_client_buffer_add(client, html_body_close());
         web_client_buffer_add(client, html_close());
+        strbuf_appendf(response_get_header(client->response), \
+                "HTTP/1.1 200 OK\r\nContent-Type: text/html; charset=utf-8\r\nContent-Length: %zu\r\nConnection: %s\r\n\r\n", \
+                response_get_body_length(client->response), client->close_after_response ? "close" : "keep-alive");
+    }
+    return 0;
+}
 
-        client->get_received = 0;
-        free(client->requested_resource);
-        client->requested_resource = NULL;
 
+/**
+ * \fn      static void web_client_service(struct web_client *client)
+ * \details Answer the requests in the client's parser one at a time: each response is composed only once the last one has been sent
+ *          completely, so pipelined requests are answered in order. The connection stays open between requests unless the client asked
+ *          otherwise, and is closed when it goes away or after a response which said it would be. A connection which has been handed
+ *          over to an event stream answers nothing more, and is only written to as the stream is flushed.
+ * \param   client A pointer to the web_client in question. It may have been destroyed by the time this returns.
+ * \return  void
+ */
+static void web_client_service(struct web_client *client)
+{
+    for (;;)
+    {
+        if (!response_is_pending(client->response))
+        {
+            if (client->close_after_response)
+            {
+                web_client_destroy(client);
+                return;
+            }
+            if (client->stream != NULL)
+            {
+                if (client->peer_closed)
+                {
+                    web_client_destroy(client);
+                    return;
+                }
+                break;
+            }
+            int r = http_parser_next(client->parser, &client->request);
+            if (r == 0)
+            {
+                if (client->peer_closed)
+                {
+                    web_client_destroy(client);
+                    return;
+                }
+                break;
+            }
+            if (r < 0)
+            {
+                //There's no telling where the next request would start, so the connection goes after this.
+                client->close_after_response = 1;
+                web_client_respond_error(client, "400 Bad Request", "");
+            }
+            else
+            {
+                //The arrays may have come or gone since the last request, so the aggregator is built fresh each time.
+                struct cmc_aggregator *cmc_agg = cmc_aggregator_create(client->cmc_list, client->num_cmcs);
+                web_client_handle_requests(client, client->cmc_list, client->num_cmcs, cmc_agg);
+                cmc_aggregator_destroy(cmc_agg);
+            }
+        }
+
+        //There's no need to wait for the reactor to say that the socket is writable; it usually is, and if not, writev() says so.
+        int r = response_write(client->response, client->fd);
+        if (r < 0)
+        {
+            web_client_destroy(client);
+            return;
+        }
+        if (r > 0)
+            break;
+        response_clear(client->response);
+        //A response which has gone out completely counts as activity; one which is stuck in the socket doesn't.
+        timeout_schedule(client->idle_timeout, WEB_CLIENT_IDLE_TIMEOUT_MS);
     }
-    //otherwise ignore
-    return 0;
+
+    //Once the client has hung up, the socket is always readable, so it's only watched for writing. The same goes while the parser's
+    //buffer is full: what's left in the socket waits until there's room for it.
+    size_t space;
+    http_parser_get_space(client->parser, &space);
+    uint32_t interest = (client->peer_closed || space == 0) ? 0 : REACTOR_READ;
+    if (response_is_pending(client->response))
+        interest |= REACTOR_WRITE;
+    reactor_modify(client->reactor, client->fd, interest);
+}
+
+
+/**
+ * \fn      static void web_client_socket_event(struct reactor *this_reactor, int fd, uint32_t events, void *data)
+ * \details The reactor callback for a web_client's file descriptor. Reads whatever has arrived, then answers whatever can be answered
+ *          (see web_client_service()). Anything happening on the socket puts off the idle timeout.
+ * \param   this_reactor The reactor which reported the events.
+ * \param   fd The client's file descriptor.
+ * \param   events The REACTOR_* events which are ready.
+ * \param   data A pointer to the web_client which owns the file descriptor.
+ * \return  void
+ */
+static void web_client_socket_event(struct reactor *this_reactor, int fd, uint32_t events, void *data)
+{
+    struct web_client *client = data;
+
+    timeout_schedule(client->idle_timeout, WEB_CLIENT_IDLE_TIMEOUT_MS);
+    if ((events & (REACTOR_READ | REACTOR_ERROR)) && !client->peer_closed)
+    {
+        int r = web_client_socket_read(client);
+        if (r == -2)
+        {
+            web_client_destroy(client);
+            return;
+        }
+        if (r == -1)
+            client->peer_closed = 1;
+    }
+    web_client_service(client);
 }